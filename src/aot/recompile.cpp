@@ -0,0 +1,480 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <string>
+
+#include "chip8.hpp"
+#include "disasm.hpp"
+#include "flowgraph.hpp"
+
+/**
+ * Ahead-of-time recompiler. Loads a CHIP8_PLATFORM_CHIP8 ROM the way the interpreter
+ * does, recovers its control flow graph and writes a C++ source file that runs it with
+ * CHIP8_ENGINE_AOT once linked into a build (make aot AOT_ROMS="..." links them into
+ * chip8-batch-aot). Every instruction the analysis found gets a label, straight line code
+ * works on the registers in locals and jumps between instructions are gotos. Returns and
+ * computed jumps go through a switch over every instruction, and whatever isn't in it is
+ * left to the interpreter, as is everything once the program changes its own code.
+ **/
+
+// ==================================================================================================
+// Variables
+// ==================================================================================================
+// The register file of the generated code, names of the locals and where they live
+static const char *register_names[16] = {
+    "v0", "v1", "v2", "v3", "v4", "v5", "v6", "v7", "v8", "v9", "vA", "vB", "vC", "vD", "vE", "vF"
+};
+
+// Written before the code of every program
+static const char *prologue =
+    "// Registers live in locals while the program runs and go back to the interpreter\n"
+    "// before anything else looks at them\n"
+    "#define SAVE_REGISTERS() \\\n"
+    "    s.V[0x0] = v0; s.V[0x1] = v1; s.V[0x2] = v2; s.V[0x3] = v3; \\\n"
+    "    s.V[0x4] = v4; s.V[0x5] = v5; s.V[0x6] = v6; s.V[0x7] = v7; \\\n"
+    "    s.V[0x8] = v8; s.V[0x9] = v9; s.V[0xA] = vA; s.V[0xB] = vB; \\\n"
+    "    s.V[0xC] = vC; s.V[0xD] = vD; s.V[0xE] = vE; s.V[0xF] = vF; \\\n"
+    "    *s.I = i\n"
+    "#define LOAD_REGISTERS() \\\n"
+    "    v0 = s.V[0x0]; v1 = s.V[0x1]; v2 = s.V[0x2]; v3 = s.V[0x3]; \\\n"
+    "    v4 = s.V[0x4]; v5 = s.V[0x5]; v6 = s.V[0x6]; v7 = s.V[0x7]; \\\n"
+    "    v8 = s.V[0x8]; v9 = s.V[0x9]; vA = s.V[0xA]; vB = s.V[0xB]; \\\n"
+    "    vC = s.V[0xC]; vD = s.V[0xD]; vE = s.V[0xE]; vF = s.V[0xF]; \\\n"
+    "    i = *s.I\n\n";
+
+// ==================================================================================================
+// Helpers
+// ==================================================================================================
+/**
+ * Prints the command line usage of the recompiler
+ **/
+static void printUsage(const char *name) {
+    printf("Usage: %s [options] rom\n", name);
+    printf("  -o, --output F    Write the C++ source to F instead of stdout\n");
+    printf("  -g, --graph       Print the control flow graph instead of the source\n");
+    printf("  -q, --quiet       Don't report what the analysis found\n");
+}
+
+/**
+ * @param   graph       The program
+ * @param   address     Any address
+ * @return              true if the generated code has a label for it
+ **/
+static bool hasLabel(const CHIP8FlowGraph &graph, int address) {
+    return address <= CHIP8_MEMORY_MAX - 2 && (graph.flags[address] & CHIP8_FLOW_CODE);
+}
+
+/**
+ * @return  A statement that carries on at the address, natively if it was translated
+ **/
+static std::string jumpTo(const CHIP8FlowGraph &graph, int address) {
+    char text[64];
+    if(hasLabel(graph, address)) {
+        snprintf(text, sizeof(text), "goto a%03X;", address);
+    } else {
+        snprintf(text, sizeof(text), "{ pc = 0x%03X; goto leave; }", address);
+    }
+    return text;
+}
+
+/**
+ * Writes the statements of one instruction
+ *
+ * @param   out             Where to write them
+ * @param   graph           The program
+ * @param   address         Where the instruction is
+ * @return                  true if control goes on with the instruction after it
+ **/
+static bool emitInstruction(FILE *out, const CHIP8FlowGraph &graph, uint16_t address) {
+    uint16_t op = graph.opcode(address);
+    uint8_t X = (op & 0x0F00) >> 8;
+    uint8_t Y = (op & 0x00F0) >> 4;
+    uint8_t N = op & 0x000F;
+    uint8_t NN = op & 0x00FF;
+    uint16_t NNN = op & 0x0FFF;
+    const char *vx = register_names[X];
+    const char *vy = register_names[Y];
+    // The register the shifts read
+    const char *vs = (CHIP8_CLASSIC_QUIRKS & CHIP8_QUIRK_SHIFT_VX) ? vx : vy;
+    bool vf_reset = (CHIP8_CLASSIC_QUIRKS & CHIP8_QUIRK_VF_RESET) != 0;
+    bool fixed_i = (CHIP8_CLASSIC_QUIRKS & CHIP8_QUIRK_FIXED_I) != 0;
+    uint16_t next = address + 2;
+    std::string skip = jumpTo(graph, address + 4);
+
+    switch(op >> 12) {
+        case 0x0:
+            if(op == 0x00E0) {
+                fprintf(out, "    chip8.clearDisplay();\n");
+            } else if(op == 0x00EE) {
+                fprintf(out, "    *s.sp = (*s.sp - 1) & 0xF;\n");
+                fprintf(out, "    pc = s.stack[*s.sp];\n");
+                fprintf(out, "    goto dispatch;\n");
+                return false;
+            } else {
+                // Machine code routines and the later variants' instructions do nothing
+            }
+            return true;
+        case 0x1:
+            if(NNN == address) {
+                // Halt, the engine skips the rest of the budget
+                fprintf(out, "    pc = 0x%03X;\n    goto leave;\n", address);
+            } else {
+                fprintf(out, "    %s\n", jumpTo(graph, NNN).c_str());
+            }
+            return false;
+        case 0x2:
+            fprintf(out, "    s.stack[*s.sp] = 0x%03X;\n", next);
+            fprintf(out, "    *s.sp = (*s.sp + 1) & 0xF;\n");
+            fprintf(out, "    %s\n", jumpTo(graph, NNN).c_str());
+            return false;
+        case 0x3:
+            fprintf(out, "    if(%s == 0x%02X) %s\n", vx, NN, skip.c_str());
+            break;
+        case 0x4:
+            fprintf(out, "    if(%s != 0x%02X) %s\n", vx, NN, skip.c_str());
+            break;
+        case 0x5:
+            if(X == Y) {
+                // Always skips
+                fprintf(out, "    %s\n", skip.c_str());
+                return false;
+            }
+            fprintf(out, "    if(%s == %s) %s\n", vx, vy, skip.c_str());
+            break;
+        case 0x6:
+            fprintf(out, "    %s = 0x%02X;\n", vx, NN);
+            break;
+        case 0x7:
+            fprintf(out, "    %s += 0x%02X;\n", vx, NN);
+            break;
+        case 0x8:
+            switch(N) {
+                case 0x0: fprintf(out, "    %s = %s;\n", vx, vy); break;
+                case 0x1: fprintf(out, "    %s |= %s;\n", vx, vy); break;
+                case 0x2: fprintf(out, "    %s &= %s;\n", vx, vy); break;
+                case 0x3: fprintf(out, "    %s ^= %s;\n", vx, vy); break;
+                case 0x4: fprintf(out, "    vF = (%s + %s) > 0xFF;\n    %s += %s;\n", vx, vy, vx, vy); break;
+                case 0x5: fprintf(out, "    vF = %s;\n    %s -= %s;\n", (X == Y) ? "1" : (std::string(vx) + " >= " + vy).c_str(), vx, vy); break;
+                case 0x6: fprintf(out, "    vF = %s & 0x01;\n    %s = %s >> 1;\n", vs, vx, vs); break;
+                case 0x7: fprintf(out, "    vF = %s;\n    %s = %s - %s;\n", (X == Y) ? "1" : (std::string(vy) + " >= " + vx).c_str(), vx, vy, vx); break;
+                case 0xE: fprintf(out, "    vF = %s >> 7;\n    %s = %s << 1;\n", vs, vx, vs); break;
+                default: break;
+            }
+            if(vf_reset && N >= 0x1 && N <= 0x3) {
+                fprintf(out, "    vF = 0;\n");
+            }
+            break;
+        case 0x9:
+            // Never skips when both are the same register
+            if(X != Y) {
+                fprintf(out, "    if(%s != %s) %s\n", vx, vy, skip.c_str());
+            }
+            break;
+        case 0xA:
+            fprintf(out, "    i = 0x%03X;\n", NNN);
+            break;
+        case 0xB:
+            // Computed jump, the switch knows every instruction that was found
+            fprintf(out, "    pc = %s + 0x%03X;\n", (CHIP8_CLASSIC_QUIRKS & CHIP8_QUIRK_JUMP_VX) ? vx : "v0", NNN);
+            fprintf(out, "    goto dispatch;\n");
+            return false;
+        case 0xC:
+            fprintf(out, "    %s = CHIP8Aot::random(chip8) & 0x%02X;\n", vx, NN);
+            break;
+        case 0xD:
+            // Sprites are drawn by the interpreter, it only needs VX, VY and I and only changes VF
+            fprintf(out, "    s.V[0x%X] = %s;\n    s.V[0x%X] = %s;\n    *s.I = i;\n", X, vx, Y, vy);
+            fprintf(out, "    CHIP8Aot::interpret(chip8, 0x%04X);\n", op);
+            fprintf(out, "    vF = s.V[0xF];\n");
+            break;
+        case 0xE:
+            if(NN == 0x9E) {
+                fprintf(out, "    if(chip8.keyDown(%s)) %s\n", vx, skip.c_str());
+            } else if(NN == 0xA1) {
+                fprintf(out, "    if(!chip8.keyDown(%s)) %s\n", vx, skip.c_str());
+            }
+            break;
+        default:
+            switch(NN) {
+                case 0x07:
+                    fprintf(out, "    %s = *s.timer_delay;\n", vx);
+                    break;
+                case 0x0A:
+                    // The interpreter repeats the instruction until a key is down
+                    fprintf(out, "    *s.pc = 0x%03X;\n", next);
+                    fprintf(out, "    CHIP8Aot::interpret(chip8, 0x%04X);\n", op);
+                    fprintf(out, "    if(*s.pc != 0x%03X) { pc = 0x%03X; goto leave; }\n", next, address);
+                    fprintf(out, "    %s = s.V[0x%X];\n", vx, X);
+                    break;
+                case 0x15:
+                    fprintf(out, "    *s.timer_delay = %s;\n", vx);
+                    break;
+                case 0x18:
+                    fprintf(out, "    *s.timer_sound = %s;\n", vx);
+                    break;
+                case 0x1E:
+                    if(CHIP8_CLASSIC_QUIRKS & CHIP8_QUIRK_ADD_I_CARRY) {
+                        fprintf(out, "    vF = (i + %s > 0xFFF) ? 1 : 0;\n", vx);
+                    }
+                    fprintf(out, "    i += %s;\n", vx);
+                    break;
+                case 0x29:
+                    fprintf(out, "    i = 0x%03X + %s * 5;\n", CHIP8_FONT_ADDRESS, vx);
+                    break;
+                case 0x33:
+                case 0x55:
+                {
+                    if(NN == 0x33) {
+                        fprintf(out, "    s.memory[i & 0x%03X] = %s / 100;\n", CHIP8_ADDRESS_MASK, vx);
+                        fprintf(out, "    s.memory[(i + 1) & 0x%03X] = (%s / 10) %% 10;\n", CHIP8_ADDRESS_MASK, vx);
+                        fprintf(out, "    s.memory[(i + 2) & 0x%03X] = %s %% 10;\n", CHIP8_ADDRESS_MASK, vx);
+                    } else {
+                        for(int r = 0; r <= X; r++) {
+                            fprintf(out, "    s.memory[(i + %d) & 0x%03X] = %s;\n", r, CHIP8_ADDRESS_MASK, register_names[r]);
+                        }
+                    }
+                    // Only the writes the analysis couldn't rule out check the code
+                    bool checked = (graph.flags[address] & (CHIP8_FLOW_MAY_WRITE | CHIP8_FLOW_WRITES_CODE)) != 0;
+                    if(checked) {
+                        fprintf(out, "    CHIP8Aot::written(chip8, i, %d);\n", (NN == 0x33) ? 3 : X + 1);
+                    }
+                    if(NN == 0x55 && !fixed_i) {
+                        fprintf(out, "    i += %d;\n", X + 1);
+                    }
+                    if(checked) {
+                        fprintf(out, "    if(CHIP8Aot::codeChanged(chip8)) { pc = 0x%03X; goto leave; }\n", next);
+                    }
+                    break;
+                }
+                case 0x65:
+                    for(int r = 0; r <= X; r++) {
+                        fprintf(out, "    %s = s.memory[(i + %d) & 0x%03X];\n", register_names[r], r, CHIP8_ADDRESS_MASK);
+                    }
+                    if(!fixed_i) {
+                        fprintf(out, "    i += %d;\n", X + 1);
+                    }
+                    break;
+                default:
+                    // Not an instruction of the platform, leave it to the interpreter
+                    fprintf(out, "    SAVE_REGISTERS();\n    *s.pc = 0x%03X;\n", next);
+                    fprintf(out, "    CHIP8Aot::interpret(chip8, 0x%04X);\n", op);
+                    fprintf(out, "    LOAD_REGISTERS();\n");
+                    break;
+            }
+            break;
+    }
+    return true;
+}
+
+/**
+ * Writes the C++ source that runs the program
+ *
+ * @param   out     Where to write it
+ * @param   graph   The analysed program
+ * @param   name    File name of the ROM
+ * @param   hash    Hash of the ROM
+ **/
+static void emitProgram(FILE *out, const CHIP8FlowGraph &graph, const char *name, uint64_t hash) {
+    fprintf(out, "// Generated by chip8-aot from %s, run chip8-aot again instead of editing it\n", name);
+    fprintf(out, "// %d instructions in %d blocks, %d computed jumps, %d writes that may reach code\n",
+        graph.count(CHIP8_FLOW_CODE), (int)graph.blocks.size(), graph.count(CHIP8_FLOW_COMPUTED),
+        graph.count(CHIP8_FLOW_MAY_WRITE | CHIP8_FLOW_WRITES_CODE));
+    fprintf(out, "#include \"aot.hpp\"\n\n");
+    fprintf(out, "%s", prologue);
+
+    // The code bytes, so the engine can tell whether memory still holds them
+    fprintf(out, "static const uint8_t bytes[] = {");
+    int count = 0;
+    for(int address = 0; address < CHIP8_MEMORY_MAX; address++) {
+        if(graph.code_map[address]) {
+            fprintf(out, "%s0x%02X,", (count % 16 == 0) ? "\n    " : " ", graph.getByte(address));
+            count++;
+        }
+    }
+    fprintf(out, "\n};\n\n");
+
+    fprintf(out, "static const CHIP8AotRange ranges[] = {\n");
+    int ranges = 0;
+    int offset = 0;
+    for(int address = 0; address < CHIP8_MEMORY_MAX; ) {
+        if(!graph.code_map[address]) {
+            address++;
+            continue;
+        }
+        int length = 0;
+        while(address + length < CHIP8_MEMORY_MAX && graph.code_map[address + length]) {
+            length++;
+        }
+        fprintf(out, "    { 0x%03X, %d, %d },\n", address, length, offset);
+        offset += length;
+        address += length;
+        ranges++;
+    }
+    fprintf(out, "};\n\n");
+
+    fprintf(out, "static int run(CHIP8Interpreter &chip8, int cycles) {\n");
+    fprintf(out, "    CHIP8AotState s = CHIP8Aot::state(chip8);\n");
+    fprintf(out, "    uint8_t v0, v1, v2, v3, v4, v5, v6, v7, v8, v9, vA, vB, vC, vD, vE, vF;\n");
+    fprintf(out, "    uint16_t i;\n");
+    fprintf(out, "    uint16_t pc = *s.pc;\n");
+    fprintf(out, "    uint16_t opcode = *s.opcode;\n");
+    fprintf(out, "    LOAD_REGISTERS();\n");
+    fprintf(out, "    goto dispatch;\n\n");
+    fprintf(out, "dispatch:\n");
+    fprintf(out, "    switch(pc) {\n");
+    for(int address = 0; address <= CHIP8_MEMORY_MAX - 2; address++) {
+        if(hasLabel(graph, address)) {
+            fprintf(out, "        case 0x%03X: goto a%03X;\n", address, address);
+        }
+    }
+    fprintf(out, "        default: goto leave;\n");
+    fprintf(out, "    }\n");
+
+    size_t block = 0;
+    for(int address = 0; address <= CHIP8_MEMORY_MAX - 2; address++) {
+        if(!hasLabel(graph, address)) {
+            continue;
+        }
+        if(block < graph.blocks.size() && graph.blocks[block].start == address) {
+            fprintf(out, "\n    // Block of %d instructions\n", graph.blocks[block].length);
+            block++;
+        }
+
+        uint16_t op = graph.opcode(address);
+        char text[CHIP8_DISASM_MAX];
+        chip8Disassemble(op, text, sizeof(text));
+        fprintf(out, "a%03X: // %04X %s\n", address, op, text);
+        fprintf(out, "    if(cycles == 0) { pc = 0x%03X; goto leave; }\n", address);
+        fprintf(out, "    cycles--;\n");
+        fprintf(out, "    opcode = 0x%04X;\n", op);
+
+        if(emitInstruction(out, graph, address)) {
+            // Falls through unless the next label is somewhere else
+            int next = address + 2;
+            int following = address + 1;
+            while(following <= CHIP8_MEMORY_MAX - 2 && !hasLabel(graph, following)) {
+                following++;
+            }
+            if(following != next) {
+                fprintf(out, "    %s\n", jumpTo(graph, next).c_str());
+            }
+        }
+    }
+
+    fprintf(out, "\nleave:\n");
+    fprintf(out, "    SAVE_REGISTERS();\n");
+    fprintf(out, "    *s.pc = pc;\n");
+    fprintf(out, "    *s.opcode = opcode;\n");
+    fprintf(out, "    return cycles;\n");
+    fprintf(out, "}\n\n");
+
+    fprintf(out, "static CHIP8AotProgram program = { \"%s\", 0x%016llXULL, bytes, ranges, %d, run, NULL };\n",
+        name, (unsigned long long)hash, ranges);
+    fprintf(out, "static CHIP8AotRegistration registration(&program);\n");
+}
+
+/**
+ * Prints the blocks of the control flow graph with where they lead
+ **/
+static void printGraph(FILE *out, const CHIP8FlowGraph &graph) {
+    for(size_t b = 0; b < graph.blocks.size(); b++) {
+        const CHIP8FlowBlock &block = graph.blocks[b];
+        fprintf(out, "0x%03X-0x%03X %3d ->", block.start, block.start + block.length * 2 - 1, block.length);
+        for(int i = 0; i < block.successor_count; i++) {
+            fprintf(out, " 0x%03X", block.successors[i]);
+        }
+        if(block.flags & CHIP8_FLOW_RETURN) {
+            fprintf(out, " return");
+        }
+        if(block.flags & CHIP8_FLOW_COMPUTED) {
+            fprintf(out, " computed");
+        }
+        if(block.flags & CHIP8_FLOW_WRITES_CODE) {
+            fprintf(out, " [writes code]");
+        } else if(block.flags & CHIP8_FLOW_MAY_WRITE) {
+            fprintf(out, " [may write code]");
+        }
+        if(block.flags & CHIP8_FLOW_OUTSIDE) {
+            fprintf(out, " [leaves memory]");
+        }
+        fprintf(out, "\n");
+    }
+}
+
+// ==================================================================================================
+// Public Functions
+// ==================================================================================================
+int main(int argc, char *argv[]) {
+    const char *output = NULL;
+    const char *rom = NULL;
+    bool graph_only = false;
+    bool quiet = false;
+
+    for(int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        bool has_value = (i + 1) < argc;
+        if((!strcmp(arg, "-o") || !strcmp(arg, "--output")) && has_value) {
+            output = argv[++i];
+        } else if(!strcmp(arg, "-g") || !strcmp(arg, "--graph")) {
+            graph_only = true;
+        } else if(!strcmp(arg, "-q") || !strcmp(arg, "--quiet")) {
+            quiet = true;
+        } else if(!strcmp(arg, "-h") || !strcmp(arg, "--help")) {
+            printUsage(argv[0]);
+            return 0;
+        } else if(arg[0] == '-') {
+            fprintf(stderr, "Unknown option '%s'\n", arg);
+            printUsage(argv[0]);
+            return 1;
+        } else {
+            rom = arg;
+        }
+    }
+    if(rom == NULL) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    CHIP8Interpreter chip8;
+    CHIP8RomError error;
+    if(!chip8.loadRom(rom, &error)) {
+        fprintf(stderr, "%s: %s\n", rom, chip8RomErrorText(error));
+        return 1;
+    }
+    CHIP8FlowGraph graph;
+    graph.analyze(chip8);
+
+    const char *name = strrchr(rom, '/');
+    name = (name != NULL) ? name + 1 : rom;
+    if(!quiet) {
+        fprintf(stderr, "%s: %d instructions in %d blocks, %d returns, %d computed jumps, "
+            "%d writes into code, %d writes that may reach code\n", name,
+            graph.count(CHIP8_FLOW_CODE), (int)graph.blocks.size(), graph.count(CHIP8_FLOW_RETURN),
+            graph.count(CHIP8_FLOW_COMPUTED), graph.count(CHIP8_FLOW_WRITES_CODE), graph.count(CHIP8_FLOW_MAY_WRITE));
+    }
+
+    FILE *out = stdout;
+    if(output != NULL) {
+        out = fopen(output, "w");
+        if(out == NULL) {
+            fprintf(stderr, "Could not create '%s'\n", output);
+            return 1;
+        }
+    }
+    if(graph_only) {
+        printGraph(out, graph);
+    } else {
+        emitProgram(out, graph, name, chip8.romHash());
+    }
+    bool failed = ferror(out) != 0;
+    if(out != stdout) {
+        failed |= fclose(out) != 0;
+    }
+    if(failed) {
+        fprintf(stderr, "Writing the output failed\n");
+        return 1;
+    }
+    return 0;
+}
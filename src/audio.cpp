@@ -0,0 +1,77 @@
+#include <stdio.h>
+
+#include "audio.hpp"
+
+// The open device and where its callback takes samples from
+static SDL_AudioDeviceID device = 0;
+static CHIP8AudioRing *ring = NULL;
+static int buffer_size = AUDIO_DEFAULT_BUFFER;
+
+/**
+ * Called on SDL's audio thread whenever the device needs more samples
+ **/
+static void audioCallback(void *userdata, Uint8 *stream, int len) {
+	int16_t *samples = (int16_t *)stream;
+	int count = len / (int)sizeof(int16_t);
+	int got = ring->pop(samples, count);
+	// Ran dry, the emulation is paused, idle or behind
+	for(int i=got; i<count; i++) {
+		samples[i] = 0;
+	}
+}
+
+/**
+ * Opens the audio device and starts playing what the emulation pushes into the ring. The
+ * device's callback only pops from the ring and plays silence when it runs dry, it never
+ * waits for the emulation.
+ *
+ * @param	ring		Where the samples come from, must outlive the device
+ * @param	buffer		Samples the device asks for at a time, smaller starts and stops sounds sooner
+ * @return				True if the device was opened
+ **/
+bool audioInit(CHIP8AudioRing *ring, int buffer) {
+	if(SDL_InitSubSystem(SDL_INIT_AUDIO) < 0) {
+		printf("Audio could not initialize! SDL_Error: %s\n", SDL_GetError());
+		return false;
+	}
+	::ring = ring;
+
+	SDL_AudioSpec wanted;
+	SDL_memset(&wanted, 0, sizeof(wanted));
+	wanted.freq = AUDIO_SAMPLE_RATE;
+	wanted.format = AUDIO_S16SYS;
+	wanted.channels = 1;
+	wanted.samples = buffer;
+	wanted.callback = audioCallback;
+
+	// SDL converts to whatever the device wants
+	SDL_AudioSpec obtained;
+	device = SDL_OpenAudioDevice(NULL, 0, &wanted, &obtained, 0);
+	if(device == 0) {
+		printf("Audio device could not be opened! SDL_Error: %s\n", SDL_GetError());
+		SDL_QuitSubSystem(SDL_INIT_AUDIO);
+		return false;
+	}
+	buffer_size = obtained.samples;
+	SDL_PauseAudioDevice(device, 0);
+	return true;
+}
+
+/**
+ * @return	Samples the opened device asks for at a time
+ **/
+int audioBufferSize() {
+	return buffer_size;
+}
+
+/**
+ * Stops playing and closes the audio device, call it before videoClose()
+ **/
+void audioClose() {
+	if(device == 0) {
+		return;
+	}
+	SDL_CloseAudioDevice(device);
+	device = 0;
+	SDL_QuitSubSystem(SDL_INIT_AUDIO);
+}
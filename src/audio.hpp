@@ -0,0 +1,35 @@
+#ifndef AUDIO_H
+#define AUDIO_H
+
+#include <stdint.h>
+#include <SDL.h>
+
+#include "audioring.hpp"
+
+// Rate the audio device is opened at (Hz)
+#define AUDIO_SAMPLE_RATE		48000
+// Samples the device asks for at a time unless --audio-buffer says otherwise, about 5 ms
+#define AUDIO_DEFAULT_BUFFER	256
+
+/**
+ * Opens the audio device and starts playing what the emulation pushes into the ring. The
+ * device's callback only pops from the ring and plays silence when it runs dry, it never
+ * waits for the emulation.
+ *
+ * @param	ring		Where the samples come from, must outlive the device
+ * @param	buffer		Samples the device asks for at a time, smaller starts and stops sounds sooner
+ * @return				True if the device was opened
+ **/
+bool audioInit(CHIP8AudioRing *ring, int buffer);
+
+/**
+ * @return	Samples the opened device asks for at a time
+ **/
+int audioBufferSize();
+
+/**
+ * Stops playing and closes the audio device, call it before videoClose()
+ **/
+void audioClose();
+
+#endif // AUDIO_H
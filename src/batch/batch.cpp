@@ -0,0 +1,543 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <chrono>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "capture.hpp"
+#include "chip8.hpp"
+#include "movie.hpp"
+#include "scheduler.hpp"
+
+/**
+ * Headless batch runner. Runs every ROM given on the command line (or found in a
+ * given directory) for a fixed instruction/frame budget at uncapped speed and
+ * writes one CSV line of results per ROM. Only depends on the CHIP-8 core.
+ **/
+
+// ==================================================================================================
+// Variables
+// ==================================================================================================
+// A single ROM to run and the results of running it
+struct BatchJob {
+    std::string path;
+    bool loaded;
+    bool mismatch;              // Differential mode only: the engine diverged from the interpreter
+    uint64_t display_hash;
+    uint64_t instructions;
+    double wall_ms;
+};
+
+// Settings shared by all the workers
+struct BatchConfig {
+    uint64_t frames;            // Number of 60 Hz frames to run each ROM for
+    uint32_t cpu_frequency;     // Instructions per second, CHIP8Scheduler spreads them over the frames
+    int threads;                // Number of worker threads
+    CHIP8Engine engine;         // How the interpreters execute the ROMs
+    CHIP8Platform platform;     // Instruction set and quirks the ROMs are written for
+    bool diff;                  // Run a reference interpreter alongside and compare every frame
+    uint64_t seed;              // Seed of the random number generator behind CXNN
+    const char *output;         // Where to write the results (NULL for stdout)
+    const char *movie;          // Movie to replay on every ROM instead of running for a budget (NULL for none)
+    const char *capture;        // Directory to write a capture of every ROM to (NULL for none)
+    CHIP8CaptureFormat capture_format;
+    int capture_scale;          // Capture pixels per CHIP-8 pixel
+    bool capture_changed;       // Only capture the frames where the display changed
+    uint32_t palette[1 << CHIP8_PLANES];    // Capture colour of each pixel value
+};
+
+// The capture of the ROM a worker is running and the thread writing it
+struct BatchCapture {
+    CHIP8Capture capture;
+    std::thread writer;
+    bool active;
+};
+
+/**
+ * A double-ended queue of job indices owned by a worker. The owner takes work from
+ * the back while idle workers steal from the front.
+ **/
+struct WorkQueue {
+    std::mutex lock;
+    std::deque<size_t> jobs;
+};
+
+// ==================================================================================================
+// Helpers
+// ==================================================================================================
+/**
+ * Prints the command line usage of the batch runner
+ **/
+static void printUsage(const char *name) {
+    printf("Usage: %s [options] <rom|directory>...\n", name);
+    printf("  -f, --frames N    Frames (60 Hz) to run each ROM for (default 600)\n");
+    printf("  -c, --cycles N    Total instructions to run each ROM for (overrides --frames)\n");
+    printf("  -z, --hz N        CPU frequency used to convert frames to instructions (default 500)\n");
+    printf("  -j, --threads N   Number of worker threads (default: all cores)\n");
+    printf("  -e, --engine E    Execution engine: interpreter (default), cached, jit or aot (programs\n");
+    printf("                    recompiled by chip8-aot and linked in, see make aot)\n");
+    printf("  -p, --platform P  Platform: chip8 (default), cosmac, schip or xochip\n");
+    printf("  -d, --diff        Check the engine against the interpreter after every frame\n");
+    printf("  -s, --seed N      Seed for the CXNN random numbers (default: fixed)\n");
+    printf("  -o, --output F    Write the CSV results to F instead of stdout\n");
+    printf("  -m, --movie F     Replay the movie F, checking the display at its checkpoints. The\n");
+    printf("                    platform, seed and frequency come from the movie.\n");
+    printf("  -C, --capture D   Write every frame of each ROM to D/<rom>.<format>\n");
+    printf("  -F, --format F    Capture format: y4m (default), ppm or pbm\n");
+    printf("  -x, --scale N     Capture pixels per CHIP-8 high resolution pixel (default 4)\n");
+    printf("  -u, --changed     Only capture the frames where the display changed\n");
+    printf("  -P, --palette C   Capture colours as RRGGBB hex values separated by commas: unlit,\n");
+    printf("                    first plane, second plane, both planes\n");
+}
+
+/**
+ * Reads up to four comma separated RRGGBB colours over the start of a palette
+ *
+ * @return  false if the list isn't valid
+ **/
+static bool parsePalette(const char *text, uint32_t palette[1 << CHIP8_PLANES]) {
+    for(int i = 0; i < (1 << CHIP8_PLANES); i++) {
+        char *end;
+        unsigned long colour = strtoul(text, &end, 16);
+        if(end == text || colour > 0xFFFFFF) {
+            return false;
+        }
+        palette[i] = colour;
+        if(*end == 0) {
+            return true;
+        }
+        if(*end != ',') {
+            return false;
+        }
+        text = end + 1;
+    }
+    return false;
+}
+
+/**
+ * Adds a ROM to the job list. Directories are expanded (one level) into the files they contain.
+ **/
+static void addPath(std::vector<BatchJob> &jobs, const std::string &path) {
+    struct stat info;
+    if(stat(path.c_str(), &info) != 0) {
+        fprintf(stderr, "Could not find '%s'\n", path.c_str());
+        return;
+    }
+
+    if(S_ISDIR(info.st_mode)) {
+        DIR *dir = opendir(path.c_str());
+        if(dir == NULL) {
+            fprintf(stderr, "Could not open directory '%s'\n", path.c_str());
+            return;
+        }
+
+        std::vector<std::string> names;
+        struct dirent *entry;
+        while((entry = readdir(dir)) != NULL) {
+            std::string file = path + "/" + entry->d_name;
+            if(stat(file.c_str(), &info) == 0 && S_ISREG(info.st_mode)) {
+                names.push_back(file);
+            }
+        }
+        closedir(dir);
+
+        // Keep the output order stable between runs
+        std::sort(names.begin(), names.end());
+        for(size_t i = 0; i < names.size(); i++) {
+            addPath(jobs, names[i]);
+        }
+        return;
+    }
+
+    BatchJob job;
+    job.path = path;
+    job.loaded = false;
+    job.mismatch = false;
+    job.display_hash = 0;
+    job.instructions = 0;
+    job.wall_ms = 0;
+    jobs.push_back(job);
+}
+
+/**
+ * Loads the job's ROM, saying why if it can't
+ **/
+static bool loadJobRom(CHIP8Interpreter &chip8, const BatchJob &job) {
+    CHIP8RomError error;
+    if(!chip8.loadRom(job.path.c_str(), &error)) {
+        fprintf(stderr, "%s: %s\n", job.path.c_str(), chip8RomErrorText(error));
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Writer thread body, writes the capture's frames as they come in until it is finished
+ **/
+static void captureMain(CHIP8Capture *capture) {
+    while(capture->write()) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+}
+
+/**
+ * Starts capturing the job's ROM once it is loaded, if the configuration asks for it
+ **/
+static void startCapture(BatchCapture &capture, const CHIP8Interpreter &chip8, const BatchJob &job, const BatchConfig &config) {
+    capture.active = false;
+    if(config.capture == NULL) {
+        return;
+    }
+    size_t slash = job.path.find_last_of("/\\");
+    std::string name = (slash == std::string::npos) ? job.path : job.path.substr(slash + 1);
+    std::string path = std::string(config.capture) + "/" + name + "." + chip8CaptureFormatName(config.capture_format);
+    if(!capture.capture.open(path.c_str(), config.capture_format, chip8.getPlatform(), config.capture_scale,
+        config.palette, config.capture_changed)) {
+        fprintf(stderr, "%s: could not create capture '%s'\n", job.path.c_str(), path.c_str());
+        return;
+    }
+    capture.writer = std::thread(captureMain, &capture.capture);
+    capture.active = true;
+}
+
+/**
+ * Hands a finished frame to the capture, called after every timer update
+ **/
+static void captureFrame(const CHIP8Interpreter &chip8, void *user) {
+    BatchCapture *capture = (BatchCapture *)user;
+    if(capture->active) {
+        capture->capture.frame(chip8);
+    }
+}
+
+/**
+ * Waits for the writer to write the last frames and closes the capture
+ **/
+static void stopCapture(BatchCapture &capture, const BatchJob &job) {
+    if(!capture.active) {
+        return;
+    }
+    capture.capture.finish();
+    capture.writer.join();
+    if(!capture.capture.close()) {
+        fprintf(stderr, "%s: writing the capture failed\n", job.path.c_str());
+    }
+    if(capture.capture.framesDropped() > 0) {
+        fprintf(stderr, "%s: the capture writer fell behind, %llu frames were dropped\n", job.path.c_str(),
+            (unsigned long long)capture.capture.framesDropped());
+    }
+    capture.active = false;
+}
+
+/**
+ * Runs one ROM with the given interpreter and a reference interpreter side by side,
+ * stopping at the first frame where their states differ. Both start from the same seed
+ * so CXNN gives them the same values.
+ **/
+static void runDiffJob(CHIP8Interpreter &chip8, BatchJob &job, const BatchConfig &config, BatchCapture &capture) {
+    CHIP8Interpreter reference;
+    reference.setPlatform(config.platform);
+    reference.seed(config.seed);
+    job.loaded = loadJobRom(chip8, job) && reference.loadRom(job.path.c_str());
+    if(!job.loaded) {
+        return;
+    }
+
+    // Both are clocked in frames, so they run the same instructions between the same ticks
+    CHIP8Scheduler scheduler(CHIP8_TIMER_FREQUENCY, config.cpu_frequency);
+    CHIP8Scheduler reference_scheduler(CHIP8_TIMER_FREQUENCY, config.cpu_frequency);
+    startCapture(capture, chip8, job, config);
+    for(uint64_t frame = 0; frame < config.frames; frame++) {
+        int cycles = scheduler.due(frame + 1);
+        scheduler.run(chip8, cycles);
+        captureFrame(chip8, &capture);
+
+        reference_scheduler.run(reference, cycles);
+
+        job.instructions += cycles;
+        if(!chip8.sameState(reference)) {
+            fprintf(stderr, "%s: engine diverged from the interpreter in frame %llu\n",
+                job.path.c_str(), (unsigned long long)frame);
+            job.mismatch = true;
+            break;
+        }
+    }
+    job.display_hash = chip8.displayHash();
+}
+
+/**
+ * Replays the movie on one ROM, the ROM must be the one the movie was recorded with
+ **/
+static void runMovieJob(CHIP8Interpreter &chip8, BatchJob &job, const BatchConfig &config, BatchCapture &capture) {
+    CHIP8MoviePlayer player;
+    if(!player.open(config.movie)) {
+        fprintf(stderr, "%s: could not read movie '%s'\n", job.path.c_str(), config.movie);
+        return;
+    }
+    chip8.setPlatform(player.getPlatform());
+    chip8.seed(player.getSeed());
+    if(!loadJobRom(chip8, job)) {
+        return;
+    }
+    if(chip8.romHash() != player.getRomHash()) {
+        fprintf(stderr, "%s: not the ROM the movie was recorded with\n", job.path.c_str());
+        return;
+    }
+    job.loaded = true;
+
+    CHIP8MovieResult result;
+    startCapture(capture, chip8, job, config);
+    player.play(chip8, result, captureFrame, &capture);
+    job.instructions = result.instructions;
+    job.display_hash = chip8.displayHash();
+    job.mismatch = result.mismatches > 0;
+    if(job.mismatch) {
+        fprintf(stderr, "%s: %llu of %llu checkpoints differ, the first after %llu instructions\n", job.path.c_str(),
+            (unsigned long long)result.mismatches, (unsigned long long)result.checkpoints, (unsigned long long)result.first_mismatch);
+    }
+    if(!result.complete) {
+        fprintf(stderr, "%s: the movie was cut short\n", job.path.c_str());
+    }
+}
+
+/**
+ * Runs one ROM to completion with the given interpreter
+ **/
+static void runJob(CHIP8Interpreter &chip8, BatchJob &job, const BatchConfig &config) {
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    // Every ROM gets the same random numbers no matter which worker runs it
+    chip8.seed(config.seed);
+    BatchCapture capture;
+    capture.active = false;
+    if(config.movie != NULL) {
+        runMovieJob(chip8, job, config, capture);
+    } else if(config.diff) {
+        runDiffJob(chip8, job, config, capture);
+    } else if((job.loaded = loadJobRom(chip8, job))) {
+        // Clocked in frames, the fractions of an instruction carry over between them
+        CHIP8Scheduler scheduler(CHIP8_TIMER_FREQUENCY, config.cpu_frequency);
+        startCapture(capture, chip8, job, config);
+        for(uint64_t frame = 0; frame < config.frames; frame++) {
+            scheduler.run(chip8, scheduler.due(frame + 1));
+            captureFrame(chip8, &capture);
+        }
+        job.instructions = scheduler.getInstructions();
+        job.display_hash = chip8.displayHash();
+    }
+    stopCapture(capture, job);
+
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+    job.wall_ms = elapsed.count();
+}
+
+/**
+ * Takes the next job for a worker: first from its own queue and, once that is empty,
+ * by stealing from the other workers' queues.
+ *
+ * @return  false when there is no work left anywhere
+ **/
+static bool takeJob(std::vector<WorkQueue> &queues, int worker, size_t &job) {
+    {
+        WorkQueue &own = queues[worker];
+        std::lock_guard<std::mutex> guard(own.lock);
+        if(!own.jobs.empty()) {
+            job = own.jobs.back();
+            own.jobs.pop_back();
+            return true;
+        }
+    }
+
+    for(size_t i = 1; i < queues.size(); i++) {
+        WorkQueue &victim = queues[(worker + i) % queues.size()];
+        std::lock_guard<std::mutex> guard(victim.lock);
+        if(!victim.jobs.empty()) {
+            job = victim.jobs.front();
+            victim.jobs.pop_front();
+            return true;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * Worker thread body. Each worker owns a single interpreter which is reused for every ROM.
+ **/
+static void workerMain(std::vector<WorkQueue> *queues, int worker, std::vector<BatchJob> *jobs, const BatchConfig *config) {
+    CHIP8Interpreter *chip8 = new CHIP8Interpreter();
+    chip8->setEngine(config->engine);
+    chip8->setPlatform(config->platform);
+    size_t job;
+    while(takeJob(*queues, worker, job)) {
+        runJob(*chip8, (*jobs)[job], *config);
+    }
+    delete chip8;
+}
+
+// ==================================================================================================
+// Main
+// ==================================================================================================
+int main(int argc, char *argv[]) {
+    BatchConfig config;
+    config.frames = 600;
+    config.cpu_frequency = 500;
+    config.threads = std::thread::hardware_concurrency();
+    config.output = NULL;
+    config.engine = CHIP8_ENGINE_INTERPRETER;
+    config.platform = CHIP8_PLATFORM_CHIP8;
+    config.diff = false;
+    config.seed = CHIP8_DEFAULT_SEED;
+    config.movie = NULL;
+    config.capture = NULL;
+    config.capture_format = CHIP8_CAPTURE_Y4M;
+    config.capture_scale = 4;
+    config.capture_changed = false;
+    parsePalette("000000,FFFFFF,AAAAAA,555555", config.palette);
+
+    uint64_t cycles = 0;
+    int cpu_freq = 500;
+    std::vector<BatchJob> jobs;
+
+    for(int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        bool has_value = (i + 1) < argc;
+        if((!strcmp(arg, "-f") || !strcmp(arg, "--frames")) && has_value) {
+            config.frames = strtoull(argv[++i], NULL, 10);
+        } else if((!strcmp(arg, "-c") || !strcmp(arg, "--cycles")) && has_value) {
+            cycles = strtoull(argv[++i], NULL, 10);
+        } else if((!strcmp(arg, "-z") || !strcmp(arg, "--hz")) && has_value) {
+            cpu_freq = atoi(argv[++i]);
+        } else if((!strcmp(arg, "-j") || !strcmp(arg, "--threads")) && has_value) {
+            config.threads = atoi(argv[++i]);
+        } else if((!strcmp(arg, "-m") || !strcmp(arg, "--movie")) && has_value) {
+            config.movie = argv[++i];
+        } else if((!strcmp(arg, "-C") || !strcmp(arg, "--capture")) && has_value) {
+            config.capture = argv[++i];
+        } else if((!strcmp(arg, "-F") || !strcmp(arg, "--format")) && has_value) {
+            const char *name = argv[++i];
+            if(!chip8CaptureFormatFromName(name, config.capture_format)) {
+                fprintf(stderr, "Unknown capture format '%s'\n", name);
+                return 1;
+            }
+        } else if((!strcmp(arg, "-x") || !strcmp(arg, "--scale")) && has_value) {
+            config.capture_scale = atoi(argv[++i]);
+        } else if(!strcmp(arg, "-u") || !strcmp(arg, "--changed")) {
+            config.capture_changed = true;
+        } else if((!strcmp(arg, "-P") || !strcmp(arg, "--palette")) && has_value) {
+            const char *text = argv[++i];
+            if(!parsePalette(text, config.palette)) {
+                fprintf(stderr, "Invalid palette '%s'\n", text);
+                return 1;
+            }
+        } else if((!strcmp(arg, "-o") || !strcmp(arg, "--output")) && has_value) {
+            config.output = argv[++i];
+        } else if((!strcmp(arg, "-e") || !strcmp(arg, "--engine")) && has_value) {
+            const char *name = argv[++i];
+            if(!strcmp(name, "interpreter")) {
+                config.engine = CHIP8_ENGINE_INTERPRETER;
+            } else if(!strcmp(name, "cached")) {
+                config.engine = CHIP8_ENGINE_CACHED;
+            } else if(!strcmp(name, "jit")) {
+                config.engine = CHIP8_ENGINE_JIT;
+            } else if(!strcmp(name, "aot")) {
+                config.engine = CHIP8_ENGINE_AOT;
+            } else {
+                fprintf(stderr, "Unknown engine '%s'\n", name);
+                return 1;
+            }
+        } else if((!strcmp(arg, "-p") || !strcmp(arg, "--platform")) && has_value) {
+            const char *name = argv[++i];
+            if(!chip8PlatformFromName(name, config.platform)) {
+                fprintf(stderr, "Unknown platform '%s'\n", name);
+                return 1;
+            }
+        } else if(!strcmp(arg, "-d") || !strcmp(arg, "--diff")) {
+            config.diff = true;
+        } else if((!strcmp(arg, "-s") || !strcmp(arg, "--seed")) && has_value) {
+            config.seed = strtoull(argv[++i], NULL, 0);
+        } else if(arg[0] == '-') {
+            printUsage(argv[0]);
+            return 1;
+        } else {
+            addPath(jobs, arg);
+        }
+    }
+
+    if(jobs.empty()) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    config.cpu_frequency = (cpu_freq < 1) ? 1 : cpu_freq;
+    // An explicit instruction budget is rounded up to whole frames
+    if(cycles > 0) {
+        config.frames = (cycles * CHIP8_TIMER_FREQUENCY + config.cpu_frequency - 1) / config.cpu_frequency;
+    }
+    if(config.threads < 1) {
+        config.threads = 1;
+    }
+    if((size_t)config.threads > jobs.size()) {
+        config.threads = jobs.size();
+    }
+
+    // Deal the jobs out round-robin, idle workers will steal the rest
+    std::vector<WorkQueue> queues(config.threads);
+    for(size_t i = 0; i < jobs.size(); i++) {
+        queues[i % config.threads].jobs.push_back(i);
+    }
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    std::vector<std::thread> workers;
+    for(int i = 0; i < config.threads; i++) {
+        workers.push_back(std::thread(workerMain, &queues, i, &jobs, &config));
+    }
+    for(size_t i = 0; i < workers.size(); i++) {
+        workers[i].join();
+    }
+
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+
+    // Write the results in the order the ROMs were given
+    FILE *out = stdout;
+    if(config.output != NULL) {
+        out = fopen(config.output, "w");
+        if(out == NULL) {
+            fprintf(stderr, "Could not open '%s' for writing\n", config.output);
+            return 1;
+        }
+    }
+
+    int failed = 0;
+    uint64_t total_instructions = 0;
+    fprintf(out, "rom,status,display_hash,instructions,wall_ms\n");
+    for(size_t i = 0; i < jobs.size(); i++) {
+        const BatchJob &job = jobs[i];
+        if(!job.loaded || job.mismatch) {
+            failed++;
+        }
+        total_instructions += job.instructions;
+        fprintf(out, "%s,%s,%016llx,%llu,%.3f\n", job.path.c_str(), !job.loaded ? "load_error" : (job.mismatch ? "mismatch" : "ok"),
+            (unsigned long long)job.display_hash, (unsigned long long)job.instructions, job.wall_ms);
+    }
+
+    if(out != stdout) {
+        fclose(out);
+    }
+
+    fprintf(stderr, "Ran %u ROMs on %d threads in %.1f ms (%d failed, %.1f million instructions/second)\n",
+        (unsigned)jobs.size(), config.threads, elapsed.count(), failed,
+        total_instructions / (elapsed.count() * 1000.0));
+
+    return failed ? 2 : 0;
+}
@@ -0,0 +1,624 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+#include "chip8.hpp"
+#include "jit.hpp"
+#include "lockstep.hpp"
+#include "scheduler.hpp"
+
+/**
+ * Benchmark suite. Microbenchmarks run one opcode (or a small group of opcodes) over
+ * and over, macrobenchmarks run small synthetic programs the way the front end would,
+ * one frame of instructions at a time. The lockstep benchmarks run the macrobenchmark
+ * programs on many instances at once with CHIP8Lockstep, counting the instructions of
+ * every instance. Every result is the best of a few repeats and is
+ * written as CSV (default) or JSON so runs can be compared between releases.
+ **/
+
+// ==================================================================================================
+// Variables
+// ==================================================================================================
+// Where the body of a microbenchmark ROM starts and ends. 0x200 jumps over the
+// subroutine at 0x202 (a lone 00EE) and the last instruction jumps back to the start.
+#define MICRO_BODY_START    0x204
+#define MICRO_BODY_END      (CHIP8_MEMORY_MAX - 2)
+
+// Instructions run before timing starts
+#define WARMUP_INSTRUCTIONS 200000
+
+// A microbenchmark: the body of the ROM is the pattern repeated as many times as it fits
+struct MicroBench {
+    const char *name;
+    uint16_t pattern[2];
+    int length;             // Number of opcodes in the pattern
+    bool relative;          // The first opcode gets the address of the next instruction as NNN
+};
+
+static const MicroBench micro_benches[] = {
+    { "00E0",               { 0x00E0 },         1, false },
+    { "2NNN+00EE",          { 0x2202 },         1, false },    // Every call returns straight away
+    { "1NNN",               { 0x1000 },         1, true  },
+    { "3XNN",               { 0x3001 },         1, false },    // Never skips
+    { "4XNN",               { 0x4000 },         1, false },
+    { "5XY0",               { 0x5010 },         1, false },    // Always skips
+    { "6XNN",               { 0x6012 },         1, false },
+    { "7XNN",               { 0x7001 },         1, false },
+    { "8XY0",               { 0x8010 },         1, false },
+    { "8XY1",               { 0x8011 },         1, false },
+    { "8XY2",               { 0x8012 },         1, false },
+    { "8XY3",               { 0x8013 },         1, false },
+    { "8XY4",               { 0x8014 },         1, false },
+    { "8XY5",               { 0x8015 },         1, false },
+    { "8XY6",               { 0x8016 },         1, false },
+    { "8XY7",               { 0x8017 },         1, false },
+    { "8XYE",               { 0x801E },         1, false },
+    { "9XY0",               { 0x9010 },         1, false },
+    { "ANNN",               { 0xA100 },         1, false },
+    { "BNNN",               { 0xB000 },         1, true  },
+    { "CXNN",               { 0xC0FF },         1, false },
+    { "DXYN/N=1",           { 0xD011 },         1, false },
+    { "DXYN/N=4",           { 0xD014 },         1, false },
+    { "DXYN/N=8",           { 0xD018 },         1, false },
+    { "DXYN/N=15",          { 0xD01F },         1, false },
+    { "EX9E",               { 0xE09E },         1, false },    // No key is pressed, never skips
+    { "EXA1",               { 0xE0A1 },         1, false },    // Always skips
+    { "FX07",               { 0xF007 },         1, false },
+    { "FX15",               { 0xF015 },         1, false },
+    { "FX18",               { 0xF018 },         1, false },
+    { "FX1E",               { 0xF01E },         1, false },
+    { "FX29",               { 0xF029 },         1, false },
+    { "FX33",               { 0xF033 },         1, false },    // Writes over the font, never over code
+    // FX55 and FX65 move I, so I is reset before each one (to 0x100, below the program)
+    { "ANNN+FX55/X=0",      { 0xA100, 0xF055 }, 2, false },
+    { "ANNN+FX55/X=3",      { 0xA100, 0xF355 }, 2, false },
+    { "ANNN+FX55/X=7",      { 0xA100, 0xF755 }, 2, false },
+    { "ANNN+FX55/X=15",     { 0xA100, 0xFF55 }, 2, false },
+    { "ANNN+FX65/X=0",      { 0xA100, 0xF065 }, 2, false },
+    { "ANNN+FX65/X=3",      { 0xA100, 0xF365 }, 2, false },
+    { "ANNN+FX65/X=7",      { 0xA100, 0xF765 }, 2, false },
+    { "ANNN+FX65/X=15",     { 0xA100, 0xFF65 }, 2, false },
+};
+
+// One word of a synthetic ROM
+struct RomWord {
+    uint16_t address;
+    uint16_t value;
+};
+
+// Counts up, converts the count to decimal and draws it, then spins in an arithmetic loop
+static const RomWord rom_counter[] = {
+    { 0x200, 0x00E0 },  // CLS
+    { 0x202, 0x6A00 },  // VA = 0
+    { 0x204, 0x7A01 },  // loop: VA += 1
+    { 0x206, 0xA300 },  // I = 0x300
+    { 0x208, 0xFA33 },  // BCD of VA
+    { 0x20A, 0xF265 },  // V0..V2 = digits
+    { 0x20C, 0x6300 },  // V3 = 0 (x)
+    { 0x20E, 0x6400 },  // V4 = 0 (y)
+    { 0x210, 0xF029 },  // Draw the three digits
+    { 0x212, 0xD345 },
+    { 0x214, 0x7305 },
+    { 0x216, 0xF129 },
+    { 0x218, 0xD345 },
+    { 0x21A, 0x7305 },
+    { 0x21C, 0xF229 },
+    { 0x21E, 0xD345 },
+    { 0x220, 0x6B10 },  // VB = 16
+    { 0x222, 0x8CA0 },  // inner: VC = VA
+    { 0x224, 0x8CB4 },  // VC += VB
+    { 0x226, 0x8CC6 },  // VC >>= 1
+    { 0x228, 0x7BFF },  // VB -= 1
+    { 0x22A, 0x3B00 },  // skip if VB == 0
+    { 0x22C, 0x1222 },  // jump inner
+    { 0x22E, 0x1204 },  // jump loop
+};
+
+// Bounces an 8x8 sprite around the screen, erasing it by drawing it again
+static const RomWord rom_sprites[] = {
+    { 0x200, 0x00E0 },  // CLS
+    { 0x202, 0x6000 },  // V0 = x
+    { 0x204, 0x6100 },  // V1 = y
+    { 0x206, 0x6201 },  // V2 = dx
+    { 0x208, 0x6301 },  // V3 = dy
+    { 0x20A, 0xA240 },  // I = sprite
+    { 0x20C, 0xD018 },  // loop: draw at the old position
+    { 0x20E, 0x8024 },  // V0 += V2
+    { 0x210, 0x8134 },  // V1 += V3
+    { 0x212, 0xD018 },  // draw at the new position
+    { 0x214, 0x4038 },  // Bounce off the edges
+    { 0x216, 0x62FF },
+    { 0x218, 0x4000 },
+    { 0x21A, 0x6201 },
+    { 0x21C, 0x4118 },
+    { 0x21E, 0x63FF },
+    { 0x220, 0x4100 },
+    { 0x222, 0x6301 },
+    { 0x224, 0x120C },  // jump loop
+    { 0x240, 0x3C7E },  // sprite
+    { 0x242, 0xFFFF },
+    { 0x244, 0xFFFF },
+    { 0x246, 0x7E3C },
+};
+
+// Copies blocks of memory through the registers
+static const RomWord rom_memory[] = {
+    { 0x200, 0x6E00 },  // VE = 0
+    { 0x202, 0xA300 },  // loop: I = 0x300
+    { 0x204, 0xFD65 },  // V0..VD = memory
+    { 0x206, 0xA500 },  // I = 0x500 + VE
+    { 0x208, 0xFE1E },
+    { 0x20A, 0xFD55 },  // memory = V0..VD
+    { 0x20C, 0xFE33 },  // BCD of VE after the block
+    { 0x20E, 0x7E0E },  // VE += 14
+    { 0x210, 0x1202 },  // jump loop
+};
+
+// Draws random digits at random places and counts the collisions
+static const RomWord rom_random[] = {
+    { 0x200, 0x00E0 },  // CLS
+    { 0x202, 0xC03F },  // loop: V0 = random x
+    { 0x204, 0xC11F },  // V1 = random y
+    { 0x206, 0xC20F },  // V2 = random digit
+    { 0x208, 0xF229 },  // I = font(V2)
+    { 0x20A, 0xD015 },  // draw
+    { 0x20C, 0xF015 },  // delay = V0
+    { 0x20E, 0xF407 },  // V4 = delay
+    { 0x210, 0x3F01 },  // skip if there was a collision
+    { 0x212, 0x1202 },  // jump loop
+    { 0x214, 0x7E01 },  // VE += 1
+    { 0x216, 0xE39E },  // skip if key V3 is pressed
+    { 0x218, 0x1202 },  // jump loop
+    { 0x21A, 0x00E0 },  // CLS
+    { 0x21C, 0x1202 },  // jump loop
+};
+
+// Nested subroutine calls doing register arithmetic
+static const RomWord rom_calls[] = {
+    { 0x200, 0x6000 },  // V0 = 0
+    { 0x202, 0x2210 },  // loop: call a
+    { 0x204, 0x7001 },  // V0 += 1
+    { 0x206, 0x1202 },  // jump loop
+    { 0x210, 0x8014 },  // a: V0 += V1
+    { 0x212, 0x2220 },  // call b
+    { 0x214, 0x00EE },
+    { 0x220, 0x8105 },  // b: V1 -= V0
+    { 0x222, 0x2230 },  // call c
+    { 0x224, 0x00EE },
+    { 0x230, 0x8206 },  // c: V2 >>= 1
+    { 0x232, 0x820E },  // V2 <<= 1
+    { 0x234, 0x7201 },  // V2 += 1
+    { 0x236, 0x00EE },
+};
+
+// A synthetic program run by the macrobenchmarks
+struct MacroBench {
+    const char *name;
+    const RomWord *words;
+    size_t length;
+};
+
+#define MACRO_BENCH(name, rom) { name, rom, sizeof(rom) / sizeof(rom[0]) }
+
+static const MacroBench macro_benches[] = {
+    MACRO_BENCH("counter", rom_counter),
+    MACRO_BENCH("sprites", rom_sprites),
+    MACRO_BENCH("memory", rom_memory),
+    MACRO_BENCH("random", rom_random),
+    MACRO_BENCH("calls", rom_calls),
+};
+
+// Settings for the whole run
+struct BenchConfig {
+    uint64_t micro_instructions;    // Instructions per microbenchmark repeat
+    uint64_t macro_instructions;    // Instructions per macrobenchmark repeat
+    int repeats;                    // Every benchmark is run this many times, the fastest run counts
+    uint32_t cpu_frequency;         // Instructions per second, CHIP8Scheduler spreads them over the frames
+    int lanes;                      // Instances run by the lockstep benchmarks
+    bool micro;
+    bool macro;
+    bool lockstep;
+    bool json;
+    const char *filter;             // Only run benchmarks whose name contains this (NULL for all)
+    const char *output;             // Where to write the results (NULL for stdout)
+};
+
+// The outcome of one benchmark on one engine
+struct BenchResult {
+    std::string name;
+    const char *kind;
+    const char *engine;
+    uint64_t instructions;
+    double seconds;
+};
+
+// ==================================================================================================
+// Helpers
+// ==================================================================================================
+/**
+ * Prints the command line usage of the benchmark suite
+ **/
+static void printUsage(const char *name) {
+    printf("Usage: %s [options]\n", name);
+    printf("  -u, --micro-instructions N    Instructions per microbenchmark in millions (default 2)\n");
+    printf("  -n, --macro-instructions N    Instructions per macrobenchmark in millions (default 20)\n");
+    printf("  -r, --repeats N               Runs of each benchmark, the fastest counts (default 3)\n");
+    printf("  -z, --hz N                    CPU frequency used for frame figures (default 500)\n");
+    printf("  -e, --engine E                Only benchmark interpreter, cached or jit (default: all)\n");
+    printf("  -l, --lanes N                 Instances run by the lockstep benchmarks (default 256)\n");
+    printf("  -m, --micro                   Only run the microbenchmarks\n");
+    printf("  -M, --macro                   Only run the macrobenchmarks\n");
+    printf("  -s, --lockstep                Only run the lockstep benchmarks\n");
+    printf("  -f, --filter S                Only run benchmarks whose name contains S\n");
+    printf("  -j, --json                    Write JSON instead of CSV\n");
+    printf("  -o, --output F                Write the results to F instead of stdout\n");
+}
+
+static const char *engineName(CHIP8Engine engine) {
+    switch(engine) {
+        case CHIP8_ENGINE_CACHED:
+            return "cached";
+        case CHIP8_ENGINE_JIT:
+            return "jit";
+        default:
+            return "interpreter";
+    }
+}
+
+/**
+ * Builds the ROM of a microbenchmark
+ **/
+static void buildMicroRom(const MicroBench &bench, std::vector<uint8_t> &rom) {
+    std::vector<uint16_t> words;
+    words.push_back(0x1000 | MICRO_BODY_START);
+    words.push_back(0x00EE);
+
+    uint16_t address = MICRO_BODY_START;
+    while(address + 2 * bench.length <= MICRO_BODY_END) {
+        for(int i = 0; i < bench.length; i++) {
+            uint16_t opcode = bench.pattern[i];
+            if(i == 0 && bench.relative) {
+                opcode = (opcode & 0xF000) | (address + 2);
+            }
+            words.push_back(opcode);
+            address += 2;
+        }
+    }
+    while(address < MICRO_BODY_END) {
+        words.push_back(0x1000 | MICRO_BODY_START);
+        address += 2;
+    }
+    words.push_back(0x1000 | MICRO_BODY_START);
+
+    rom.clear();
+    for(size_t i = 0; i < words.size(); i++) {
+        rom.push_back(words[i] >> 8);
+        rom.push_back(words[i] & 0xFF);
+    }
+}
+
+/**
+ * Builds the ROM of a macrobenchmark
+ **/
+static void buildMacroRom(const MacroBench &bench, std::vector<uint8_t> &rom) {
+    rom.clear();
+    for(size_t i = 0; i < bench.length; i++) {
+        size_t offset = bench.words[i].address - 0x200;
+        if(rom.size() < offset + 2) {
+            rom.resize(offset + 2, 0);
+        }
+        rom[offset] = bench.words[i].value >> 8;
+        rom[offset + 1] = bench.words[i].value & 0xFF;
+    }
+}
+
+/**
+ * Runs instructions a frame at a time, the way the front end does
+ *
+ * @param   frame           The last frame run, counts up
+ * @param   instructions    Instructions to run, the last frame is cut short to end on it
+ **/
+static void runFrames(CHIP8Interpreter &chip8, CHIP8Scheduler &scheduler, uint64_t &frame, uint64_t instructions) {
+    uint64_t end = scheduler.getInstructions() + instructions;
+    while(scheduler.getInstructions() < end) {
+        uint64_t cycles = scheduler.due(++frame);
+        uint64_t left = end - scheduler.getInstructions();
+        scheduler.run(chip8, (int)((cycles < left) ? cycles : left));
+    }
+}
+
+/**
+ * Times a ROM on one engine, running it in frames of a 60th of config.cpu_frequency
+ * instructions
+ *
+ * @return  The time of the fastest repeat, in seconds
+ **/
+static double timeRom(const std::vector<uint8_t> &rom, CHIP8Engine engine, uint64_t instructions, const BenchConfig &config) {
+    CHIP8Interpreter chip8;
+    chip8.setEngine(engine);
+
+    double best = 0;
+    for(int repeat = 0; repeat < config.repeats; repeat++) {
+        chip8.loadRom(&rom[0], rom.size());
+        CHIP8Scheduler scheduler(CHIP8_TIMER_FREQUENCY, config.cpu_frequency);
+        uint64_t frame = 0;
+
+        // Let the engines decode and translate the hot code before the clock starts. The
+        // microbenchmark loops are long, so this has to go round them plenty of times.
+        runFrames(chip8, scheduler, frame, WARMUP_INSTRUCTIONS);
+
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        runFrames(chip8, scheduler, frame, instructions);
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+        if(repeat == 0 || elapsed.count() < best) {
+            best = elapsed.count();
+        }
+    }
+
+    return best;
+}
+
+/**
+ * Times a ROM on many instances stepped together, each with its own random seed, running
+ * them in frames of a 60th of config.cpu_frequency instructions
+ *
+ * @param   instructions    Instructions to run across all the instances
+ * @return                  The time of the fastest repeat, in seconds
+ **/
+static double timeLockstep(const std::vector<uint8_t> &rom, bool avx2, uint64_t instructions, const BenchConfig &config) {
+    CHIP8Lockstep lockstep(config.lanes);
+    lockstep.useAvx2(avx2);
+
+    double best = 0;
+    for(int repeat = 0; repeat < config.repeats; repeat++) {
+        CHIP8Interpreter chip8;
+        for(int lane = 0; lane < config.lanes; lane++) {
+            chip8.seed(lane);
+            chip8.loadRom(&rom[0], rom.size());
+            lockstep.importLane(lane, chip8);
+        }
+
+        // The lanes have no scheduler of their own, this one only counts out the
+        // instructions of each frame and the timers tick after it
+        CHIP8Scheduler clock(CHIP8_TIMER_FREQUENCY, config.cpu_frequency);
+        uint64_t frame = 0;
+        for(uint64_t run = 0; run < (uint64_t)(WARMUP_INSTRUCTIONS / config.lanes); ) {
+            int cycles = clock.due(++frame);
+            lockstep.run(cycles);
+            lockstep.timerUpdate();
+            run += cycles;
+        }
+
+        uint64_t per_lane = instructions / config.lanes;
+        std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+        for(uint64_t run = 0; run < per_lane; ) {
+            uint64_t cycles = clock.due(++frame);
+            if(cycles > per_lane - run) {
+                cycles = per_lane - run;
+            }
+            lockstep.run((int)cycles);
+            lockstep.timerUpdate();
+            run += cycles;
+        }
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+        if(repeat == 0 || elapsed.count() < best) {
+            best = elapsed.count();
+        }
+    }
+
+    return best;
+}
+
+static bool matchesFilter(const char *name, const BenchConfig &config) {
+    return config.filter == NULL || strstr(name, config.filter) != NULL;
+}
+
+/**
+ * Writes the results as CSV, one line per benchmark and engine
+ **/
+static void writeCsv(FILE *out, const std::vector<BenchResult> &results, const BenchConfig &config) {
+    fprintf(out, "benchmark,kind,engine,instructions,seconds,instructions_per_second,ns_per_instruction,frames_per_second\n");
+    for(size_t i = 0; i < results.size(); i++) {
+        const BenchResult &result = results[i];
+        double ips = result.instructions / result.seconds;
+        fprintf(out, "%s,%s,%s,%llu,%.6f,%.0f,%.3f,%.0f\n", result.name.c_str(), result.kind, result.engine,
+            (unsigned long long)result.instructions, result.seconds, ips, 1e9 / ips, ips * CHIP8_TIMER_FREQUENCY / config.cpu_frequency);
+    }
+}
+
+/**
+ * Writes the results as a JSON document
+ **/
+static void writeJson(FILE *out, const std::vector<BenchResult> &results, const BenchConfig &config) {
+    fprintf(out, "{\n  \"cpu_frequency\": %u,\n  \"repeats\": %d,\n  \"results\": [\n", config.cpu_frequency, config.repeats);
+    for(size_t i = 0; i < results.size(); i++) {
+        const BenchResult &result = results[i];
+        double ips = result.instructions / result.seconds;
+        fprintf(out, "    {\"benchmark\": \"%s\", \"kind\": \"%s\", \"engine\": \"%s\", \"instructions\": %llu, "
+            "\"seconds\": %.6f, \"instructions_per_second\": %.0f, \"ns_per_instruction\": %.3f, \"frames_per_second\": %.0f}%s\n",
+            result.name.c_str(), result.kind, result.engine, (unsigned long long)result.instructions, result.seconds,
+            ips, 1e9 / ips, ips * CHIP8_TIMER_FREQUENCY / config.cpu_frequency, (i + 1 < results.size()) ? "," : "");
+    }
+    fprintf(out, "  ]\n}\n");
+}
+
+// ==================================================================================================
+// Main
+// ==================================================================================================
+int main(int argc, char *argv[]) {
+    BenchConfig config;
+    config.micro_instructions = 2000000;
+    config.macro_instructions = 20000000;
+    config.repeats = 3;
+    config.lanes = 256;
+    config.micro = true;
+    config.macro = true;
+    config.lockstep = true;
+    config.json = false;
+    config.filter = NULL;
+    config.output = NULL;
+
+    int cpu_freq = 500;
+    std::vector<CHIP8Engine> engines;
+
+    for(int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        bool has_value = (i + 1) < argc;
+        if((!strcmp(arg, "-u") || !strcmp(arg, "--micro-instructions")) && has_value) {
+            config.micro_instructions = strtod(argv[++i], NULL) * 1000000;
+        } else if((!strcmp(arg, "-n") || !strcmp(arg, "--macro-instructions")) && has_value) {
+            config.macro_instructions = strtod(argv[++i], NULL) * 1000000;
+        } else if((!strcmp(arg, "-r") || !strcmp(arg, "--repeats")) && has_value) {
+            config.repeats = atoi(argv[++i]);
+        } else if((!strcmp(arg, "-z") || !strcmp(arg, "--hz")) && has_value) {
+            cpu_freq = atoi(argv[++i]);
+        } else if((!strcmp(arg, "-e") || !strcmp(arg, "--engine")) && has_value) {
+            const char *name = argv[++i];
+            if(!strcmp(name, "interpreter")) {
+                engines.push_back(CHIP8_ENGINE_INTERPRETER);
+            } else if(!strcmp(name, "cached")) {
+                engines.push_back(CHIP8_ENGINE_CACHED);
+            } else if(!strcmp(name, "jit")) {
+                engines.push_back(CHIP8_ENGINE_JIT);
+            } else {
+                fprintf(stderr, "Unknown engine '%s'\n", name);
+                return 1;
+            }
+        } else if((!strcmp(arg, "-l") || !strcmp(arg, "--lanes")) && has_value) {
+            config.lanes = atoi(argv[++i]);
+        } else if(!strcmp(arg, "-m") || !strcmp(arg, "--micro")) {
+            config.macro = false;
+            config.lockstep = false;
+        } else if(!strcmp(arg, "-M") || !strcmp(arg, "--macro")) {
+            config.micro = false;
+            config.lockstep = false;
+        } else if(!strcmp(arg, "-s") || !strcmp(arg, "--lockstep")) {
+            config.micro = false;
+            config.macro = false;
+        } else if((!strcmp(arg, "-f") || !strcmp(arg, "--filter")) && has_value) {
+            config.filter = argv[++i];
+        } else if(!strcmp(arg, "-j") || !strcmp(arg, "--json")) {
+            config.json = true;
+        } else if((!strcmp(arg, "-o") || !strcmp(arg, "--output")) && has_value) {
+            config.output = argv[++i];
+        } else {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    config.cpu_frequency = (cpu_freq < 1) ? 1 : cpu_freq;
+    if(config.repeats < 1) {
+        config.repeats = 1;
+    }
+    if(config.lanes < 1) {
+        config.lanes = 1;
+    }
+    if(engines.empty()) {
+        engines.push_back(CHIP8_ENGINE_INTERPRETER);
+        engines.push_back(CHIP8_ENGINE_CACHED);
+        if(CHIP8Jit::supported()) {
+            engines.push_back(CHIP8_ENGINE_JIT);
+        }
+    }
+
+    std::vector<BenchResult> results;
+    std::vector<uint8_t> rom;
+
+    if(config.micro) {
+        for(size_t i = 0; i < sizeof(micro_benches) / sizeof(micro_benches[0]); i++) {
+            const MicroBench &bench = micro_benches[i];
+            if(!matchesFilter(bench.name, config)) {
+                continue;
+            }
+            buildMicroRom(bench, rom);
+            for(size_t e = 0; e < engines.size(); e++) {
+                BenchResult result;
+                result.name = bench.name;
+                result.kind = "micro";
+                result.engine = engineName(engines[e]);
+                result.instructions = config.micro_instructions;
+                result.seconds = timeRom(rom, engines[e], config.micro_instructions, config);
+                results.push_back(result);
+                fprintf(stderr, "%-16s %-12s %8.3f ns/instruction\n", bench.name, result.engine,
+                    result.seconds * 1e9 / result.instructions);
+            }
+        }
+    }
+
+    if(config.macro) {
+        for(size_t i = 0; i < sizeof(macro_benches) / sizeof(macro_benches[0]); i++) {
+            const MacroBench &bench = macro_benches[i];
+            if(!matchesFilter(bench.name, config)) {
+                continue;
+            }
+            buildMacroRom(bench, rom);
+            for(size_t e = 0; e < engines.size(); e++) {
+                BenchResult result;
+                result.name = bench.name;
+                result.kind = "macro";
+                result.engine = engineName(engines[e]);
+                result.instructions = config.macro_instructions;
+                result.seconds = timeRom(rom, engines[e], config.macro_instructions, config);
+                results.push_back(result);
+                fprintf(stderr, "%-16s %-12s %8.3f ns/instruction\n", bench.name, result.engine,
+                    result.seconds * 1e9 / result.instructions);
+            }
+        }
+    }
+
+    if(config.lockstep) {
+        // The scalar kernels for comparison, and AVX2 where this CPU has it
+        std::vector<bool> kernels;
+        kernels.push_back(false);
+        if(CHIP8Lockstep::vectorized()) {
+            kernels.push_back(true);
+        }
+        for(size_t i = 0; i < sizeof(macro_benches) / sizeof(macro_benches[0]); i++) {
+            const MacroBench &bench = macro_benches[i];
+            if(!matchesFilter(bench.name, config)) {
+                continue;
+            }
+            buildMacroRom(bench, rom);
+            for(size_t k = 0; k < kernels.size(); k++) {
+                BenchResult result;
+                result.name = bench.name;
+                result.kind = "lockstep";
+                result.engine = kernels[k] ? "lockstep-avx2" : "lockstep-scalar";
+                result.instructions = config.macro_instructions / config.lanes * config.lanes;
+                result.seconds = timeLockstep(rom, kernels[k], config.macro_instructions, config);
+                results.push_back(result);
+                fprintf(stderr, "%-16s %-16s %8.3f ns/instruction\n", bench.name, result.engine,
+                    result.seconds * 1e9 / result.instructions);
+            }
+        }
+    }
+
+    FILE *out = stdout;
+    if(config.output != NULL) {
+        out = fopen(config.output, "w");
+        if(out == NULL) {
+            fprintf(stderr, "Could not open '%s' for writing\n", config.output);
+            return 1;
+        }
+    }
+
+    if(config.json) {
+        writeJson(out, results, config);
+    } else {
+        writeCsv(out, results, config);
+    }
+
+    if(out != stdout) {
+        fclose(out);
+    }
+
+    return 0;
+}
@@ -0,0 +1,142 @@
+#include <string.h>
+
+#include "aot.hpp"
+
+// ==================================================================================================
+// Variables
+// ==================================================================================================
+// Every registered program. Constant initialised, so it is ready before any registration runs.
+static CHIP8AotProgram *programs = NULL;
+
+// ==================================================================================================
+// Public Functions
+// ==================================================================================================
+/**
+ * @param   program     The program to add, must live as long as the process
+ **/
+CHIP8AotRegistration::CHIP8AotRegistration(CHIP8AotProgram *program) {
+    program->next = programs;
+    programs = program;
+}
+
+/**
+ * @param   chip8   The interpreter the engine belongs to
+ **/
+CHIP8Aot::CHIP8Aot(const CHIP8Interpreter &chip8) {
+    memory = chip8.classic_memory;      // Only CHIP-8 programs are recompiled, their memory is this
+    invalidate();
+}
+
+/**
+ * Executes the given number of instructions, in the recompiled program wherever it
+ * covers the code and the interpreter everywhere else
+ *
+ * @param   chip8   The interpreter whose state is executed on
+ * @param   cycles  The number of instructions to execute
+ **/
+void CHIP8Aot::execute(CHIP8Interpreter &chip8, int cycles) {
+    if(!selected) {
+        select(chip8);
+    }
+
+    while(cycles > 0) {
+        if(program != NULL && changed == 0) {
+            int left = program->run(chip8, cycles);
+
+            // Same guard as step()
+            if(chip8.pc > CHIP8_MEMORY_MAX) {
+                chip8.pc = 0;
+            }
+            if(left != cycles) {
+                // The program leaves at the loops that wait for a key or a halt
+                cycles = chip8.skipIdle(left);
+                continue;
+            }
+        }
+
+        chip8.step();
+        cycles--;
+    }
+}
+
+/**
+ * Forgets which program goes with the memory, it is looked up again before the next
+ * instruction. Needed whenever a ROM or state is loaded.
+ **/
+void CHIP8Aot::invalidate() {
+    program = NULL;
+    selected = false;
+    changed = 0;
+    memset(code_map, 0, sizeof(code_map));
+    memset(differs, 0, sizeof(differs));
+}
+
+/**
+ * Checks code bytes the program wrote to. The recompiled program stops running while any
+ * of them differs from the code it was made from, and runs again once they all match.
+ *
+ * @param   address     The first address written to
+ * @param   length      The number of bytes written
+ **/
+void CHIP8Aot::invalidate(uint16_t address, int length) {
+    for(int i = 0; i < length; i++) {
+        uint16_t written = (address + i) & CHIP8_ADDRESS_MASK;
+        if(!code_map[written]) {
+            continue;
+        }
+        uint8_t now = memory[written] != expected[written];
+        changed += now - differs[written];
+        differs[written] = now;
+    }
+}
+
+/**
+ * @param   rom_hash    CHIP8Interpreter::hashRom() of a ROM
+ * @return              The program recompiled from that ROM, NULL if none was linked in
+ **/
+const CHIP8AotProgram *CHIP8Aot::find(uint64_t rom_hash) {
+    for(const CHIP8AotProgram *program = programs; program != NULL; program = program->next) {
+        if(program->rom_hash == rom_hash) {
+            return program;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Executes one instruction in the interpreter, for the recompiled programs. The program
+ * counter must already point past it.
+ *
+ * @param   chip8   The interpreter whose state is executed on
+ * @param   opcode  The instruction
+ **/
+void CHIP8Aot::interpret(CHIP8Interpreter &chip8, uint16_t opcode) {
+    chip8.opcode = opcode;
+    (chip8.*(chip8.opcodeTable[opcode >> 12]))();
+}
+
+// ==================================================================================================
+// Private Functions
+// ==================================================================================================
+/**
+ * Looks up the program for the loaded ROM and compares its code with memory
+ **/
+void CHIP8Aot::select(const CHIP8Interpreter &chip8) {
+    invalidate();
+    selected = true;
+    program = find(chip8.rom_hash);
+    if(program == NULL) {
+        return;
+    }
+
+    for(int r = 0; r < program->range_count; r++) {
+        const CHIP8AotRange &range = program->ranges[r];
+        for(int i = 0; i < range.length; i++) {
+            uint16_t address = (range.address + i) & CHIP8_ADDRESS_MASK;
+            code_map[address] = 1;
+            expected[address] = program->bytes[range.offset + i];
+            differs[address] = memory[address] != expected[address];
+            changed += differs[address];
+        }
+    }
+}
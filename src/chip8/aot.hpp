@@ -0,0 +1,110 @@
+#ifndef CHIP8_AOT_H
+#define CHIP8_AOT_H
+
+#include <stdint.h>
+
+#include "chip8.hpp"
+
+/**
+ * Bytes of memory a recompiled program was made from, everything the translated
+ * instructions cover
+ **/
+struct CHIP8AotRange {
+    uint16_t address;       // First address
+    uint16_t length;        // Number of bytes
+    uint32_t offset;        // Where the bytes start in CHIP8AotProgram::bytes
+};
+
+/**
+ * Runs a recompiled program from the interpreter's program counter until the budget is
+ * spent or it reaches code it doesn't have, and leaves the interpreter as step() would
+ *
+ * @param   chip8   The interpreter whose state is executed on
+ * @param   cycles  The number of instructions it may execute, at least 1
+ * @return          The number left, the same number if it couldn't execute any
+ **/
+typedef int (*CHIP8AotFunction)(CHIP8Interpreter &chip8, int cycles);
+
+/**
+ * A ROM that chip8-aot turned into C++. Its source registers it when the program starts
+ * and CHIP8_ENGINE_AOT picks it for interpreters with the same ROM loaded.
+ **/
+struct CHIP8AotProgram {
+    const char *name;               // File name of the ROM
+    uint64_t rom_hash;              // CHIP8Interpreter::hashRom() of the ROM
+    const uint8_t *bytes;           // Code the program was made from
+    const CHIP8AotRange *ranges;
+    int range_count;
+    CHIP8AotFunction run;
+    CHIP8AotProgram *next;          // Next registered program
+};
+
+/**
+ * Where the interpreter keeps the state a recompiled program works on
+ **/
+struct CHIP8AotState {
+    uint8_t *V;
+    uint16_t *I;
+    uint16_t *pc;
+    uint16_t *opcode;
+    uint16_t *sp;
+    uint16_t *stack;
+    uint8_t *memory;
+    uint8_t *timer_delay;
+    uint8_t *timer_sound;
+};
+
+/**
+ * Adds a program to the ones CHIP8_ENGINE_AOT can use, every generated source has one
+ * of these as a static object
+ **/
+class CHIP8AotRegistration {
+    public:
+        CHIP8AotRegistration(CHIP8AotProgram *program);
+};
+
+/**
+ * Execution engine for programs recompiled ahead of time.
+ *
+ * chip8-aot recovers the control flow graph of a ROM and emits a C++ function with a
+ * label for every instruction it found, which is linked into the build. This engine
+ * looks the program up by the ROM hash and runs it for as long as the code in memory
+ * is the code it was made from. Anything the program doesn't cover (computed jumps to
+ * addresses the analysis didn't reach, code changed by the program itself) is stepped
+ * by the interpreter until control is back in known code.
+ **/
+class CHIP8Aot {
+    public:
+        // Non-zero for every byte of memory the recompiled program was made from
+        uint8_t code_map[CHIP8_MEMORY_MAX];
+
+        CHIP8Aot(const CHIP8Interpreter &chip8);
+        void execute(CHIP8Interpreter &chip8, int cycles);
+        void invalidate();
+        void invalidate(uint16_t address, int length);
+        static const CHIP8AotProgram *find(uint64_t rom_hash);
+
+        // ======================================== Generated Code ========================================
+        // What the recompiled programs use to reach the interpreter
+        static CHIP8AotState state(CHIP8Interpreter &chip8) {
+            CHIP8AotState s = { chip8.V, &chip8.I, &chip8.pc, &chip8.opcode, &chip8.sp, chip8.stack, chip8.memory,
+                &chip8.timer_delay, &chip8.timer_sound };
+            return s;
+        }
+        static uint8_t random(CHIP8Interpreter &chip8) { return chip8.randomByte(); }
+        static void written(CHIP8Interpreter &chip8, uint16_t address, int length) { chip8.codeWritten(address, length); }
+        static bool codeChanged(const CHIP8Interpreter &chip8) { return chip8.aot->changed != 0; }
+        static void interpret(CHIP8Interpreter &chip8, uint16_t opcode);
+
+    private:
+        const uint8_t *memory;              // Memory of the interpreter this engine belongs to
+        const CHIP8AotProgram *program;     // Program for the loaded ROM, NULL if there is none
+        bool selected;                      // False until program is looked up for the memory as it is now
+        uint8_t expected[CHIP8_MEMORY_MAX]; // The program's code, at the addresses code_map marks
+        uint8_t differs[CHIP8_MEMORY_MAX];  // Non-zero for every code byte memory no longer matches
+        int changed;                        // Number of code bytes that differ, the program only runs at 0
+
+        void select(const CHIP8Interpreter &chip8);
+};
+
+#endif // CHIP8_AOT_H
@@ -0,0 +1,72 @@
+#include "audioring.hpp"
+
+// ==================================================================================================
+// Public Functions
+// ==================================================================================================
+/**
+ * @param   capacity    Most samples the ring holds, rounded up to a power of two
+ **/
+CHIP8AudioRing::CHIP8AudioRing(uint32_t capacity) {
+    size = 1;
+    while(size < capacity) {
+        size <<= 1;
+    }
+    samples_buffer.resize(size);
+    head.store(0);
+    tail.store(0);
+}
+
+/**
+ * @return  Samples waiting to be popped, only a snapshot when called from the producer
+ **/
+uint32_t CHIP8AudioRing::available() const {
+    return tail.load(std::memory_order_acquire) - head.load(std::memory_order_acquire);
+}
+
+/**
+ * Adds samples to the back of the ring. Only call this from the producer thread.
+ *
+ * @param   samples The samples to add
+ * @param   count   Number of samples
+ * @param   limit   Most samples to let the ring hold, what would go past it is dropped
+ *                  so the consumer is never more than this far behind
+ * @return          Number of samples added
+ **/
+int CHIP8AudioRing::push(const int16_t *samples, int count, uint32_t limit) {
+    uint32_t position = tail.load(std::memory_order_relaxed);
+    uint32_t used = position - head.load(std::memory_order_acquire);
+    if(limit > size) {
+        limit = size;
+    }
+    uint32_t space = (used < limit) ? limit - used : 0;
+    if((uint32_t)count > space) {
+        count = space;
+    }
+
+    for(int i=0; i<count; i++) {
+        samples_buffer[(position + i) & (size - 1)] = samples[i];
+    }
+    tail.store(position + count, std::memory_order_release);
+    return count;
+}
+
+/**
+ * Takes samples from the front of the ring. Only call this from the consumer thread.
+ *
+ * @param   samples Receives the samples
+ * @param   count   Most samples to take
+ * @return          Number of samples taken, less than count when the ring ran dry
+ **/
+int CHIP8AudioRing::pop(int16_t *samples, int count) {
+    uint32_t position = head.load(std::memory_order_relaxed);
+    uint32_t used = tail.load(std::memory_order_acquire) - position;
+    if((uint32_t)count > used) {
+        count = used;
+    }
+
+    for(int i=0; i<count; i++) {
+        samples[i] = samples_buffer[(position + i) & (size - 1)];
+    }
+    head.store(position + count, std::memory_order_release);
+    return count;
+}
@@ -0,0 +1,33 @@
+#ifndef CHIP8_AUDIORING_H
+#define CHIP8_AUDIORING_H
+
+#include <stdint.h>
+#include <atomic>
+#include <vector>
+
+/**
+ * Lock-free ring of audio samples from one producer thread (the one running the
+ * interpreter) to one consumer thread (the audio device's callback). The storage is
+ * allocated once up front, pushing and popping never allocate or wait: samples that
+ * don't fit are dropped and a short pop is the consumer's to fill with silence.
+ **/
+class CHIP8AudioRing {
+    public:
+        CHIP8AudioRing(uint32_t capacity);
+        uint32_t capacity() const { return size; }
+        uint32_t available() const;
+
+        // ======================================== Producer ========================================
+        int push(const int16_t *samples, int count, uint32_t limit);
+
+        // ======================================== Consumer ========================================
+        int pop(int16_t *samples, int count);
+
+    private:
+        std::vector<int16_t> samples_buffer;
+        uint32_t size;                  // Capacity, a power of two
+        std::atomic<uint32_t> head;     // Next sample to pop, only advanced by the consumer
+        std::atomic<uint32_t> tail;     // Next free slot, only advanced by the producer
+};
+
+#endif // CHIP8_AUDIORING_H
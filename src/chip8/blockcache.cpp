@@ -0,0 +1,400 @@
+#include <stdint.h>
+#include <string.h>
+
+#include "blockcache.hpp"
+
+// Labels as values are a GNU extension, other compilers get a switch per instruction instead
+#if defined(__GNUC__)
+#define CHIP8_THREADED_DISPATCH
+#endif
+
+/**
+ * Every kind of decoded instruction. Instructions that are rarely hot or that need
+ * the interpreter's full behavior (CXNN, DXYN, EXxx, FX0A, FX33, FX55) are executed by
+ * calling the interpreter's own opcode function with the raw opcode.
+ **/
+#define CHIP8_BLOCK_KINDS(KIND) \
+    KIND(INTERPRET) KIND(INTERPRET_END) KIND(NOP) \
+    KIND(CLS) KIND(RET) KIND(JP) KIND(CALL) \
+    KIND(SE_XNN) KIND(SNE_XNN) KIND(SE_XY) KIND(SNE_XY) \
+    KIND(LD_XNN) KIND(ADD_XNN) \
+    KIND(LD_XY) KIND(OR) KIND(AND) KIND(XOR) KIND(ADD_XY) KIND(SUB) KIND(SHR) KIND(SUBN) KIND(SHL) \
+    KIND(LD_I) KIND(JP_V0) \
+    KIND(LD_X_DT) KIND(LD_DT) KIND(LD_ST) KIND(ADD_I) KIND(LD_F) KIND(LOAD)
+
+#define KIND_ENUM(name) KIND_##name,
+enum {
+    CHIP8_BLOCK_KINDS(KIND_ENUM)
+    KIND_COUNT
+};
+
+// ==================================================================================================
+// Public Functions
+// ==================================================================================================
+CHIP8BlockCache::CHIP8BlockCache() {
+    invalidate();
+}
+
+/**
+ * Drops every decoded block
+ **/
+void CHIP8BlockCache::invalidate() {
+    blocks.clear();
+    instructions.clear();
+    memset(code_map, 0, sizeof(code_map));
+    for(int i = 0; i < CHIP8_MEMORY_MAX; i++) {
+        block_index[i] = -1;
+    }
+}
+
+/**
+ * Drops the blocks that include any of the given bytes
+ *
+ * @param   address     The first address written to
+ * @param   length      The number of bytes written
+ **/
+void CHIP8BlockCache::invalidate(uint16_t address, int length) {
+    // Dropped blocks keep their records, start over once too many have piled up
+    if(instructions.size() > CHIP8_BLOCK_CACHE_LIMIT) {
+        invalidate();
+        return;
+    }
+
+    int start = address - (CHIP8_BLOCK_MAX_LENGTH * 2 - 1);
+    if(start < 0) {
+        start = 0;
+    }
+    for(; start < address + length && start < CHIP8_MEMORY_MAX; start++) {
+        int32_t index = block_index[start];
+        if(index >= 0 && start + blocks[index].length * 2 > address) {
+            block_index[start] = -1;
+        }
+    }
+}
+
+/**
+ * Executes the given number of instructions, decoding new blocks as they are reached.
+ * A block that does not fit in the remaining cycles is only partly executed, so the
+ * interpreter always ends up in exactly the state step() would have left it in.
+ *
+ * @param   chip8   The interpreter whose state is executed on
+ * @param   cycles  The number of instructions to execute
+ **/
+void CHIP8BlockCache::execute(CHIP8Interpreter &chip8, int cycles) {
+#ifdef CHIP8_THREADED_DISPATCH
+    #define KIND_LABEL(name) &&op_##name,
+    static const void *const handlers[KIND_COUNT] = { CHIP8_BLOCK_KINDS(KIND_LABEL) };
+    #undef KIND_LABEL
+
+    #define CASE(name)  op_##name:
+    #define DISPATCH()  goto *op->handler
+#else
+    #define CASE(name)  case KIND_##name:
+    #define DISPATCH()  goto dispatch
+#endif
+    // Move on to the next instruction, or leave the block when the last one was executed
+    #define NEXT()      if(++op == stop) { chip8.pc = op[-1].next; goto block_done; } DISPATCH()
+    // Leave the block after an instruction that set the program counter
+    #define END()       goto block_done
+
+    uint8_t *V = chip8.V;
+
+    while(cycles > 0) {
+        uint16_t pc = chip8.pc;
+
+        // The last byte of memory can't hold a whole opcode, leave it to the interpreter
+        if(pc >= CHIP8_MEMORY_MAX - 1) {
+            chip8.step();
+            cycles--;
+            continue;
+        }
+
+        int32_t index = block_index[pc];
+        if(index < 0) {
+            index = buildBlock(chip8, pc);
+        }
+
+        Block &block = blocks[index];
+#ifdef CHIP8_THREADED_DISPATCH
+        // Resolve the handler addresses the first time the block runs
+        if(!block.linked) {
+            for(uint32_t i = block.first; i < block.first + block.length; i++) {
+                instructions[i].handler = handlers[instructions[i].kind];
+            }
+            block.linked = true;
+        }
+#endif
+
+        int length = (block.length < cycles) ? block.length : cycles;
+        cycles -= length;
+
+        const Instruction *op = &instructions[block.first];
+        const Instruction *stop = op + length;
+
+        DISPATCH();
+
+#ifndef CHIP8_THREADED_DISPATCH
+    dispatch:
+        switch(op->kind) {
+#endif
+        CASE(INTERPRET)
+            chip8.opcode = op->opcode;
+            (chip8.*chip8.opcodeTable[op->opcode >> 12])();
+            NEXT();
+        CASE(INTERPRET_END)
+            chip8.pc = op->next;
+            chip8.opcode = op->opcode;
+            (chip8.*chip8.opcodeTable[op->opcode >> 12])();
+            END();
+        CASE(NOP)
+            NEXT();
+
+        // 00E0, 00EE, 1NNN, 2NNN
+        CASE(CLS)
+            chip8.clearDisplay();
+            NEXT();
+        CASE(RET)
+            chip8.sp = (chip8.sp - 1) & 0xF;
+            chip8.pc = chip8.stack[chip8.sp];
+            END();
+        CASE(JP)
+            chip8.pc = op->nnn;
+            END();
+        CASE(CALL)
+            chip8.stack[chip8.sp] = op->next;
+            chip8.sp = (chip8.sp + 1) & 0xF;
+            chip8.pc = op->nnn;
+            END();
+
+        // 3XNN, 4XNN, 5XY0, 9XY0
+        CASE(SE_XNN)
+            chip8.pc = op->next + ((V[op->x] == op->nn) ? 2 : 0);
+            END();
+        CASE(SNE_XNN)
+            chip8.pc = op->next + ((V[op->x] != op->nn) ? 2 : 0);
+            END();
+        CASE(SE_XY)
+            chip8.pc = op->next + ((V[op->x] == V[op->y]) ? 2 : 0);
+            END();
+        CASE(SNE_XY)
+            chip8.pc = op->next + ((V[op->x] != V[op->y]) ? 2 : 0);
+            END();
+
+        // 6XNN, 7XNN
+        CASE(LD_XNN)
+            V[op->x] = op->nn;
+            NEXT();
+        CASE(ADD_XNN)
+            V[op->x] += op->nn;
+            NEXT();
+
+        // 8XYN
+        CASE(LD_XY)
+            V[op->x] = V[op->y];
+            NEXT();
+        CASE(OR)
+            V[op->x] = V[op->x] | V[op->y];
+            NEXT();
+        CASE(AND)
+            V[op->x] = V[op->x] & V[op->y];
+            NEXT();
+        CASE(XOR)
+            V[op->x] = V[op->x] ^ V[op->y];
+            NEXT();
+        CASE(ADD_XY)
+            V[0xF] = (V[op->x] + V[op->y]) > 0xFF;
+            V[op->x] += V[op->y];
+            NEXT();
+        CASE(SUB)
+            V[0xF] = V[op->x] >= V[op->y];
+            V[op->x] -= V[op->y];
+            NEXT();
+        CASE(SHR)
+            V[0xF] = 0x01 & V[op->y];
+            V[op->x] = V[op->y] >> 1;
+            NEXT();
+        CASE(SUBN)
+            V[0xF] = V[op->y] >= V[op->x];
+            V[op->x] = V[op->y] - V[op->x];
+            NEXT();
+        CASE(SHL)
+            V[0xF] = V[op->y] >> 7;
+            V[op->x] = V[op->y] << 1;
+            NEXT();
+
+        // ANNN, BNNN
+        CASE(LD_I)
+            chip8.I = op->nnn;
+            NEXT();
+        CASE(JP_V0)
+            chip8.pc = V[0] + op->nnn;
+            END();
+
+        // FX07, FX15, FX18, FX1E, FX29, FX65
+        CASE(LD_X_DT)
+            V[op->x] = chip8.timer_delay;
+            NEXT();
+        CASE(LD_DT)
+            chip8.timer_delay = V[op->x];
+            NEXT();
+        CASE(LD_ST)
+            chip8.timer_sound = V[op->x];
+            NEXT();
+        CASE(ADD_I)
+            V[0xF] = (chip8.I + V[op->x] > 0xFFF) ? 1 : 0;
+            chip8.I += V[op->x];
+            NEXT();
+        CASE(LD_F)
+            chip8.I = V[op->x] * 5;
+            NEXT();
+        CASE(LOAD)
+            for(int i = 0; i <= op->x; i++) {
+                V[i] = chip8.memory[(chip8.I + i) & CHIP8_ADDRESS_MASK];
+            }
+            chip8.I += op->x + 1;
+            NEXT();
+#ifndef CHIP8_THREADED_DISPATCH
+        default:
+            break;
+        }
+#endif
+
+    block_done:
+        // Same guard as step()
+        if(chip8.pc > CHIP8_MEMORY_MAX) {
+            chip8.pc = 0;
+        }
+    }
+
+    #undef CASE
+    #undef DISPATCH
+    #undef NEXT
+    #undef END
+}
+
+// ==================================================================================================
+// Private Functions
+// ==================================================================================================
+/**
+ * Decodes the instructions starting at an address into a new block
+ *
+ * @param   chip8   The interpreter whose memory is decoded
+ * @param   start   Address of the first instruction
+ * @return          Index of the new block
+ **/
+int32_t CHIP8BlockCache::buildBlock(const CHIP8Interpreter &chip8, uint16_t start) {
+    Block block;
+    block.first = instructions.size();
+    block.length = 0;
+    block.linked = false;
+
+    uint16_t address = start;
+    bool ends_block = false;
+    while(!ends_block && block.length < CHIP8_BLOCK_MAX_LENGTH && address < CHIP8_MEMORY_MAX - 1) {
+        uint16_t opcode = (chip8.memory[address] << 8) | chip8.memory[address + 1];
+
+        Instruction instruction;
+        instruction.handler = NULL;
+        instruction.kind = decode(opcode, ends_block);
+        instruction.x = (0x0F00 & opcode) >> 8;
+        instruction.y = (0x00F0 & opcode) >> 4;
+        instruction.nn = 0x00FF & opcode;
+        instruction.nnn = 0x0FFF & opcode;
+        instruction.next = address + 2;
+        instruction.opcode = opcode;
+        instructions.push_back(instruction);
+
+        code_map[address] = 1;
+        code_map[address + 1] = 1;
+        address += 2;
+        block.length++;
+    }
+
+    blocks.push_back(block);
+    block_index[start] = blocks.size() - 1;
+    return block_index[start];
+}
+
+/**
+ * Picks the handler for an opcode
+ *
+ * @param   opcode      The raw opcode
+ * @param   ends_block  Set to true if the instruction must be the last one of its block
+ * @return              The kind of the instruction
+ **/
+uint8_t CHIP8BlockCache::decode(uint16_t opcode, bool &ends_block) {
+    ends_block = false;
+    switch((opcode & 0xF000) >> 12) {
+        case 0x0:
+            if(opcode == 0x00E0) {
+                return KIND_CLS;
+            }
+            if(opcode == 0x00EE) {
+                ends_block = true;
+                return KIND_RET;
+            }
+            return KIND_NOP;
+        case 0x1:
+            ends_block = true;
+            return KIND_JP;
+        case 0x2:
+            ends_block = true;
+            return KIND_CALL;
+        case 0x3:
+            ends_block = true;
+            return KIND_SE_XNN;
+        case 0x4:
+            ends_block = true;
+            return KIND_SNE_XNN;
+        case 0x5:
+            ends_block = true;
+            return KIND_SE_XY;
+        case 0x6:
+            return KIND_LD_XNN;
+        case 0x7:
+            return KIND_ADD_XNN;
+        case 0x8:
+            switch(opcode & 0x000F) {
+                case 0x0: return KIND_LD_XY;
+                case 0x1: return KIND_OR;
+                case 0x2: return KIND_AND;
+                case 0x3: return KIND_XOR;
+                case 0x4: return KIND_ADD_XY;
+                case 0x5: return KIND_SUB;
+                case 0x6: return KIND_SHR;
+                case 0x7: return KIND_SUBN;
+                case 0xE: return KIND_SHL;
+                default:  return KIND_NOP;
+            }
+        case 0x9:
+            ends_block = true;
+            return KIND_SNE_XY;
+        case 0xA:
+            return KIND_LD_I;
+        case 0xB:
+            ends_block = true;
+            return KIND_JP_V0;
+        case 0xC:
+        case 0xD:
+            return KIND_INTERPRET;
+        case 0xE:
+            ends_block = true;
+            return KIND_INTERPRET_END;
+        default:
+            switch(opcode & 0x00FF) {
+                case 0x07: return KIND_LD_X_DT;
+                case 0x15: return KIND_LD_DT;
+                case 0x18: return KIND_LD_ST;
+                case 0x1E: return KIND_ADD_I;
+                case 0x29: return KIND_LD_F;
+                case 0x65: return KIND_LOAD;
+                case 0x0A:
+                case 0x33:
+                case 0x55:
+                    ends_block = true;
+                    return KIND_INTERPRET_END;
+                default:
+                    return KIND_NOP;
+            }
+    }
+}
@@ -0,0 +1,59 @@
+#ifndef CHIP8_BLOCKCACHE_H
+#define CHIP8_BLOCKCACHE_H
+
+#include <stdint.h>
+#include <vector>
+
+#include "chip8.hpp"
+
+// Longest run of instructions that will be decoded into a single block
+#define CHIP8_BLOCK_MAX_LENGTH 64
+// Number of decoded instructions (including dropped ones) kept before starting over
+#define CHIP8_BLOCK_CACHE_LIMIT 65536
+
+/**
+ * Execution engine that decodes each address once into a compact instruction record and
+ * groups them into basic blocks. A block ends at any instruction that can change the
+ * program counter (jumps, calls, returns, skips, FX0A) or that writes to memory
+ * (FX33, FX55), so a write into code can never change the block that is running.
+ * Blocks are executed with direct-threaded dispatch where the compiler supports it.
+ **/
+class CHIP8BlockCache {
+    public:
+        // Non-zero for every byte of memory that is part of a cached block
+        uint8_t code_map[CHIP8_MEMORY_MAX];
+
+        CHIP8BlockCache();
+        void execute(CHIP8Interpreter &chip8, int cycles);
+        void invalidate();
+        void invalidate(uint16_t address, int length);
+
+    private:
+        // A single decoded instruction
+        struct Instruction {
+            const void *handler;    // Address of the handler (direct-threaded dispatch only)
+            uint8_t kind;           // Which handler executes the instruction
+            uint8_t x;              // Register X (0x0F00)
+            uint8_t y;              // Register Y (0x00F0)
+            uint8_t nn;             // 8-bit constant (0x00FF)
+            uint16_t nnn;           // Address (0x0FFF), or the address after the block for the end marker
+            uint16_t next;          // Address of the following instruction
+            uint16_t opcode;        // The raw opcode, for the instructions the interpreter executes
+        };
+
+        // A run of instructions that is always executed from start to end
+        struct Block {
+            uint32_t first;         // Index of the first instruction in `instructions`
+            uint16_t length;        // Number of CHIP-8 instructions in the block
+            bool linked;            // True once the handlers have been resolved
+        };
+
+        int32_t block_index[CHIP8_MEMORY_MAX];  // Block that starts at each address, -1 if none
+        std::vector<Block> blocks;
+        std::vector<Instruction> instructions;
+
+        int32_t buildBlock(const CHIP8Interpreter &chip8, uint16_t start);
+        static uint8_t decode(uint16_t opcode, bool &ends_block);
+};
+
+#endif // CHIP8_BLOCKCACHE_H
@@ -0,0 +1,324 @@
+#include <string.h>
+
+#include "capture.hpp"
+
+// ==================================================================================================
+// Variables
+// ==================================================================================================
+static const char *format_names[] = { "y4m", "ppm", "pbm" };
+
+// Colour of each pixel value (0xRRGGBB) when no palette is given, the same as the window's
+static const uint32_t default_palette[1 << CHIP8_PLANES] = {
+    0x000000,   // Unlit
+    0xFFFFFF,   // First plane, the only one before XO-CHIP
+    0xAAAAAA,   // Second plane
+    0x555555    // Both planes
+};
+
+// ==================================================================================================
+// Helpers
+// ==================================================================================================
+/**
+ * Converts a colour to studio range Y'CbCr (BT.601), what Y4M players expect
+ **/
+static void rgbToYuv(uint32_t rgb, uint8_t yuv[3]) {
+    int r = (rgb >> 16) & 0xFF;
+    int g = (rgb >> 8) & 0xFF;
+    int b = rgb & 0xFF;
+    yuv[0] = (uint8_t)(16.5 + (65.481 * r + 128.553 * g + 24.966 * b) / 255.0);
+    yuv[1] = (uint8_t)(128.5 + (-37.797 * r - 74.203 * g + 112.0 * b) / 255.0);
+    yuv[2] = (uint8_t)(128.5 + (112.0 * r - 93.786 * g - 18.214 * b) / 255.0);
+}
+
+// ==================================================================================================
+// Public Functions
+// ==================================================================================================
+/**
+ * @param   format  A capture format
+ * @return          Its name on the command line, such as "y4m"
+ **/
+const char *chip8CaptureFormatName(CHIP8CaptureFormat format) {
+    if(format < CHIP8_CAPTURE_Y4M || format > CHIP8_CAPTURE_PBM) {
+        return "unknown";
+    }
+    return format_names[format];
+}
+
+/**
+ * Looks a capture format up by the name chip8CaptureFormatName() gives it
+ *
+ * @param   name    The name to look up
+ * @param   format  Receives the format
+ * @return          false if no format has that name
+ **/
+bool chip8CaptureFormatFromName(const char *name, CHIP8CaptureFormat &format) {
+    for(int i = CHIP8_CAPTURE_Y4M; i <= CHIP8_CAPTURE_PBM; i++) {
+        if(!strcmp(name, format_names[i])) {
+            format = (CHIP8CaptureFormat)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+CHIP8Capture::CHIP8Capture() {
+    file = NULL;
+    holding = false;
+    head.store(0);
+    tail.store(0);
+    finished.store(false);
+    queued = 0;
+    dropped = 0;
+    written = 0;
+    failed = false;
+}
+
+CHIP8Capture::~CHIP8Capture() {
+    close();
+}
+
+/**
+ * Creates the file and writes the stream header. Call it before the threads start.
+ *
+ * @param   filename        Where to write the capture
+ * @param   format          What to write it as
+ * @param   platform        Platform of the program, decides the size of the frames
+ * @param   scale           Output pixels per CHIP-8 high resolution pixel, in both directions
+ * @param   palette         Colour (0xRRGGBB) of each pixel value, bit 0 is the first plane and
+ *                          bit 1 the second. NULL for the window's colours.
+ * @param   changed_only    Only write a frame when the display changed, the stream doesn't
+ *                          keep time then
+ * @return                  false if the file could not be created
+ **/
+bool CHIP8Capture::open(const char *filename, CHIP8CaptureFormat format, CHIP8Platform platform, int scale,
+    const uint32_t palette[1 << CHIP8_PLANES], bool changed_only) {
+    close();
+    file = fopen(filename, "wb");
+    if(file == NULL) {
+        return false;
+    }
+
+    this->format = format;
+    this->scale = (scale < 1) ? 1 : scale;
+    this->changed_only = changed_only;
+    bool hires = chip8PlatformVariant(platform) != CHIP8_VARIANT_CHIP8;
+    grid_width = hires ? CHIP8_HIRES_WIDTH : CHIP8_SCREEN_WIDTH;
+    grid_height = hires ? CHIP8_HIRES_HEIGHT : CHIP8_SCREEN_HEIGHT;
+
+    if(palette == NULL) {
+        palette = default_palette;
+    }
+    for(int i = 0; i < (1 << CHIP8_PLANES); i++) {
+        if(format == CHIP8_CAPTURE_Y4M) {
+            rgbToYuv(palette[i], colours[i]);
+        } else {
+            colours[i][0] = (palette[i] >> 16) & 0xFF;
+            colours[i][1] = (palette[i] >> 8) & 0xFF;
+            colours[i][2] = palette[i] & 0xFF;
+        }
+    }
+
+    // Every frame is written from one buffer, headers included
+    char header[64];
+    int header_size = 0;
+    size_t pixels = (size_t)width() * height();
+    if(format == CHIP8_CAPTURE_Y4M) {
+        fprintf(file, "YUV4MPEG2 W%d H%d F%d:1 Ip A1:1 C444\n", width(), height(), CHIP8_CAPTURE_RATE);
+        header_size = snprintf(header, sizeof(header), "FRAME\n");
+        image.assign(header_size + pixels * 3, 0);
+    } else if(format == CHIP8_CAPTURE_PPM) {
+        header_size = snprintf(header, sizeof(header), "P6\n%d %d\n255\n", width(), height());
+        image.assign(header_size + pixels * 3, 0);
+    } else {
+        header_size = snprintf(header, sizeof(header), "P4\n%d %d\n", width(), height());
+        image.assign(header_size + (size_t)(width() + 7) / 8 * height(), 0);
+    }
+    memcpy(&image[0], header, header_size);
+
+    holding = false;
+    head.store(0);
+    tail.store(0);
+    finished.store(false);
+    queued = 0;
+    dropped = 0;
+    written = 0;
+    failed = ferror(file) != 0;
+    return true;
+}
+
+/**
+ * Captures the display as it is now, call it once per 1/60th of a second of emulated time.
+ * Only call this from the producer thread, it never waits.
+ *
+ * @param   chip8   The interpreter to take the display from
+ **/
+void CHIP8Capture::frame(const CHIP8Interpreter &chip8) {
+    uint64_t hash = chip8.displayHash() ^ (uint64_t)chip8.screenWidth();
+    // The hash only rules frames out, a match is checked so a collision can't repeat a frame
+    if(holding && hash == held_hash && held.frame.width == chip8.screenWidth() &&
+        memcmp(held.frame.display, chip8.display, sizeof(held.frame.display)) == 0) {
+        held.count++;
+        return;
+    }
+
+    // The newest frame is held back until a different one comes along, so it can count
+    // the frames that repeat it
+    uint32_t count = 1;
+    if(holding) {
+        if(push(held)) {
+            queued++;
+        } else {
+            // The writer is behind, this frame takes the place of the one dropped
+            dropped++;
+            count += held.count;
+        }
+    }
+
+    memcpy(held.frame.display, chip8.display, sizeof(held.frame.display));
+    held.frame.width = chip8.screenWidth();
+    held.frame.height = chip8.screenHeight();
+    held.frame.number = queued + dropped;
+    held.count = count;
+    held_hash = hash;
+    holding = true;
+}
+
+/**
+ * Ends the capture, no more frames come after this. The frame held back goes to the
+ * writer, which stops once it wrote it.
+ **/
+void CHIP8Capture::finish() {
+    if(holding && push(held)) {
+        queued++;
+        holding = false;
+    }
+    // Otherwise the writer takes the held frame itself once it sees this
+    finished.store(true, std::memory_order_release);
+}
+
+/**
+ * Writes every frame queued so far. Only call this from the consumer thread, over and
+ * over until it returns false.
+ *
+ * @return  false once finish() was called and everything is written
+ **/
+bool CHIP8Capture::write() {
+    if(file == NULL) {
+        return false;
+    }
+    // Seen before the queue is emptied, so every frame queued before finish() is in it
+    bool done = finished.load(std::memory_order_acquire);
+
+    uint32_t position = head.load(std::memory_order_relaxed);
+    uint32_t end = tail.load(std::memory_order_acquire);
+    for(; position != end; position++) {
+        writeSlot(slots[position & (CHIP8_CAPTURE_QUEUE_SIZE - 1)]);
+        head.store(position + 1, std::memory_order_release);
+    }
+
+    if(!done) {
+        return true;
+    }
+    if(holding) {
+        // The producer is done with it
+        writeSlot(held);
+        queued++;
+        holding = false;
+    }
+    return false;
+}
+
+/**
+ * Closes the file, once the writer stopped
+ *
+ * @return  false if any write failed
+ **/
+bool CHIP8Capture::close() {
+    if(file == NULL) {
+        return true;
+    }
+    failed |= fclose(file) != 0;
+    file = NULL;
+    return !failed;
+}
+
+// ==================================================================================================
+// Private Functions
+// ==================================================================================================
+/**
+ * Adds a frame to the queue
+ *
+ * @return  false if the queue is full
+ **/
+bool CHIP8Capture::push(const CHIP8CaptureSlot &slot) {
+    uint32_t position = tail.load(std::memory_order_relaxed);
+    if(position - head.load(std::memory_order_acquire) >= CHIP8_CAPTURE_QUEUE_SIZE) {
+        return false;
+    }
+    slots[position & (CHIP8_CAPTURE_QUEUE_SIZE - 1)] = slot;
+    tail.store(position + 1, std::memory_order_release);
+    return true;
+}
+
+/**
+ * Writes a frame as many times as it stands for
+ **/
+void CHIP8Capture::writeSlot(const CHIP8CaptureSlot &slot) {
+    render(slot.frame);
+    uint32_t count = changed_only ? 1 : slot.count;
+    for(uint32_t i = 0; i < count; i++) {
+        failed |= fwrite(&image[0], 1, image.size(), file) != image.size();
+    }
+    written += count;
+}
+
+/**
+ * Converts a frame to the output format in image, after the header
+ **/
+void CHIP8Capture::render(const CHIP8Frame &frame) {
+    // Low resolution pixels cover 2x2 pixels of a high resolution grid
+    int shift = (frame.width < grid_width) ? 1 : 0;
+    uint8_t values[CHIP8_HIRES_HEIGHT][CHIP8_HIRES_WIDTH];
+    for(int y = 0; y < grid_height; y++) {
+        for(int x = 0; x < grid_width; x++) {
+            int fx = x >> shift;
+            int fy = y >> shift;
+            int bit = 63 - (fx & 63);
+            int value = 0;
+            for(int plane = 0; plane < CHIP8_PLANES; plane++) {
+                value |= ((frame.display[plane][fy][fx >> 6] >> bit) & 1) << plane;
+            }
+            values[y][x] = value;
+        }
+    }
+
+    size_t pixels = (size_t)width() * height();
+    uint8_t *out = &image[image.size() - ((format == CHIP8_CAPTURE_PBM) ? (size_t)(width() + 7) / 8 * height() : pixels * 3)];
+    if(format == CHIP8_CAPTURE_PBM) {
+        int row_bytes = (width() + 7) / 8;
+        memset(out, 0, (size_t)row_bytes * height());
+        for(int y = 0; y < height(); y++) {
+            for(int x = 0; x < width(); x++) {
+                if(values[y / scale][x / scale] != 0) {
+                    out[y * row_bytes + (x >> 3)] |= 0x80 >> (x & 7);
+                }
+            }
+        }
+    } else if(format == CHIP8_CAPTURE_PPM) {
+        for(int y = 0; y < height(); y++) {
+            for(int x = 0; x < width(); x++) {
+                memcpy(out, colours[values[y / scale][x / scale]], 3);
+                out += 3;
+            }
+        }
+    } else {
+        // Planar, all the Y then all the U then all the V
+        for(int component = 0; component < 3; component++) {
+            for(int y = 0; y < height(); y++) {
+                for(int x = 0; x < width(); x++) {
+                    *out++ = colours[values[y / scale][x / scale]][component];
+                }
+            }
+        }
+    }
+}
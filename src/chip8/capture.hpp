@@ -0,0 +1,105 @@
+#ifndef CHIP8_CAPTURE_H
+#define CHIP8_CAPTURE_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <atomic>
+#include <vector>
+
+#include "chip8.hpp"
+#include "framebuffer.hpp"
+
+// Frames waiting for the writer, must be a power of two
+#define CHIP8_CAPTURE_QUEUE_SIZE    64
+// Frames per second of the stream, one per timer tick
+#define CHIP8_CAPTURE_RATE          60
+
+/**
+ * What the capture is written as
+ **/
+enum CHIP8CaptureFormat {
+    CHIP8_CAPTURE_Y4M,      // YUV4MPEG2 4:4:4 video, plays in most players and pipes into ffmpeg
+    CHIP8_CAPTURE_PPM,      // Binary PPM (P6) images one after another, ffmpeg reads them as image2pipe
+    CHIP8_CAPTURE_PBM       // Binary PBM (P4) images one after another, lit pixels are black ink
+};
+
+const char *chip8CaptureFormatName(CHIP8CaptureFormat format);
+bool chip8CaptureFormatFromName(const char *name, CHIP8CaptureFormat &format);
+
+/**
+ * A frame waiting for the writer
+ **/
+struct CHIP8CaptureSlot {
+    CHIP8Frame frame;
+    uint32_t count;         // Consecutive frames it stands for, identical ones are only queued once
+};
+
+/**
+ * Writes the display to a file once per frame from a thread of its own.
+ *
+ * The thread running the interpreter calls frame() every 1/60th of a second of emulated
+ * time. Frames go to the writer through a lock-free queue of CHIP8_CAPTURE_QUEUE_SIZE
+ * slots and the writer thread converts, scales and writes them with write(). Neither
+ * side ever waits for the other. A frame identical to the one before (same display hash,
+ * then same pixels) isn't queued again, the slot holding it counts it instead, so a program that draws
+ * little costs the writer little. When the writer falls too far behind a frame is
+ * dropped rather than waited for and the one after it stands in for it, so the stream
+ * keeps its length.
+ *
+ * Low and high resolution frames share one size, the high resolution grid of the
+ * platform (128x64 for SUPER-CHIP and XO-CHIP, 64x32 otherwise) times the scale.
+ **/
+class CHIP8Capture {
+    public:
+        CHIP8Capture();
+        ~CHIP8Capture();
+        bool open(const char *filename, CHIP8CaptureFormat format, CHIP8Platform platform, int scale,
+            const uint32_t palette[1 << CHIP8_PLANES], bool changed_only);
+        int width() const { return grid_width * scale; }
+        int height() const { return grid_height * scale; }
+
+        // ======================================== Producer ========================================
+        void frame(const CHIP8Interpreter &chip8);
+        void finish();
+
+        // ======================================== Consumer ========================================
+        bool write();
+        bool close();
+
+        uint64_t framesWritten() const { return written; }
+        uint64_t framesQueued() const { return queued; }
+        uint64_t framesDropped() const { return dropped; }
+
+    private:
+        FILE *file;
+        CHIP8CaptureFormat format;
+        int grid_width;                     // Pixels of the high resolution grid
+        int grid_height;
+        int scale;                          // Output pixels per grid pixel, in both directions
+        bool changed_only;                  // Write identical frames once instead of count times
+        uint8_t colours[1 << CHIP8_PLANES][3];  // Palette as R G B, or Y U V for CHIP8_CAPTURE_Y4M
+
+        // Producer side
+        CHIP8CaptureSlot held;              // Newest frame, queued once a different one comes along
+        bool holding;
+        uint64_t held_hash;
+        uint64_t queued;                    // Unique frames queued
+        uint64_t dropped;                   // Unique frames dropped because the queue was full
+
+        // Shared
+        CHIP8CaptureSlot slots[CHIP8_CAPTURE_QUEUE_SIZE];
+        std::atomic<uint32_t> head;         // Next slot to write, only advanced by the consumer
+        std::atomic<uint32_t> tail;         // Next free slot, only advanced by the producer
+        std::atomic<bool> finished;         // No more frames are coming
+
+        // Consumer side
+        std::vector<uint8_t> image;         // One converted frame
+        uint64_t written;                   // Frames written, repeats included
+        bool failed;                        // A write failed
+
+        bool push(const CHIP8CaptureSlot &slot);
+        void writeSlot(const CHIP8CaptureSlot &slot);
+        void render(const CHIP8Frame &frame);
+};
+
+#endif // CHIP8_CAPTURE_H
@@ -1,9 +1,21 @@
 #include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
 #include <stdint.h>
-#include <time.h>
-#include <iostream>
 
 #include "chip8.hpp"
+#include "blockcache.hpp"
+#include "jit.hpp"
+#include "aot.hpp"
+#include "debugger.hpp"
+
+// Profiling hooks, compiled out unless CHIP8_PROFILE is defined
+#ifdef CHIP8_PROFILE
+#include "profile.hpp"
+#define PROFILE(event) profile->event
+#else
+#define PROFILE(event)
+#endif
 
 // ==================================================================================================
 // Variables
@@ -29,6 +41,68 @@ static uint8_t fontset[80] =
   0xF0, 0x80, 0xF0, 0x80, 0x80  // F
 };
 
+// Large font used by FX30 on SUPER-CHIP and XO-CHIP, 10 bytes per character
+static uint8_t big_fontset[160] =
+{
+  0xFF, 0xFF, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xFF, 0xFF, // 0
+  0x18, 0x78, 0x78, 0x18, 0x18, 0x18, 0x18, 0x18, 0xFF, 0xFF, // 1
+  0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, // 2
+  0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, // 3
+  0xC3, 0xC3, 0xC3, 0xC3, 0xFF, 0xFF, 0x03, 0x03, 0x03, 0x03, // 4
+  0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, // 5
+  0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, // 6
+  0xFF, 0xFF, 0x03, 0x03, 0x06, 0x0C, 0x18, 0x18, 0x18, 0x18, // 7
+  0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, // 8
+  0xFF, 0xFF, 0xC3, 0xC3, 0xFF, 0xFF, 0x03, 0x03, 0xFF, 0xFF, // 9
+  0x7E, 0xFF, 0xC3, 0xC3, 0xC3, 0xFF, 0xFF, 0xC3, 0xC3, 0xC3, // A
+  0xFC, 0xFC, 0xC3, 0xC3, 0xFC, 0xFC, 0xC3, 0xC3, 0xFC, 0xFC, // B
+  0x3C, 0xFF, 0xC3, 0xC0, 0xC0, 0xC0, 0xC0, 0xC3, 0xFF, 0x3C, // C
+  0xFC, 0xFE, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xC3, 0xFE, 0xFC, // D
+  0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, // E
+  0xFF, 0xFF, 0xC0, 0xC0, 0xFF, 0xFF, 0xC0, 0xC0, 0xC0, 0xC0  // F
+};
+
+// Addresses wrap around the end of the variant's memory
+#define ADDRESS_MASK(variant)   (((variant) == CHIP8_VARIANT_XOCHIP) ? (CHIP8_XO_MEMORY_MAX - 1) : CHIP8_ADDRESS_MASK)
+// The variant's memory, only XO-CHIP's goes through the pointer
+#define MEMORY(variant)         (((variant) == CHIP8_VARIANT_XOCHIP) ? memory : classic_memory)
+
+// ==================================================================================================
+// Helpers
+// ==================================================================================================
+/**
+ * Lines a row of sprite data up with a display row
+ *
+ * @param   bits    The sprite row, right aligned
+ * @param   width   The number of bits in the sprite row (8 or 16)
+ * @param   x       Column of the leftmost sprite pixel, less than screen_width
+ * @param   screen_width    Width of the display (64 or 128)
+ * @param   wrap    true if the pixels past the right edge wrap around to the left, otherwise
+ *                  they are dropped
+ * @param   row     Receives the two words to XOR into the display row
+ **/
+static void spriteRow(uint32_t bits, int width, int x, int screen_width, bool wrap, uint64_t row[2]) {
+    uint64_t left = (uint64_t)bits << (64 - width);
+
+    // The part that fits, and what falls off the right edge
+    uint64_t past_edge = 0;
+    if(screen_width == CHIP8_SCREEN_WIDTH) {
+        row[0] = left >> x;
+        row[1] = 0;
+        past_edge = (x == 0) ? 0 : (left << (64 - x));
+    } else if(x < 64) {
+        row[0] = left >> x;
+        row[1] = (x == 0) ? 0 : (left << (64 - x));
+    } else {
+        row[0] = 0;
+        row[1] = left >> (x - 64);
+        past_edge = (x == 64) ? 0 : (left << (128 - x));
+    }
+    if(wrap) {
+        row[0] |= past_edge;
+    }
+}
+
 // ==================================================================================================
 // Public Functions
 // ==================================================================================================
@@ -36,9 +110,61 @@ static uint8_t fontset[80] =
  * Performs preliminary operations to start the interpreter
  **/
 CHIP8Interpreter::CHIP8Interpreter() {
+    memory = classic_memory;
+    xo_memory = NULL;
+    applyPlatform(CHIP8_PLATFORM_CHIP8);
+    engine = CHIP8_ENGINE_INTERPRETER;
+    block_cache = NULL;
+    jit = NULL;
+    aot = NULL;
+    code_map = NULL;
+    debugger = NULL;
+    rng_seed = CHIP8_DEFAULT_SEED;
+#ifdef CHIP8_PROFILE
+    profile = new CHIP8Profile();
+#endif
     reset();
 }
 
+/**
+ * Copies the state of another interpreter. The copy uses the same engine but builds
+ * its own caches.
+ **/
+CHIP8Interpreter::CHIP8Interpreter(const CHIP8Interpreter &other) {
+    memory = classic_memory;
+    xo_memory = NULL;
+    engine = CHIP8_ENGINE_INTERPRETER;
+    block_cache = NULL;
+    jit = NULL;
+    aot = NULL;
+    code_map = NULL;
+    debugger = NULL;
+#ifdef CHIP8_PROFILE
+    profile = new CHIP8Profile();
+#endif
+    copyState(other);
+    setEngine(other.engine);
+}
+
+CHIP8Interpreter &CHIP8Interpreter::operator=(const CHIP8Interpreter &other) {
+    if(this != &other) {
+        copyState(other);
+        invalidateCode();
+        setEngine(other.engine);
+    }
+    return *this;
+}
+
+CHIP8Interpreter::~CHIP8Interpreter() {
+    delete[] xo_memory;
+    delete block_cache;
+    delete jit;
+    delete aot;
+#ifdef CHIP8_PROFILE
+    delete profile;
+#endif
+}
+
 /**
  * Resets the memory and pointers in the CHIP8
  **/
@@ -49,45 +175,224 @@ void CHIP8Interpreter::reset() {
     timer_sound = 0;
     sp = 0;
     pc = 0x200;
-    srand(time(NULL));
+    seed(rng_seed);
+    rom_hash = 0;
+    invalidateCode();
+#ifdef CHIP8_PROFILE
+    profile->reset();
+#endif
 
     // Clear memory
-    for(int i=0; i<CHIP8_MEMORY_MAX; i++) {
-        memory[i] = 0;
-    }
+    memset(memory, 0, memorySize());
 
     // Clear registers, stack and keys
     for(int i=0; i<16; i++) {
         V[i] = 0;
         stack[i] = 0;
-        key[i] = 0;
     }
+    keys = 0;
 
     // Clear the display buffer
     clearDisplay();
+    draw_flag = 0;
+    hires = false;
+    planes = 1;
+
+    // Sound and flags of the later variants
+    memset(rpl, 0, sizeof(rpl));
+    memset(audio_pattern, 0, sizeof(audio_pattern));
+    pitch = 64;
 
     // Load font
     for(int i=0; i<80; i++) {
-        memory[i] = fontset[i];
+        memory[CHIP8_FONT_ADDRESS + i] = fontset[i];
+    }
+    if(chip8PlatformVariant(platform) != CHIP8_VARIANT_CHIP8) {
+        memcpy(&memory[CHIP8_BIG_FONT_ADDRESS], big_fontset, sizeof(big_fontset));
     }
 }
 
+/**
+ * Restarts the random number generator used by CXNN. The same seed always gives the
+ * same sequence, reset() goes back to the start of it.
+ *
+ * @param   value   Any value, including 0
+ **/
+void CHIP8Interpreter::seed(uint64_t value) {
+    rng_seed = value;
+
+    // Scramble the seed (splitmix64) so similar seeds give unrelated sequences and
+    // the state can never be 0, which xorshift would be stuck on
+    uint64_t z = value + 0x9E3779B97F4A7C15ULL;
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    rng_state = (z ^ (z >> 31)) | 1;
+}
+
+/**
+ * Selects the instruction set and quirks the program is written for, and resets the
+ * machine for it. Load the ROM afterwards.
+ *
+ * @param   platform    The platform to emulate
+ **/
+void CHIP8Interpreter::setPlatform(CHIP8Platform platform) {
+    applyPlatform(platform);
+    reset();
+}
+
 /**
  * Steps through one CPU cycle for the interpreter
+ *
+ * @return  CHIP8_RUNNING, or what the program is waiting for if the instruction left it
+ *          spinning in place
  **/
-void CHIP8Interpreter::step() {
-    // An opcode is 4 bytes long, therefore need to merge
-    opcode = (memory[pc] << 8) | memory[pc+1];
-    pc += 2;
+CHIP8Status CHIP8Interpreter::step() {
+    #define STEP_CASE(name, text, variant, quirks) \
+        case CHIP8_PLATFORM_##name: return stepPlatform<variant, quirks>();
+    switch(platform) {
+        CHIP8_PLATFORMS(STEP_CASE)
+        default: return CHIP8_HALTED;
+    }
+    #undef STEP_CASE
+}
 
-    // std::cout << "Opcode: " << std::hex << std::uppercase << opcode << std::nouppercase << std::dec << std::endl;
-    // Execute the opcode 
-    ((this)->*opcodeTable[(opcode & 0xF000) >> 12])();
+/**
+ * Executes the given number of instructions using the selected engine. Instructions
+ * spent spinning in an idle loop are skipped without executing them, leaving the
+ * machine in exactly the state executing them would have.
+ *
+ * @param   cycles  The number of instructions to execute
+ * @return          What the program is waiting for afterwards, see idleStatus()
+ **/
+CHIP8Status CHIP8Interpreter::run(int cycles) {
+    // Breakpoints and watchpoints need every instruction checked, the debugger steps them
+    if(debugger != NULL && debugger->armed()) {
+        return debugger->run(cycles);
+    }
 
-    // Temporary: Keeps program from crashing
-    if(pc > CHIP8_MEMORY_MAX) {
-        pc = 0;
+    cycles = skipIdle(cycles);
+    if(cycles <= 0) {
+        return idleStatus();
+    }
+
+#ifndef CHIP8_PROFILE
+    // The engines check once the budget is spent, the host runs short slices anyway
+    if(engine == CHIP8_ENGINE_CACHED && platform == CHIP8_PLATFORM_CHIP8) {
+        block_cache->execute(*this, cycles);
+        return idleStatus();
+    }
+    if(engine == CHIP8_ENGINE_JIT && platform == CHIP8_PLATFORM_CHIP8) {
+        jit->execute(*this, cycles);
+        return idleStatus();
+    }
+    if(engine == CHIP8_ENGINE_AOT && platform == CHIP8_PLATFORM_CHIP8) {
+        aot->execute(*this, cycles);
+        return idleStatus();
+    }
+#endif
+
+    // Profiling builds count in the interpreter, so everything goes through it
+    #define RUN_CASE(name, text, variant, quirks) \
+        case CHIP8_PLATFORM_##name: return runPlatform<variant, quirks>(cycles);
+    switch(platform) {
+        CHIP8_PLATFORMS(RUN_CASE)
+        default: return CHIP8_HALTED;
+    }
+    #undef RUN_CASE
+}
+
+/**
+ * Recognises the loops programs wait in. Nothing but a key press or a timer tick can
+ * get the program out of them, so the instructions in between don't need running.
+ *
+ * @return  What the program at pc is waiting for, CHIP8_RUNNING if it isn't idle
+ **/
+CHIP8Status CHIP8Interpreter::idleStatus() const {
+    uint16_t op = fetch(pc);
+
+    // FX0A - Repeats until a key is down
+    if((op & 0xF0FF) == 0xF00A) {
+        return (keys != 0) ? CHIP8_RUNNING : CHIP8_WAIT_KEY;
+    }
+
+    // 1NNN - Jump to itself, or 00FD - Exit the interpreter
+    if(op == (0x1000 | pc) || (op == 0x00FD && chip8PlatformVariant(platform) != CHIP8_VARIANT_CHIP8)) {
+        return CHIP8_HALTED;
+    }
+
+    // FX07, 3X00, 1NNN - Read the delay timer until it reaches 0
+    if((op & 0xF0FF) == 0xF007 && timer_delay > 0) {
+        uint16_t X = op & 0x0F00;
+        if(fetch(pc + 2) == (0x3000 | X) && fetch(pc + 4) == (0x1000 | pc)) {
+            return CHIP8_WAIT_TIMER;
+        }
+    }
+    return CHIP8_RUNNING;
+}
+
+/**
+ * Selects how run() executes the program. Hosts that can't generate native code
+ * get the block cache when asking for the JIT.
+ *
+ * @param   engine  The engine to use from now on
+ **/
+void CHIP8Interpreter::setEngine(CHIP8Engine engine) {
+    if(engine == CHIP8_ENGINE_JIT && !CHIP8Jit::supported()) {
+        engine = CHIP8_ENGINE_CACHED;
     }
+    this->engine = engine;
+
+    if(engine != CHIP8_ENGINE_CACHED) {
+        delete block_cache;
+        block_cache = NULL;
+    }
+    if(engine != CHIP8_ENGINE_JIT) {
+        delete jit;
+        jit = NULL;
+    }
+    if(engine != CHIP8_ENGINE_AOT) {
+        delete aot;
+        aot = NULL;
+    }
+
+    code_map = NULL;
+    if(engine == CHIP8_ENGINE_CACHED) {
+        if(block_cache == NULL) {
+            block_cache = new CHIP8BlockCache();
+        }
+        code_map = block_cache->code_map;
+    } else if(engine == CHIP8_ENGINE_JIT) {
+        if(jit == NULL) {
+            jit = new CHIP8Jit(*this);
+        }
+        code_map = jit->code_map;
+    } else if(engine == CHIP8_ENGINE_AOT) {
+        if(aot == NULL) {
+            aot = new CHIP8Aot(*this);
+        }
+        code_map = aot->code_map;
+    }
+}
+
+/**
+ * Compares the emulated machine state of two interpreters, ignoring which engine
+ * they use. Used to check the engines against each other.
+ *
+ * @param   other   The interpreter to compare against
+ * @return          true if both would behave identically from here on
+ **/
+bool CHIP8Interpreter::sameState(const CHIP8Interpreter &other) const {
+    return platform == other.platform && pc == other.pc && I == other.I && sp == other.sp &&
+        timer_delay == other.timer_delay && timer_sound == other.timer_sound &&
+        draw_flag == other.draw_flag &&
+        memcmp(memory, other.memory, memorySize()) == 0 &&
+        memcmp(V, other.V, sizeof(V)) == 0 &&
+        memcmp(stack, other.stack, sizeof(stack)) == 0 &&
+        memcmp(display, other.display, sizeof(display)) == 0 &&
+        rng_state == other.rng_state &&
+        hires == other.hires && planes == other.planes && pitch == other.pitch &&
+        memcmp(rpl, other.rpl, sizeof(rpl)) == 0 &&
+        memcmp(audio_pattern, other.audio_pattern, sizeof(audio_pattern)) == 0;
 }
 
 /**
@@ -100,37 +405,434 @@ void CHIP8Interpreter::timerUpdate() {
     if(timer_sound > 0) {
         timer_sound--;
     }
+    PROFILE(frame());
 }
 
 /**
  * Sets all values in the display buffer to 0
  **/
 void CHIP8Interpreter::clearDisplay() {
-    // Clear the display buffer
-    for(int x=0; x<CHIP8_SCREEN_WIDTH; x++) {
-        for(int y=0; y<CHIP8_SCREEN_HEIGHT; y++) {
-            display[x][y] = 0;
+    memset(display, 0, sizeof(display));
+}
+
+/**
+ * Expands the visible part of the display into one byte per pixel, bit 0 set if the
+ * pixel is set in the first plane and bit 1 if it is set in the second
+ *
+ * @param   pixels  Receives the pixels, indexed by row then column
+ **/
+void CHIP8Interpreter::unpackDisplay(uint8_t pixels[CHIP8_HIRES_HEIGHT][CHIP8_HIRES_WIDTH]) const {
+    for(int y=0; y<screenHeight(); y++) {
+        for(int x=0; x<screenWidth(); x++) {
+            int shift = 63 - (x & 63);
+            pixels[y][x] = ((display[0][y][x >> 6] >> shift) & 1) | (((display[1][y][x >> 6] >> shift) & 1) << 1);
         }
     }
 }
 
+/**
+ * Hashes the contents of the display (every row word of the visible area and the planes
+ * the variant has, folded in with hashDisplayWord()). Two displays with the same pixels
+ * always have the same hash.
+ *
+ * @return  The hash of the display
+ **/
+uint64_t CHIP8Interpreter::displayHash() const {
+    int plane_count = (chip8PlatformVariant(platform) == CHIP8_VARIANT_XOCHIP) ? CHIP8_PLANES : 1;
+    int words = hires ? 2 : 1;
+
+    uint64_t hash = 0xCBF29CE484222325ULL;
+    for(int plane=0; plane<plane_count; plane++) {
+        for(int y=0; y<screenHeight(); y++) {
+            for(int word=0; word<words; word++) {
+                hash = hashDisplayWord(hash, display[plane][y][word]);
+            }
+        }
+    }
+    return hash;
+}
+
+// ==================================================================================================
+// Private Functions
+// ==================================================================================================
+/**
+ * Switches platform without touching the rest of the machine state. Memory moves when
+ * the size changes, the addresses both sizes have keep their contents.
+ **/
+void CHIP8Interpreter::applyPlatform(CHIP8Platform platform) {
+    if(platform < 0 || platform >= CHIP8_PLATFORM_COUNT) {
+        platform = CHIP8_PLATFORM_CHIP8;
+    }
+    this->platform = platform;
+    address_mask = ADDRESS_MASK(chip8PlatformVariant(platform));
+
+    if(address_mask == CHIP8_XO_MEMORY_MAX - 1 && xo_memory == NULL) {
+        xo_memory = new uint8_t[CHIP8_XO_MEMORY_MAX];
+        memcpy(xo_memory, classic_memory, CHIP8_MEMORY_MAX);
+        memset(&xo_memory[CHIP8_MEMORY_MAX], 0, CHIP8_XO_MEMORY_MAX - CHIP8_MEMORY_MAX);
+        memory = xo_memory;
+    } else if(address_mask != CHIP8_XO_MEMORY_MAX - 1 && xo_memory != NULL) {
+        memcpy(classic_memory, xo_memory, CHIP8_MEMORY_MAX);
+        delete[] xo_memory;
+        xo_memory = NULL;
+        memory = classic_memory;
+    }
+}
+
+/**
+ * Copies the emulated machine state (but not the engine caches) from another interpreter
+ **/
+void CHIP8Interpreter::copyState(const CHIP8Interpreter &other) {
+    applyPlatform(other.platform);
+    opcode = other.opcode;
+    pc = other.pc;
+    I = other.I;
+    memcpy(memory, other.memory, memorySize());
+    memcpy(V, other.V, sizeof(V));
+    memcpy(stack, other.stack, sizeof(stack));
+    sp = other.sp;
+    timer_delay = other.timer_delay;
+    timer_sound = other.timer_sound;
+    memcpy(display, other.display, sizeof(display));
+    draw_flag = other.draw_flag;
+    keys = other.keys;
+    rng_seed = other.rng_seed;
+    rng_state = other.rng_state;
+    rom_hash = other.rom_hash;
+    hires = other.hires;
+    planes = other.planes;
+    memcpy(rpl, other.rpl, sizeof(rpl));
+    memcpy(audio_pattern, other.audio_pattern, sizeof(audio_pattern));
+    pitch = other.pitch;
+}
+
+/**
+ * Finishes loadRom(), leaving the interpreter without a program if it failed
+ *
+ * @param   result  How loading went
+ * @param   error   Where the caller wants the result, may be NULL
+ * @return          true if the program was loaded
+ **/
+bool CHIP8Interpreter::romLoaded(CHIP8RomError result, CHIP8RomError *error) {
+    if(error != NULL) {
+        *error = result;
+    }
+    if(result != CHIP8_ROM_OK) {
+        reset();
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @return  The next byte from the random number generator, every value is equally likely
+ **/
+uint8_t CHIP8Interpreter::randomByte() {
+    rng_state ^= rng_state >> 12;
+    rng_state ^= rng_state << 25;
+    rng_state ^= rng_state >> 27;
+    // The top bits of the scrambled output are the best distributed
+    return (rng_state * 0x2545F4914F6CDD1DULL) >> 56;
+}
+
+/**
+ * Must be called after the program writes to memory. Drops any decoded or
+ * translated code that the write may have changed.
+ *
+ * @param   address     The first address written to
+ * @param   length      The number of bytes written
+ **/
+void CHIP8Interpreter::codeWritten(uint16_t address, int length) {
+    if(code_map == NULL) {
+        return;
+    }
+    for(int i = 0; i < length; i++) {
+        uint16_t written = (address + i) & CHIP8_ADDRESS_MASK;
+        if(code_map[written]) {
+            if(block_cache != NULL) {
+                block_cache->invalidate(written, 1);
+            }
+            if(jit != NULL) {
+                jit->invalidate(written, 1);
+            }
+            if(aot != NULL) {
+                aot->invalidate(written, 1);
+            }
+        }
+    }
+}
+
+/**
+ * Drops all decoded code, used whenever memory changes outside of the engine's view
+ **/
+void CHIP8Interpreter::invalidateCode() {
+    if(block_cache != NULL) {
+        block_cache->invalidate();
+    }
+    if(jit != NULL) {
+        jit->invalidate();
+    }
+    if(aot != NULL) {
+        aot->invalidate();
+    }
+}
+
+/**
+ * @param   address     Where the opcode starts, wraps around the end of memory
+ * @return              The big endian opcode at the address
+ **/
+uint16_t CHIP8Interpreter::fetch(uint16_t address) const {
+    return (memory[address & address_mask] << 8) | memory[(address + 1) & address_mask];
+}
+
+/**
+ * Skips instructions the program would spend in an idle loop. The state afterwards is
+ * exactly what executing them would have left, only timer ticks and key presses (which
+ * happen between calls to run()) can make a difference.
+ *
+ * @param   cycles  The number of instructions left to run
+ * @return          The number that still have to be executed
+ **/
+int CHIP8Interpreter::skipIdle(int cycles) {
+    if(cycles <= 0) {
+        return cycles;
+    }
+
+    switch(idleStatus()) {
+        case CHIP8_WAIT_KEY:
+        case CHIP8_HALTED:
+            // The same instruction runs over and over without changing anything
+            opcode = fetch(pc);
+            return 0;
+        case CHIP8_WAIT_TIMER:
+        {
+            // Every pass through the loop copies the delay timer into VX and jumps back,
+            // only whole passes are skipped so pc ends up where it started
+            int passes = cycles / 3;
+            if(passes > 0) {
+                V[(fetch(pc) & 0x0F00) >> 8] = timer_delay;
+                opcode = fetch(pc + 4);
+            }
+            return cycles - passes * 3;
+        }
+        default:
+            return cycles;
+    }
+}
+
+/**
+ * Clears the visible area of the selected bitplanes
+ *
+ * @param   mask    The planes to clear, bit 0 for the first
+ **/
+void CHIP8Interpreter::clearPlanes(uint8_t mask) {
+    for(int plane = 0; plane < CHIP8_PLANES; plane++) {
+        if(mask & (1 << plane)) {
+            memset(display[plane], 0, sizeof(display[plane]));
+        }
+    }
+}
+
+/**
+ * Scrolls the selected planes up or down, the rows scrolled in are blank
+ *
+ * @param   rows    Rows to scroll down by, negative to scroll up
+ **/
+void CHIP8Interpreter::scrollVertical(int rows) {
+    int height = screenHeight();
+    for(int plane = 0; plane < CHIP8_PLANES; plane++) {
+        if(!(planes & (1 << plane))) {
+            continue;
+        }
+        uint64_t (*lines)[2] = display[plane];
+        if(rows > 0) {
+            for(int y = height - 1; y >= 0; y--) {
+                lines[y][0] = (y >= rows) ? lines[y - rows][0] : 0;
+                lines[y][1] = (y >= rows) ? lines[y - rows][1] : 0;
+            }
+        } else {
+            for(int y = 0; y < height; y++) {
+                lines[y][0] = (y - rows < height) ? lines[y - rows][0] : 0;
+                lines[y][1] = (y - rows < height) ? lines[y - rows][1] : 0;
+            }
+        }
+    }
+    draw_flag = 1;
+}
+
+/**
+ * Scrolls the selected planes left or right, the columns scrolled in are blank
+ *
+ * @param   pixels  Columns to scroll right by (1 to 63), negative to scroll left
+ **/
+void CHIP8Interpreter::scrollHorizontal(int pixels) {
+    for(int plane = 0; plane < CHIP8_PLANES; plane++) {
+        if(!(planes & (1 << plane))) {
+            continue;
+        }
+        for(int y = 0; y < screenHeight(); y++) {
+            uint64_t *line = display[plane][y];
+            if(!hires) {
+                // Only the first word is on screen
+                line[0] = (pixels > 0) ? (line[0] >> pixels) : (line[0] << -pixels);
+            } else if(pixels > 0) {
+                line[1] = (line[1] >> pixels) | (line[0] << (64 - pixels));
+                line[0] >>= pixels;
+            } else {
+                line[0] = (line[0] << -pixels) | (line[1] >> (64 + pixels));
+                line[1] <<= -pixels;
+            }
+        }
+    }
+    draw_flag = 1;
+}
+
+/**
+ * Switches between the 64x32 and 128x64 display, which clears it
+ *
+ * @param   hires   true for 128x64
+ **/
+void CHIP8Interpreter::setResolution(bool hires) {
+    this->hires = hires;
+    clearDisplay();
+    draw_flag = 1;
+}
+
+/**
+ * Executes one instruction as the given platform
+ *
+ * @return  CHIP8_RUNNING, or what the program is waiting for if the instruction left it
+ *          spinning in place
+ **/
+template<int VARIANT, int QUIRKS>
+CHIP8Status CHIP8Interpreter::stepPlatform() {
+    const uint16_t mask = ADDRESS_MASK(VARIANT);
+
+    // An opcode is 4 bytes long, therefore need to merge
+    opcode = (MEMORY(VARIANT)[pc & mask] << 8) | MEMORY(VARIANT)[(pc + 1) & mask];
+    PROFILE(instruction(pc, opcode));
+    pc += 2;
+
+    // Execute the opcode 
+    switch(opcode >> 12) {
+        case 0x0: opcode0<VARIANT, QUIRKS>(); break;
+        case 0x1: opcode1<VARIANT, QUIRKS>(); break;
+        case 0x2: opcode2<VARIANT, QUIRKS>(); break;
+        case 0x3: opcode3<VARIANT, QUIRKS>(); break;
+        case 0x4: opcode4<VARIANT, QUIRKS>(); break;
+        case 0x5: opcode5<VARIANT, QUIRKS>(); break;
+        case 0x6: opcode6<VARIANT, QUIRKS>(); break;
+        case 0x7: opcode7<VARIANT, QUIRKS>(); break;
+        case 0x8: opcode8<VARIANT, QUIRKS>(); break;
+        case 0x9: opcode9<VARIANT, QUIRKS>(); break;
+        case 0xA: opcodeA<VARIANT, QUIRKS>(); break;
+        case 0xB: opcodeB<VARIANT, QUIRKS>(); break;
+        case 0xC: opcodeC<VARIANT, QUIRKS>(); break;
+        case 0xD: opcodeD<VARIANT, QUIRKS>(); break;
+        case 0xE: opcodeE<VARIANT, QUIRKS>(); break;
+        default:  opcodeF<VARIANT, QUIRKS>(); break;
+    }
+
+    // Temporary: Keeps program from crashing (XO-CHIP programs can use every address)
+    if(VARIANT != CHIP8_VARIANT_XOCHIP && pc > CHIP8_MEMORY_MAX) {
+        pc = 0;
+    }
+
+    // Only jumps, FX0A and 00FD can leave the program in one of the idle loops
+    if((opcode & 0xF000) == 0x1000 || (opcode & 0xF0FF) == 0xF00A ||
+       (VARIANT != CHIP8_VARIANT_CHIP8 && opcode == 0x00FD)) {
+        return idleStatus();
+    }
+    return CHIP8_RUNNING;
+}
+
+/**
+ * The interpreter loop of a platform
+ *
+ * @param   cycles  The number of instructions to execute
+ * @return          What the program is waiting for afterwards, see idleStatus()
+ **/
+template<int VARIANT, int QUIRKS>
+CHIP8Status CHIP8Interpreter::runPlatform(int cycles) {
+    while(cycles > 0) {
+        cycles--;
+        if(stepPlatform<VARIANT, QUIRKS>() != CHIP8_RUNNING) {
+            cycles = skipIdle(cycles);
+        }
+    }
+    return idleStatus();
+}
+
+/**
+ * Skips the next instruction. On XO-CHIP that is 4 bytes when it is F000 NNNN.
+ **/
+template<int VARIANT>
+void CHIP8Interpreter::skipNext() {
+    const uint16_t mask = ADDRESS_MASK(VARIANT);
+    if(VARIANT == CHIP8_VARIANT_XOCHIP && memory[pc & mask] == 0xF0 && memory[(pc + 1) & mask] == 0x00) {
+        pc += 4;
+    } else {
+        pc += 2;
+    }
+}
+
 // ==================================================================================================
 // Opcodes
 // ==================================================================================================
 /**
  * Handles all opcodes that start with 0
  **/
+template<int VARIANT, int QUIRKS>
 void CHIP8Interpreter::opcode0() {
     switch(opcode) {
         case 0x00E0:
-            clearDisplay();
+            // Clears the selected planes, which is all there is before XO-CHIP
+            if(VARIANT == CHIP8_VARIANT_XOCHIP) {
+                clearPlanes(planes);
+            } else {
+                clearDisplay();
+            }
             break;
         case 0x00EE:
             // Return from a subroutine
-            sp--;
+            // The stack pointer wraps around instead of leaving the 16 levels
+            sp = (sp - 1) & 0xF;
             pc = stack[sp];
+            PROFILE(ret());
+            break;
+        case 0x00FB:
+            // 00FB - Scroll right by 4 pixels (SUPER-CHIP)
+            if(VARIANT != CHIP8_VARIANT_CHIP8) {
+                scrollHorizontal(4);
+            }
+            break;
+        case 0x00FC:
+            // 00FC - Scroll left by 4 pixels (SUPER-CHIP)
+            if(VARIANT != CHIP8_VARIANT_CHIP8) {
+                scrollHorizontal(-4);
+            }
+            break;
+        case 0x00FD:
+            // 00FD - Exit the interpreter, which is a halt that repeats this instruction (SUPER-CHIP)
+            if(VARIANT != CHIP8_VARIANT_CHIP8) {
+                pc -= 2;
+            }
+            break;
+        case 0x00FE:
+        case 0x00FF:
+            // 00FE / 00FF - Switch to 64x32 / 128x64 (SUPER-CHIP)
+            if(VARIANT != CHIP8_VARIANT_CHIP8) {
+                setResolution(opcode == 0x00FF);
+            }
             break;
         default:
+            if(VARIANT != CHIP8_VARIANT_CHIP8 && (opcode & 0xFFF0) == 0x00C0) {
+                // 00CN - Scroll down by N rows (SUPER-CHIP)
+                scrollVertical(opcode & 0x000F);
+            } else if(VARIANT == CHIP8_VARIANT_XOCHIP && (opcode & 0xFFF0) == 0x00D0) {
+                // 00DN - Scroll up by N rows (XO-CHIP)
+                scrollVertical(-(opcode & 0x000F));
+            }
             break;
     }
 }
@@ -138,6 +840,7 @@ void CHIP8Interpreter::opcode0() {
 /**
  * Handles all opcodes that start with 1
  **/
+template<int VARIANT, int QUIRKS>
 void CHIP8Interpreter::opcode1() {
     // 0x1NNN - Jump to address NNN
     pc = (0x0FFF & opcode);
@@ -146,45 +849,74 @@ void CHIP8Interpreter::opcode1() {
 /**
  * Handles all opcodes that start with 2
  **/
+template<int VARIANT, int QUIRKS>
 void CHIP8Interpreter::opcode2() {
     // 0x2NNN - Execute subroutine starting at address NNN
-    stack[sp++] = pc;
+    stack[sp] = pc;
+    sp = (sp + 1) & 0xF;
     pc = (0x0FFF & opcode);
+    PROFILE(call());
 }
 
 /**
  * Handles all opcodes that start with 3
  **/
+template<int VARIANT, int QUIRKS>
 void CHIP8Interpreter::opcode3() {
     // 0x3XNN - Skip the following instruction if the value of register VX equals NN
     if(V[(0x0F00 & opcode) >> 8] == (0x00FF & opcode)) {
-        pc += 2;
+        skipNext<VARIANT>();
     }
 }
 
 /**
  * Handles all opcodes that start with 4
  **/
+template<int VARIANT, int QUIRKS>
 void CHIP8Interpreter::opcode4() {
     // 0x4XNN - Skip the following instruction if the value of register VX is not equal to NN
     if(V[(0x0F00 & opcode) >> 8] != (0x00FF & opcode)) {
-        pc += 2;
+        skipNext<VARIANT>();
     }
 }
 
 /**
  * Handles all opcodes that start with 5
  **/
+template<int VARIANT, int QUIRKS>
 void CHIP8Interpreter::opcode5() {
+    uint8_t X = (0x0F00 & opcode) >> 8;
+    uint8_t Y = (0x00F0 & opcode) >> 4;
+
+    if(VARIANT == CHIP8_VARIANT_XOCHIP && (opcode & 0x000E) == 0x0002) {
+        // 0x5XY2 / 0x5XY3 - Store / load registers VX to VY (in either direction) at address I,
+        // I is left unchanged (XO-CHIP)
+        const uint16_t mask = ADDRESS_MASK(VARIANT);
+        int count = (X <= Y) ? (Y - X + 1) : (X - Y + 1);
+        int direction = (X <= Y) ? 1 : -1;
+        for(int i = 0; i < count; i++) {
+            if((opcode & 0x000F) == 0x0002) {
+                memory[(I + i) & mask] = V[X + i * direction];
+            } else {
+                V[X + i * direction] = memory[(I + i) & mask];
+            }
+        }
+        if((opcode & 0x000F) == 0x0002) {
+            codeWritten(I, count);
+        }
+        return;
+    }
+
     // 0x5XY0 - Skip the following instruction if the value of register VX is equal to the value of register VY
-    if(V[(0x0F00 & opcode) >> 8] == V[(0x00F0 & opcode) >> 4]) {
-        pc += 2;
+    if(V[X] == V[Y]) {
+        skipNext<VARIANT>();
     }
 }
 
 /**
  * Handles all opcodes that start with 6
  **/
+template<int VARIANT, int QUIRKS>
 void CHIP8Interpreter::opcode6() {
     // 0x6XNN - Store number NN in register VX
     V[(0x0F00 & opcode) >> 8] = (0x00FF & opcode);
@@ -193,6 +925,7 @@ void CHIP8Interpreter::opcode6() {
 /**
  * Handles all opcodes that start with 7
  **/
+template<int VARIANT, int QUIRKS>
 void CHIP8Interpreter::opcode7() {
     // 0x7XNN - Add the value NN to register VX
     V[(0x0F00 & opcode) >> 8] += (0x00FF & opcode);
@@ -201,10 +934,13 @@ void CHIP8Interpreter::opcode7() {
 /**
  * Handles all opcodes that start with 8
  **/
+template<int VARIANT, int QUIRKS>
 void CHIP8Interpreter::opcode8() {
     uint8_t n = 0x000F & opcode;
     uint8_t X = (0x0F00 & opcode) >> 8;
     uint8_t Y = (0x00F0 & opcode) >> 4;
+    // The register the shifts read, VY unless the platform shifts VX in place
+    uint8_t S = (QUIRKS & CHIP8_QUIRK_SHIFT_VX) ? X : Y;
     switch(n) {
         case 0x0000:
             // 0x8XY0 - Store the value of register VY in register VX
@@ -213,14 +949,23 @@ void CHIP8Interpreter::opcode8() {
         case 0x0001:
             // 0x8XY1 - Set VX to VX OR VY
             V[X] = V[X] | V[Y];
+            if(QUIRKS & CHIP8_QUIRK_VF_RESET) {
+                V[0xF] = 0;
+            }
             break;
         case 0x0002:
             // 0x8XY2 - Set VX to VX AND VY
             V[X] = V[X] & V[Y];
+            if(QUIRKS & CHIP8_QUIRK_VF_RESET) {
+                V[0xF] = 0;
+            }
             break;
         case 0x0003:
             // 0x8XY3 - Set VX to VX XOR VY
             V[X] = V[X] ^ V[Y];
+            if(QUIRKS & CHIP8_QUIRK_VF_RESET) {
+                V[0xF] = 0;
+            }
             break;
         case 0x0004:
             // 0x8XY4 - Add the value of register VY to register VX
@@ -237,8 +982,8 @@ void CHIP8Interpreter::opcode8() {
         case 0x0006:
             // 0x8XY6 - Store the value of register VY shifted right one bit in register VX
             // Set register VF to the least significant bit prior to the shift
-            V[0xF] = 0x01 & V[Y];
-            V[X] = V[Y] >> 1;
+            V[0xF] = 0x01 & V[S];
+            V[X] = V[S] >> 1;
             break;
         case 0x0007:
             // 0x8XY7 - Set register VX to the value of VY minus VX
@@ -249,8 +994,8 @@ void CHIP8Interpreter::opcode8() {
         case 0x000E:
             // 0x8XYE - Store the value of register VY shifted left one bit in register VX
             // Set register VF to the most significant bit prior to the shift
-            V[0xF] = V[Y] >> 7;
-            V[X] = V[Y] << 1;
+            V[0xF] = V[S] >> 7;
+            V[X] = V[S] << 1;
             break;
         default:
             break;
@@ -260,16 +1005,18 @@ void CHIP8Interpreter::opcode8() {
 /**
  * Handles all opcodes that start with 9
  **/
+template<int VARIANT, int QUIRKS>
 void CHIP8Interpreter::opcode9() {
     // 9XY0 - Skip the following instruction if the value of register VX is not equal to the value of register VY
     if(V[(0x0F00 & opcode) >> 8] != V[(0x00F0 & opcode) >> 4]) {
-        pc += 2;
+        skipNext<VARIANT>();
     }
 }
 
 /**
  * Handles all opcodes that start with A
  **/
+template<int VARIANT, int QUIRKS>
 void CHIP8Interpreter::opcodeA() {
     // ANNN - Store memory address NNN in register I
     I = 0x0FFF & opcode;
@@ -278,17 +1025,24 @@ void CHIP8Interpreter::opcodeA() {
 /**
  * Handles all opcodes that start with B
  **/
+template<int VARIANT, int QUIRKS>
 void CHIP8Interpreter::opcodeB() {
-    // BNNN - Jump to address NNN + V0
-    pc = V[0] + (0x0FFF & opcode);
+    if(QUIRKS & CHIP8_QUIRK_JUMP_VX) {
+        // BXNN - Jump to address XNN + VX
+        pc = V[(0x0F00 & opcode) >> 8] + (0x0FFF & opcode);
+    } else {
+        // BNNN - Jump to address NNN + V0
+        pc = V[0] + (0x0FFF & opcode);
+    }
 }
 
 /**
  * Handles all opcodes that start with C
  **/
+template<int VARIANT, int QUIRKS>
 void CHIP8Interpreter::opcodeC() {
     // CXNN - Set VX to a random number with a mask of NN
-    V[(0x0F00 & opcode) >> 8] = (rand() % 0xFF) & (0x00FF & opcode);
+    V[(0x0F00 & opcode) >> 8] = randomByte() & (0x00FF & opcode);
 }
 
 /**
@@ -297,52 +1051,102 @@ void CHIP8Interpreter::opcodeC() {
  * Draw a sprite at position VX, VY with N bytes of sprite data starting 
  * at the address stored in I 
  * Set VF to 01 if any set pixels are changed to unset, and 00 otherwise
+ * 
+ * The starting position wraps around the screen, the parts of the sprite that 
+ * go past the right or bottom edge are clipped (or wrap around with CHIP8_QUIRK_WRAP_SPRITES)
+ *
+ * SUPER-CHIP and XO-CHIP draw a 16x16 sprite for DXY0, and XO-CHIP draws to every
+ * selected plane in turn with the data for each following the previous one.
  **/
+template<int VARIANT, int QUIRKS>
 void CHIP8Interpreter::opcodeD() {
+    const uint16_t mask = ADDRESS_MASK(VARIANT);
     V[0xF] = 0;
     uint8_t X = (0x0F00 & opcode) >> 8;
     uint8_t Y = (0x00F0 & opcode) >> 4;
-    
-    // DXYN - Draw a sprite at position (VX,VY)
-    // The corresponding graphic on the screen will be eight pixels wide and N pixels high.
     uint8_t N = 0x000F & opcode;
-    for(int sprite_y = 0; sprite_y < N; sprite_y++) {
-        // Get the 8-bit pixel data that represents this row in the sprite
-        uint8_t pixel = memory[I + sprite_y];
-        for(int sprite_x = 0; sprite_x < 8; sprite_x++) {
-            // Check if the current x value in the pixel data is a 1 (ie. should be drawn)
-            if((pixel & (0x80 >> sprite_x)) != 0) {
-                // Test for collision
-                if(display[V[X] + sprite_x][V[Y] + sprite_y]) {
-                    V[0xF] = 1;
+    uint64_t collision = 0;
+
+    if(VARIANT == CHIP8_VARIANT_CHIP8 && !(QUIRKS & CHIP8_QUIRK_WRAP_SPRITES)) {
+        uint8_t x = V[X] % CHIP8_SCREEN_WIDTH;
+        uint8_t y = V[Y] % CHIP8_SCREEN_HEIGHT;
+
+        // DXYN - Draw a sprite at position (VX,VY)
+        // The corresponding graphic on the screen will be eight pixels wide and N pixels high.
+        for(int sprite_y = 0; sprite_y < N && y + sprite_y < CHIP8_SCREEN_HEIGHT; sprite_y++) {
+            // Line the 8-bit pixel data up with the row, the bits past the right edge fall off
+            uint64_t pixels = ((uint64_t)MEMORY(VARIANT)[(I + sprite_y) & mask] << 56) >> x;
+            // Any pixel that is set in both is about to be unset
+            collision |= display[0][y + sprite_y][0] & pixels;
+            display[0][y + sprite_y][0] ^= pixels;
+        }
+    } else {
+        int width = screenWidth();
+        int height = screenHeight();
+        int x = V[X] & (width - 1);
+        int y = V[Y] & (height - 1);
+
+        // DXY0 is 16 pixels wide and 16 high, 2 bytes per row
+        bool big = (N == 0 && VARIANT != CHIP8_VARIANT_CHIP8);
+        int rows = big ? 16 : N;
+        int row_bytes = big ? 2 : 1;
+
+        uint16_t address = I;
+        for(int plane = 0; plane < CHIP8_PLANES; plane++) {
+            if(!(planes & (1 << plane))) {
+                continue;
+            }
+            for(int sprite_y = 0; sprite_y < rows; sprite_y++) {
+                int line = y + sprite_y;
+                if(line >= height) {
+                    if(!(QUIRKS & CHIP8_QUIRK_WRAP_SPRITES)) {
+                        break;
+                    }
+                    line -= height;
                 }
-                display[V[X] + sprite_x][V[Y] + sprite_y] ^= 1;
+
+                uint16_t data = address + sprite_y * row_bytes;
+                uint32_t bits = MEMORY(VARIANT)[data & mask];
+                if(big) {
+                    bits = (bits << 8) | MEMORY(VARIANT)[(data + 1) & mask];
+                }
+                uint64_t pixels[2];
+                spriteRow(bits, row_bytes * 8, x, width, (QUIRKS & CHIP8_QUIRK_WRAP_SPRITES) != 0, pixels);
+
+                uint64_t *row = display[plane][line];
+                collision |= (row[0] & pixels[0]) | (row[1] & pixels[1]);
+                row[0] ^= pixels[0];
+                row[1] ^= pixels[1];
             }
+            address += rows * row_bytes;
         }
     }
+    V[0xF] = (collision != 0);
 
     draw_flag = 1;
+    PROFILE(draw());
 }
 
 /**
  * Handles all opcodes that start with E
  **/
+template<int VARIANT, int QUIRKS>
 void CHIP8Interpreter::opcodeE() {
     uint8_t X = (0x0F00 & opcode) >> 8;
 
     // EX9E - Skip the following instruction if the key corresponding to the hex 
     // value currently stored in register VX is pressed
     if((0x00FF & opcode) == 0x009E) {
-        if(key[V[X]]) {
-            pc += 2;
+        if(keyDown(V[X])) {
+            skipNext<VARIANT>();
         }
     }
     
     // EXA1 - Skip the following instruction if the key corresponding to the hex 
     // value currently stored in register VX is not pressed
     if((0x00FF & opcode) == 0x00A1) {
-        if(!key[V[X]]) {
-            pc += 2;
+        if(!keyDown(V[X])) {
+            skipNext<VARIANT>();
         }
     }
 }
@@ -350,10 +1154,33 @@ void CHIP8Interpreter::opcodeE() {
 /**
  * Handles all opcodes that start with F
  **/
+template<int VARIANT, int QUIRKS>
 void CHIP8Interpreter::opcodeF() {
+    const uint16_t mask = ADDRESS_MASK(VARIANT);
     uint8_t n = 0x00FF & opcode;
     uint8_t X = (0x0F00 & opcode) >> 8;
     switch(n) {
+        case 0x0000:
+            // F000 NNNN - Load the 16-bit address in the next word into I (XO-CHIP)
+            if(VARIANT == CHIP8_VARIANT_XOCHIP && X == 0) {
+                I = (memory[pc & mask] << 8) | memory[(pc + 1) & mask];
+                pc += 2;
+            }
+            break;
+        case 0x0001:
+            // FN01 - Select the planes N to draw to, clear and scroll (XO-CHIP)
+            if(VARIANT == CHIP8_VARIANT_XOCHIP) {
+                planes = X & 0x3;
+            }
+            break;
+        case 0x0002:
+            // F002 - Load the 16-byte audio pattern from address I (XO-CHIP)
+            if(VARIANT == CHIP8_VARIANT_XOCHIP && X == 0) {
+                for(int i = 0; i < 16; i++) {
+                    audio_pattern[i] = memory[(I + i) & mask];
+                }
+            }
+            break;
         case 0x0007:
             // FX07 - Sets VX to the value of the delay timer
             V[X] = timer_delay;
@@ -362,15 +1189,11 @@ void CHIP8Interpreter::opcodeF() {
         {
             // FX0A - A key press is awaited, and then stored in VX. 
             // (Blocking Operation. All instruction halted until next key event)
-            bool key_pressed = false;
-            for(int i=0; i < 16; i++) { 
-                if(key[i] != 0) {
-                    key_pressed = true;
-                    V[X] = i;
-                }
-            }
-            // Repeat this instruction if key wasn't pressed
-            if(!key_pressed) {
+            // The highest key down wins when there are several
+            if(keys != 0) {
+                V[X] = 31 - __builtin_clz(keys);
+            } else {
+                // Repeat this instruction if key wasn't pressed
                 pc -= 2;
             }
             break;
@@ -386,38 +1209,73 @@ void CHIP8Interpreter::opcodeF() {
         case 0x001E:
             // FX1E - Add the value stored in register VX to register I
             // Set VF to 1 if overflow
-            V[0xF] = (I + V[X] > 0xFFF) ? 1 : 0;
+            if(QUIRKS & CHIP8_QUIRK_ADD_I_CARRY) {
+                V[0xF] = (I + V[X] > 0xFFF) ? 1 : 0;
+            }
             I += V[X];
+            break;
         case 0x0029:
             // FX29 - Set I to the memory address of the sprite data corresponding 
             // to the hexadecimal digit stored in register VX
             // Point I to an image of a hex character for the low 4 bits of the value 
             // of register VX. The image is 4 pixels wide and 5 pixels high
-            I = V[X] * 5;
+            I = CHIP8_FONT_ADDRESS + V[X] * 5;
             break;  
+        case 0x0030:
+            // FX30 - Point I to the 8x10 image of the hex digit in VX (SUPER-CHIP)
+            if(VARIANT != CHIP8_VARIANT_CHIP8) {
+                I = CHIP8_BIG_FONT_ADDRESS + (V[X] & 0xF) * 10;
+            }
+            break;
         case 0x0033:
             // FX33 - Store the binary-coded decimal equivalent of the value stored in 
             // register VX at addresses I, I+1, and I+2
-            memory[I] = V[X] / 100;
-            memory[I + 1] = (V[X] / 10) % 10;
-            memory[I + 2] = (V[X] % 100) % 10;
+            MEMORY(VARIANT)[I & mask] = V[X] / 100;
+            MEMORY(VARIANT)[(I + 1) & mask] = (V[X] / 10) % 10;
+            MEMORY(VARIANT)[(I + 2) & mask] = (V[X] % 100) % 10;
+            codeWritten(I, 3);
+            break;
+        case 0x003A:
+            // FX3A - Set the playback rate of the audio pattern to VX (XO-CHIP)
+            if(VARIANT == CHIP8_VARIANT_XOCHIP) {
+                pitch = V[X];
+            }
             break;
         case 0x0055:
             // FX55 - Store the values of registers V0 to VX inclusive in memory starting 
             // at address I. 
             for(int i = 0; i <= X; i++) {
-                memory[I + i] = V[i];
+                MEMORY(VARIANT)[(I + i) & mask] = V[i];
             }
+            codeWritten(I, X + 1);
             // I is set to I + X + 1 after operation
-            I += X + 1;
+            if(!(QUIRKS & CHIP8_QUIRK_FIXED_I)) {
+                I += X + 1;
+            }
             break;
         case 0x0065:
             // FX65 - Fill registers V0 to VX inclusive with the values stored in memory starting at address I
             for(int i = 0; i <= X; i++) {
-                V[i] = memory[I + i];
+                V[i] = MEMORY(VARIANT)[(I + i) & mask];
             }
             // I is set to I + X + 1 after operation
-            I += X + 1;
+            if(!(QUIRKS & CHIP8_QUIRK_FIXED_I)) {
+                I += X + 1;
+            }
+            break;
+        case 0x0075:
+        case 0x0085:
+            // FX75 / FX85 - Store / load V0 to VX in the RPL user flags, SUPER-CHIP only has 8 of them
+            if(VARIANT != CHIP8_VARIANT_CHIP8) {
+                int last = (VARIANT == CHIP8_VARIANT_SCHIP) ? (X & 0x7) : X;
+                for(int i = 0; i <= last; i++) {
+                    if(n == 0x0075) {
+                        rpl[i] = V[i];
+                    } else {
+                        V[i] = rpl[i];
+                    }
+                }
+            }
             break;
         default:
             break;
@@ -425,47 +1283,126 @@ void CHIP8Interpreter::opcodeF() {
 }
 
 /**
- * Load the contents of a CHIP-8 file into memory.
+ * Load the contents of a CHIP-8 file into memory. The file is read straight into the
+ * program area, nothing is allocated. On failure the interpreter is left reset with no
+ * program loaded.
  * 
  * @param   filename    The name of the file to load
+ * @param   error       Receives why the file couldn't be loaded, may be NULL
  * @return              true if succesfully loaded the file
  **/
-bool CHIP8Interpreter::loadRom(const char *filename) {
+bool CHIP8Interpreter::loadRom(const char *filename, CHIP8RomError *error) {
     reset();
 
     // Open the file
     FILE *file = fopen(filename, "rb");
     if(file == NULL) {
-        return false;
+        return romLoaded(CHIP8_ROM_NOT_FOUND, error);
     }
-    
-    // Get file size
-    fseek(file, 0, SEEK_END);
-    unsigned long file_size = ftell(file);
-    rewind(file);
-
-    // Create a buffer to hold the file contents
-    char *buffer = (char*)malloc(sizeof(char) * file_size);
-    if(buffer == NULL) {
-        return false;
+
+    // Read up to one byte more than fits, to tell a ROM that fills memory from one that is too big
+    size_t space = address_mask + 1u - 0x200;
+    size_t size = fread(&memory[0x200], 1, space, file);
+    bool too_large = (size == space) && (fgetc(file) != EOF);
+    bool failed = ferror(file) != 0;
+    fclose(file);
+
+    if(failed) {
+        return romLoaded(CHIP8_ROM_READ_ERROR, error);
+    }
+    if(too_large) {
+        return romLoaded(CHIP8_ROM_TOO_LARGE, error);
+    }
+    if(size == 0) {
+        return romLoaded(CHIP8_ROM_EMPTY, error);
     }
+    rom_hash = hashRom(&memory[0x200], size);
 
-    // Copy the file into the buffer
-    size_t result = fread(buffer, 1, file_size, file);
-    if(result != file_size) {
-        return false;
+    return romLoaded(CHIP8_ROM_OK, error);
+}
+
+/**
+ * Load a CHIP-8 program that is already in memory.
+ *
+ * @param   data    The program
+ * @param   size    The size of the program in bytes
+ * @param   error   Receives why the program couldn't be loaded, may be NULL
+ * @return          true if the program fits in the platform's memory and was loaded
+ **/
+bool CHIP8Interpreter::loadRom(const uint8_t *data, size_t size, CHIP8RomError *error) {
+    reset();
+
+    if(size > address_mask + 1u - 0x200) {
+        return romLoaded(CHIP8_ROM_TOO_LARGE, error);
     }
+    if(size == 0) {
+        return romLoaded(CHIP8_ROM_EMPTY, error);
+    }
+    memcpy(&memory[0x200], data, size);
+    rom_hash = hashRom(data, size);
 
-    // Copy buffer to the CHIP-8 memory
-    if((CHIP8_MEMORY_MAX - 0x200) > file_size) {
-        for(unsigned int i = 0; i < file_size; i++) {
-            memory[i + 0x200] = buffer[i];
-        }
+    return romLoaded(CHIP8_ROM_OK, error);
+}
+
+/**
+ * Identifies a ROM by its contents (64-bit FNV-1a), so a movie can tell whether it is
+ * being replayed against the program it was recorded with
+ *
+ * @param   data    The ROM
+ * @param   size    Its size in bytes
+ * @return          The hash, the same bytes always give the same hash
+ **/
+uint64_t CHIP8Interpreter::hashRom(const uint8_t *data, size_t size) {
+    uint64_t hash = 0xCBF29CE484222325ULL;
+    for(size_t i = 0; i < size; i++) {
+        hash ^= data[i];
+        hash *= 0x100000001B3ULL;
     }
+    return hash;
+}
 
-    // Close the file, free buffer
-    fclose(file);
-    free(buffer);
+/**
+ * Folds a row word of the display into a hash. The word goes through the splitmix64
+ * finalizer first: xoring whole words in and multiplying, like FNV does with bytes,
+ * never carries the top bits down, so pixels in column 0 cancel out.
+ *
+ * @param   hash    The hash so far, 0xCBF29CE484222325 to start
+ * @param   word    64 pixels of a row, the leftmost in the top bit
+ * @return          The new hash
+ **/
+uint64_t CHIP8Interpreter::hashDisplayWord(uint64_t hash, uint64_t word) {
+    word ^= word >> 30;
+    word *= 0xBF58476D1CE4E5B9ULL;
+    word ^= word >> 27;
+    word *= 0x94D049BB133111EBULL;
+    word ^= word >> 31;
+    hash ^= word;
+    hash *= 0x100000001B3ULL;
+    return hash ^ (hash >> 32);
+}
 
-    return true;
-}
\ No newline at end of file
+/**
+ * @param   error   Why loadRom() failed
+ * @return          A description of it for the user
+ **/
+const char *chip8RomErrorText(CHIP8RomError error) {
+    switch(error) {
+        case CHIP8_ROM_OK:          return "loaded";
+        case CHIP8_ROM_NOT_FOUND:   return "could not open the file";
+        case CHIP8_ROM_READ_ERROR:  return "could not read the file";
+        case CHIP8_ROM_EMPTY:       return "the file is empty";
+        case CHIP8_ROM_TOO_LARGE:   return "too large for the platform's memory";
+        default:                    return "unknown error";
+    }
+}
+
+#ifdef CHIP8_PROFILE
+/**
+ * Writes the profile of everything executed since the last reset
+ *
+ * @param   out     Where to write the report
+ **/
+void CHIP8Interpreter::profileReport(FILE *out) const {
+    profile->report(out, memory);
+}
+#endif
@@ -1,9 +1,80 @@
 #ifndef CHIP8_H
 #define CHIP8_H
 
+#include <stdint.h>
+#include <stddef.h>
+
+#include "platform.hpp"
+
 #define CHIP8_MEMORY_MAX    4096
+#define CHIP8_ADDRESS_MASK  (CHIP8_MEMORY_MAX - 1)  // Addresses past the end of memory wrap around
+#define CHIP8_XO_MEMORY_MAX 65536                   // XO-CHIP has the whole 16-bit address space
 #define CHIP8_SCREEN_WIDTH  64
 #define CHIP8_SCREEN_HEIGHT 32
+#define CHIP8_HIRES_WIDTH   128                     // SUPER-CHIP and XO-CHIP high resolution mode
+#define CHIP8_HIRES_HEIGHT  64
+#define CHIP8_PLANES        2                       // XO-CHIP bitplanes, the other variants only use the first
+
+// Where the font sprites are loaded
+#define CHIP8_FONT_ADDRESS      0x000   // 4x5 hexadecimal digits (FX29)
+#define CHIP8_BIG_FONT_ADDRESS  0x050   // 8x10 hexadecimal digits (FX30), SUPER-CHIP and XO-CHIP only
+
+// Seed used by CXNN until seed() is called
+#define CHIP8_DEFAULT_SEED  0x43484950382D3031ULL
+
+// Save state format, see savestate.cpp
+#define CHIP8_STATE_VERSION     3
+#define CHIP8_STATE_SIZE_V1     (16 + 16 + 16 * 2 + 3 + CHIP8_MEMORY_MAX + CHIP8_SCREEN_HEIGHT * 8)
+#define CHIP8_STATE_SIZE_V2     (CHIP8_STATE_SIZE_V1 + 8)
+#define CHIP8_STATE_SIZE_BASE   (CHIP8_STATE_SIZE_V2 + 4 + 16 + 16)
+#define CHIP8_STATE_SIZE_HIRES  (CHIP8_STATE_SIZE_BASE + CHIP8_PLANES * CHIP8_HIRES_HEIGHT * 16)
+#define CHIP8_STATE_SIZE        (CHIP8_STATE_SIZE_HIRES + CHIP8_XO_MEMORY_MAX - CHIP8_MEMORY_MAX)  // Largest, any platform fits
+
+class CHIP8BlockCache;
+class CHIP8Jit;
+class CHIP8Aot;
+class CHIP8Debugger;
+#ifdef CHIP8_PROFILE
+#include <stdio.h>
+class CHIP8Profile;
+#endif
+
+/**
+ * The ways the interpreter can execute a program. All of them produce the same results,
+ * they only differ in how fast they get there. The block cache, JIT and recompiled programs
+ * only know CHIP8_PLATFORM_CHIP8, every other platform always runs in the interpreter.
+ **/
+enum CHIP8Engine {
+    CHIP8_ENGINE_INTERPRETER,   // Fetch, decode and execute one opcode at a time
+    CHIP8_ENGINE_CACHED,        // Execute basic blocks that were decoded once and cached
+    CHIP8_ENGINE_JIT,           // Translate hot blocks to native code (x86-64 hosts only)
+    CHIP8_ENGINE_AOT            // Run the program's code recompiled ahead of time by chip8-aot and linked
+                                // in, the interpreter runs programs that weren't recompiled
+};
+
+/**
+ * What the program is doing, as reported by step() and run(). Anything other than
+ * CHIP8_RUNNING means it is spinning in place and the host can skip ahead.
+ **/
+enum CHIP8Status {
+    CHIP8_RUNNING,      // Doing work
+    CHIP8_WAIT_KEY,     // FX0A waiting for a key press
+    CHIP8_WAIT_TIMER,   // FX07, 3X00, 1NNN loop polling the delay timer until it reaches 0
+    CHIP8_HALTED        // 1NNN jumping to itself, nothing but the timers will ever change
+};
+
+/**
+ * Why loadRom() failed
+ **/
+enum CHIP8RomError {
+    CHIP8_ROM_OK,
+    CHIP8_ROM_NOT_FOUND,    // The file could not be opened
+    CHIP8_ROM_READ_ERROR,   // Reading the file failed part way
+    CHIP8_ROM_EMPTY,        // The file has nothing in it
+    CHIP8_ROM_TOO_LARGE     // The program doesn't fit in the platform's memory
+};
+
+const char *chip8RomErrorText(CHIP8RomError error);
 
 /**
  * Emulates a CHIP-8 interpreter by providing functions to execute a 
@@ -14,7 +85,7 @@ class CHIP8Interpreter {
     uint16_t pc;        // Program counter
     uint16_t I;         // Index register
 
-    uint8_t memory[CHIP8_MEMORY_MAX];   // CPU memory (Program rom and work ram: 0x200-0xFFF)
+    uint8_t *memory;    // CPU memory (Program rom and work ram: 0x200-0xFFF, up to 0xFFFF on XO-CHIP), memorySize() bytes
     uint8_t V[16];                      // Registers                                              
 
     uint16_t stack[16]; // Stack where the program counter is stored - has 16 levels
@@ -24,46 +95,150 @@ class CHIP8Interpreter {
     uint8_t timer_delay;
     uint8_t timer_sound;
 
+    uint16_t keys;      // The Chip-8 keypad, bit N is set while key N is down
+
+    // Random number generator behind CXNN (xorshift64*), every interpreter has its own
+    uint64_t rng_seed;  // What reset() restarts the sequence from
+    uint64_t rng_state;
+
+    // SUPER-CHIP and XO-CHIP state
+    bool hires;                 // 128x64 instead of 64x32
+    uint8_t planes;             // Bitplanes drawn to, cleared and scrolled (bit 0 is the first plane)
+    uint8_t rpl[16];            // RPL user flags (FX75, FX85)
+    uint8_t audio_pattern[16];  // 1-bit samples played while the sound timer runs (F002)
+    uint8_t pitch;              // Playback rate of the pattern, 4000 * 2 ^ ((pitch - 64) / 48) Hz (FX3A)
+
     public:
-        uint8_t display[CHIP8_SCREEN_WIDTH][CHIP8_SCREEN_HEIGHT];   // Screen buffer
+        // Screen buffer for each bitplane - two 64-bit words per row, the most significant bit of the
+        // first is the leftmost pixel. In low resolution only the first 32 rows of the first word are used.
+        uint64_t display[CHIP8_PLANES][CHIP8_HIRES_HEIGHT][2];
         int draw_flag = 0;  // Will be set to 1 when the display changes
-        int key[16];        // The state of each key for the Chip-8 keypad
 
         CHIP8Interpreter();
+        CHIP8Interpreter(const CHIP8Interpreter &other);
+        CHIP8Interpreter &operator=(const CHIP8Interpreter &other);
+        ~CHIP8Interpreter();
         void reset();
-        void step();
+        void seed(uint64_t value);
+        uint64_t getSeed() const { return rng_seed; }
+        void setPlatform(CHIP8Platform platform);
+        CHIP8Platform getPlatform() const { return platform; }
+        CHIP8Status step();
+        CHIP8Status run(int cycles);
+        CHIP8Status idleStatus() const;
+        void setKey(int key, bool down) { keys = down ? (keys | (1 << (key & 0xF))) : (keys & ~(1 << (key & 0xF))); }
+        bool keyDown(int key) const { return key < 16 && ((keys >> key) & 1); }
+        void setKeys(uint16_t keys) { this->keys = keys; }
+        uint16_t getKeys() const { return keys; }
+        bool timersRunning() const { return timer_delay != 0 || timer_sound != 0; }
+        bool soundOn() const { return timer_sound != 0; }
+        const uint8_t *audioPattern() const { return audio_pattern; }
+        uint8_t getPitch() const { return pitch; }
+        void setEngine(CHIP8Engine engine);
+        CHIP8Engine getEngine() const { return engine; }
+        bool sameState(const CHIP8Interpreter &other) const;
         void timerUpdate();
         void clearDisplay();
-        bool loadRom(const char *filename);
+        int screenWidth() const { return hires ? CHIP8_HIRES_WIDTH : CHIP8_SCREEN_WIDTH; }
+        int screenHeight() const { return hires ? CHIP8_HIRES_HEIGHT : CHIP8_SCREEN_HEIGHT; }
+        bool getPixel(int x, int y) const { return (display[0][y][x >> 6] >> (63 - (x & 63))) & 1; }
+        void unpackDisplay(uint8_t pixels[CHIP8_HIRES_HEIGHT][CHIP8_HIRES_WIDTH]) const;
+        uint64_t displayHash() const;
+        bool loadRom(const char *filename, CHIP8RomError *error = NULL);
+        bool loadRom(const uint8_t *data, size_t size, CHIP8RomError *error = NULL);
+        uint64_t romHash() const { return rom_hash; }
+        const uint8_t *getMemory() const { return memory; }
+        size_t memorySize() const { return (size_t)address_mask + 1; }
+        static uint64_t hashRom(const uint8_t *data, size_t size);
+        static uint64_t hashDisplayWord(uint64_t hash, uint64_t word);
+
+        // ======================================== Save States ========================================
+        size_t stateSize() const;
+        size_t saveState(uint8_t *buffer, size_t size) const;
+        bool loadState(const uint8_t *buffer, size_t size);
+        bool saveStateFile(const char *filename) const;
+        bool loadStateFile(const char *filename);
+
+#ifdef CHIP8_PROFILE
+        // ======================================== Profiling ========================================
+        CHIP8Profile *profile;          // Counters for everything step() executes
+        void profileReport(FILE *out) const;
+#endif
 
     private:
-        // ======================================== Opcode Functions ========================================  
-        void opcode0();
-        void opcode1();
-        void opcode2();
-        void opcode3();
-        void opcode4();
-        void opcode5();
-        void opcode6();
-        void opcode7();
-        void opcode8();
-        void opcode9();
-        void opcodeA();
-        void opcodeB();
-        void opcodeC();
-        void opcodeD();
-        void opcodeE();
-        void opcodeF();
+        friend class CHIP8BlockCache;
+        friend class CHIP8Jit;
+        friend class CHIP8Lockstep;
+        friend class CHIP8Aot;
+        friend class CHIP8Debugger;
+        friend class CHIP8ForkPool;
+
+        CHIP8Platform platform;         // What the program is written for
+        uint16_t address_mask;          // Memory size of the platform - 1
+        uint64_t rom_hash;              // hashRom() of the loaded ROM, 0 after reset()
+        CHIP8Engine engine;             // How run() executes the program
+        CHIP8BlockCache *block_cache;   // Decoded blocks, only allocated for CHIP8_ENGINE_CACHED
+        CHIP8Jit *jit;                  // Native blocks, only allocated for CHIP8_ENGINE_JIT
+        CHIP8Aot *aot;                  // Recompiled program, only allocated for CHIP8_ENGINE_AOT
+        const uint8_t *code_map;        // Non-zero for every address covered by a cached or native block
+        CHIP8Debugger *debugger;        // Attached debugger, run() hands it the instructions while it is armed
+
+        // Where memory points: the 4 KB of CHIP-8 and SUPER-CHIP are part of the interpreter,
+        // the 64 KB of XO-CHIP are only allocated while that platform is selected. The
+        // display stays whole for every platform, its layout is what hosts draw from.
+        uint8_t classic_memory[CHIP8_MEMORY_MAX];
+        uint8_t *xo_memory;
+
+        void applyPlatform(CHIP8Platform platform);
+        void copyState(const CHIP8Interpreter &other);
+        bool romLoaded(CHIP8RomError result, CHIP8RomError *error);
+        void codeWritten(uint16_t address, int length);
+        uint8_t randomByte();
+        void invalidateCode();
+        uint16_t fetch(uint16_t address) const;
+        int skipIdle(int cycles);
+        void clearPlanes(uint8_t mask);
+        void scrollVertical(int rows);
+        void scrollHorizontal(int pixels);
+        void setResolution(bool hires);
+
+        template<int VARIANT, int QUIRKS> CHIP8Status stepPlatform();
+        template<int VARIANT, int QUIRKS> CHIP8Status runPlatform(int cycles);
+        template<int VARIANT> void skipNext();
+
+        // ======================================== Opcode Functions ========================================
+        // Each platform gets its own copy of the handlers with its variant and quirks compiled in
+        template<int VARIANT, int QUIRKS> void opcode0();
+        template<int VARIANT, int QUIRKS> void opcode1();
+        template<int VARIANT, int QUIRKS> void opcode2();
+        template<int VARIANT, int QUIRKS> void opcode3();
+        template<int VARIANT, int QUIRKS> void opcode4();
+        template<int VARIANT, int QUIRKS> void opcode5();
+        template<int VARIANT, int QUIRKS> void opcode6();
+        template<int VARIANT, int QUIRKS> void opcode7();
+        template<int VARIANT, int QUIRKS> void opcode8();
+        template<int VARIANT, int QUIRKS> void opcode9();
+        template<int VARIANT, int QUIRKS> void opcodeA();
+        template<int VARIANT, int QUIRKS> void opcodeB();
+        template<int VARIANT, int QUIRKS> void opcodeC();
+        template<int VARIANT, int QUIRKS> void opcodeD();
+        template<int VARIANT, int QUIRKS> void opcodeE();
+        template<int VARIANT, int QUIRKS> void opcodeF();
 
         typedef void (CHIP8Interpreter::*OpcodeFunc)();
         /**
          * A table of function pointers. Every CHIP-8 opcode falls in the range 0x0nnn to 0xFnnn therefore
-         * this table holds the functions that handle opcodes that start with 0x0 until 0xF.
+         * this table holds the functions that handle opcodes that start with 0x0 until 0xF. These are the
+         * CHIP8_PLATFORM_CHIP8 handlers, the engines use them for the instructions they don't translate.
          **/
+        #define CHIP8_CLASSIC_OPCODE(n) &CHIP8Interpreter::opcode##n<CHIP8_CLASSIC_VARIANT, CHIP8_CLASSIC_QUIRKS>
         OpcodeFunc opcodeTable[16] = {
-            opcode0, opcode1, opcode2, opcode3, opcode4, opcode5, opcode6, opcode7, 
-            opcode8, opcode9, opcodeA, opcodeB, opcodeC, opcodeD, opcodeE, opcodeF
+            CHIP8_CLASSIC_OPCODE(0), CHIP8_CLASSIC_OPCODE(1), CHIP8_CLASSIC_OPCODE(2), CHIP8_CLASSIC_OPCODE(3),
+            CHIP8_CLASSIC_OPCODE(4), CHIP8_CLASSIC_OPCODE(5), CHIP8_CLASSIC_OPCODE(6), CHIP8_CLASSIC_OPCODE(7),
+            CHIP8_CLASSIC_OPCODE(8), CHIP8_CLASSIC_OPCODE(9), CHIP8_CLASSIC_OPCODE(A), CHIP8_CLASSIC_OPCODE(B),
+            CHIP8_CLASSIC_OPCODE(C), CHIP8_CLASSIC_OPCODE(D), CHIP8_CLASSIC_OPCODE(E), CHIP8_CLASSIC_OPCODE(F)
         };
+        #undef CHIP8_CLASSIC_OPCODE
 };
 
 #endif // CHIP8_H
\ No newline at end of file
@@ -0,0 +1,375 @@
+#include <string.h>
+
+#include "debugger.hpp"
+#include "disasm.hpp"
+
+// ==================================================================================================
+// Variables
+// ==================================================================================================
+// Names of the registers a watchpoint can be on
+static const char *register_names[CHIP8_DEBUG_REGISTER_I + 1] = {
+    "V0", "V1", "V2", "V3", "V4", "V5", "V6", "V7",
+    "V8", "V9", "VA", "VB", "VC", "VD", "VE", "VF", "I"
+};
+
+// ==================================================================================================
+// Public Functions
+// ==================================================================================================
+/**
+ * Attaches a debugger to an interpreter, replacing any it had. Nothing is armed yet.
+ *
+ * @param   chip8   The interpreter to debug
+ **/
+CHIP8Debugger::CHIP8Debugger(CHIP8Interpreter &chip8) : chip8(chip8) {
+    memset(breakpoints, 0, sizeof(breakpoints));
+    breakpoint_count = 0;
+    over_active = false;
+    over_pc = 0;
+    over_sp = 0;
+    stop = CHIP8_DEBUG_NONE;
+    stop_address = 0;
+    stop_text[0] = '\0';
+    cycles_executed = 0;
+    chip8.debugger = this;
+}
+
+CHIP8Debugger::~CHIP8Debugger() {
+    if(chip8.debugger == this) {
+        chip8.debugger = NULL;
+    }
+}
+
+/**
+ * Executes instructions one at a time, checking each against the breakpoints and
+ * watchpoints. The interpreter's run() calls this instead of its own loop while
+ * anything is armed.
+ *
+ * @param   cycles  The number of instructions to execute
+ * @return          What the program is waiting for afterwards, see idleStatus()
+ **/
+CHIP8Status CHIP8Debugger::run(int cycles) {
+    // Carrying on from a breakpoint executes the instruction it stopped at
+    bool resuming = (stop == CHIP8_DEBUG_BREAKPOINT && chip8.pc == stop_address);
+    stop = CHIP8_DEBUG_NONE;
+    stop_text[0] = '\0';
+    cycles_executed = 0;
+    for(size_t w = 0; w < watches.size(); w++) {
+        readWatch(watches[w]);
+    }
+
+    while(cycles > 0) {
+        uint16_t pc = chip8.pc;
+        if(over_active && pc == over_pc && chip8.sp == over_sp) {
+            over_active = false;
+            stop = CHIP8_DEBUG_STEP_OVER;
+            stop_address = pc;
+            snprintf(stop_text, sizeof(stop_text), "Returned to 0x%03X", pc);
+            break;
+        }
+        if(breakpoints[pc] && !resuming) {
+            stop = CHIP8_DEBUG_BREAKPOINT;
+            stop_address = pc;
+            snprintf(stop_text, sizeof(stop_text), "Breakpoint at 0x%03X", pc);
+            break;
+        }
+        resuming = false;
+
+        CHIP8Status status = chip8.step();
+        cycles--;
+        cycles_executed++;
+        if(checkWatches(pc)) {
+            break;
+        }
+
+        // Idle loops are skipped like run() does, unless something would stop in them
+        if(status != CHIP8_RUNNING && !breakpointInLoop()) {
+            int left = chip8.skipIdle(cycles);
+            cycles_executed += cycles - left;
+            cycles = left;
+            if(checkWatches(chip8.pc)) {
+                break;
+            }
+        }
+    }
+    return chip8.idleStatus();
+}
+
+/**
+ * Executes exactly one instruction. Watchpoints report what it changed, and a breakpoint
+ * at the instruction after it is reported as reached.
+ *
+ * @return  What step() returned
+ **/
+CHIP8Status CHIP8Debugger::step() {
+    stop = CHIP8_DEBUG_NONE;
+    stop_text[0] = '\0';
+    for(size_t w = 0; w < watches.size(); w++) {
+        readWatch(watches[w]);
+    }
+
+    uint16_t pc = chip8.pc;
+    CHIP8Status status = chip8.step();
+    cycles_executed = 1;
+    if(!checkWatches(pc) && breakpoints[chip8.pc]) {
+        // Reported like run() would, and run() carries on from it the same way
+        stop = CHIP8_DEBUG_BREAKPOINT;
+        stop_address = chip8.pc;
+        snprintf(stop_text, sizeof(stop_text), "Breakpoint at 0x%03X", chip8.pc);
+    }
+    return status;
+}
+
+/**
+ * Steps over the instruction at the program counter. A call (2NNN) isn't executed here:
+ * the debugger is armed to stop once it returns and the host runs the program as usual
+ * until stopReason() is CHIP8_DEBUG_STEP_OVER, breakpoints and watchpoints in the
+ * subroutine still stop it first. Any other instruction is stepped.
+ *
+ * @return  true if a call is being stepped over, false if the instruction was stepped
+ **/
+bool CHIP8Debugger::stepOver() {
+    if((chip8.fetch(chip8.pc) & 0xF000) != 0x2000) {
+        step();
+        return false;
+    }
+    over_active = true;
+    over_pc = chip8.pc + 2;
+    over_sp = chip8.sp;
+    return true;
+}
+
+/**
+ * @param   address     Address of the instruction
+ * @param   on          true to stop before the instruction executes, false to remove it
+ **/
+void CHIP8Debugger::setBreakpoint(uint16_t address, bool on) {
+    address &= chip8.address_mask;
+    if(breakpoints[address] != on) {
+        breakpoint_count += on ? 1 : -1;
+        breakpoints[address] = on;
+    }
+}
+
+void CHIP8Debugger::clearBreakpoints() {
+    memset(breakpoints, 0, sizeof(breakpoints));
+    breakpoint_count = 0;
+}
+
+/**
+ * @param   reg     0 to 15 for V0 to VF, CHIP8_DEBUG_REGISTER_I for I
+ * @return          The number of the watchpoint, -1 if there is no such register
+ **/
+int CHIP8Debugger::watchRegister(int reg) {
+    if(reg < 0 || reg > CHIP8_DEBUG_REGISTER_I) {
+        return -1;
+    }
+    CHIP8Watch watch;
+    watch.reg = reg;
+    watch.address = 0;
+    watch.length = 0;
+    readWatch(watch);
+    watches.push_back(watch);
+    return watches.size() - 1;
+}
+
+/**
+ * @param   address     First byte to watch
+ * @param   length      Number of bytes, at least 1
+ * @return              The number of the watchpoint, -1 if the range doesn't fit in memory
+ **/
+int CHIP8Debugger::watchMemory(uint16_t address, int length) {
+    if(length < 1 || (size_t)address + length > chip8.memorySize()) {
+        return -1;
+    }
+    CHIP8Watch watch;
+    watch.reg = -1;
+    watch.address = address;
+    watch.length = length;
+    readWatch(watch);
+    watches.push_back(watch);
+    return watches.size() - 1;
+}
+
+/**
+ * @param   index   A number returned by watchRegister() or watchMemory(), the ones
+ *                  after it move down by one
+ * @return          false if there is no such watchpoint
+ **/
+bool CHIP8Debugger::removeWatch(int index) {
+    if(index < 0 || (size_t)index >= watches.size()) {
+        return false;
+    }
+    watches.erase(watches.begin() + index);
+    return true;
+}
+
+/**
+ * @param   address     Where an instruction starts
+ * @return              Its length in bytes, 4 for the XO-CHIP F000 NNNN
+ **/
+int CHIP8Debugger::instructionLength(uint16_t address) const {
+    if(chip8PlatformVariant(chip8.platform) == CHIP8_VARIANT_XOCHIP && chip8.fetch(address) == 0xF000) {
+        return 4;
+    }
+    return 2;
+}
+
+/**
+ * Prints the registers, timers and keys
+ **/
+void CHIP8Debugger::printRegisters(FILE *out) const {
+    fprintf(out, "PC 0x%03X  I 0x%03X  SP %d  DT %d  ST %d  keys %04X\n",
+        chip8.pc, chip8.I, chip8.sp, chip8.timer_delay, chip8.timer_sound, chip8.keys);
+    for(int reg = 0; reg < 16; reg++) {
+        fprintf(out, "%s %02X%s", register_names[reg], chip8.V[reg], (reg % 8 == 7) ? "\n" : "  ");
+    }
+}
+
+/**
+ * Prints the return addresses on the stack, innermost first
+ **/
+void CHIP8Debugger::printStack(FILE *out) const {
+    if(chip8.sp == 0) {
+        fprintf(out, "Stack is empty\n");
+    }
+    for(int level = chip8.sp - 1; level >= 0; level--) {
+        fprintf(out, "#%-2d 0x%03X\n", level, chip8.stack[level & 0xF]);
+    }
+}
+
+/**
+ * Prints instructions as they are in memory now. The one at the program counter is
+ * marked with >, breakpoints with *.
+ *
+ * @param   address     Where to start
+ * @param   count       Number of instructions
+ * @return              The address after the last one
+ **/
+uint16_t CHIP8Debugger::printDisassembly(FILE *out, uint16_t address, int count) const {
+    for(int i = 0; i < count; i++) {
+        address &= chip8.address_mask;
+        uint16_t op = chip8.fetch(address);
+        char text[CHIP8_DISASM_MAX];
+        chip8Disassemble(op, text, sizeof(text));
+
+        int length = instructionLength(address);
+        if(length == 4) {
+            // The address follows F000
+            snprintf(text, sizeof(text), "LD I, 0x%04X", chip8.fetch(address + 2));
+        }
+        fprintf(out, "%c%c 0x%03X  %04X  %s\n", (address == chip8.pc) ? '>' : ' ',
+            breakpoints[address] ? '*' : ' ', address, op, text);
+        address += length;
+    }
+    return address & chip8.address_mask;
+}
+
+/**
+ * Prints memory as hex and text, 16 bytes to a line
+ *
+ * @param   address     First byte
+ * @param   length      Number of bytes
+ **/
+void CHIP8Debugger::printMemory(FILE *out, uint16_t address, int length) const {
+    for(int line = 0; line < length; line += 16) {
+        uint16_t start = (address + line) & chip8.address_mask;
+        int count = (length - line < 16) ? (length - line) : 16;
+        fprintf(out, "0x%03X ", start);
+        for(int i = 0; i < 16; i++) {
+            if(i < count) {
+                fprintf(out, " %02X", readByte(start + i));
+            } else {
+                fprintf(out, "   ");
+            }
+        }
+        fprintf(out, "  ");
+        for(int i = 0; i < count; i++) {
+            uint8_t byte = readByte(start + i);
+            fputc((byte >= 0x20 && byte < 0x7F) ? byte : '.', out);
+        }
+        fputc('\n', out);
+    }
+}
+
+/**
+ * Prints the first bitplane of the display, # for lit pixels
+ **/
+void CHIP8Debugger::printDisplay(FILE *out) const {
+    for(int y = 0; y < chip8.screenHeight(); y++) {
+        for(int x = 0; x < chip8.screenWidth(); x++) {
+            fputc(chip8.getPixel(x, y) ? '#' : '.', out);
+        }
+        fputc('\n', out);
+    }
+}
+
+// ==================================================================================================
+// Private Functions
+// ==================================================================================================
+/**
+ * Takes a copy of what a watchpoint watches, as it is now
+ **/
+void CHIP8Debugger::readWatch(CHIP8Watch &watch) const {
+    if(watch.reg == CHIP8_DEBUG_REGISTER_I) {
+        watch.values.resize(2);
+        watch.values[0] = chip8.I >> 8;
+        watch.values[1] = chip8.I & 0xFF;
+    } else if(watch.reg >= 0) {
+        watch.values.resize(1);
+        watch.values[0] = chip8.V[watch.reg];
+    } else {
+        watch.values.assign(&chip8.memory[watch.address], &chip8.memory[watch.address + watch.length]);
+    }
+}
+
+/**
+ * Compares every watchpoint with the copy taken after the last instruction, and takes
+ * a new one. Describes the first change in stop_text.
+ *
+ * @param   address     The instruction that was executed
+ * @return              true if anything watched changed
+ **/
+bool CHIP8Debugger::checkWatches(uint16_t address) {
+    bool changed = false;
+    for(size_t w = 0; w < watches.size(); w++) {
+        CHIP8Watch &watch = watches[w];
+        std::vector<uint8_t> before = watch.values;
+        readWatch(watch);
+        if(changed || before == watch.values) {
+            continue;
+        }
+
+        changed = true;
+        stop = CHIP8_DEBUG_WATCHPOINT;
+        stop_address = address;
+        if(watch.reg == CHIP8_DEBUG_REGISTER_I) {
+            snprintf(stop_text, sizeof(stop_text), "Watchpoint %d: I changed from 0x%03X to 0x%03X at 0x%03X", (int)w,
+                (before[0] << 8) | before[1], chip8.I, address);
+        } else if(watch.reg >= 0) {
+            snprintf(stop_text, sizeof(stop_text), "Watchpoint %d: %s changed from 0x%02X to 0x%02X at 0x%03X", (int)w,
+                register_names[watch.reg], before[0], watch.values[0], address);
+        } else {
+            int i = 0;
+            while(before[i] == watch.values[i]) {
+                i++;
+            }
+            snprintf(stop_text, sizeof(stop_text), "Watchpoint %d: 0x%03X changed from 0x%02X to 0x%02X at 0x%03X", (int)w,
+                watch.address + i, before[i], watch.values[i], address);
+        }
+    }
+    return changed;
+}
+
+/**
+ * @return  true if skipping the idle loop at the program counter would pass over a
+ *          breakpoint or the end of a step over, the loops are at most 3 instructions
+ **/
+bool CHIP8Debugger::breakpointInLoop() const {
+    for(int i = 0; i < 6; i += 2) {
+        uint16_t address = (chip8.pc + i) & chip8.address_mask;
+        if(breakpoints[address] || (over_active && address == over_pc)) {
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,104 @@
+#ifndef CHIP8_DEBUGGER_H
+#define CHIP8_DEBUGGER_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <vector>
+
+#include "chip8.hpp"
+
+// Register numbers for watchRegister(), V0 to VF are 0 to 15
+#define CHIP8_DEBUG_REGISTER_I  16
+
+/**
+ * Why the debugger last stopped the program
+ **/
+enum CHIP8DebugStop {
+    CHIP8_DEBUG_NONE,           // It didn't, the instructions it was given all ran
+    CHIP8_DEBUG_BREAKPOINT,     // The program counter reached a breakpoint
+    CHIP8_DEBUG_WATCHPOINT,     // An instruction changed a watched register or memory byte
+    CHIP8_DEBUG_STEP_OVER       // A call stepped over with stepOver() returned
+};
+
+/**
+ * A register or range of memory the debugger stops on when its value changes
+ **/
+struct CHIP8Watch {
+    int reg;                        // Register number, -1 for memory
+    uint16_t address;               // First byte of memory
+    uint16_t length;                // Number of bytes of memory
+    std::vector<uint8_t> values;    // What the register or bytes held after the last instruction
+};
+
+/**
+ * Breakpoints, watchpoints and inspection for an interpreter.
+ *
+ * The interpreter only looks at its debugger once per call to run(): while nothing is
+ * armed run() takes its usual path (and engine) without any per instruction checks.
+ * Once a breakpoint, a watchpoint or a step over is armed, run() hands the instructions
+ * to this debugger, which steps them in the interpreter one at a time and checks each
+ * of them. Watchpoints compare values after every instruction, so they catch the
+ * instruction that changed something, not writes of the value already there.
+ *
+ * The debugger must not outlive the interpreter it is attached to.
+ **/
+class CHIP8Debugger {
+    public:
+        CHIP8Debugger(CHIP8Interpreter &chip8);
+        ~CHIP8Debugger();
+        bool armed() const { return breakpoint_count > 0 || !watches.empty() || over_active; }
+        CHIP8Status run(int cycles);
+        CHIP8Status step();
+        bool stepOver();
+
+        void setBreakpoint(uint16_t address, bool on);
+        bool breakpoint(uint16_t address) const { return breakpoints[address] != 0; }
+        void clearBreakpoints();
+        int watchRegister(int reg);
+        int watchMemory(uint16_t address, int length);
+        bool removeWatch(int index);
+        const std::vector<CHIP8Watch> &getWatches() const { return watches; }
+
+        // ======================================== Last Stop ========================================
+        CHIP8DebugStop stopReason() const { return stop; }
+        uint16_t stopAddress() const { return stop_address; }
+        const char *stopText() const { return stop_text; }
+        int executed() const { return cycles_executed; }
+
+        // ======================================== Inspection ========================================
+        uint16_t getPC() const { return chip8.pc; }
+        uint16_t getI() const { return chip8.I; }
+        uint8_t getV(int reg) const { return chip8.V[reg & 0xF]; }
+        uint16_t getSP() const { return chip8.sp; }
+        uint16_t getStack(int level) const { return chip8.stack[level & 0xF]; }
+        uint8_t getDelayTimer() const { return chip8.timer_delay; }
+        uint8_t getSoundTimer() const { return chip8.timer_sound; }
+        uint8_t readByte(uint16_t address) const { return chip8.memory[address & chip8.address_mask]; }
+        int instructionLength(uint16_t address) const;
+        void printRegisters(FILE *out) const;
+        void printStack(FILE *out) const;
+        uint16_t printDisassembly(FILE *out, uint16_t address, int count) const;
+        void printMemory(FILE *out, uint16_t address, int length) const;
+        void printDisplay(FILE *out) const;
+
+    private:
+        CHIP8Interpreter &chip8;
+        uint8_t breakpoints[CHIP8_XO_MEMORY_MAX];   // Non-zero at every address with a breakpoint
+        int breakpoint_count;
+        std::vector<CHIP8Watch> watches;
+
+        bool over_active;               // stepOver() is waiting for a call to return
+        uint16_t over_pc;               // The instruction after the call
+        uint16_t over_sp;               // Stack level the call was made at
+
+        CHIP8DebugStop stop;
+        uint16_t stop_address;          // Where it stopped, or the instruction that changed a watchpoint
+        char stop_text[96];             // What happened, for the front end
+        int cycles_executed;            // Instructions the last run() or step() executed
+
+        void readWatch(CHIP8Watch &watch) const;
+        bool checkWatches(uint16_t address);
+        bool breakpointInLoop() const;
+};
+
+#endif // CHIP8_DEBUGGER_H
@@ -0,0 +1,155 @@
+#include <stdint.h>
+#include <stdio.h>
+
+#include "disasm.hpp"
+
+// ==================================================================================================
+// Variables
+// ==================================================================================================
+// Names of the opcode classes, in the order chip8OpcodeClass() numbers them
+static const char *class_names[CHIP8_OPCODE_CLASSES] = {
+    "00E0", "00EE", "0NNN", "1NNN", "2NNN", "3XNN", "4XNN", "5XY0", "6XNN", "7XNN",
+    "8XY0", "8XY1", "8XY2", "8XY3", "8XY4", "8XY5", "8XY6", "8XY7", "8XYE", "9XY0",
+    "ANNN", "BNNN", "CXNN", "DXYN", "EX9E", "EXA1", "FX07", "FX0A", "FX15", "FX18",
+    "FX1E", "FX29", "FX33", "FX55", "FX65",
+    "00CN", "00DN", "00FB", "00FC", "00FD", "00FE", "00FF", "5XY2", "5XY3", "F000",
+    "FN01", "F002", "FX30", "FX3A", "FX75", "FX85", "unknown"
+};
+
+// Assembly for each class: %X is replaced by VX, %Y by VY, %N by N, %P by X as a number, %B by NN
+// and %A by NNN. The SUPER-CHIP and XO-CHIP instructions come after the original ones.
+static const char *class_formats[CHIP8_OPCODE_CLASSES] = {
+    "CLS", "RET", "SYS %A", "JP %A", "CALL %A", "SE %X, %B", "SNE %X, %B", "SE %X, %Y", "LD %X, %B", "ADD %X, %B",
+    "LD %X, %Y", "OR %X, %Y", "AND %X, %Y", "XOR %X, %Y", "ADD %X, %Y", "SUB %X, %Y", "SHR %X", "SUBN %X, %Y", "SHL %X", "SNE %X, %Y",
+    "LD I, %A", "JP V0, %A", "RND %X, %B", "DRW %X, %Y, %N", "SKP %X", "SKNP %X", "LD %X, DT", "LD %X, K", "LD DT, %X", "LD ST, %X",
+    "ADD I, %X", "LD F, %X", "LD B, %X", "LD [I], %X", "LD %X, [I]",
+    "SCD %N", "SCU %N", "SCR", "SCL", "EXIT", "LOW", "HIGH", "LD [I], %X-%Y", "LD %X-%Y, [I]", "LD I, long",
+    "PLANE %P", "AUDIO", "LD HF, %X", "PITCH %X", "LD R, %X", "LD %X, R", "DW %W"
+};
+
+// Class of the opcodes that don't mean anything
+#define CLASS_UNKNOWN   (CHIP8_OPCODE_CLASSES - 1)
+
+// ==================================================================================================
+// Public Functions
+// ==================================================================================================
+/**
+ * Works out which kind of instruction an opcode is
+ *
+ * @param   opcode  The raw opcode
+ * @return          A number from 0 to CHIP8_OPCODE_CLASSES - 1, the last one for opcodes
+ *                  that don't mean anything
+ **/
+int chip8OpcodeClass(uint16_t opcode) {
+    switch((opcode & 0xF000) >> 12) {
+        case 0x0:
+            if(opcode == 0x00E0) return 0;
+            if(opcode == 0x00EE) return 1;
+            if((opcode & 0xFFF0) == 0x00C0) return 35;
+            if((opcode & 0xFFF0) == 0x00D0) return 36;
+            if(opcode >= 0x00FB && opcode <= 0x00FF) return 37 + (opcode - 0x00FB);
+            return 2;
+        case 0x1: return 3;
+        case 0x2: return 4;
+        case 0x3: return 5;
+        case 0x4: return 6;
+        case 0x5:
+            if((opcode & 0x000F) == 0x0) return 7;
+            if((opcode & 0x000F) == 0x2) return 42;
+            if((opcode & 0x000F) == 0x3) return 43;
+            return CLASS_UNKNOWN;
+        case 0x6: return 8;
+        case 0x7: return 9;
+        case 0x8:
+            switch(opcode & 0x000F) {
+                case 0x0: case 0x1: case 0x2: case 0x3:
+                case 0x4: case 0x5: case 0x6: case 0x7:
+                    return 10 + (opcode & 0x000F);
+                case 0xE:
+                    return 18;
+                default:
+                    return CLASS_UNKNOWN;
+            }
+        case 0x9: return ((opcode & 0x000F) == 0) ? 19 : CLASS_UNKNOWN;
+        case 0xA: return 20;
+        case 0xB: return 21;
+        case 0xC: return 22;
+        case 0xD: return 23;
+        case 0xE:
+            if((opcode & 0x00FF) == 0x9E) return 24;
+            if((opcode & 0x00FF) == 0xA1) return 25;
+            return CLASS_UNKNOWN;
+        default:
+            switch(opcode & 0x00FF) {
+                case 0x00: return (opcode == 0xF000) ? 44 : CLASS_UNKNOWN;
+                case 0x01: return 45;
+                case 0x02: return (opcode == 0xF002) ? 46 : CLASS_UNKNOWN;
+                case 0x07: return 26;
+                case 0x0A: return 27;
+                case 0x15: return 28;
+                case 0x18: return 29;
+                case 0x1E: return 30;
+                case 0x29: return 31;
+                case 0x33: return 32;
+                case 0x55: return 33;
+                case 0x65: return 34;
+                case 0x30: return 47;
+                case 0x3A: return 48;
+                case 0x75: return 49;
+                case 0x85: return 50;
+                default:   return CLASS_UNKNOWN;
+            }
+    }
+}
+
+/**
+ * @param   opcode_class    A class returned by chip8OpcodeClass()
+ * @return                  The name of the class, such as "8XY4"
+ **/
+const char *chip8OpcodeClassName(int opcode_class) {
+    if(opcode_class < 0 || opcode_class >= CHIP8_OPCODE_CLASSES) {
+        return class_names[CHIP8_OPCODE_CLASSES - 1];
+    }
+    return class_names[opcode_class];
+}
+
+/**
+ * Writes the assembly for an opcode, such as "DRW V1, V2, 5"
+ *
+ * @param   opcode  The raw opcode
+ * @param   buffer  Where to write the text
+ * @param   size    The size of the buffer, CHIP8_DISASM_MAX is always enough
+ * @return          The length of the text
+ **/
+size_t chip8Disassemble(uint16_t opcode, char *buffer, size_t size) {
+    if(size == 0) {
+        return 0;
+    }
+
+    const char *format = class_formats[chip8OpcodeClass(opcode)];
+    size_t length = 0;
+    for(; *format != '\0'; format++) {
+        char text[8];
+        if(*format != '%') {
+            text[0] = *format;
+            text[1] = '\0';
+        } else {
+            format++;
+            switch(*format) {
+                case 'X': snprintf(text, sizeof(text), "V%X", (opcode & 0x0F00) >> 8); break;
+                case 'Y': snprintf(text, sizeof(text), "V%X", (opcode & 0x00F0) >> 4); break;
+                case 'N': snprintf(text, sizeof(text), "%d", opcode & 0x000F); break;
+                case 'P': snprintf(text, sizeof(text), "%d", (opcode & 0x0F00) >> 8); break;
+                case 'B': snprintf(text, sizeof(text), "0x%02X", opcode & 0x00FF); break;
+                case 'A': snprintf(text, sizeof(text), "0x%03X", opcode & 0x0FFF); break;
+                default:  snprintf(text, sizeof(text), "0x%04X", opcode); break;
+            }
+        }
+        for(const char *c = text; *c != '\0' && length + 1 < size; c++) {
+            buffer[length++] = *c;
+        }
+    }
+    buffer[length] = '\0';
+
+    return length;
+}
@@ -0,0 +1,16 @@
+#ifndef CHIP8_DISASM_H
+#define CHIP8_DISASM_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Longest text chip8Disassemble() writes, including the terminator
+#define CHIP8_DISASM_MAX        24
+// Number of classes chip8OpcodeClass() sorts opcodes into, the last one is for unknown opcodes
+#define CHIP8_OPCODE_CLASSES    52
+
+size_t chip8Disassemble(uint16_t opcode, char *buffer, size_t size);
+int chip8OpcodeClass(uint16_t opcode);
+const char *chip8OpcodeClassName(int opcode_class);
+
+#endif // CHIP8_DISASM_H
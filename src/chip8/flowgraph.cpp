@@ -0,0 +1,229 @@
+#include <string.h>
+
+#include "flowgraph.hpp"
+
+// ==================================================================================================
+// Public Functions
+// ==================================================================================================
+CHIP8FlowGraph::CHIP8FlowGraph() {
+    memset(flags, 0, sizeof(flags));
+    memset(code_map, 0, sizeof(code_map));
+    memset(memory, 0, sizeof(memory));
+}
+
+/**
+ * Works out the control flow graph of the program in an interpreter's memory, as it is
+ * right after loadRom()
+ *
+ * @param   chip8   The interpreter with the program loaded, CHIP8_PLATFORM_CHIP8
+ * @param   start   Where the program starts
+ **/
+void CHIP8FlowGraph::analyze(const CHIP8Interpreter &chip8, uint16_t start) {
+    memcpy(memory, chip8.getMemory(), sizeof(memory));
+    memset(flags, 0, sizeof(flags));
+    memset(code_map, 0, sizeof(code_map));
+    blocks.clear();
+
+    findCode(start);
+    findBlocks();
+    findWrites();
+}
+
+/**
+ * @param   flag    One of the CHIP8_FLOW_* flags
+ * @return          The number of addresses that have it
+ **/
+int CHIP8FlowGraph::count(uint8_t flag) const {
+    int total = 0;
+    for(int address = 0; address < CHIP8_MEMORY_MAX; address++) {
+        total += (flags[address] & flag) != 0;
+    }
+    return total;
+}
+
+/**
+ * Where control can go after an instruction, as far as the instruction alone tells
+ *
+ * @param   address     Where the instruction is
+ * @param   opcode      The instruction
+ * @param   next        Receives up to two addresses, for calls the subroutine comes first
+ *                      and then the instruction it returns to
+ * @return              The number of addresses, 0 for returns and computed jumps
+ **/
+int CHIP8FlowGraph::successors(uint16_t address, uint16_t opcode, uint16_t next[2]) {
+    uint16_t NNN = opcode & 0x0FFF;
+    switch(opcode >> 12) {
+        case 0x0:
+            if(opcode == 0x00EE) {
+                return 0;
+            }
+            break;
+        case 0x1:
+            next[0] = NNN;
+            return 1;
+        case 0x2:
+            next[0] = NNN;
+            next[1] = address + 2;
+            return 2;
+        case 0x3:
+        case 0x4:
+        case 0x5:
+        case 0x9:
+            next[0] = address + 2;
+            next[1] = address + 4;
+            return 2;
+        case 0xB:
+            return 0;
+        case 0xE:
+            if((opcode & 0x00FF) == 0x009E || (opcode & 0x00FF) == 0x00A1) {
+                next[0] = address + 2;
+                next[1] = address + 4;
+                return 2;
+            }
+            break;
+        default:
+            break;
+    }
+    next[0] = address + 2;
+    return 1;
+}
+
+/**
+ * @param   opcode  An instruction
+ * @return          true if control doesn't always go on with the instruction after it
+ **/
+bool CHIP8FlowGraph::endsBlock(uint16_t opcode) {
+    uint16_t next[2];
+    uint8_t kind = opcode >> 12;
+    return kind == 0x1 || kind == 0x2 || kind == 0xB || successors(0, opcode, next) != 1;
+}
+
+// ==================================================================================================
+// Private Functions
+// ==================================================================================================
+/**
+ * Marks every instruction reachable from the start
+ **/
+void CHIP8FlowGraph::findCode(uint16_t start) {
+    std::vector<uint16_t> pending;
+    pending.push_back(start);
+    flags[start] |= CHIP8_FLOW_LEADER;
+
+    while(!pending.empty()) {
+        uint16_t address = pending.back();
+        pending.pop_back();
+        if(flags[address] & CHIP8_FLOW_CODE) {
+            continue;
+        }
+        flags[address] |= CHIP8_FLOW_CODE;
+        code_map[address] = 1;
+        code_map[address + 1] = 1;
+
+        uint16_t op = opcode(address);
+        if(op == 0x00EE) {
+            flags[address] |= CHIP8_FLOW_RETURN;
+        } else if((op >> 12) == 0xB) {
+            flags[address] |= CHIP8_FLOW_COMPUTED;
+        }
+
+        uint16_t next[2];
+        int count = successors(address, op, next);
+        bool ends = endsBlock(op);
+        for(int i = 0; i < count; i++) {
+            // The last whole instruction is at CHIP8_MEMORY_MAX - 2, step() wraps whatever
+            // goes past it around to 0
+            if(next[i] > CHIP8_MEMORY_MAX - 2) {
+                flags[address] |= CHIP8_FLOW_OUTSIDE;
+                next[i] = 0;
+            }
+            if(ends) {
+                flags[next[i]] |= CHIP8_FLOW_LEADER;
+            }
+            pending.push_back(next[i]);
+        }
+    }
+}
+
+/**
+ * Splits the code into basic blocks
+ **/
+void CHIP8FlowGraph::findBlocks() {
+    for(int start = 0; start < CHIP8_MEMORY_MAX; start++) {
+        if((flags[start] & (CHIP8_FLOW_CODE | CHIP8_FLOW_LEADER)) != (CHIP8_FLOW_CODE | CHIP8_FLOW_LEADER)) {
+            continue;
+        }
+
+        CHIP8FlowBlock block;
+        block.start = start;
+        block.length = 0;
+        block.flags = 0;
+        uint16_t address = start;
+        while(true) {
+            block.length++;
+            block.flags |= flags[address] & ~(CHIP8_FLOW_CODE | CHIP8_FLOW_LEADER);
+            uint16_t next = address + 2;
+            if(endsBlock(opcode(address)) || next > CHIP8_MEMORY_MAX - 2 ||
+               (flags[next] & (CHIP8_FLOW_CODE | CHIP8_FLOW_LEADER)) != CHIP8_FLOW_CODE) {
+                break;
+            }
+            address = next;
+        }
+
+        block.successor_count = 0;
+        uint16_t next[2];
+        int count = successors(address, opcode(address), next);
+        for(int i = 0; i < count; i++) {
+            block.successors[block.successor_count++] = (next[i] <= CHIP8_MEMORY_MAX - 2) ? next[i] : 0;
+        }
+        blocks.push_back(block);
+    }
+}
+
+/**
+ * Flags the writes to memory that reach code. I is followed through each block from
+ * where it is set by ANNN, it is unknown at the start of every block.
+ **/
+void CHIP8FlowGraph::findWrites() {
+    for(size_t b = 0; b < blocks.size(); b++) {
+        CHIP8FlowBlock &block = blocks[b];
+        bool known = false;
+        uint16_t I = 0;
+
+        for(int i = 0; i < block.length; i++) {
+            uint16_t address = block.start + i * 2;
+            uint16_t op = opcode(address);
+            uint8_t X = (op & 0x0F00) >> 8;
+            int length = 0;
+
+            if((op >> 12) == 0xA) {
+                known = true;
+                I = op & 0x0FFF;
+            } else if((op & 0xF0FF) == 0xF01E || (op & 0xF0FF) == 0xF029) {
+                known = false;
+            } else if((op & 0xF0FF) == 0xF033) {
+                length = 3;
+            } else if((op & 0xF0FF) == 0xF055) {
+                length = X + 1;
+            }
+
+            if(length > 0) {
+                uint8_t flag = CHIP8_FLOW_MAY_WRITE;
+                if(known) {
+                    flag = 0;
+                    for(int j = 0; j < length; j++) {
+                        if(code_map[(I + j) & CHIP8_ADDRESS_MASK]) {
+                            flag = CHIP8_FLOW_WRITES_CODE;
+                        }
+                    }
+                }
+                flags[address] |= flag;
+                block.flags |= flag;
+            }
+
+            // FX55 and FX65 move I past what they store or load
+            if(((op & 0xF0FF) == 0xF055 || (op & 0xF0FF) == 0xF065) && !(CHIP8_CLASSIC_QUIRKS & CHIP8_QUIRK_FIXED_I)) {
+                I += X + 1;
+            }
+        }
+    }
+}
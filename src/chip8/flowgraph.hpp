@@ -0,0 +1,61 @@
+#ifndef CHIP8_FLOWGRAPH_H
+#define CHIP8_FLOWGRAPH_H
+
+#include <stdint.h>
+#include <vector>
+
+#include "chip8.hpp"
+
+// What the analysis found out about an address, see CHIP8FlowGraph::flags
+#define CHIP8_FLOW_CODE         0x01    // An instruction starts here
+#define CHIP8_FLOW_LEADER       0x02    // A basic block starts here
+#define CHIP8_FLOW_COMPUTED     0x04    // BNNN, a jump whose target depends on a register
+#define CHIP8_FLOW_RETURN       0x08    // 00EE, returns to wherever the stack says
+#define CHIP8_FLOW_MAY_WRITE    0x10    // FX33 or FX55 with an unknown I, it may write into code
+#define CHIP8_FLOW_WRITES_CODE  0x20    // FX33 or FX55 that writes into code
+#define CHIP8_FLOW_OUTSIDE      0x40    // Control can go past the end of memory from here
+
+/**
+ * A run of instructions that is always entered at the first and left after the last
+ **/
+struct CHIP8FlowBlock {
+    uint16_t start;             // Address of the first instruction
+    uint16_t length;            // Number of instructions
+    uint16_t successors[2];     // Where control goes afterwards when it is known
+    uint8_t successor_count;
+    uint8_t flags;              // CHIP8_FLOW_* of the instructions in the block
+};
+
+/**
+ * Recovers the control flow graph of a CHIP8_PLATFORM_CHIP8 program from its memory.
+ *
+ * Every instruction reachable from 0x200 is found by following jumps (1NNN), calls
+ * (2NNN, assuming they return to the instruction after), returns (00EE) and both ways out
+ * of every skip. What can't be followed is flagged instead: the targets of computed
+ * jumps (BNNN) and writes to memory (FX33, FX55) that reach, or may reach, the code that
+ * was found. Control that runs off the end of memory carries on at 0, where step() wraps
+ * it to. Bytes that were never reached are taken to be data.
+ **/
+class CHIP8FlowGraph {
+    public:
+        uint8_t flags[CHIP8_MEMORY_MAX];    // CHIP8_FLOW_* of every address
+        uint8_t code_map[CHIP8_MEMORY_MAX]; // Non-zero for every byte that is part of an instruction
+        std::vector<CHIP8FlowBlock> blocks; // By start address
+
+        CHIP8FlowGraph();
+        void analyze(const CHIP8Interpreter &chip8, uint16_t start = 0x200);
+        int count(uint8_t flag) const;
+        static int successors(uint16_t address, uint16_t opcode, uint16_t next[2]);
+        static bool endsBlock(uint16_t opcode);
+        uint8_t getByte(uint16_t address) const { return memory[address]; }
+        uint16_t opcode(uint16_t address) const { return (memory[address] << 8) | memory[(address + 1) & CHIP8_ADDRESS_MASK]; }
+
+    private:
+        uint8_t memory[CHIP8_MEMORY_MAX];
+
+        void findCode(uint16_t start);
+        void findBlocks();
+        void findWrites();
+};
+
+#endif // CHIP8_FLOWGRAPH_H
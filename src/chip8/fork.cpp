@@ -0,0 +1,243 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "fork.hpp"
+
+// ==================================================================================================
+// Variables
+// ==================================================================================================
+// Pages of the display, all bitplanes in high resolution
+#define DISPLAY_PAGES   ((int)(sizeof(CHIP8Interpreter::display) / CHIP8_PAGE_SIZE))
+
+// ==================================================================================================
+// Public Functions
+// ==================================================================================================
+/**
+ * @param   platform    Platform of the interpreters that will be forked, it decides how
+ *                      many pages of memory a fork has
+ **/
+CHIP8ForkPool::CHIP8ForkPool(CHIP8Platform platform) {
+    size_t memory_size = (chip8PlatformVariant(platform) == CHIP8_VARIANT_XOCHIP) ? CHIP8_XO_MEMORY_MAX : CHIP8_MEMORY_MAX;
+    memory_pages = memory_size / CHIP8_PAGE_SIZE;
+    page_count = memory_pages + DISPLAY_PAGES;
+    fork_size = sizeof(CHIP8Fork) + page_count * sizeof(CHIP8Page *);
+    free_pages = NULL;
+    free_forks = NULL;
+    live_forks = 0;
+    live_pages = 0;
+
+    zero_page = allocPage();
+    memset(zero_page->bytes, 0, sizeof(zero_page->bytes));
+    live_pages = 0;
+}
+
+CHIP8ForkPool::~CHIP8ForkPool() {
+    for(size_t i = 0; i < slabs.size(); i++) {
+        free(slabs[i]);
+    }
+}
+
+/**
+ * Takes the machine state of an interpreter
+ *
+ * @param   chip8   The interpreter, its platform must have the memory size of the pool's
+ * @param   base    A fork to share the pages that haven't changed with, usually the one
+ *                  the interpreter was restored from. NULL to only share zero pages.
+ * @return          The new fork, NULL if the memory size doesn't match
+ **/
+CHIP8Fork *CHIP8ForkPool::fork(const CHIP8Interpreter &chip8, const CHIP8Fork *base) {
+    if(chip8.memorySize() != (size_t)memory_pages * CHIP8_PAGE_SIZE) {
+        return NULL;
+    }
+
+    CHIP8Fork *fork = allocFork();
+    fork->rng_seed = chip8.rng_seed;
+    fork->rng_state = chip8.rng_state;
+    fork->rom_hash = chip8.rom_hash;
+    fork->draw_flag = chip8.draw_flag;
+    fork->platform = chip8.platform;
+    fork->opcode = chip8.opcode;
+    fork->pc = chip8.pc;
+    fork->I = chip8.I;
+    fork->sp = chip8.sp;
+    memcpy(fork->stack, chip8.stack, sizeof(fork->stack));
+    fork->keys = chip8.keys;
+    memcpy(fork->V, chip8.V, sizeof(fork->V));
+    fork->timer_delay = chip8.timer_delay;
+    fork->timer_sound = chip8.timer_sound;
+    fork->hires = chip8.hires;
+    fork->planes = chip8.planes;
+    fork->pitch = chip8.pitch;
+    memcpy(fork->rpl, chip8.rpl, sizeof(fork->rpl));
+    memcpy(fork->audio_pattern, chip8.audio_pattern, sizeof(fork->audio_pattern));
+
+    for(int page = 0; page < page_count; page++) {
+        const uint8_t *bytes = pageBytes(chip8, page);
+        CHIP8Page *shared = NULL;
+        if(base != NULL && memcmp(base->pages[page]->bytes, bytes, CHIP8_PAGE_SIZE) == 0) {
+            shared = base->pages[page];
+        } else if(memcmp(zero_page->bytes, bytes, CHIP8_PAGE_SIZE) == 0) {
+            shared = zero_page;
+        }
+
+        if(shared != NULL) {
+            shared->refs++;
+            fork->pages[page] = shared;
+        } else {
+            CHIP8Page *copy = allocPage();
+            memcpy(copy->bytes, bytes, CHIP8_PAGE_SIZE);
+            fork->pages[page] = copy;
+        }
+    }
+    return fork;
+}
+
+/**
+ * @param   fork    A fork of this pool
+ * @return          Another fork of the same state sharing all of its pages, to be released
+ *                  on its own
+ **/
+CHIP8Fork *CHIP8ForkPool::clone(const CHIP8Fork *fork) {
+    CHIP8Fork *copy = allocFork();
+    CHIP8Page **pages = copy->pages;
+    memcpy(copy, fork, sizeof(CHIP8Fork));
+    copy->pages = pages;
+    for(int page = 0; page < page_count; page++) {
+        pages[page] = fork->pages[page];
+        pages[page]->refs++;
+    }
+    return copy;
+}
+
+/**
+ * Puts the machine state of a fork into an interpreter, whichever engine it uses. Only
+ * the pages of memory that differ are copied, and only those are invalidated in the
+ * engine's caches, so restoring branches of the same game keeps the translated code.
+ *
+ * @param   chip8   The interpreter to overwrite, its memory size must be the pool's
+ * @param   fork    A fork of this pool
+ * @return          false if the memory size doesn't match
+ **/
+bool CHIP8ForkPool::restore(CHIP8Interpreter &chip8, const CHIP8Fork *fork) const {
+    if(chip8.platform != fork->platform) {
+        chip8.applyPlatform(fork->platform);
+        chip8.invalidateCode();
+    }
+    if(chip8.memorySize() != (size_t)memory_pages * CHIP8_PAGE_SIZE) {
+        return false;
+    }
+
+    chip8.rng_seed = fork->rng_seed;
+    chip8.rng_state = fork->rng_state;
+    chip8.draw_flag = fork->draw_flag;
+    chip8.opcode = fork->opcode;
+    chip8.pc = fork->pc;
+    chip8.I = fork->I;
+    chip8.sp = fork->sp;
+    memcpy(chip8.stack, fork->stack, sizeof(chip8.stack));
+    chip8.keys = fork->keys;
+    memcpy(chip8.V, fork->V, sizeof(chip8.V));
+    chip8.timer_delay = fork->timer_delay;
+    chip8.timer_sound = fork->timer_sound;
+    chip8.hires = fork->hires;
+    chip8.planes = fork->planes;
+    chip8.pitch = fork->pitch;
+    memcpy(chip8.rpl, fork->rpl, sizeof(chip8.rpl));
+    memcpy(chip8.audio_pattern, fork->audio_pattern, sizeof(chip8.audio_pattern));
+
+    for(int page = 0; page < memory_pages; page++) {
+        uint8_t *bytes = &chip8.memory[page * CHIP8_PAGE_SIZE];
+        if(memcmp(bytes, fork->pages[page]->bytes, CHIP8_PAGE_SIZE) != 0) {
+            memcpy(bytes, fork->pages[page]->bytes, CHIP8_PAGE_SIZE);
+            chip8.codeWritten(page * CHIP8_PAGE_SIZE, CHIP8_PAGE_SIZE);
+        }
+    }
+    uint8_t *display = (uint8_t *)chip8.display;
+    for(int page = 0; page < DISPLAY_PAGES; page++) {
+        memcpy(&display[page * CHIP8_PAGE_SIZE], fork->pages[memory_pages + page]->bytes, CHIP8_PAGE_SIZE);
+    }
+
+    // Another program altogether, the engines have to start over
+    if(chip8.rom_hash != fork->rom_hash) {
+        chip8.rom_hash = fork->rom_hash;
+        chip8.invalidateCode();
+    }
+    return true;
+}
+
+/**
+ * Gives a fork back to the pool, with every page no other fork uses
+ *
+ * @param   fork    A fork of this pool, may be NULL
+ **/
+void CHIP8ForkPool::release(CHIP8Fork *fork) {
+    if(fork == NULL) {
+        return;
+    }
+    for(int page = 0; page < page_count; page++) {
+        releasePage(fork->pages[page]);
+    }
+    fork->next = free_forks;
+    free_forks = fork;
+    live_forks--;
+}
+
+// ==================================================================================================
+// Private Functions
+// ==================================================================================================
+/**
+ * @return  The bytes of a page in the interpreter, memory pages first and then the display
+ **/
+const uint8_t *CHIP8ForkPool::pageBytes(const CHIP8Interpreter &chip8, int page) const {
+    if(page < memory_pages) {
+        return &chip8.memory[page * CHIP8_PAGE_SIZE];
+    }
+    return (const uint8_t *)chip8.display + (page - memory_pages) * CHIP8_PAGE_SIZE;
+}
+
+/**
+ * @return  A page used by one fork, its bytes are whatever they were
+ **/
+CHIP8Page *CHIP8ForkPool::allocPage() {
+    if(free_pages == NULL) {
+        CHIP8Page *slab = (CHIP8Page *)malloc(sizeof(CHIP8Page) * CHIP8_FORK_SLAB_COUNT);
+        slabs.push_back((uint8_t *)slab);
+        for(int i = 0; i < CHIP8_FORK_SLAB_COUNT; i++) {
+            slab[i].next = free_pages;
+            free_pages = &slab[i];
+        }
+    }
+    CHIP8Page *page = free_pages;
+    free_pages = page->next;
+    page->refs = 1;
+    live_pages++;
+    return page;
+}
+
+/**
+ * @return  A fork with room for its page table, nothing else is set
+ **/
+CHIP8Fork *CHIP8ForkPool::allocFork() {
+    if(free_forks == NULL) {
+        uint8_t *slab = (uint8_t *)malloc(fork_size * CHIP8_FORK_SLAB_COUNT);
+        slabs.push_back(slab);
+        for(int i = 0; i < CHIP8_FORK_SLAB_COUNT; i++) {
+            CHIP8Fork *fork = (CHIP8Fork *)(slab + i * fork_size);
+            fork->pages = (CHIP8Page **)(fork + 1);
+            fork->next = free_forks;
+            free_forks = fork;
+        }
+    }
+    CHIP8Fork *fork = free_forks;
+    free_forks = fork->next;
+    live_forks++;
+    return fork;
+}
+
+void CHIP8ForkPool::releasePage(CHIP8Page *page) {
+    if(--page->refs == 0) {
+        page->next = free_pages;
+        free_pages = page;
+        live_pages--;
+    }
+}
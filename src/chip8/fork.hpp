@@ -0,0 +1,99 @@
+#ifndef CHIP8_FORK_H
+#define CHIP8_FORK_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+#include "chip8.hpp"
+
+// Guest memory and the display are shared between forks in pages of this many bytes
+#define CHIP8_PAGE_SIZE         256
+// Pages and forks are allocated this many at a time
+#define CHIP8_FORK_SLAB_COUNT   256
+
+/**
+ * A page of guest memory or display, shared by every fork it is the same in
+ **/
+struct CHIP8Page {
+    union {
+        uint32_t refs;          // Forks using the page, while it is in use
+        CHIP8Page *next;        // Next free page, while it isn't
+    };
+    uint8_t bytes[CHIP8_PAGE_SIZE];
+};
+
+/**
+ * The machine state of an interpreter at the moment it was forked. The registers are
+ * kept here, memory and the display are kept in pages that are shared with the fork it
+ * was made from wherever they are still the same.
+ **/
+struct CHIP8Fork {
+    uint64_t rng_seed;
+    uint64_t rng_state;
+    uint64_t rom_hash;
+    int draw_flag;
+    CHIP8Platform platform;
+    uint16_t opcode;
+    uint16_t pc;
+    uint16_t I;
+    uint16_t sp;
+    uint16_t stack[16];
+    uint16_t keys;
+    uint8_t V[16];
+    uint8_t timer_delay;
+    uint8_t timer_sound;
+    bool hires;
+    uint8_t planes;
+    uint8_t pitch;
+    uint8_t rpl[16];
+    uint8_t audio_pattern[16];
+    CHIP8Fork *next;            // Next free fork, while it isn't in use
+    CHIP8Page **pages;          // Memory pages, then display pages. Stored right after the fork.
+};
+
+/**
+ * Forks interpreters cheaply, for searching over the states of a game.
+ *
+ * fork() takes the state of an interpreter and restore() puts it back, into the same or
+ * any other interpreter, so one interpreter can run every branch of a search in turn.
+ * Forks are copy-on-write: a page of memory or display that is the same as in the fork
+ * given as the base is shared with it instead of copied, so branches of the same game
+ * share the program and everything else they haven't written to. Pages that are all
+ * zero are shared by every fork. Forks and pages come from free lists filled a slab at a
+ * time, so forking and releasing doesn't go to the heap once the pool has warmed up.
+ *
+ * The interpreter itself keeps flat memory, which every engine addresses directly, so
+ * pages are compared when forking rather than tracked as they are written. A pool is
+ * not thread safe, use one per thread.
+ **/
+class CHIP8ForkPool {
+    public:
+        CHIP8ForkPool(CHIP8Platform platform = CHIP8_PLATFORM_CHIP8);
+        ~CHIP8ForkPool();
+        CHIP8Fork *fork(const CHIP8Interpreter &chip8, const CHIP8Fork *base = NULL);
+        CHIP8Fork *clone(const CHIP8Fork *fork);
+        bool restore(CHIP8Interpreter &chip8, const CHIP8Fork *fork) const;
+        void release(CHIP8Fork *fork);
+        size_t liveForks() const { return live_forks; }
+        size_t livePages() const { return live_pages; }
+        size_t bytesPerFork() const { return fork_size; }
+
+    private:
+        int memory_pages;                   // Pages of guest memory, the platform's memory size
+        int page_count;                     // Memory pages and display pages
+        size_t fork_size;                   // A fork with its page table
+        std::vector<uint8_t *> slabs;       // Everything allocated, freed with the pool
+        CHIP8Page *free_pages;
+        CHIP8Fork *free_forks;
+        CHIP8Page *zero_page;               // Shared by every page that is all zero, never freed
+        size_t live_forks;
+        size_t live_pages;
+
+        const uint8_t *pageBytes(const CHIP8Interpreter &chip8, int page) const;
+        CHIP8Page *allocPage();
+        CHIP8Fork *allocFork();
+        void releasePage(CHIP8Page *page);
+};
+
+#endif // CHIP8_FORK_H
@@ -0,0 +1,62 @@
+#include <string.h>
+
+#include "framebuffer.hpp"
+
+// ==================================================================================================
+// Variables
+// ==================================================================================================
+// Set in the middle index when it holds a frame the consumer hasn't seen
+#define CHIP8_FRAME_FRESH   0x4
+#define CHIP8_FRAME_INDEX   0x3
+
+// ==================================================================================================
+// Public Functions
+// ==================================================================================================
+CHIP8FrameBuffer::CHIP8FrameBuffer() {
+    memset(frames, 0, sizeof(frames));
+    for(int i=0; i<3; i++) {
+        frames[i].width = CHIP8_SCREEN_WIDTH;
+        frames[i].height = CHIP8_SCREEN_HEIGHT;
+    }
+    back_index = 0;
+    middle.store(1);
+    front_index = 2;
+    published = 0;
+}
+
+/**
+ * Copies the interpreter's display into the producer's frame and publishes it
+ *
+ * @param   chip8   The interpreter to take the display from
+ **/
+void CHIP8FrameBuffer::publish(const CHIP8Interpreter &chip8) {
+    CHIP8Frame &frame = back();
+    memcpy(frame.display, chip8.display, sizeof(frame.display));
+    frame.width = chip8.screenWidth();
+    frame.height = chip8.screenHeight();
+    publish();
+}
+
+/**
+ * Hands the frame filled in through back() over to the consumer. back() is another frame
+ * afterwards, with whatever it last held.
+ **/
+void CHIP8FrameBuffer::publish() {
+    frames[back_index].number = ++published;
+    // Release so the consumer sees the whole frame once it sees the index
+    back_index = middle.exchange(back_index | CHIP8_FRAME_FRESH, std::memory_order_acq_rel) & CHIP8_FRAME_INDEX;
+}
+
+/**
+ * Makes the newest published frame available through front()
+ *
+ * @return  false if nothing was published since the last call, front() is unchanged then
+ **/
+bool CHIP8FrameBuffer::acquire() {
+    if(!(middle.load(std::memory_order_relaxed) & CHIP8_FRAME_FRESH)) {
+        return false;
+    }
+    // Only the consumer clears the fresh flag, so it can't go away between the two
+    front_index = middle.exchange(front_index, std::memory_order_acq_rel) & CHIP8_FRAME_INDEX;
+    return true;
+}
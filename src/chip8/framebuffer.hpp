@@ -0,0 +1,50 @@
+#ifndef CHIP8_FRAMEBUFFER_H
+#define CHIP8_FRAMEBUFFER_H
+
+#include <stdint.h>
+#include <atomic>
+
+#include "chip8.hpp"
+
+/**
+ * A finished picture of the display, as handed from the emulation to whatever shows it
+ **/
+struct CHIP8Frame {
+    uint64_t display[CHIP8_PLANES][CHIP8_HIRES_HEIGHT][2];  // Same layout as CHIP8Interpreter::display
+    int width;                                              // Resolution the display was in
+    int height;
+    uint64_t number;                                        // Counts up with every frame published
+};
+
+/**
+ * Lock-free triple buffer passing frames from one producer thread to one consumer thread.
+ *
+ * The producer always has a frame of its own to fill and the consumer always has one of
+ * its own to read. Publishing swaps the producer's frame with the spare one in the middle,
+ * and acquiring swaps the consumer's frame with the middle one if it is newer. Neither side
+ * ever waits for the other: frames the consumer didn't get to in time are replaced by
+ * newer ones.
+ **/
+class CHIP8FrameBuffer {
+    public:
+        CHIP8FrameBuffer();
+
+        // ======================================== Producer ========================================
+        CHIP8Frame &back() { return frames[back_index]; }
+        void publish(const CHIP8Interpreter &chip8);
+        void publish();
+
+        // ======================================== Consumer ========================================
+        bool acquire();
+        const CHIP8Frame &front() const { return frames[front_index]; }
+
+    private:
+        CHIP8Frame frames[3];
+        int back_index;                 // Only touched by the producer
+        int front_index;                // Only touched by the consumer
+        std::atomic<int> middle;        // Index of the spare frame, with CHIP8_FRAME_FRESH set when
+                                        // it was published after the consumer last acquired
+        uint64_t published;             // Frames published so far, only touched by the producer
+};
+
+#endif // CHIP8_FRAMEBUFFER_H
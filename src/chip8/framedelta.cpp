@@ -0,0 +1,199 @@
+#include <string.h>
+
+#include "framedelta.hpp"
+
+// ==================================================================================================
+// Variables
+// ==================================================================================================
+// Tokens of a row, see CHIP8FrameDelta
+#define TOKEN_LITERAL   0x80
+#define TOKEN_LENGTH    0x7F
+
+// ==================================================================================================
+// Helpers
+// ==================================================================================================
+/**
+ * Run-length encodes the XOR of a row
+ **/
+static void encodeRow(const uint8_t row[CHIP8_DELTA_ROW_SIZE], std::vector<uint8_t> &out) {
+    int i = 0;
+    while(i < CHIP8_DELTA_ROW_SIZE) {
+        int end = i;
+        if(row[i] == 0) {
+            while(end < CHIP8_DELTA_ROW_SIZE && row[end] == 0) {
+                end++;
+            }
+            out.push_back(end - i - 1);
+        } else {
+            while(end < CHIP8_DELTA_ROW_SIZE && row[end] != 0) {
+                end++;
+            }
+            out.push_back(TOKEN_LITERAL | (end - i - 1));
+            out.insert(out.end(), &row[i], &row[end]);
+        }
+        i = end;
+    }
+}
+
+static void put64(uint8_t *out, uint64_t value) {
+    for(int b = 0; b < 8; b++) {
+        out[b] = (value >> (8 * b)) & 0xFF;
+    }
+}
+
+static uint64_t get64(const uint8_t *in) {
+    uint64_t value = 0;
+    for(int b = 7; b >= 0; b--) {
+        value = (value << 8) | in[b];
+    }
+    return value;
+}
+
+// ==================================================================================================
+// Public Functions
+// ==================================================================================================
+/**
+ * Appends the message for a frame
+ *
+ * @param   frame       The frame to send
+ * @param   previous    The frame sent before it, NULL for a keyframe
+ * @param   out         Where the message is appended
+ * @return              The size of the message
+ **/
+size_t CHIP8FrameDelta::encode(const CHIP8Frame &frame, const CHIP8Frame *previous, std::vector<uint8_t> &out) {
+    size_t start = out.size();
+    out.resize(start + CHIP8_DELTA_HEADER_SIZE);
+
+    for(int plane = 0; plane < CHIP8_PLANES; plane++) {
+        for(int y = 0; y < CHIP8_HIRES_HEIGHT; y++) {
+            uint8_t row[CHIP8_DELTA_ROW_SIZE];
+            uint64_t changed = 0;
+            for(int word = 0; word < 2; word++) {
+                uint64_t bits = frame.display[plane][y][word];
+                if(previous != NULL) {
+                    bits ^= previous->display[plane][y][word];
+                }
+                changed |= bits;
+                for(int b = 0; b < 8; b++) {
+                    row[word * 8 + b] = bits >> (56 - 8 * b);
+                }
+            }
+            if(changed == 0) {
+                continue;
+            }
+            out.push_back(plane);
+            out.push_back(y);
+            encodeRow(row, out);
+        }
+    }
+
+    uint8_t *header = &out[start];
+    uint32_t length = out.size() - start - 4;
+    for(int b = 0; b < 4; b++) {
+        header[b] = (length >> (8 * b)) & 0xFF;
+    }
+    header[4] = (previous == NULL) ? CHIP8_DELTA_KEYFRAME : CHIP8_DELTA_UPDATE;
+    header[5] = frame.width;
+    header[6] = frame.height;
+    header[7] = 0;
+    put64(&header[8], frame.number);
+    return out.size() - start;
+}
+
+/**
+ * Finds where a message ends in a stream
+ *
+ * @param   data    The start of a message
+ * @param   size    Bytes received from there on
+ * @return          The size of the whole message, 0 until its length has been received
+ **/
+size_t CHIP8FrameDelta::messageSize(const uint8_t *data, size_t size) {
+    if(size < 4) {
+        return 0;
+    }
+    return 4 + (data[0] | (data[1] << 8) | (data[2] << 16) | ((size_t)data[3] << 24));
+}
+
+CHIP8FrameDecoder::CHIP8FrameDecoder() {
+    memset(&current, 0, sizeof(current));
+    current.width = CHIP8_SCREEN_WIDTH;
+    current.height = CHIP8_SCREEN_HEIGHT;
+    has_keyframe = false;
+}
+
+/**
+ * Applies a message to the display
+ *
+ * @param   message     A whole message, see CHIP8FrameDelta::messageSize()
+ * @param   size        Its size
+ * @return              false if it is malformed, or an update before any keyframe. The
+ *                      display is only changed by messages that are applied.
+ **/
+bool CHIP8FrameDecoder::decode(const uint8_t *message, size_t size) {
+    if(size < CHIP8_DELTA_HEADER_SIZE || CHIP8FrameDelta::messageSize(message, size) != size) {
+        return false;
+    }
+    uint8_t kind = message[4];
+    int width = message[5];
+    int height = message[6];
+    if(kind > CHIP8_DELTA_UPDATE || (kind == CHIP8_DELTA_UPDATE && !has_keyframe) ||
+       width < 1 || width > CHIP8_HIRES_WIDTH || height < 1 || height > CHIP8_HIRES_HEIGHT) {
+        return false;
+    }
+
+    // Decoded into a copy so a malformed message leaves the display alone
+    CHIP8Frame next = current;
+    if(kind == CHIP8_DELTA_KEYFRAME) {
+        memset(next.display, 0, sizeof(next.display));
+    }
+
+    size_t offset = CHIP8_DELTA_HEADER_SIZE;
+    while(offset < size) {
+        if(size - offset < 2) {
+            return false;
+        }
+        int plane = message[offset++];
+        int y = message[offset++];
+        if(plane >= CHIP8_PLANES || y >= CHIP8_HIRES_HEIGHT) {
+            return false;
+        }
+
+        uint8_t row[CHIP8_DELTA_ROW_SIZE];
+        int filled = 0;
+        while(filled < CHIP8_DELTA_ROW_SIZE) {
+            if(offset >= size) {
+                return false;
+            }
+            uint8_t token = message[offset++];
+            int count = (token & TOKEN_LENGTH) + 1;
+            if(filled + count > CHIP8_DELTA_ROW_SIZE) {
+                return false;
+            }
+            if(token & TOKEN_LITERAL) {
+                if(size - offset < (size_t)count) {
+                    return false;
+                }
+                memcpy(&row[filled], &message[offset], count);
+                offset += count;
+            } else {
+                memset(&row[filled], 0, count);
+            }
+            filled += count;
+        }
+
+        for(int word = 0; word < 2; word++) {
+            uint64_t bits = 0;
+            for(int b = 0; b < 8; b++) {
+                bits = (bits << 8) | row[word * 8 + b];
+            }
+            next.display[plane][y][word] ^= bits;
+        }
+    }
+
+    next.width = width;
+    next.height = height;
+    next.number = get64(&message[8]);
+    current = next;
+    has_keyframe = true;
+    return true;
+}
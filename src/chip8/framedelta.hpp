@@ -0,0 +1,69 @@
+#ifndef CHIP8_FRAMEDELTA_H
+#define CHIP8_FRAMEDELTA_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+#include "framebuffer.hpp"
+
+// Size of the header in front of every message
+#define CHIP8_DELTA_HEADER_SIZE     16
+// Bytes of one display row of one plane in a message
+#define CHIP8_DELTA_ROW_SIZE        16
+// Largest message: every row of every plane changed, with the most tokens a row can take
+#define CHIP8_DELTA_MAX_SIZE        (CHIP8_DELTA_HEADER_SIZE + CHIP8_PLANES * CHIP8_HIRES_HEIGHT * (2 + CHIP8_DELTA_ROW_SIZE * 3 / 2))
+
+/**
+ * What a message is relative to
+ **/
+enum CHIP8DeltaKind {
+    CHIP8_DELTA_KEYFRAME,   // A blank display, the message is a whole frame
+    CHIP8_DELTA_UPDATE      // The frame of the message before it
+};
+
+/**
+ * Encodes frames as the rows that changed since another frame, for sending them over a
+ * stream. A message is, little-endian:
+ *
+ *   offset  size    field
+ *   0       4       length of the rest of the message
+ *   4       1       kind (CHIP8DeltaKind)
+ *   5       1       width of the display (64 or 128)
+ *   6       1       height of the display (32 or 64)
+ *   7       1       reserved (0)
+ *   8       8       frame number
+ *   16      ...     rows
+ *
+ * Every row is the plane (1 byte) and the row number (1 byte) followed by the 16 bytes of
+ * the row XORed with the same row of the frame before, leftmost pixel in the top bit of
+ * the first byte, run-length encoded as tokens:
+ *
+ *   1xxxxxxx                   literal: the next (x + 1) bytes are copied as they are
+ *   0xxxxxxx                   run of (x + 1) zero bytes
+ *
+ * Rows that didn't change aren't in the message at all.
+ **/
+class CHIP8FrameDelta {
+    public:
+        static size_t encode(const CHIP8Frame &frame, const CHIP8Frame *previous, std::vector<uint8_t> &out);
+        static size_t messageSize(const uint8_t *data, size_t size);
+};
+
+/**
+ * Rebuilds the display from a stream of messages made by CHIP8FrameDelta
+ **/
+class CHIP8FrameDecoder {
+    public:
+        CHIP8FrameDecoder();
+        bool decode(const uint8_t *message, size_t size);
+        bool synced() const { return has_keyframe; }
+        const CHIP8Frame &frame() const { return current; }
+        bool getPixel(int x, int y) const { return (current.display[0][y][x >> 6] >> (63 - (x & 63))) & 1; }
+
+    private:
+        CHIP8Frame current;
+        bool has_keyframe;      // Updates are ignored until a keyframe arrives
+};
+
+#endif // CHIP8_FRAMEDELTA_H
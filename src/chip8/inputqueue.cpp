@@ -0,0 +1,41 @@
+#include "inputqueue.hpp"
+
+// ==================================================================================================
+// Public Functions
+// ==================================================================================================
+CHIP8InputQueue::CHIP8InputQueue() {
+    head.store(0);
+    tail.store(0);
+}
+
+/**
+ * Adds an event to the back of the queue. Only call this from the producer thread.
+ *
+ * @param   event   The event to add
+ * @return          false if the queue is full, the event is not added then
+ **/
+bool CHIP8InputQueue::push(const CHIP8InputEvent &event) {
+    uint32_t position = tail.load(std::memory_order_relaxed);
+    if(position - head.load(std::memory_order_acquire) >= CHIP8_INPUT_QUEUE_SIZE) {
+        return false;
+    }
+    events[position & (CHIP8_INPUT_QUEUE_SIZE - 1)] = event;
+    tail.store(position + 1, std::memory_order_release);
+    return true;
+}
+
+/**
+ * Takes the event at the front of the queue. Only call this from the consumer thread.
+ *
+ * @param   event   Receives the event
+ * @return          false if the queue is empty
+ **/
+bool CHIP8InputQueue::pop(CHIP8InputEvent &event) {
+    uint32_t position = head.load(std::memory_order_relaxed);
+    if(position == tail.load(std::memory_order_acquire)) {
+        return false;
+    }
+    event = events[position & (CHIP8_INPUT_QUEUE_SIZE - 1)];
+    head.store(position + 1, std::memory_order_release);
+    return true;
+}
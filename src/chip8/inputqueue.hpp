@@ -0,0 +1,43 @@
+#ifndef CHIP8_INPUTQUEUE_H
+#define CHIP8_INPUTQUEUE_H
+
+#include <stdint.h>
+#include <atomic>
+
+// Events the queue can hold, must be a power of two
+#define CHIP8_INPUT_QUEUE_SIZE  256
+
+/**
+ * What happened to an input
+ **/
+enum CHIP8InputType {
+    CHIP8_INPUT_KEY,        // A keypad key went down or up, code is the key (0x0-0xF)
+    CHIP8_INPUT_HOTKEY      // An emulator control, code is defined by the front end
+};
+
+struct CHIP8InputEvent {
+    uint8_t type;           // CHIP8InputType
+    uint8_t code;
+    bool down;              // Pressed (true) or released (false)
+    uint64_t time;          // Host clock when it happened, so the consumer can apply it at the
+                            // instruction that was due then
+};
+
+/**
+ * Lock-free queue of input events from one producer thread (the one reading the host's
+ * events) to one consumer thread (the one running the interpreter). Events come out in
+ * the order they went in.
+ **/
+class CHIP8InputQueue {
+    public:
+        CHIP8InputQueue();
+        bool push(const CHIP8InputEvent &event);
+        bool pop(CHIP8InputEvent &event);
+
+    private:
+        CHIP8InputEvent events[CHIP8_INPUT_QUEUE_SIZE];
+        std::atomic<uint32_t> head;     // Next event to pop, only advanced by the consumer
+        std::atomic<uint32_t> tail;     // Next free slot, only advanced by the producer
+};
+
+#endif // CHIP8_INPUTQUEUE_H
@@ -0,0 +1,626 @@
+#include <stdint.h>
+#include <string.h>
+
+#if defined(_WIN32)
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+#include "jit.hpp"
+
+// x86 register numbers used in the ModRM byte
+#define REG_EAX 0
+#define REG_ECX 1
+#define REG_EDX 2
+
+// Second byte of the SETcc instructions
+#define SETCC_AE    0x93
+#define SETCC_E     0x94
+#define SETCC_NE    0x95
+#define SETCC_A     0x97
+
+// Largest native block that can be emitted. Translation stops once the body passes
+// CHIP8_JIT_MAX_BODY_BYTES, which leaves room for one more instruction (FX65 with X = F
+// is the longest) plus the exit stubs and entry points of all 64 instructions.
+#define CHIP8_JIT_MAX_BLOCK_BYTES       16384
+#define CHIP8_JIT_MAX_BODY_BYTES        8192
+
+// Size of what emitEnter() emits, linked exits jump past it into the code of the block
+#define CHIP8_JIT_ENTER_BYTES           7
+
+// ==================================================================================================
+// Public Functions
+// ==================================================================================================
+/**
+ * Allocates the code buffer and works out where the interpreter keeps its state
+ *
+ * @param   chip8   The interpreter the native code will run on
+ **/
+CHIP8Jit::CHIP8Jit(const CHIP8Interpreter &chip8) {
+    const uint8_t *base = (const uint8_t*)&chip8;
+    offset_V = (const uint8_t*)chip8.V - base;
+    offset_I = (const uint8_t*)&chip8.I - base;
+    offset_pc = (const uint8_t*)&chip8.pc - base;
+    offset_sp = (const uint8_t*)&chip8.sp - base;
+    offset_stack = (const uint8_t*)chip8.stack - base;
+    offset_memory = chip8.classic_memory - base;   // The JIT only runs CHIP-8, whose memory is this
+    offset_timer_delay = (const uint8_t*)&chip8.timer_delay - base;
+    offset_timer_sound = (const uint8_t*)&chip8.timer_sound - base;
+
+    // Never writable and executable at once, setWritable() switches between the two
+    code = NULL;
+    writable = true;
+#if defined(CHIP8_JIT_SUPPORTED)
+#if defined(_WIN32)
+    code = (uint8_t*)VirtualAlloc(NULL, CHIP8_JIT_CODE_SIZE, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+#else
+    void *memory = mmap(NULL, CHIP8_JIT_CODE_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    code = (memory == MAP_FAILED) ? NULL : (uint8_t*)memory;
+#endif
+#endif
+
+    invalidate();
+    setWritable(false);
+}
+
+CHIP8Jit::~CHIP8Jit() {
+    if(code != NULL) {
+#if defined(_WIN32)
+        VirtualFree(code, 0, MEM_RELEASE);
+#else
+        munmap(code, CHIP8_JIT_CODE_SIZE);
+#endif
+    }
+}
+
+/**
+ * @return  true if native code can be generated on this host
+ **/
+bool CHIP8Jit::supported() {
+#if defined(CHIP8_JIT_SUPPORTED)
+    return true;
+#else
+    return false;
+#endif
+}
+
+/**
+ * Drops every translated block
+ **/
+void CHIP8Jit::invalidate() {
+    memset(entries, 0, sizeof(entries));
+    memset(code_map, 0, sizeof(code_map));
+    links.clear();
+    code_used = 0;
+}
+
+/**
+ * Drops the blocks that include any of the given bytes. Their native code stays in the
+ * buffer until the next full invalidation.
+ *
+ * @param   address     The first address written to
+ * @param   length      The number of bytes written
+ **/
+void CHIP8Jit::invalidate(uint16_t address, int length) {
+    int start = address - (CHIP8_JIT_MAX_LENGTH * 2 - 1);
+    if(start < 0) {
+        start = 0;
+    }
+    for(; start < address + length && start < CHIP8_MEMORY_MAX; start++) {
+        Entry &entry = entries[start];
+        if(entry.code != NULL && start + entry.length * 2 > address) {
+            entry.code = NULL;
+            entry.hits = 0;
+        }
+        // The first instruction may have become something that can be translated
+        if(start + 1 >= address) {
+            entry.failed = false;
+        }
+    }
+
+    // Exits into the dropped blocks go back to returning to execute()
+    for(size_t i = 0; i < links.size(); i++) {
+        Link &exit = links[i];
+        if(exit.linked && entries[exit.target].code == NULL) {
+            setWritable(true);
+            memset(exit.site, 0, 4);
+            exit.linked = false;
+        }
+    }
+    setWritable(false);
+}
+
+/**
+ * Executes the given number of instructions. Blocks that are hot run as native code,
+ * everything else is stepped by the interpreter. Native blocks count the cycles down
+ * themselves and leave early when they run out.
+ *
+ * @param   chip8   The interpreter whose state is executed on
+ * @param   cycles  The number of instructions to execute
+ **/
+void CHIP8Jit::execute(CHIP8Interpreter &chip8, int cycles) {
+    while(cycles > 0) {
+        uint16_t pc = chip8.pc;
+
+        if(pc < CHIP8_MEMORY_MAX - 1 && code != NULL) {
+            Entry &entry = entries[pc];
+
+            if(entry.code == NULL && !entry.failed && ++entry.hits >= CHIP8_JIT_THRESHOLD) {
+                compile(chip8, pc);
+            }
+
+            if(entry.code != NULL) {
+                cycles = entry.code(&chip8, cycles);
+
+                // Same guard as step()
+                if(chip8.pc > CHIP8_MEMORY_MAX) {
+                    chip8.pc = 0;
+                }
+                continue;
+            }
+        }
+
+        chip8.step();
+        cycles--;
+    }
+}
+
+// ==================================================================================================
+// Translation
+// ==================================================================================================
+/**
+ * Translates the block starting at an address. If the very first instruction can't be
+ * translated the address is marked so it isn't tried again until the next invalidation.
+ *
+ * @param   chip8   The interpreter whose memory is translated
+ * @param   start   Address of the first instruction
+ **/
+void CHIP8Jit::compile(const CHIP8Interpreter &chip8, uint16_t start) {
+    Entry &entry = entries[start];
+
+    // Start over once the buffer is full
+    if(code_used + CHIP8_JIT_MAX_BLOCK_BYTES > CHIP8_JIT_CODE_SIZE) {
+        invalidate();
+    }
+    setWritable(true);
+
+    uint8_t *block = code + code_used;
+    emit_ptr = block;
+    emitEnter();
+
+    // Where the native code of each instruction starts
+    uint8_t *instructions[CHIP8_JIT_MAX_LENGTH];
+
+    // Where each instruction leaves the block if it used up the last cycle
+    uint8_t *exit_jumps[CHIP8_JIT_MAX_LENGTH];
+    uint16_t exit_addresses[CHIP8_JIT_MAX_LENGTH];
+    int exits = 0;
+
+    uint16_t address = start;
+    uint16_t length = 0;
+    uint16_t last_opcode = 0;
+    bool ends_block = false;
+    while(!ends_block && length < CHIP8_JIT_MAX_LENGTH && address < CHIP8_MEMORY_MAX - 1 &&
+          emit_ptr - block < CHIP8_JIT_MAX_BODY_BYTES) {
+        uint16_t opcode = (chip8.memory[address] << 8) | chip8.memory[address + 1];
+        instructions[length] = emit_ptr;
+        if(!translate(opcode, address, ends_block)) {
+            break;
+        }
+        code_map[address] = 1;
+        code_map[address + 1] = 1;
+        address += 2;
+        length++;
+        last_opcode = opcode;
+
+        emit8(0x41); emit8(0xFF); emit8(0xC8);  // dec r8d
+        if(!ends_block) {
+            emit8(0x0F); emit8(0x84);           // jz exit
+            exit_jumps[exits] = emit_ptr;
+            exit_addresses[exits] = address;
+            exits++;
+            emit32(0);
+        }
+    }
+
+    if(length == 0) {
+        entry.failed = true;
+        setWritable(false);
+        return;
+    }
+
+    // Where the block goes when that doesn't depend on the registers: the next
+    // instruction, or the target of a 1NNN or 2NNN
+    int target = -1;
+    if(!ends_block) {
+        target = address;
+    } else if((last_opcode & 0xF000) == 0x1000 || (last_opcode & 0xF000) == 0x2000) {
+        target = last_opcode & 0x0FFF;
+    }
+
+    // With cycles left, go straight on to the native code there once link() patched it in
+    if(target >= 0 && target < CHIP8_MEMORY_MAX - 1) {
+        emit8(0x45); emit8(0x85); emit8(0xC0);  // test r8d, r8d
+        emit8(0x74); emit8(0x05);               // jz past the jmp
+        emit8(0xE9);                            // jmp target, falls through until linked
+        Link exit;
+        exit.site = emit_ptr;
+        exit.target = target;
+        exit.linked = false;
+        links.push_back(exit);
+        emit32(0);
+    }
+
+    // Blocks that don't end in a jump continue at the next instruction
+    if(!ends_block) {
+        emitStoreImm16(offset_pc, address);
+    }
+
+    // Return the cycles left: mov eax, r8d; pop rbx; ret
+    emit8(0x44); emit8(0x89); emit8(0xC0);
+    emit8(0x5B);
+    emit8(0xC3);
+
+    // Out of cycles part way through: continue at the next instruction next time
+    for(int i = 0; i < exits; i++) {
+        uint32_t jump = emit_ptr - (exit_jumps[i] + 4);
+        memcpy(exit_jumps[i], &jump, sizeof(jump));
+        emitStoreImm16(offset_pc, exit_addresses[i]);
+        emit8(0x31); emit8(0xC0);               // xor eax, eax
+        emit8(0x5B);
+        emit8(0xC3);
+    }
+
+    // Every other instruction of the block can be entered as well, which is where
+    // execution resumes after running out of cycles in the middle of the block
+    for(int i = 1; i < length; i++) {
+        Entry &inner = entries[start + i * 2];
+        inner.code = (NativeBlock)emit_ptr;
+        inner.length = length - i;
+        emitEnter();
+        uint32_t jump = instructions[i] - (emit_ptr + 5);
+        emit8(0xE9); emit32(jump);              // jmp instruction
+    }
+
+    code_used += emit_ptr - block;
+    entry.code = (NativeBlock)block;
+    entry.length = length;
+
+    link();
+    setWritable(false);
+}
+
+/**
+ * Patches every exit whose target has native code now to jump straight into it. The
+ * buffer must be writable.
+ **/
+void CHIP8Jit::link() {
+    for(size_t i = 0; i < links.size(); i++) {
+        Link &exit = links[i];
+        NativeBlock target = entries[exit.target].code;
+        if(!exit.linked && target != NULL) {
+            int32_t jump = ((uint8_t*)target + CHIP8_JIT_ENTER_BYTES) - (exit.site + 4);
+            memcpy(exit.site, &jump, sizeof(jump));
+            exit.linked = true;
+        }
+    }
+}
+
+/**
+ * Maps the buffer for writing code into it, or for running it
+ **/
+void CHIP8Jit::setWritable(bool writable) {
+    if(code == NULL || this->writable == writable) {
+        return;
+    }
+#if defined(_WIN32)
+    DWORD previous;
+    VirtualProtect(code, CHIP8_JIT_CODE_SIZE, writable ? PAGE_READWRITE : PAGE_EXECUTE_READ, &previous);
+#else
+    mprotect(code, CHIP8_JIT_CODE_SIZE, writable ? (PROT_READ | PROT_WRITE) : (PROT_READ | PROT_EXEC));
+#endif
+    this->writable = writable;
+}
+
+/**
+ * Emits the native code for a single instruction
+ *
+ * @param   opcode      The raw opcode
+ * @param   address     Address of the instruction
+ * @param   ends_block  Set to true if the instruction sets the program counter
+ * @return              false if the instruction must be left to the interpreter
+ **/
+bool CHIP8Jit::translate(uint16_t opcode, uint16_t address, bool &ends_block) {
+    uint8_t X = (0x0F00 & opcode) >> 8;
+    uint8_t Y = (0x00F0 & opcode) >> 4;
+    uint8_t NN = 0x00FF & opcode;
+    uint16_t NNN = 0x0FFF & opcode;
+    uint16_t next = address + 2;
+
+    ends_block = false;
+    switch((opcode & 0xF000) >> 12) {
+        case 0x0:
+            if(opcode == 0x00E0) {
+                return false;
+            }
+            if(opcode == 0x00EE) {
+                // 00EE - sp = (sp - 1) & 0xF; pc = stack[sp]
+                emitLoad16(REG_EAX, offset_sp);
+                emit8(0xFF); emit8(0xC8);                                           // dec eax
+                emit8(0x83); emit8(0xE0); emit8(0x0F);                              // and eax, 0xF
+                emitStore16(REG_EAX, offset_sp);
+                emit8(0x0F); emit8(0xB7); emit8(0x84); emit8(0x43); emit32(offset_stack);  // movzx eax, word [rbx+rax*2+stack]
+                emitStore16(REG_EAX, offset_pc);
+                ends_block = true;
+            }
+            // Any other 0NNN does nothing
+            return true;
+        case 0x1:
+            // 1NNN - pc = NNN
+            emitStoreImm16(offset_pc, NNN);
+            ends_block = true;
+            return true;
+        case 0x2:
+            // 2NNN - stack[sp] = pc; sp = (sp + 1) & 0xF; pc = NNN
+            emitLoad16(REG_EAX, offset_sp);
+            emit8(0x66); emit8(0xC7); emit8(0x84); emit8(0x43); emit32(offset_stack); emit16(next);  // mov word [rbx+rax*2+stack], next
+            emit8(0xFF); emit8(0xC0);                                           // inc eax
+            emit8(0x83); emit8(0xE0); emit8(0x0F);                              // and eax, 0xF
+            emitStore16(REG_EAX, offset_sp);
+            emitStoreImm16(offset_pc, NNN);
+            ends_block = true;
+            return true;
+        case 0x3:
+        case 0x4:
+            // 3XNN / 4XNN - skip if VX ==/!= NN
+            emitLoadV(REG_EAX, X);
+            emit8(0x3D); emit32(NN);                                            // cmp eax, NN
+            emitSkip(((opcode & 0xF000) == 0x3000) ? SETCC_E : SETCC_NE, next);
+            ends_block = true;
+            return true;
+        case 0x5:
+        case 0x9:
+            // 5XY0 / 9XY0 - skip if VX ==/!= VY
+            emitLoadV(REG_EAX, X);
+            emitLoadV(REG_ECX, Y);
+            emit8(0x39); emit8(0xC8);                                           // cmp eax, ecx
+            emitSkip(((opcode & 0xF000) == 0x5000) ? SETCC_E : SETCC_NE, next);
+            ends_block = true;
+            return true;
+        case 0x6:
+            // 6XNN - VX = NN
+            emit8(0xC6); emitModRM(0, offset_V + X); emit8(NN);
+            return true;
+        case 0x7:
+            // 7XNN - VX += NN
+            emit8(0x80); emitModRM(0, offset_V + X); emit8(NN);
+            return true;
+        case 0x8:
+            switch(opcode & 0x000F) {
+                case 0x0:
+                    emitLoadV(REG_EAX, Y);
+                    emitStoreV(REG_EAX, X);
+                    return true;
+                case 0x1:
+                case 0x2:
+                case 0x3:
+                {
+                    // or / and / xor al, cl
+                    static const uint8_t alu[4] = { 0x00, 0x08, 0x20, 0x30 };
+                    emitLoadV(REG_EAX, X);
+                    emitLoadV(REG_ECX, Y);
+                    emit8(alu[opcode & 0x000F]); emit8(0xC8);
+                    emitStoreV(REG_EAX, X);
+                    return true;
+                }
+                case 0x4:
+                    // VF = (VX + VY) > 0xFF; VX += VY
+                    emitLoadV(REG_EAX, X);
+                    emitLoadV(REG_ECX, Y);
+                    emit8(0x01); emit8(0xC8);                                   // add eax, ecx
+                    emit8(0x3D); emit32(0xFF);                                  // cmp eax, 0xFF
+                    emit8(0x0F); emit8(SETCC_A); emit8(0xC2);                   // seta dl
+                    emitStoreV(REG_EDX, 0xF);
+                    emitLoadV(REG_EAX, X);
+                    emitLoadV(REG_ECX, Y);
+                    emit8(0x00); emit8(0xC8);                                   // add al, cl
+                    emitStoreV(REG_EAX, X);
+                    return true;
+                case 0x5:
+                case 0x7:
+                {
+                    // 8XY5: VF = VX >= VY; VX = VX - VY
+                    // 8XY7: VF = VY >= VX; VX = VY - VX
+                    uint8_t a = ((opcode & 0x000F) == 0x5) ? X : Y;
+                    uint8_t b = ((opcode & 0x000F) == 0x5) ? Y : X;
+                    emitLoadV(REG_EAX, a);
+                    emitLoadV(REG_ECX, b);
+                    emit8(0x39); emit8(0xC8);                                   // cmp eax, ecx
+                    emit8(0x0F); emit8(SETCC_AE); emit8(0xC2);                  // setae dl
+                    emitStoreV(REG_EDX, 0xF);
+                    emitLoadV(REG_EAX, a);
+                    emitLoadV(REG_ECX, b);
+                    emit8(0x28); emit8(0xC8);                                   // sub al, cl
+                    emitStoreV(REG_EAX, X);
+                    return true;
+                }
+                case 0x6:
+                    // VF = VY & 1; VX = VY >> 1
+                    emitLoadV(REG_EAX, Y);
+                    emit8(0x24); emit8(0x01);                                   // and al, 1
+                    emitStoreV(REG_EAX, 0xF);
+                    emitLoadV(REG_EAX, Y);
+                    emit8(0xD0); emit8(0xE8);                                   // shr al, 1
+                    emitStoreV(REG_EAX, X);
+                    return true;
+                case 0xE:
+                    // VF = VY >> 7; VX = VY << 1
+                    emitLoadV(REG_EAX, Y);
+                    emit8(0xC0); emit8(0xE8); emit8(0x07);                      // shr al, 7
+                    emitStoreV(REG_EAX, 0xF);
+                    emitLoadV(REG_EAX, Y);
+                    emit8(0xD0); emit8(0xE0);                                   // shl al, 1
+                    emitStoreV(REG_EAX, X);
+                    return true;
+                default:
+                    return true;
+            }
+        case 0xA:
+            // ANNN - I = NNN
+            emitStoreImm16(offset_I, NNN);
+            return true;
+        case 0xB:
+            // BNNN - pc = V0 + NNN
+            emitLoadV(REG_EAX, 0);
+            emit8(0x05); emit32(NNN);                                           // add eax, NNN
+            emitStore16(REG_EAX, offset_pc);
+            ends_block = true;
+            return true;
+        case 0xF:
+            switch(NN) {
+                case 0x07:
+                    // FX07 - VX = delay timer
+                    emit8(0x0F); emit8(0xB6); emitModRM(REG_EAX, offset_timer_delay);
+                    emitStoreV(REG_EAX, X);
+                    return true;
+                case 0x15:
+                case 0x18:
+                    // FX15 / FX18 - delay / sound timer = VX
+                    emitLoadV(REG_EAX, X);
+                    emit8(0x88); emitModRM(REG_EAX, (NN == 0x15) ? offset_timer_delay : offset_timer_sound);
+                    return true;
+                case 0x1E:
+                    // FX1E - VF = (I + VX) > 0xFFF; I += VX
+                    emitLoad16(REG_ECX, offset_I);
+                    emitLoadV(REG_EAX, X);
+                    emit8(0x01); emit8(0xC8);                                   // add eax, ecx
+                    emit8(0x3D); emit32(0xFFF);                                 // cmp eax, 0xFFF
+                    emit8(0x0F); emit8(SETCC_A); emit8(0xC2);                   // seta dl
+                    emitStoreV(REG_EDX, 0xF);
+                    emitLoad16(REG_ECX, offset_I);
+                    emitLoadV(REG_EAX, X);
+                    emit8(0x01); emit8(0xC8);                                   // add eax, ecx
+                    emitStore16(REG_EAX, offset_I);
+                    return true;
+                case 0x29:
+                    // FX29 - I = VX * 5
+                    emitLoadV(REG_EAX, X);
+                    emit8(0x8D); emit8(0x04); emit8(0x80);                      // lea eax, [rax+rax*4]
+                    emitStore16(REG_EAX, offset_I);
+                    return true;
+                case 0x65:
+                    // FX65 - V0..VX = memory[I..I+X] (wrapping around); I += X + 1
+                    emitLoad16(REG_ECX, offset_I);
+                    for(int i = 0; i <= X; i++) {
+                        emit8(0x8D); emit8(0x51); emit8(i);                     // lea edx, [rcx+i]
+                        emit8(0x81); emit8(0xE2); emit32(CHIP8_ADDRESS_MASK);   // and edx, CHIP8_ADDRESS_MASK
+                        emit8(0x0F); emit8(0xB6); emit8(0x84); emit8(0x13); emit32(offset_memory);  // movzx eax, byte [rbx+rdx+memory]
+                        emitStoreV(REG_EAX, i);
+                    }
+                    emit8(0x83); emit8(0xC1); emit8(X + 1);                     // add ecx, X + 1
+                    emitStore16(REG_ECX, offset_I);
+                    return true;
+                case 0x0A:
+                case 0x33:
+                case 0x55:
+                    return false;
+                default:
+                    // Unknown FXNN opcodes do nothing
+                    return true;
+            }
+        default:
+            // CXNN, DXYN and EXNN are left to the interpreter
+            return false;
+    }
+}
+
+// ==================================================================================================
+// Code Emission
+// ==================================================================================================
+/**
+ * Emits the start of a native block: push rbx, then keep the interpreter pointer in rbx
+ * and the cycles left in r8d. CHIP8_JIT_ENTER_BYTES long.
+ **/
+void CHIP8Jit::emitEnter() {
+    emit8(0x53);
+#if defined(_WIN32)
+    emit8(0x48); emit8(0x89); emit8(0xCB);  // mov rbx, rcx
+    emit8(0x41); emit8(0x89); emit8(0xD0);  // mov r8d, edx
+#else
+    emit8(0x48); emit8(0x89); emit8(0xFB);  // mov rbx, rdi
+    emit8(0x41); emit8(0x89); emit8(0xF0);  // mov r8d, esi
+#endif
+}
+
+void CHIP8Jit::emit8(uint8_t value) {
+    *emit_ptr++ = value;
+}
+
+void CHIP8Jit::emit16(uint16_t value) {
+    emit8(value & 0xFF);
+    emit8(value >> 8);
+}
+
+void CHIP8Jit::emit32(uint32_t value) {
+    emit16(value & 0xFFFF);
+    emit16(value >> 16);
+}
+
+/**
+ * Emits a ModRM byte and displacement addressing [rbx + offset]
+ **/
+void CHIP8Jit::emitModRM(uint8_t reg, int32_t offset) {
+    emit8(0x80 | (reg << 3) | 0x03);
+    emit32(offset);
+}
+
+/**
+ * movzx reg, byte [V + x]
+ **/
+void CHIP8Jit::emitLoadV(uint8_t reg, uint8_t x) {
+    emit8(0x0F); emit8(0xB6); emitModRM(reg, offset_V + x);
+}
+
+/**
+ * mov byte [V + x], reg8
+ **/
+void CHIP8Jit::emitStoreV(uint8_t reg, uint8_t x) {
+    emit8(0x88); emitModRM(reg, offset_V + x);
+}
+
+/**
+ * movzx reg, word [offset]
+ **/
+void CHIP8Jit::emitLoad16(uint8_t reg, int32_t offset) {
+    emit8(0x0F); emit8(0xB7); emitModRM(reg, offset);
+}
+
+/**
+ * mov word [offset], reg16
+ **/
+void CHIP8Jit::emitStore16(uint8_t reg, int32_t offset) {
+    emit8(0x66); emit8(0x89); emitModRM(reg, offset);
+}
+
+/**
+ * mov word [offset], value
+ **/
+void CHIP8Jit::emitStoreImm16(int32_t offset, uint16_t value) {
+    emit8(0x66); emit8(0xC7); emitModRM(0, offset); emit16(value);
+}
+
+/**
+ * Sets pc to the next instruction, or the one after it if the flags of the
+ * previous compare satisfy the condition
+ *
+ * @param   setcc   Second byte of the SETcc instruction testing the condition
+ * @param   next    Address of the next instruction
+ **/
+void CHIP8Jit::emitSkip(uint8_t setcc, uint16_t next) {
+    emit8(0x0F); emit8(setcc); emit8(0xC2);     // setcc dl
+    emit8(0x0F); emit8(0xB6); emit8(0xD2);      // movzx edx, dl
+    emit8(0x01); emit8(0xD2);                   // add edx, edx
+    emit8(0x81); emit8(0xC2); emit32(next);     // add edx, next
+    emitStore16(REG_EDX, offset_pc);
+}
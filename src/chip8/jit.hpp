@@ -0,0 +1,109 @@
+#ifndef CHIP8_JIT_H
+#define CHIP8_JIT_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <vector>
+
+#include "chip8.hpp"
+
+// Only x86-64 hosts get native code, everything else falls back to the block cache
+#if defined(__x86_64__) || defined(_M_X64)
+#define CHIP8_JIT_SUPPORTED
+#endif
+
+// Number of times a block has to start before it is translated to native code
+#define CHIP8_JIT_THRESHOLD     16
+// Longest run of CHIP-8 instructions translated into a single native block
+#define CHIP8_JIT_MAX_LENGTH    64
+// Size of the executable buffer, everything is flushed when it fills up
+#define CHIP8_JIT_CODE_SIZE     (1024 * 1024)
+
+/**
+ * Dynamic recompiler that translates hot CHIP-8 basic blocks into x86-64 code.
+ *
+ * A native block runs the same instructions step() would, writing the results straight
+ * into the interpreter's registers and memory, and sets the program counter when it
+ * leaves. Blocks stop before any instruction that is not translated (00E0, CXNN, DXYN,
+ * EXxx, FX0A, FX33, FX55) so the interpreter executes those, which also means every
+ * write to memory goes through the interpreter and its self-modifying code checks.
+ * Every instruction counts down the cycle budget and the block stops as soon as it is
+ * spent, so run() executes exactly the number of instructions asked for. Any instruction
+ * of a block can be entered, so a block cut short carries on natively where it stopped.
+ *
+ * Blocks that end in a jump or call, or fall through into the next instruction, know
+ * where they go. Once the block there is translated the exit is patched to jump straight
+ * into it while cycles are left, so hot loops stay in native code instead of returning
+ * to execute() after every block. Dropping a block unpatches the exits that lead to it.
+ * The buffer is only writable while blocks are emitted or exits patched, executable
+ * the rest of the time.
+ **/
+class CHIP8Jit {
+    public:
+        // Non-zero for every byte of memory that has been translated
+        uint8_t code_map[CHIP8_MEMORY_MAX];
+
+        CHIP8Jit(const CHIP8Interpreter &chip8);
+        ~CHIP8Jit();
+        static bool supported();
+        void execute(CHIP8Interpreter &chip8, int cycles);
+        void invalidate();
+        void invalidate(uint16_t address, int length);
+
+    private:
+        // Runs the block with a budget of cycles (at least 1), returns the cycles left
+        typedef int (*NativeBlock)(CHIP8Interpreter *chip8, int cycles);
+
+        // What is known about the block starting at each address
+        struct Entry {
+            NativeBlock code;       // Translated code, NULL if not translated yet
+            uint16_t length;        // Number of CHIP-8 instructions from here to the end of the block
+            uint16_t hits;          // Number of times the block started in the interpreter
+            bool failed;            // True if the first instruction can't be translated
+        };
+
+        // An exit of a native block that goes to a known address
+        struct Link {
+            uint8_t *site;          // rel32 of the jmp to patch, 0 falls back to returning
+            uint16_t target;        // Address the block goes to
+            bool linked;            // The jmp goes to the native code at target
+        };
+
+        Entry entries[CHIP8_MEMORY_MAX];
+        std::vector<Link> links;    // Every exit to a known address in the buffer
+
+        uint8_t *code;              // Buffer the native blocks are emitted into
+        size_t code_used;           // Bytes of the buffer that hold translated blocks
+        uint8_t *emit_ptr;          // Where the next byte of the block being translated goes
+        bool writable;              // The buffer is mapped for writing rather than executing
+
+        // Offsets of the interpreter's state from the start of the object
+        int32_t offset_V;
+        int32_t offset_I;
+        int32_t offset_pc;
+        int32_t offset_sp;
+        int32_t offset_stack;
+        int32_t offset_memory;
+        int32_t offset_timer_delay;
+        int32_t offset_timer_sound;
+
+        void compile(const CHIP8Interpreter &chip8, uint16_t start);
+        void link();
+        void setWritable(bool writable);
+        bool translate(uint16_t opcode, uint16_t address, bool &ends_block);
+
+        // ======================================== Code Emission ========================================
+        void emitEnter();
+        void emit8(uint8_t value);
+        void emit16(uint16_t value);
+        void emit32(uint32_t value);
+        void emitModRM(uint8_t reg, int32_t offset);
+        void emitLoadV(uint8_t reg, uint8_t x);
+        void emitStoreV(uint8_t reg, uint8_t x);
+        void emitLoad16(uint8_t reg, int32_t offset);
+        void emitStore16(uint8_t reg, int32_t offset);
+        void emitStoreImm16(int32_t offset, uint16_t value);
+        void emitSkip(uint8_t setcc, uint16_t next);
+};
+
+#endif // CHIP8_JIT_H
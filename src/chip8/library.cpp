@@ -0,0 +1,289 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <map>
+
+#include "library.hpp"
+
+/**
+ * Index format. A text file with a line per ROM, each line being these fields separated
+ * by tabs, and lines starting with # ignored:
+ *
+ *   hash        16 hex digits, CHIP8Interpreter::hashRom() of the file
+ *   size        bytes
+ *   modified    modification time of the file when it was hashed (seconds)
+ *   platform    chip8PlatformName(), such as "schip"
+ *   frequency   instructions per second
+ *   name        the file name, the rest of the line
+ **/
+
+// Largest file taken for a ROM, anything bigger can't fit in any platform's memory
+#define LIBRARY_MAX_ROM     (CHIP8_XO_MEMORY_MAX - 0x200)
+// Size of the longest ROM the original CHIP-8 memory can hold
+#define LIBRARY_CHIP8_ROM   (CHIP8_MEMORY_MAX - 0x200)
+
+// ==================================================================================================
+// Helpers
+// ==================================================================================================
+static bool entryNameLess(const CHIP8LibraryEntry &a, const CHIP8LibraryEntry &b) {
+    return a.name < b.name;
+}
+
+/**
+ * @return  true for files in the library directory that are never ROMs
+ **/
+static bool libraryIgnored(const std::string &name) {
+    static const char *suffixes[] = { ".state", ".c8mv", ".txt" };
+    if(name.empty() || name[0] == '.') {
+        return true;
+    }
+    for(size_t i = 0; i < sizeof(suffixes) / sizeof(suffixes[0]); i++) {
+        size_t length = strlen(suffixes[i]);
+        if(name.size() >= length && name.compare(name.size() - length, length, suffixes[i]) == 0) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @return  The CPU frequency suggested for ROMs of a platform
+ **/
+static uint32_t defaultFrequency(CHIP8Platform platform) {
+    switch(chip8PlatformVariant(platform)) {
+        case CHIP8_VARIANT_SCHIP:   return CHIP8_LIBRARY_SCHIP_FREQ;
+        case CHIP8_VARIANT_XOCHIP:  return CHIP8_LIBRARY_XOCHIP_FREQ;
+        default:                    return CHIP8_LIBRARY_CHIP8_FREQ;
+    }
+}
+
+// ==================================================================================================
+// Public Functions
+// ==================================================================================================
+/**
+ * Opens a directory of ROMs, bringing its index up to date
+ *
+ * @param   directory   The directory
+ * @return              false if it can't be read
+ **/
+bool CHIP8Library::open(const char *directory) {
+    this->directory = directory;
+    entries.clear();
+
+    DIR *dir = opendir(directory);
+    if(dir == NULL) {
+        return false;
+    }
+
+    // What the index knows, by name
+    std::vector<CHIP8LibraryEntry> index;
+    readIndex(index);
+    std::map<std::string, size_t> indexed;
+    std::map<uint64_t, size_t> by_hash;
+    for(size_t i = 0; i < index.size(); i++) {
+        indexed[index[i].name] = i;
+        by_hash[index[i].hash] = i;
+    }
+
+    bool changed = false;
+    std::vector<uint8_t> buffer(LIBRARY_MAX_ROM + 1);
+    struct dirent *item;
+    while((item = readdir(dir)) != NULL) {
+        std::string name = item->d_name;
+        std::string file = this->directory + "/" + name;
+        struct stat info;
+        if(libraryIgnored(name) || stat(file.c_str(), &info) != 0 || !S_ISREG(info.st_mode) ||
+           info.st_size == 0 || info.st_size > LIBRARY_MAX_ROM) {
+            continue;
+        }
+
+        // Files that haven't changed since they were indexed aren't read again
+        std::map<std::string, size_t>::const_iterator known = indexed.find(name);
+        if(known != indexed.end() && index[known->second].size == (uint32_t)info.st_size &&
+           index[known->second].modified == (int64_t)info.st_mtime) {
+            entries.push_back(index[known->second]);
+            continue;
+        }
+
+        FILE *rom = fopen(file.c_str(), "rb");
+        if(rom == NULL) {
+            continue;
+        }
+        size_t size = fread(&buffer[0], 1, buffer.size(), rom);
+        fclose(rom);
+        if(size == 0 || size > LIBRARY_MAX_ROM) {
+            continue;
+        }
+
+        CHIP8LibraryEntry entry;
+        entry.name = name;
+        entry.hash = CHIP8Interpreter::hashRom(&buffer[0], size);
+        entry.size = size;
+        entry.modified = info.st_mtime;
+        // A ROM that was only renamed or touched keeps its settings
+        std::map<uint64_t, size_t>::const_iterator same = by_hash.find(entry.hash);
+        if(same != by_hash.end()) {
+            entry.platform = index[same->second].platform;
+            entry.cpu_frequency = index[same->second].cpu_frequency;
+        } else {
+            entry.platform = detectPlatform(&buffer[0], size);
+            entry.cpu_frequency = defaultFrequency(entry.platform);
+        }
+        entries.push_back(entry);
+        changed = true;
+    }
+    closedir(dir);
+
+    std::sort(entries.begin(), entries.end(), entryNameLess);
+    if(changed || entries.size() != index.size()) {
+        writeIndex();
+    }
+    return true;
+}
+
+/**
+ * @param   name_or_hash    A file name in the library, or the 16 hex digit hash of a ROM
+ * @return                  The ROM, NULL if the library doesn't have it
+ **/
+const CHIP8LibraryEntry *CHIP8Library::find(const char *name_or_hash) const {
+    for(size_t i = 0; i < entries.size(); i++) {
+        if(entries[i].name == name_or_hash) {
+            return &entries[i];
+        }
+    }
+
+    char *end = NULL;
+    uint64_t hash = strtoull(name_or_hash, &end, 16);
+    if(strlen(name_or_hash) != 16 || *end != '\0') {
+        return NULL;
+    }
+    for(size_t i = 0; i < entries.size(); i++) {
+        if(entries[i].hash == hash) {
+            return &entries[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @return  Where the ROM's file is
+ **/
+std::string CHIP8Library::path(const CHIP8LibraryEntry &entry) const {
+    return directory + "/" + entry.name;
+}
+
+/**
+ * Switches the interpreter to the ROM's platform and loads it
+ *
+ * @param   entry   The ROM
+ * @param   chip8   The interpreter
+ * @param   error   Receives why the ROM couldn't be loaded, may be NULL
+ * @return          true if it was loaded
+ **/
+bool CHIP8Library::load(const CHIP8LibraryEntry &entry, CHIP8Interpreter &chip8, CHIP8RomError *error) const {
+    chip8.setPlatform(entry.platform);
+    return chip8.loadRom(path(entry).c_str(), error);
+}
+
+/**
+ * Guesses the platform a ROM was written for from the instructions in it. Every pair of
+ * bytes is looked at, so data can be mistaken for instructions; the index lets a wrong
+ * guess be corrected.
+ *
+ * @param   data    The ROM
+ * @param   size    Its size in bytes
+ * @return          The platform with the smallest instruction set that has everything found
+ **/
+CHIP8Platform CHIP8Library::detectPlatform(const uint8_t *data, size_t size) {
+    // Too big for anything but XO-CHIP's memory
+    if(size > LIBRARY_CHIP8_ROM) {
+        return CHIP8_PLATFORM_XOCHIP;
+    }
+
+    bool schip = false;
+    for(size_t i = 0; i + 1 < size; i += 2) {
+        uint16_t opcode = (data[i] << 8) | data[i + 1];
+        // Long I, plane selection and the audio pattern only exist on XO-CHIP
+        if(opcode == 0xF000 || opcode == 0xF002 || (opcode & 0xF0FF) == 0xF001) {
+            return CHIP8_PLATFORM_XOCHIP;
+        }
+        // Resolution switches, the big font and the RPL flags are SUPER-CHIP's
+        if(opcode == 0x00FE || opcode == 0x00FF || (opcode & 0xF0FF) == 0xF030 ||
+           (opcode & 0xF0FF) == 0xF075 || (opcode & 0xF0FF) == 0xF085) {
+            schip = true;
+        }
+    }
+    return schip ? CHIP8_PLATFORM_SCHIP : CHIP8_PLATFORM_CHIP8;
+}
+
+// ==================================================================================================
+// Private Functions
+// ==================================================================================================
+/**
+ * Reads the index, a missing or unreadable index is just empty
+ *
+ * @param   index   Receives the entries in it
+ **/
+void CHIP8Library::readIndex(std::vector<CHIP8LibraryEntry> &index) const {
+    FILE *file = fopen((directory + "/" CHIP8_LIBRARY_INDEX).c_str(), "r");
+    if(file == NULL) {
+        return;
+    }
+
+    char line[1024];
+    while(fgets(line, sizeof(line), file) != NULL) {
+        if(line[0] == '#') {
+            continue;
+        }
+        line[strcspn(line, "\r\n")] = '\0';
+
+        unsigned long long hash;
+        unsigned long size;
+        long long modified;
+        char platform[32];
+        unsigned long frequency;
+        int name_start = 0;
+        if(sscanf(line, "%16llx\t%lu\t%lld\t%31[^\t]\t%lu\t%n", &hash, &size, &modified, platform, &frequency, &name_start) != 5 ||
+           name_start == 0 || line[name_start] == '\0') {
+            continue;
+        }
+
+        CHIP8LibraryEntry entry;
+        entry.name = &line[name_start];
+        entry.hash = hash;
+        entry.size = size;
+        entry.modified = modified;
+        if(!chip8PlatformFromName(platform, entry.platform)) {
+            entry.platform = CHIP8_PLATFORM_CHIP8;
+        }
+        entry.cpu_frequency = (frequency == 0) ? defaultFrequency(entry.platform) : frequency;
+        index.push_back(entry);
+    }
+    fclose(file);
+}
+
+/**
+ * Writes the index for the entries found by open()
+ *
+ * @return  false if it couldn't be written, the library still works without it
+ **/
+bool CHIP8Library::writeIndex() const {
+    FILE *file = fopen((directory + "/" CHIP8_LIBRARY_INDEX).c_str(), "w");
+    if(file == NULL) {
+        return false;
+    }
+
+    fprintf(file, "# CHIP-8 ROM library index, the platform and frequency of a ROM can be changed\n");
+    fprintf(file, "# hash\tsize\tmodified\tplatform\tfrequency\tname\n");
+    for(size_t i = 0; i < entries.size(); i++) {
+        const CHIP8LibraryEntry &entry = entries[i];
+        fprintf(file, "%016llx\t%u\t%lld\t%s\t%u\t%s\n", (unsigned long long)entry.hash, (unsigned)entry.size,
+            (long long)entry.modified, chip8PlatformName(entry.platform), (unsigned)entry.cpu_frequency, entry.name.c_str());
+    }
+    return fclose(file) == 0;
+}
@@ -0,0 +1,56 @@
+#ifndef CHIP8_LIBRARY_H
+#define CHIP8_LIBRARY_H
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "chip8.hpp"
+
+// Name of the index file kept in the library directory
+#define CHIP8_LIBRARY_INDEX         "chip8-library.txt"
+// Instructions per second suggested for a newly found ROM
+#define CHIP8_LIBRARY_CHIP8_FREQ    500
+#define CHIP8_LIBRARY_SCHIP_FREQ    1000
+#define CHIP8_LIBRARY_XOCHIP_FREQ   2000
+
+/**
+ * A ROM in the library and how to run it
+ **/
+struct CHIP8LibraryEntry {
+    std::string name;           // File name in the library directory
+    uint64_t hash;              // CHIP8Interpreter::hashRom() of the contents
+    uint32_t size;              // Size in bytes
+    int64_t modified;           // Modification time of the file when it was hashed
+    CHIP8Platform platform;     // Detected from the instructions used, can be changed in the index
+    uint32_t cpu_frequency;     // Instructions per second to run it at, can be changed in the index
+};
+
+/**
+ * A directory of ROMs with an index of their hashes and settings.
+ *
+ * The index is a text file in the directory with one ROM per line. Opening the library
+ * reads it and only hashes the files that were added or changed since it was written, so
+ * opening a large collection that hasn't changed doesn't read any ROM. The platform and
+ * CPU frequency of a ROM in the index are kept for as long as its contents stay the same,
+ * so they can be edited by hand.
+ **/
+class CHIP8Library {
+    public:
+        bool open(const char *directory);
+        size_t count() const { return entries.size(); }
+        const CHIP8LibraryEntry &entry(size_t index) const { return entries[index]; }
+        const CHIP8LibraryEntry *find(const char *name_or_hash) const;
+        std::string path(const CHIP8LibraryEntry &entry) const;
+        bool load(const CHIP8LibraryEntry &entry, CHIP8Interpreter &chip8, CHIP8RomError *error = NULL) const;
+        static CHIP8Platform detectPlatform(const uint8_t *data, size_t size);
+
+    private:
+        std::string directory;
+        std::vector<CHIP8LibraryEntry> entries;    // Sorted by name
+
+        void readIndex(std::vector<CHIP8LibraryEntry> &index) const;
+        bool writeIndex() const;
+};
+
+#endif // CHIP8_LIBRARY_H
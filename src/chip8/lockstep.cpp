@@ -0,0 +1,1010 @@
+#include <string.h>
+#include <stdint.h>
+
+#include "lockstep.hpp"
+
+#ifdef CHIP8_LOCKSTEP_AVX2
+#include <immintrin.h>
+#define AVX2_KERNEL __attribute__((target("avx2")))
+#endif
+
+// ==================================================================================================
+// Variables
+// ==================================================================================================
+// Byte operations of alu(), VX = VX op VY (or NN), the ones that set VF do so before VX changes
+enum {
+    ALU_SET,        // 6XNN
+    ALU_ADD,        // 7XNN
+    ALU_MOV,        // 8XY0, FX07, FX15, FX18
+    ALU_OR,         // 8XY1
+    ALU_AND,        // 8XY2
+    ALU_XOR,        // 8XY3
+    ALU_ADD_CARRY,  // 8XY4
+    ALU_SUB,        // 8XY5
+    ALU_SHR,        // 8XY6
+    ALU_SUBN,       // 8XY7
+    ALU_SHL         // 8XYE
+};
+
+// Conditions of skip()
+enum {
+    SKIP_EQ_NN,     // 3XNN
+    SKIP_NE_NN,     // 4XNN
+    SKIP_EQ,        // 5XY0
+    SKIP_NE         // 9XY0
+};
+
+// Bytes between the memory of one lane and the next. The extra cache line keeps the same
+// address of every lane from landing in the same cache set.
+#define LANE_MEMORY     (CHIP8_MEMORY_MAX + 64)
+
+// The kernels only handle program counters that can't run past the end of memory
+#define KERNEL_PC_MAX   (CHIP8_MEMORY_MAX - 8)
+
+// ==================================================================================================
+// Helpers
+// ==================================================================================================
+static void aluScalar(int op, uint8_t *vx, const uint8_t *vy, uint8_t *vf, uint8_t nn, const uint8_t *mask, int stride) {
+    for(int l = 0; l < stride; l++) {
+        if(!mask[l]) {
+            continue;
+        }
+        // VF is written first and VX worked out from what the registers hold afterwards,
+        // the same order the interpreter uses when VF is one of the operands
+        switch(op) {
+            case ALU_SET:       vx[l] = nn; break;
+            case ALU_ADD:       vx[l] += nn; break;
+            case ALU_MOV:       vx[l] = vy[l]; break;
+            case ALU_OR:        vx[l] |= vy[l]; break;
+            case ALU_AND:       vx[l] &= vy[l]; break;
+            case ALU_XOR:       vx[l] ^= vy[l]; break;
+            case ALU_ADD_CARRY: vf[l] = (vx[l] + vy[l]) > 0xFF; vx[l] += vy[l]; break;
+            case ALU_SUB:       vf[l] = vx[l] >= vy[l]; vx[l] -= vy[l]; break;
+            case ALU_SHR:       vf[l] = vy[l] & 0x01; vx[l] = vy[l] >> 1; break;
+            case ALU_SUBN:      vf[l] = vy[l] >= vx[l]; vx[l] = vy[l] - vx[l]; break;
+            case ALU_SHL:       vf[l] = vy[l] >> 7; vx[l] = vy[l] << 1; break;
+        }
+    }
+}
+
+static void skipScalar(int op, const uint8_t *vx, const uint8_t *vy, uint8_t nn, const uint8_t *mask, uint16_t *pc, int stride) {
+    for(int l = 0; l < stride; l++) {
+        bool taken = false;
+        switch(op) {
+            case SKIP_EQ_NN:    taken = vx[l] == nn; break;
+            case SKIP_NE_NN:    taken = vx[l] != nn; break;
+            case SKIP_EQ:       taken = vx[l] == vy[l]; break;
+            case SKIP_NE:       taken = vx[l] != vy[l]; break;
+        }
+        if(mask[l] && taken) {
+            pc[l] += 2;
+        }
+    }
+}
+
+static void setWordsScalar(uint16_t *row, uint16_t value, const uint8_t *mask, int stride) {
+    for(int l = 0; l < stride; l++) {
+        if(mask[l]) {
+            row[l] = value;
+        }
+    }
+}
+
+static void addIndexScalar(uint16_t *I, const uint8_t *vx, uint8_t *vf, const uint8_t *mask, int stride) {
+    for(int l = 0; l < stride; l++) {
+        if(mask[l]) {
+            vf[l] = (I[l] + vx[l] > 0xFFF) ? 1 : 0;
+            I[l] += vx[l];
+        }
+    }
+}
+
+static bool sameWordsScalar(const uint16_t *row, uint16_t value, const uint8_t *mask, int stride) {
+    for(int l = 0; l < stride; l++) {
+        if(mask[l] && row[l] != value) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static int selectPcScalar(const uint16_t *pc, uint16_t address, const uint8_t *active, uint8_t *assigned,
+                          uint8_t *mask, uint16_t *list, int stride) {
+    int size = 0;
+    for(int l = 0; l < stride; l++) {
+        // A lane stepped earlier may have just arrived at the address
+        mask[l] = (active[l] && !assigned[l] && pc[l] == address) ? 0xFF : 0;
+        assigned[l] |= mask[l];
+        if(mask[l]) {
+            list[size++] = l;
+        }
+    }
+    return size;
+}
+
+#ifdef CHIP8_LOCKSTEP_AVX2
+/**
+ * Widens the 0x00 / 0xFF lane mask of 16 lanes to the 16-bit rows
+ **/
+AVX2_KERNEL static inline __m256i wordMask(const uint8_t *mask) {
+    return _mm256_cvtepi8_epi16(_mm_loadu_si128((const __m128i *)mask));
+}
+
+AVX2_KERNEL static void aluAvx2(int op, uint8_t *vx, const uint8_t *vy, uint8_t *vf, uint8_t nn, const uint8_t *mask, int stride) {
+    const __m256i imm = _mm256_set1_epi8((char)nn);
+    const __m256i one = _mm256_set1_epi8(1);
+    const __m256i low7 = _mm256_set1_epi8(0x7F);
+    bool sets_vf = (op >= ALU_ADD_CARRY);
+
+    for(int l = 0; l < stride; l += 32) {
+        __m256i m = _mm256_loadu_si256((const __m256i *)(mask + l));
+        __m256i x = _mm256_loadu_si256((const __m256i *)(vx + l));
+        __m256i y = _mm256_loadu_si256((const __m256i *)(vy + l));
+
+        if(sets_vf) {
+            __m256i flag;
+            switch(op) {
+                case ALU_ADD_CARRY: {
+                    // A carry leaves the sum smaller than VX
+                    __m256i sum = _mm256_add_epi8(x, y);
+                    flag = _mm256_andnot_si256(_mm256_cmpeq_epi8(_mm256_max_epu8(sum, x), sum), one);
+                    break;
+                }
+                case ALU_SUB:   flag = _mm256_and_si256(_mm256_cmpeq_epi8(_mm256_max_epu8(x, y), x), one); break;
+                case ALU_SUBN:  flag = _mm256_and_si256(_mm256_cmpeq_epi8(_mm256_max_epu8(x, y), y), one); break;
+                case ALU_SHR:   flag = _mm256_and_si256(y, one); break;
+                default:        flag = _mm256_and_si256(_mm256_srli_epi16(y, 7), one); break;
+            }
+            __m256i f = _mm256_loadu_si256((const __m256i *)(vf + l));
+            _mm256_storeu_si256((__m256i *)(vf + l), _mm256_blendv_epi8(f, flag, m));
+            x = _mm256_loadu_si256((const __m256i *)(vx + l));
+            y = _mm256_loadu_si256((const __m256i *)(vy + l));
+        }
+
+        __m256i result;
+        switch(op) {
+            case ALU_SET:       result = imm; break;
+            case ALU_ADD:       result = _mm256_add_epi8(x, imm); break;
+            case ALU_MOV:       result = y; break;
+            case ALU_OR:        result = _mm256_or_si256(x, y); break;
+            case ALU_AND:       result = _mm256_and_si256(x, y); break;
+            case ALU_XOR:       result = _mm256_xor_si256(x, y); break;
+            case ALU_ADD_CARRY: result = _mm256_add_epi8(x, y); break;
+            case ALU_SUB:       result = _mm256_sub_epi8(x, y); break;
+            case ALU_SHR:       result = _mm256_and_si256(_mm256_srli_epi16(y, 1), low7); break;
+            case ALU_SUBN:      result = _mm256_sub_epi8(y, x); break;
+            default:            result = _mm256_add_epi8(y, y); break;
+        }
+        _mm256_storeu_si256((__m256i *)(vx + l), _mm256_blendv_epi8(x, result, m));
+    }
+}
+
+AVX2_KERNEL static void skipAvx2(int op, const uint8_t *vx, const uint8_t *vy, uint8_t nn, const uint8_t *mask, uint16_t *pc, int stride) {
+    const __m256i imm = _mm256_set1_epi8((char)nn);
+    const __m256i two = _mm256_set1_epi16(2);
+
+    for(int l = 0; l < stride; l += 32) {
+        __m256i x = _mm256_loadu_si256((const __m256i *)(vx + l));
+        __m256i taken;
+        if(op == SKIP_EQ_NN || op == SKIP_NE_NN) {
+            taken = _mm256_cmpeq_epi8(x, imm);
+        } else {
+            taken = _mm256_cmpeq_epi8(x, _mm256_loadu_si256((const __m256i *)(vy + l)));
+        }
+        if(op == SKIP_NE_NN || op == SKIP_NE) {
+            taken = _mm256_xor_si256(taken, _mm256_set1_epi8(-1));
+        }
+        taken = _mm256_and_si256(taken, _mm256_loadu_si256((const __m256i *)(mask + l)));
+
+        // The bytes of 32 lanes cover two rows of program counters
+        __m256i low = _mm256_cvtepi8_epi16(_mm256_castsi256_si128(taken));
+        __m256i high = _mm256_cvtepi8_epi16(_mm256_extracti128_si256(taken, 1));
+        __m256i *p = (__m256i *)(pc + l);
+        _mm256_storeu_si256(p, _mm256_add_epi16(_mm256_loadu_si256(p), _mm256_and_si256(low, two)));
+        _mm256_storeu_si256(p + 1, _mm256_add_epi16(_mm256_loadu_si256(p + 1), _mm256_and_si256(high, two)));
+    }
+}
+
+AVX2_KERNEL static void setWordsAvx2(uint16_t *row, uint16_t value, const uint8_t *mask, int stride) {
+    const __m256i v = _mm256_set1_epi16((short)value);
+    for(int l = 0; l < stride; l += 16) {
+        __m256i *p = (__m256i *)(row + l);
+        _mm256_storeu_si256(p, _mm256_blendv_epi8(_mm256_loadu_si256(p), v, wordMask(mask + l)));
+    }
+}
+
+AVX2_KERNEL static void addIndexAvx2(uint16_t *I, const uint8_t *vx, uint8_t *vf, const uint8_t *mask, int stride) {
+    const __m256i limit = _mm256_set1_epi16(0x1000);
+    const __m256i ones = _mm256_set1_epi8(-1);
+    const __m256i one = _mm256_set1_epi8(1);
+
+    for(int l = 0; l < stride; l += 32) {
+        __m256i m = _mm256_loadu_si256((const __m256i *)(mask + l));
+        __m256i *p = (__m256i *)(I + l);
+
+        // VF is set if I + VX goes past 0xFFF, which includes going past 0xFFFF
+        __m256i flags[2];
+        for(int half = 0; half < 2; half++) {
+            __m256i i = _mm256_loadu_si256(p + half);
+            __m256i x = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)(vx + l + half * 16)));
+            __m256i sum = _mm256_add_epi16(i, x);
+            __m256i past_limit = _mm256_cmpeq_epi16(_mm256_max_epu16(sum, limit), sum);
+            __m256i wrapped = _mm256_xor_si256(_mm256_cmpeq_epi16(_mm256_max_epu16(sum, i), sum), ones);
+            flags[half] = _mm256_or_si256(past_limit, wrapped);
+        }
+        // Packing works within each 128-bit half, put the lanes back in order
+        __m256i flag = _mm256_permute4x64_epi64(_mm256_packs_epi16(flags[0], flags[1]), 0xD8);
+        __m256i f = _mm256_loadu_si256((const __m256i *)(vf + l));
+        _mm256_storeu_si256((__m256i *)(vf + l), _mm256_blendv_epi8(f, _mm256_and_si256(flag, one), m));
+
+        // VX is read again in case it is VF
+        for(int half = 0; half < 2; half++) {
+            __m256i i = _mm256_loadu_si256(p + half);
+            __m256i x = _mm256_cvtepu8_epi16(_mm_loadu_si128((const __m128i *)(vx + l + half * 16)));
+            _mm256_storeu_si256(p + half, _mm256_blendv_epi8(i, _mm256_add_epi16(i, x), wordMask(mask + l + half * 16)));
+        }
+    }
+}
+
+AVX2_KERNEL static void timersAvx2(uint8_t *delay, uint8_t *sound, int stride) {
+    const __m256i one = _mm256_set1_epi8(1);
+    for(int l = 0; l < stride; l += 32) {
+        __m256i *d = (__m256i *)(delay + l);
+        __m256i *s = (__m256i *)(sound + l);
+        _mm256_storeu_si256(d, _mm256_subs_epu8(_mm256_loadu_si256(d), one));
+        _mm256_storeu_si256(s, _mm256_subs_epu8(_mm256_loadu_si256(s), one));
+    }
+}
+
+AVX2_KERNEL static bool sameWordsAvx2(const uint16_t *row, uint16_t value, const uint8_t *mask, int stride) {
+    const __m256i v = _mm256_set1_epi16((short)value);
+    for(int l = 0; l < stride; l += 32) {
+        __m256i low = _mm256_cmpeq_epi16(_mm256_loadu_si256((const __m256i *)(row + l)), v);
+        __m256i high = _mm256_cmpeq_epi16(_mm256_loadu_si256((const __m256i *)(row + l + 16)), v);
+        __m256i same = _mm256_permute4x64_epi64(_mm256_packs_epi16(low, high), 0xD8);
+        __m256i different = _mm256_andnot_si256(same, _mm256_loadu_si256((const __m256i *)(mask + l)));
+        if(!_mm256_testz_si256(different, different)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+AVX2_KERNEL static int selectPcAvx2(const uint16_t *pc, uint16_t address, const uint8_t *active, uint8_t *assigned,
+                                    uint8_t *mask, uint16_t *list, int stride) {
+    const __m256i a = _mm256_set1_epi16((short)address);
+    int size = 0;
+    for(int l = 0; l < stride; l += 32) {
+        __m256i low = _mm256_cmpeq_epi16(_mm256_loadu_si256((const __m256i *)(pc + l)), a);
+        __m256i high = _mm256_cmpeq_epi16(_mm256_loadu_si256((const __m256i *)(pc + l + 16)), a);
+        __m256i m = _mm256_permute4x64_epi64(_mm256_packs_epi16(low, high), 0xD8);
+        m = _mm256_and_si256(m, _mm256_loadu_si256((const __m256i *)(active + l)));
+        __m256i *done = (__m256i *)(assigned + l);
+        m = _mm256_andnot_si256(_mm256_loadu_si256(done), m);
+        _mm256_storeu_si256((__m256i *)(mask + l), m);
+        _mm256_storeu_si256(done, _mm256_or_si256(_mm256_loadu_si256(done), m));
+        for(uint32_t bits = _mm256_movemask_epi8(m); bits != 0; bits &= bits - 1) {
+            list[size++] = l + __builtin_ctz(bits);
+        }
+    }
+    return size;
+}
+#endif
+
+// ==================================================================================================
+// Public Functions
+// ==================================================================================================
+/**
+ * Creates the lanes, all of them reset to an empty CHIP8_PLATFORM_CHIP8 machine. Load
+ * them with importLane().
+ *
+ * @param   count   Number of instances to run
+ **/
+CHIP8Lockstep::CHIP8Lockstep(int count) {
+    lanes = (count < 1) ? 1 : count;
+    stride = (lanes + CHIP8_LOCKSTEP_LANE_BLOCK - 1) / CHIP8_LOCKSTEP_LANE_BLOCK * CHIP8_LOCKSTEP_LANE_BLOCK;
+    avx2 = vectorized();
+
+    V.assign(16 * stride, 0);
+    pc.assign(stride, 0x200);
+    I.assign(stride, 0);
+    timer_delay.assign(stride, 0);
+    timer_sound.assign(stride, 0);
+    sp.assign(stride, 0);
+    draw_flag.assign(stride, 0);
+    keys.assign(stride, 0);
+
+    memory.assign((size_t)stride * LANE_MEMORY, 0);
+    stack.assign(stride * 16, 0);
+    display.assign(CHIP8_SCREEN_HEIGHT * stride, 0);
+    rng_seed.assign(stride, 0);
+    rng_state.assign(stride, 0);
+    rom_hash.assign(stride, 0);
+
+    active.assign(stride, 0);
+    memset(&active[0], 0xFF, lanes);
+    assigned.assign(stride, 0);
+    group.assign(stride, 0);
+    group_lanes.assign(stride, 0);
+    for(int lane = 0; lane < lanes; lane++) {
+        all_lanes.push_back(lane);
+    }
+
+    // Every lane starts out as a reset interpreter
+    CHIP8Interpreter blank;
+    for(int lane = 0; lane < lanes; lane++) {
+        importLane(lane, blank);
+    }
+
+    vector_steps = 0;
+    scalar_steps = 0;
+}
+
+/**
+ * @return  true if this CPU can run the AVX2 kernels
+ **/
+bool CHIP8Lockstep::vectorized() {
+#ifdef CHIP8_LOCKSTEP_AVX2
+    __builtin_cpu_init();
+    return __builtin_cpu_supports("avx2");
+#else
+    return false;
+#endif
+}
+
+/**
+ * Chooses between the AVX2 and the scalar kernels, both give the same results
+ *
+ * @param   enable  true to use AVX2 where the CPU has it
+ * @return          true if the AVX2 kernels are used from now on
+ **/
+bool CHIP8Lockstep::useAvx2(bool enable) {
+    avx2 = enable && vectorized();
+    return avx2;
+}
+
+/**
+ * Copies the state of an interpreter into a lane
+ *
+ * @param   lane    The lane to set
+ * @param   chip8   The machine to copy, it must be running CHIP8_PLATFORM_CHIP8
+ * @return          false if the interpreter is on some other platform
+ **/
+bool CHIP8Lockstep::importLane(int lane, const CHIP8Interpreter &chip8) {
+    if(lane < 0 || lane >= lanes || chip8.platform != CHIP8_PLATFORM_CHIP8) {
+        return false;
+    }
+
+    for(int x = 0; x < 16; x++) {
+        reg(x)[lane] = chip8.V[x];
+        stack[lane * 16 + x] = chip8.stack[x];
+    }
+    pc[lane] = chip8.pc;
+    I[lane] = chip8.I;
+    sp[lane] = chip8.sp & 0xF;
+    timer_delay[lane] = chip8.timer_delay;
+    timer_sound[lane] = chip8.timer_sound;
+    draw_flag[lane] = (chip8.draw_flag != 0);
+
+    keys[lane] = chip8.keys;
+
+    memcpy(&memory[(size_t)lane * LANE_MEMORY], chip8.memory, CHIP8_MEMORY_MAX);
+    for(int y = 0; y < CHIP8_SCREEN_HEIGHT; y++) {
+        display[y * stride + lane] = chip8.display[0][y][0];
+    }
+    rng_seed[lane] = chip8.rng_seed;
+    rng_state[lane] = chip8.rng_state;
+    rom_hash[lane] = chip8.rom_hash;
+
+    shared_valid = false;
+    return true;
+}
+
+/**
+ * Copies a lane into an interpreter, which is switched to CHIP8_PLATFORM_CHIP8. The
+ * interpreter keeps its engine.
+ *
+ * @param   lane    The lane to copy
+ * @param   chip8   Receives the state of the lane
+ **/
+void CHIP8Lockstep::exportLane(int lane, CHIP8Interpreter &chip8) const {
+    chip8.setPlatform(CHIP8_PLATFORM_CHIP8);
+
+    for(int x = 0; x < 16; x++) {
+        chip8.V[x] = reg(x)[lane];
+        chip8.stack[x] = stack[lane * 16 + x];
+    }
+    chip8.keys = keys[lane];
+    chip8.pc = pc[lane];
+    chip8.I = I[lane];
+    chip8.sp = sp[lane];
+    chip8.timer_delay = timer_delay[lane];
+    chip8.timer_sound = timer_sound[lane];
+    chip8.draw_flag = draw_flag[lane];
+
+    memcpy(chip8.memory, &memory[(size_t)lane * LANE_MEMORY], CHIP8_MEMORY_MAX);
+    for(int y = 0; y < CHIP8_SCREEN_HEIGHT; y++) {
+        chip8.display[0][y][0] = display[y * stride + lane];
+    }
+    chip8.rng_seed = rng_seed[lane];
+    chip8.rng_state = rng_state[lane];
+    chip8.rom_hash = rom_hash[lane];
+    chip8.invalidateCode();
+}
+
+/**
+ * @param   lane    The lane whose keypad changes
+ * @param   keys    Bit N set for every key N that is down
+ **/
+void CHIP8Lockstep::setKeys(int lane, uint16_t keys) {
+    this->keys[lane] = keys;
+}
+
+/**
+ * Executes the given number of instructions on every lane
+ *
+ * @param   cycles  The number of instructions to execute
+ **/
+void CHIP8Lockstep::run(int cycles) {
+    if(!shared_valid) {
+        shareCode();
+    }
+    for(int cycle = 0; cycle < cycles; cycle++) {
+        step();
+    }
+}
+
+/**
+ * Ticks down the timers of every lane
+ **/
+void CHIP8Lockstep::timerUpdate() {
+#ifdef CHIP8_LOCKSTEP_AVX2
+    if(avx2) {
+        timersAvx2(&timer_delay[0], &timer_sound[0], stride);
+        return;
+    }
+#endif
+    for(int l = 0; l < stride; l++) {
+        if(timer_delay[l] > 0) {
+            timer_delay[l]--;
+        }
+        if(timer_sound[l] > 0) {
+            timer_sound[l]--;
+        }
+    }
+}
+
+/**
+ * @param   lane    A lane
+ * @return          The hash CHIP8Interpreter::displayHash() gives the display of the lane
+ **/
+uint64_t CHIP8Lockstep::displayHash(int lane) const {
+    uint64_t hash = 0xCBF29CE484222325ULL;
+    for(int y = 0; y < CHIP8_SCREEN_HEIGHT; y++) {
+        hash = CHIP8Interpreter::hashDisplayWord(hash, display[y * stride + lane]);
+    }
+    return hash;
+}
+
+// ==================================================================================================
+// Private Functions
+// ==================================================================================================
+/**
+ * Reads a byte of a lane's memory. Addresses every lane agrees on are read from the first
+ * lane, which stays in the cache.
+ *
+ * @param   lane        The lane to read
+ * @param   address     The address, wrapped around the end of memory
+ * @return              The byte at the address
+ **/
+inline uint8_t CHIP8Lockstep::load(int lane, uint16_t address) const {
+    address &= CHIP8_ADDRESS_MASK;
+    if(shared[address]) {
+        return memory[address];
+    }
+    return memory[(size_t)lane * LANE_MEMORY + address];
+}
+
+/**
+ * Executes one instruction on every lane
+ **/
+void CHIP8Lockstep::step() {
+    // The common case, every lane is at the same place
+    uint16_t first = pc[0];
+    if(sameWords(&pc[0], first, &active[0])) {
+        if(!stepGroup(first, &active[0], &all_lanes[0], lanes)) {
+            for(int l = 0; l < lanes; l++) {
+                stepLane(l);
+            }
+        }
+        return;
+    }
+
+    // Otherwise step the lanes one program counter at a time, in the order of the first
+    // lane at each. Past CHIP8_LOCKSTEP_MAX_GROUPS the rest go one lane at a time.
+    memset(&assigned[0], 0, stride);
+    int groups = 0;
+    for(int lane = 0; lane < lanes; lane++) {
+        if(assigned[lane]) {
+            continue;
+        }
+        if(groups == CHIP8_LOCKSTEP_MAX_GROUPS) {
+            assigned[lane] = 0xFF;
+            stepLane(lane);
+            continue;
+        }
+        uint16_t address = pc[lane];
+        int size = selectPc(address, &group[0], &group_lanes[0]);
+        groups++;
+        if(size < CHIP8_LOCKSTEP_MIN_GROUP || !stepGroup(address, &group[0], &group_lanes[0], size)) {
+            for(int i = 0; i < size; i++) {
+                stepLane(group_lanes[i]);
+            }
+        }
+    }
+}
+
+/**
+ * Works out which addresses hold the same byte in every lane
+ **/
+void CHIP8Lockstep::shareCode() {
+    const uint8_t *first = &memory[0];
+    memset(shared, 1, sizeof(shared));
+    for(int lane = 1; lane < lanes; lane++) {
+        const uint8_t *other = &memory[(size_t)lane * LANE_MEMORY];
+        for(int address = 0; address < CHIP8_MEMORY_MAX; address++) {
+            if(other[address] != first[address]) {
+                shared[address] = 0;
+            }
+        }
+    }
+    shared_valid = true;
+}
+
+/**
+ * Executes the instruction at an address on every lane of a group. It is fetched and
+ * decoded once, and executed with one kernel if there is one for it.
+ *
+ * @param   address     The program counter of every lane in the group
+ * @param   mask        0xFF for the lanes in the group
+ * @param   list        The lanes in the group
+ * @param   size        Number of lanes in the group
+ * @return              false if the lanes may not all have the same instruction there,
+ *                      nothing has been executed then
+ **/
+bool CHIP8Lockstep::stepGroup(uint16_t address, const uint8_t *mask, const uint16_t *list, int size) {
+    if(address > KERNEL_PC_MAX || !shared[address] || !shared[address + 1]) {
+        return false;
+    }
+    uint16_t opcode = (memory[address] << 8) | memory[address + 1];
+    uint8_t X = (opcode & 0x0F00) >> 8;
+    uint8_t Y = (opcode & 0x00F0) >> 4;
+    uint8_t NN = opcode & 0x00FF;
+    uint16_t NNN = opcode & 0x0FFF;
+    uint16_t next = address + 2;
+    bool kernel = true;
+
+    switch(opcode >> 12) {
+        case 0x1:
+            setWords(&pc[0], NNN, mask);
+            break;
+        case 0x3:
+        case 0x4:
+        case 0x5:
+        case 0x9:
+        {
+            static const int conditions[16] = { 0, 0, 0, SKIP_EQ_NN, SKIP_NE_NN, SKIP_EQ, 0, 0, 0, SKIP_NE };
+            setWords(&pc[0], next, mask);
+            skip(conditions[opcode >> 12], reg(X), reg(Y), NN, mask);
+            break;
+        }
+        case 0x6:
+            setWords(&pc[0], next, mask);
+            alu(ALU_SET, reg(X), reg(X), reg(0xF), NN, mask);
+            break;
+        case 0x7:
+            setWords(&pc[0], next, mask);
+            alu(ALU_ADD, reg(X), reg(X), reg(0xF), NN, mask);
+            break;
+        case 0x8:
+        {
+            static const int8_t operations[16] = {
+                ALU_MOV, ALU_OR, ALU_AND, ALU_XOR, ALU_ADD_CARRY, ALU_SUB, ALU_SHR, ALU_SUBN,
+                -1, -1, -1, -1, -1, -1, ALU_SHL, -1
+            };
+            setWords(&pc[0], next, mask);
+            // The rest of 8XYN do nothing
+            if(operations[opcode & 0xF] >= 0) {
+                alu(operations[opcode & 0xF], reg(X), reg(Y), reg(0xF), 0, mask);
+            }
+            break;
+        }
+        case 0xA:
+            setWords(&pc[0], next, mask);
+            setWords(&I[0], NNN, mask);
+            break;
+        case 0xF:
+            if(NN == 0x07) {
+                setWords(&pc[0], next, mask);
+                alu(ALU_MOV, reg(X), &timer_delay[0], reg(0xF), 0, mask);
+            } else if(NN == 0x15) {
+                setWords(&pc[0], next, mask);
+                alu(ALU_MOV, &timer_delay[0], reg(X), reg(0xF), 0, mask);
+            } else if(NN == 0x18) {
+                setWords(&pc[0], next, mask);
+                alu(ALU_MOV, &timer_sound[0], reg(X), reg(0xF), 0, mask);
+            } else if(NN == 0x1E) {
+                setWords(&pc[0], next, mask);
+                addIndex(reg(X), reg(0xF), mask);
+            } else if(NN == 0x65 && loadsShared(X, mask, list)) {
+                // Every lane loads the same bytes, so each register is set to a constant
+                uint16_t index = I[list[0]];
+                setWords(&pc[0], next, mask);
+                for(int r = 0; r <= X; r++) {
+                    alu(ALU_SET, reg(r), reg(r), reg(0xF), memory[index + r], mask);
+                }
+                setWords(&I[0], index + X + 1, mask);
+            } else {
+                kernel = false;
+            }
+            break;
+        default:
+            kernel = false;
+            break;
+    }
+
+    if(!kernel) {
+        // Decoded once all the same, and executed one lane at a time
+        for(int i = 0; i < size; i++) {
+            pc[list[i]] = next;
+        }
+        executeLanes(opcode, list, size);
+        for(int i = 0; i < size; i++) {
+            if(pc[list[i]] > CHIP8_MEMORY_MAX) {
+                pc[list[i]] = 0;
+            }
+        }
+        scalar_steps += size;
+        return true;
+    }
+    vector_steps += size;
+    return true;
+}
+
+/**
+ * @param   X       The last register FX65 loads
+ * @return          true if FX65 would load the same bytes on every lane of the group,
+ *                  without wrapping around the end of memory
+ **/
+bool CHIP8Lockstep::loadsShared(uint8_t X, const uint8_t *mask, const uint16_t *list) const {
+    uint16_t index = I[list[0]];
+    if(index + X >= CHIP8_MEMORY_MAX || !sameWords(&I[0], index, mask)) {
+        return false;
+    }
+    for(int r = 0; r <= X; r++) {
+        if(!shared[index + r]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * Executes one instruction on a single lane
+ **/
+void CHIP8Lockstep::stepLane(int lane) {
+    uint16_t address = pc[lane];
+    uint16_t opcode = (load(lane, address) << 8) | load(lane, address + 1);
+    pc[lane] = address + 2;
+
+    uint16_t list = lane;
+    executeLanes(opcode, &list, 1);
+
+    // The interpreter does the same to stop the program counter leaving memory
+    if(pc[lane] > CHIP8_MEMORY_MAX) {
+        pc[lane] = 0;
+    }
+    scalar_steps++;
+}
+
+/**
+ * Executes an opcode on a list of lanes the way CHIP8_PLATFORM_CHIP8 does, see the opcode
+ * functions of CHIP8Interpreter. The program counters have already moved past it.
+ *
+ * @param   opcode  The instruction to execute
+ * @param   list    The lanes to execute it on
+ * @param   count   Number of lanes in the list
+ **/
+void CHIP8Lockstep::executeLanes(uint16_t opcode, const uint16_t *list, int count) {
+    uint8_t X = (opcode & 0x0F00) >> 8;
+    uint8_t Y = (opcode & 0x00F0) >> 4;
+    uint8_t N = opcode & 0x000F;
+    uint8_t NN = opcode & 0x00FF;
+    uint16_t NNN = opcode & 0x0FFF;
+    uint8_t *vx = reg(X);
+    uint8_t *vy = reg(Y);
+    uint8_t *vf = reg(0xF);
+
+    switch(opcode >> 12) {
+        case 0x0:
+            if(opcode == 0x00E0) {
+                for(int y = 0; y < CHIP8_SCREEN_HEIGHT; y++) {
+                    uint64_t *row = &display[y * stride];
+                    for(int i = 0; i < count; i++) {
+                        row[list[i]] = 0;
+                    }
+                }
+            } else if(opcode == 0x00EE) {
+                for(int i = 0; i < count; i++) {
+                    int l = list[i];
+                    sp[l] = (sp[l] - 1) & 0xF;
+                    pc[l] = stack[l * 16 + sp[l]];
+                }
+            }
+            break;
+        case 0x1:
+            for(int i = 0; i < count; i++) {
+                pc[list[i]] = NNN;
+            }
+            break;
+        case 0x2:
+            for(int i = 0; i < count; i++) {
+                int l = list[i];
+                stack[l * 16 + sp[l]] = pc[l];
+                sp[l] = (sp[l] + 1) & 0xF;
+                pc[l] = NNN;
+            }
+            break;
+        case 0x3:
+        case 0x4:
+        case 0x5:
+        case 0x9:
+            for(int i = 0; i < count; i++) {
+                int l = list[i];
+                bool taken;
+                switch(opcode >> 12) {
+                    case 0x3: taken = vx[l] == NN; break;
+                    case 0x4: taken = vx[l] != NN; break;
+                    case 0x5: taken = vx[l] == vy[l]; break;
+                    default:  taken = vx[l] != vy[l]; break;
+                }
+                if(taken) {
+                    pc[l] += 2;
+                }
+            }
+            break;
+        case 0x6:
+        case 0x7:
+        case 0x8:
+        case 0xA:
+            // Only reached one lane at a time, the kernels take care of groups
+            for(int i = 0; i < count; i++) {
+                int l = list[i];
+                switch(opcode >> 12) {
+                    case 0x6: vx[l] = NN; break;
+                    case 0x7: vx[l] += NN; break;
+                    case 0xA: I[l] = NNN; break;
+                    default:
+                        switch(N) {
+                            case 0x0: vx[l] = vy[l]; break;
+                            case 0x1: vx[l] |= vy[l]; break;
+                            case 0x2: vx[l] &= vy[l]; break;
+                            case 0x3: vx[l] ^= vy[l]; break;
+                            case 0x4: vf[l] = (vx[l] + vy[l]) > 0xFF; vx[l] += vy[l]; break;
+                            case 0x5: vf[l] = vx[l] >= vy[l]; vx[l] -= vy[l]; break;
+                            case 0x6: vf[l] = vy[l] & 0x01; vx[l] = vy[l] >> 1; break;
+                            case 0x7: vf[l] = vy[l] >= vx[l]; vx[l] = vy[l] - vx[l]; break;
+                            case 0xE: vf[l] = vy[l] >> 7; vx[l] = vy[l] << 1; break;
+                            default: break;
+                        }
+                        break;
+                }
+            }
+            break;
+        case 0xB:
+            for(int i = 0; i < count; i++) {
+                pc[list[i]] = reg(0)[list[i]] + NNN;
+            }
+            break;
+        case 0xC:
+            for(int i = 0; i < count; i++) {
+                // The interpreter's xorshift64*, so every lane draws the numbers it would
+                int l = list[i];
+                uint64_t state = rng_state[l];
+                state ^= state >> 12;
+                state ^= state << 25;
+                state ^= state >> 27;
+                rng_state[l] = state;
+                vx[l] = ((state * 0x2545F4914F6CDD1DULL) >> 56) & NN;
+            }
+            break;
+        case 0xD:
+            for(int i = 0; i < count; i++) {
+                int l = list[i];
+                vf[l] = 0;
+                uint8_t x = vx[l] % CHIP8_SCREEN_WIDTH;
+                uint8_t y = vy[l] % CHIP8_SCREEN_HEIGHT;
+                uint64_t *row = &display[y * stride + l];
+                uint64_t collision = 0;
+                for(int sprite_y = 0; sprite_y < N && y + sprite_y < CHIP8_SCREEN_HEIGHT; sprite_y++) {
+                    uint64_t pixels = ((uint64_t)load(l, I[l] + sprite_y) << 56) >> x;
+                    collision |= *row & pixels;
+                    *row ^= pixels;
+                    row += stride;
+                }
+                vf[l] = (collision != 0);
+                draw_flag[l] = 1;
+            }
+            break;
+        case 0xE:
+            for(int i = 0; i < count; i++) {
+                // Values past the last key read as not pressed
+                int l = list[i];
+                bool pressed = vx[l] < 16 && ((keys[l] >> vx[l]) & 1);
+                if((NN == 0x9E && pressed) || (NN == 0xA1 && !pressed)) {
+                    pc[l] += 2;
+                }
+            }
+            break;
+        default:
+            for(int i = 0; i < count; i++) {
+                int l = list[i];
+                uint8_t *mem = &memory[(size_t)l * LANE_MEMORY];
+                switch(NN) {
+                    case 0x07:
+                        vx[l] = timer_delay[l];
+                        break;
+                    case 0x0A:
+                        if(keys[l] == 0) {
+                            pc[l] -= 2;
+                        } else {
+                            // The highest key that is down, like the interpreter's loop
+                            vx[l] = 31 - __builtin_clz(keys[l]);
+                        }
+                        break;
+                    case 0x15:
+                        timer_delay[l] = vx[l];
+                        break;
+                    case 0x18:
+                        timer_sound[l] = vx[l];
+                        break;
+                    case 0x1E:
+                        vf[l] = (I[l] + vx[l] > 0xFFF) ? 1 : 0;
+                        I[l] += vx[l];
+                        break;
+                    case 0x29:
+                        I[l] = CHIP8_FONT_ADDRESS + vx[l] * 5;
+                        break;
+                    case 0x33:
+                        mem[I[l] & CHIP8_ADDRESS_MASK] = vx[l] / 100;
+                        mem[(I[l] + 1) & CHIP8_ADDRESS_MASK] = (vx[l] / 10) % 10;
+                        mem[(I[l] + 2) & CHIP8_ADDRESS_MASK] = vx[l] % 10;
+                        unshare(I[l], 3);
+                        break;
+                    case 0x55:
+                        for(int r = 0; r <= X; r++) {
+                            mem[(I[l] + r) & CHIP8_ADDRESS_MASK] = reg(r)[l];
+                        }
+                        unshare(I[l], X + 1);
+                        I[l] += X + 1;
+                        break;
+                    case 0x65:
+                        for(int r = 0; r <= X; r++) {
+                            reg(r)[l] = load(l, I[l] + r);
+                        }
+                        I[l] += X + 1;
+                        break;
+                    default:
+                        break;
+                }
+            }
+            break;
+    }
+}
+
+/**
+ * Must be called after a lane writes to memory, the lanes may no longer agree on
+ * what is there
+ *
+ * @param   address     The first address written to
+ * @param   length      The number of bytes written
+ **/
+void CHIP8Lockstep::unshare(uint16_t address, int length) {
+    for(int i = 0; i < length; i++) {
+        shared[(address + i) & CHIP8_ADDRESS_MASK] = 0;
+    }
+}
+
+/**
+ * Finds the lanes at a program counter that haven't been stepped yet, and marks them
+ * as stepped
+ *
+ * @param   address     The program counter to look for
+ * @param   mask        Receives 0xFF for every lane at the address
+ * @param   list        Receives the lanes at the address
+ * @return              Number of lanes at the address
+ **/
+int CHIP8Lockstep::selectPc(uint16_t address, uint8_t *mask, uint16_t *list) {
+#ifdef CHIP8_LOCKSTEP_AVX2
+    if(avx2) {
+        return selectPcAvx2(&pc[0], address, &active[0], &assigned[0], mask, list, stride);
+    }
+#endif
+    return selectPcScalar(&pc[0], address, &active[0], &assigned[0], mask, list, stride);
+}
+
+// ==================================================================================================
+// Kernels
+// ==================================================================================================
+/**
+ * VX = VX op VY (or NN) on every lane in the mask, setting VF for the operations that do
+ *
+ * @param   op      One of the ALU_ operations
+ * @param   vx      Row of the destination register
+ * @param   vy      Row of the source register
+ * @param   vf      Row of VF
+ * @param   nn      The constant of ALU_SET and ALU_ADD
+ * @param   mask    0xFF for the lanes to change
+ **/
+void CHIP8Lockstep::alu(int op, uint8_t *vx, const uint8_t *vy, uint8_t *vf, uint8_t nn, const uint8_t *mask) {
+#ifdef CHIP8_LOCKSTEP_AVX2
+    if(avx2) {
+        aluAvx2(op, vx, vy, vf, nn, mask, stride);
+        return;
+    }
+#endif
+    aluScalar(op, vx, vy, vf, nn, mask, stride);
+}
+
+/**
+ * Skips the next instruction on every lane in the mask where the condition holds
+ *
+ * @param   op      One of the SKIP_ conditions
+ **/
+void CHIP8Lockstep::skip(int op, const uint8_t *vx, const uint8_t *vy, uint8_t nn, const uint8_t *mask) {
+#ifdef CHIP8_LOCKSTEP_AVX2
+    if(avx2) {
+        skipAvx2(op, vx, vy, nn, mask, &pc[0], stride);
+        return;
+    }
+#endif
+    skipScalar(op, vx, vy, nn, mask, &pc[0], stride);
+}
+
+/**
+ * @return  true if a 16-bit register holds the value on every lane in the mask
+ **/
+bool CHIP8Lockstep::sameWords(const uint16_t *row, uint16_t value, const uint8_t *mask) const {
+#ifdef CHIP8_LOCKSTEP_AVX2
+    if(avx2) {
+        return sameWordsAvx2(row, value, mask, stride);
+    }
+#endif
+    return sameWordsScalar(row, value, mask, stride);
+}
+
+/**
+ * Sets a 16-bit register on every lane in the mask
+ **/
+void CHIP8Lockstep::setWords(uint16_t *row, uint16_t value, const uint8_t *mask) {
+#ifdef CHIP8_LOCKSTEP_AVX2
+    if(avx2) {
+        setWordsAvx2(row, value, mask, stride);
+        return;
+    }
+#endif
+    setWordsScalar(row, value, mask, stride);
+}
+
+/**
+ * FX1E on every lane in the mask
+ **/
+void CHIP8Lockstep::addIndex(const uint8_t *vx, uint8_t *vf, const uint8_t *mask) {
+#ifdef CHIP8_LOCKSTEP_AVX2
+    if(avx2) {
+        addIndexAvx2(&I[0], vx, vf, mask, stride);
+        return;
+    }
+#endif
+    addIndexScalar(&I[0], vx, vf, mask, stride);
+}
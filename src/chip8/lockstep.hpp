@@ -0,0 +1,109 @@
+#ifndef CHIP8_LOCKSTEP_H
+#define CHIP8_LOCKSTEP_H
+
+#include <stdint.h>
+#include <vector>
+
+#include "chip8.hpp"
+
+// The AVX2 kernels are built on x86 hosts with GCC or Clang and picked at run time,
+// everything else uses the scalar kernels
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define CHIP8_LOCKSTEP_AVX2
+#endif
+
+// Lanes are allocated in multiples of this, the width of an AVX2 register in bytes
+#define CHIP8_LOCKSTEP_LANE_BLOCK   32
+// Most program counters stepped with the vector kernels in one step when the lanes disagree
+#define CHIP8_LOCKSTEP_MAX_GROUPS   16
+// Fewest lanes at one program counter worth a vector kernel, smaller groups step one lane at a time
+#define CHIP8_LOCKSTEP_MIN_GROUP    4
+
+/**
+ * Runs many instances of the same CHIP8_PLATFORM_CHIP8 program side by side, for
+ * searches, fuzzing and training runs that need thousands of them.
+ *
+ * The state of the instances (lanes) is kept as a structure of arrays: register VX of
+ * every lane is one row of bytes, and so are the program counters, I and the timers. Each
+ * step executes exactly one instruction on every lane. While the lanes agree on the
+ * program counter and the code there is the same in all of them, the opcode is fetched
+ * and decoded once and executed on every lane with a single kernel, 32 lanes per AVX2
+ * instruction. Once they drift apart the lanes are grouped by program counter and each
+ * large group still gets the kernel with the other lanes masked out, what is left steps
+ * one lane at a time. Instructions without a kernel (draws, calls, memory and key
+ * instructions) also run one lane at a time. Every lane ends up in exactly the state a
+ * CHIP8Interpreter running the same instructions would be in.
+ **/
+class CHIP8Lockstep {
+    public:
+        CHIP8Lockstep(int count);
+        int count() const { return lanes; }
+        static bool vectorized();
+        bool useAvx2(bool enable);
+        bool importLane(int lane, const CHIP8Interpreter &chip8);
+        void exportLane(int lane, CHIP8Interpreter &chip8) const;
+        void setKeys(int lane, uint16_t keys);
+        uint16_t getKeys(int lane) const { return keys[lane]; }
+        void run(int cycles);
+        void timerUpdate();
+        uint64_t displayHash(int lane) const;
+        uint64_t vectorSteps() const { return vector_steps; }
+        uint64_t scalarSteps() const { return scalar_steps; }
+
+    private:
+        int lanes;                          // Number of instances
+        int stride;                         // Lanes rounded up to CHIP8_LOCKSTEP_LANE_BLOCK, the length of every row
+        bool avx2;                          // Use the AVX2 kernels
+
+        // One row per register, indexed by lane
+        std::vector<uint8_t> V;             // 16 rows, VX of every lane is at X * stride
+        std::vector<uint16_t> pc;
+        std::vector<uint16_t> I;
+        std::vector<uint8_t> timer_delay;
+        std::vector<uint8_t> timer_sound;
+        std::vector<uint8_t> sp;
+        std::vector<uint8_t> draw_flag;
+        std::vector<uint16_t> keys;         // Bit N set while key N is down
+        std::vector<uint64_t> display;      // CHIP8_SCREEN_HEIGHT rows, display row Y of every lane is at Y * stride
+
+        // Per lane blocks, only ever accessed one lane at a time
+        std::vector<uint8_t> memory;        // CHIP8_MEMORY_MAX bytes per lane, padded
+        std::vector<uint16_t> stack;        // 16 levels per lane
+        std::vector<uint64_t> rng_seed;
+        std::vector<uint64_t> rng_state;
+        std::vector<uint64_t> rom_hash;
+
+        // Masks for the current step, 0xFF for every lane taking part, and the same as lists
+        std::vector<uint8_t> active;        // Every lane that exists
+        std::vector<uint16_t> all_lanes;
+        std::vector<uint8_t> assigned;      // Lanes already stepped
+        std::vector<uint8_t> group;         // Lanes at the program counter being stepped
+        std::vector<uint16_t> group_lanes;
+
+        uint8_t shared[CHIP8_MEMORY_MAX];   // Non-zero for every address that holds the same byte in every lane
+        bool shared_valid;                  // False after importLane() until shared is worked out again
+
+        uint64_t vector_steps;              // Lane instructions executed by the kernels
+        uint64_t scalar_steps;              // Lane instructions executed one lane at a time
+
+        uint8_t *reg(int x) { return &V[x * stride]; }
+        const uint8_t *reg(int x) const { return &V[x * stride]; }
+        uint8_t load(int lane, uint16_t address) const;
+        void step();
+        void shareCode();
+        bool stepGroup(uint16_t address, const uint8_t *mask, const uint16_t *list, int size);
+        void stepLane(int lane);
+        void executeLanes(uint16_t opcode, const uint16_t *list, int count);
+        void unshare(uint16_t address, int length);
+        bool loadsShared(uint8_t X, const uint8_t *mask, const uint16_t *list) const;
+        int selectPc(uint16_t address, uint8_t *mask, uint16_t *list);
+
+        // ======================================== Kernels ========================================
+        void alu(int op, uint8_t *vx, const uint8_t *vy, uint8_t *vf, uint8_t nn, const uint8_t *mask);
+        void skip(int op, const uint8_t *vx, const uint8_t *vy, uint8_t nn, const uint8_t *mask);
+        bool sameWords(const uint16_t *row, uint16_t value, const uint8_t *mask) const;
+        void setWords(uint16_t *row, uint16_t value, const uint8_t *mask);
+        void addIndex(const uint8_t *vx, uint8_t *vf, const uint8_t *mask);
+};
+
+#endif // CHIP8_LOCKSTEP_H
@@ -0,0 +1,316 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "movie.hpp"
+#include "scheduler.hpp"
+
+/**
+ * Movie format. All values are little-endian.
+ *
+ *   offset  size    field
+ *   0       4       magic "C8MV"
+ *   4       1       version (CHIP8_MOVIE_VERSION)
+ *   5       1       platform
+ *   6       2       reserved (0)
+ *   8       4       CPU frequency (instructions per second)
+ *   12      8       random number generator seed
+ *   20      8       ROM hash (CHIP8Interpreter::hashRom)
+ *   28      ...     records
+ *
+ * Every record is the number of instructions run since the previous record (LEB128, 7 bits
+ * a byte, lowest first) followed by a tag byte:
+ *
+ *   0x00-0x0F       key 0-F released
+ *   0x10-0x1F       key 0-F pressed
+ *   0x20            checkpoint, followed by the 8-byte display hash
+ *   0x21            end of the movie
+ *
+ * Every key starts released. A movie that is cut short still replays up to its last
+ * whole record.
+ **/
+
+static const uint8_t movie_magic[4] = { 'C', '8', 'M', 'V' };
+
+#define MOVIE_HEADER_SIZE       28
+#define MOVIE_TAG_PRESSED       0x10
+#define MOVIE_TAG_CHECKPOINT    0x20
+#define MOVIE_TAG_END           0x21
+
+// ==================================================================================================
+// Helpers
+// ==================================================================================================
+static void put32(uint8_t *out, uint32_t value) {
+    for(int b = 0; b < 4; b++) {
+        out[b] = (value >> (8 * b)) & 0xFF;
+    }
+}
+
+static uint32_t get32(const uint8_t *in) {
+    uint32_t value = 0;
+    for(int b = 0; b < 4; b++) {
+        value |= (uint32_t)in[b] << (8 * b);
+    }
+    return value;
+}
+
+static void put64(uint8_t *out, uint64_t value) {
+    for(int b = 0; b < 8; b++) {
+        out[b] = (value >> (8 * b)) & 0xFF;
+    }
+}
+
+static uint64_t get64(const uint8_t *in) {
+    uint64_t value = 0;
+    for(int b = 0; b < 8; b++) {
+        value |= (uint64_t)in[b] << (8 * b);
+    }
+    return value;
+}
+
+// ==================================================================================================
+// Recorder
+// ==================================================================================================
+CHIP8MovieRecorder::CHIP8MovieRecorder() {
+    file = NULL;
+    cpu_frequency = 0;
+    last = 0;
+    last_checkpoint = 0;
+    failed = false;
+}
+
+CHIP8MovieRecorder::~CHIP8MovieRecorder() {
+    close(last);
+}
+
+/**
+ * Starts a movie. Call it right after the ROM is loaded, before anything has run.
+ *
+ * @param   filename        The file to write
+ * @param   chip8           The interpreter, with the ROM loaded
+ * @param   cpu_frequency   Instructions the scheduler runs per second
+ * @return                  false if the file could not be created
+ **/
+bool CHIP8MovieRecorder::open(const char *filename, const CHIP8Interpreter &chip8, uint32_t cpu_frequency) {
+    close(last);
+    file = fopen(filename, "wb");
+    if(file == NULL) {
+        return false;
+    }
+    this->cpu_frequency = cpu_frequency;
+    last = 0;
+    last_checkpoint = 0;
+    failed = false;
+
+    uint8_t header[MOVIE_HEADER_SIZE];
+    memset(header, 0, sizeof(header));
+    memcpy(header, movie_magic, sizeof(movie_magic));
+    header[4] = CHIP8_MOVIE_VERSION;
+    header[5] = chip8.getPlatform();
+    put32(&header[8], cpu_frequency);
+    put64(&header[12], chip8.getSeed());
+    put64(&header[20], chip8.romHash());
+    failed = fwrite(header, 1, sizeof(header), file) != sizeof(header);
+    return !failed;
+}
+
+/**
+ * Records a key going down or up
+ *
+ * @param   instructions    Instructions run before the change was applied
+ * @param   key             The key (0x0-0xF)
+ * @param   down            true if it was pressed
+ **/
+void CHIP8MovieRecorder::key(uint64_t instructions, int key, bool down) {
+    if(file != NULL) {
+        record(instructions, (key & 0xF) | (down ? MOVIE_TAG_PRESSED : 0));
+    }
+}
+
+/**
+ * Call after running each batch of instructions, writes a checkpoint once every emulated second
+ *
+ * @param   instructions    Instructions run so far
+ * @param   chip8           The interpreter
+ **/
+void CHIP8MovieRecorder::update(uint64_t instructions, const CHIP8Interpreter &chip8) {
+    if(file == NULL || instructions - last_checkpoint < cpu_frequency) {
+        return;
+    }
+    record(instructions, MOVIE_TAG_CHECKPOINT);
+    uint8_t hash[8];
+    put64(hash, chip8.displayHash());
+    failed |= fwrite(hash, 1, sizeof(hash), file) != sizeof(hash);
+    last_checkpoint = instructions;
+}
+
+/**
+ * Ends the movie
+ *
+ * @param   instructions    Instructions run so far
+ * @return                  false if anything could not be written
+ **/
+bool CHIP8MovieRecorder::close(uint64_t instructions) {
+    if(file == NULL) {
+        return false;
+    }
+    record(instructions, MOVIE_TAG_END);
+    bool written = !failed;
+    written &= fclose(file) == 0;
+    file = NULL;
+    return written;
+}
+
+/**
+ * Writes the instructions since the previous record and a tag
+ **/
+void CHIP8MovieRecorder::record(uint64_t instructions, uint8_t tag) {
+    uint64_t delta = instructions - last;
+    last = instructions;
+
+    uint8_t bytes[11];
+    int count = 0;
+    do {
+        bytes[count] = delta & 0x7F;
+        delta >>= 7;
+        if(delta != 0) {
+            bytes[count] |= 0x80;
+        }
+        count++;
+    } while(delta != 0);
+    bytes[count++] = tag;
+    failed |= fwrite(bytes, 1, count, file) != (size_t)count;
+}
+
+// ==================================================================================================
+// Player
+// ==================================================================================================
+CHIP8MoviePlayer::CHIP8MoviePlayer() {
+    file = NULL;
+    platform = CHIP8_PLATFORM_CHIP8;
+    cpu_frequency = 0;
+    seed = 0;
+    rom_hash = 0;
+}
+
+CHIP8MoviePlayer::~CHIP8MoviePlayer() {
+    if(file != NULL) {
+        fclose(file);
+    }
+}
+
+/**
+ * Opens a movie and reads its header
+ *
+ * @param   filename    The movie
+ * @return              false if it can't be read or isn't a movie this version understands
+ **/
+bool CHIP8MoviePlayer::open(const char *filename) {
+    if(file != NULL) {
+        fclose(file);
+    }
+    file = fopen(filename, "rb");
+    if(file == NULL) {
+        return false;
+    }
+
+    uint8_t header[MOVIE_HEADER_SIZE];
+    if(fread(header, 1, sizeof(header), file) != sizeof(header) || memcmp(header, movie_magic, sizeof(movie_magic)) != 0 ||
+       header[4] != CHIP8_MOVIE_VERSION || header[5] >= CHIP8_PLATFORM_COUNT) {
+        fclose(file);
+        file = NULL;
+        return false;
+    }
+    platform = (CHIP8Platform)header[5];
+    cpu_frequency = get32(&header[8]);
+    seed = get64(&header[12]);
+    rom_hash = get64(&header[20]);
+    return cpu_frequency != 0;
+}
+
+/**
+ * Replays the movie as fast as possible. The interpreter must be set up the way the
+ * movie was recorded: setPlatform(getPlatform()), seed(getSeed()) then loadRom() with
+ * the ROM whose hash is getRomHash().
+ *
+ * @param   chip8   The interpreter to replay on
+ * @param   result  Receives what the replay found
+ * @param   frame   Called after every timer tick, NULL for none
+ * @param   user    Passed on to frame
+ * @return          false if the interpreter isn't set up for this movie
+ **/
+bool CHIP8MoviePlayer::play(CHIP8Interpreter &chip8, CHIP8MovieResult &result, CHIP8MovieFrameCallback frame, void *user) {
+    memset(&result, 0, sizeof(result));
+    if(file == NULL || chip8.getPlatform() != platform || chip8.getSeed() != seed || chip8.romHash() != rom_hash) {
+        return false;
+    }
+
+    chip8.setKeys(0);
+    CHIP8Scheduler scheduler(1, cpu_frequency);
+    // The scheduler ticks the timers right after instruction ceil(N * cpu_frequency / 60)
+    uint64_t ticks = 1;
+    uint64_t next_tick = (cpu_frequency + CHIP8_TIMER_FREQUENCY - 1) / CHIP8_TIMER_FREQUENCY;
+
+    uint64_t delta;
+    int tag;
+    while(readRecord(delta, tag)) {
+        // Scheduler::run takes an int, long gaps are run in pieces. With a frame callback
+        // the pieces end at the timer ticks.
+        uint64_t target = result.instructions + delta;
+        while(scheduler.getInstructions() < target) {
+            uint64_t end = (frame != NULL && next_tick < target) ? next_tick : target;
+            uint64_t left = end - scheduler.getInstructions();
+            scheduler.run(chip8, (left > 0x40000000) ? 0x40000000 : (int)left);
+            if(frame != NULL && scheduler.getInstructions() == next_tick) {
+                frame(chip8, user);
+                ticks++;
+                next_tick = (ticks * cpu_frequency + CHIP8_TIMER_FREQUENCY - 1) / CHIP8_TIMER_FREQUENCY;
+            }
+        }
+        result.instructions += delta;
+
+        if(tag < MOVIE_TAG_CHECKPOINT) {
+            chip8.setKey(tag & 0xF, (tag & MOVIE_TAG_PRESSED) != 0);
+            result.events++;
+        } else if(tag == MOVIE_TAG_CHECKPOINT) {
+            uint8_t hash[8];
+            if(fread(hash, 1, sizeof(hash), file) != sizeof(hash)) {
+                break;
+            }
+            if(get64(hash) != chip8.displayHash()) {
+                if(result.mismatches == 0) {
+                    result.first_mismatch = result.instructions;
+                }
+                result.mismatches++;
+            }
+            result.checkpoints++;
+        } else if(tag == MOVIE_TAG_END) {
+            result.complete = true;
+            break;
+        } else {
+            break;
+        }
+    }
+    return true;
+}
+
+/**
+ * Reads the instruction count and tag of the next record
+ *
+ * @return  false at the end of the file
+ **/
+bool CHIP8MoviePlayer::readRecord(uint64_t &delta, int &tag) {
+    delta = 0;
+    for(int shift = 0; ; shift += 7) {
+        int byte = getc(file);
+        if(byte == EOF || shift > 63) {
+            return false;
+        }
+        delta |= (uint64_t)(byte & 0x7F) << shift;
+        if(!(byte & 0x80)) {
+            break;
+        }
+    }
+    tag = getc(file);
+    return tag != EOF;
+}
@@ -0,0 +1,85 @@
+#ifndef CHIP8_MOVIE_H
+#define CHIP8_MOVIE_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "chip8.hpp"
+
+// Version 2 changed the display hash of the checkpoints, version 1 movies are refused
+#define CHIP8_MOVIE_VERSION     2
+
+/**
+ * Writes a movie: every change of the keypad, stamped with the number of instructions
+ * run before it was applied, so the session can be replayed exactly. The random seed,
+ * platform, CPU frequency and a hash of the ROM go in the header. Once every emulated
+ * second the display hash is written as a checkpoint the replay is verified against.
+ *
+ * The instruction counts must come from a CHIP8Scheduler that started with the ROM, the
+ * timer ticks are placed by it and the replay runs one the same way.
+ **/
+class CHIP8MovieRecorder {
+    public:
+        CHIP8MovieRecorder();
+        ~CHIP8MovieRecorder();
+        bool open(const char *filename, const CHIP8Interpreter &chip8, uint32_t cpu_frequency);
+        bool isOpen() const { return file != NULL; }
+        void key(uint64_t instructions, int key, bool down);
+        void update(uint64_t instructions, const CHIP8Interpreter &chip8);
+        bool close(uint64_t instructions);
+
+    private:
+        FILE *file;
+        uint32_t cpu_frequency;
+        uint64_t last;                  // Instruction count of the last record
+        uint64_t last_checkpoint;       // Instruction count of the last checkpoint
+        bool failed;                    // A write failed
+
+        void record(uint64_t instructions, uint8_t tag);
+};
+
+/**
+ * What replaying a movie found
+ **/
+struct CHIP8MovieResult {
+    uint64_t instructions;      // Instructions run
+    uint64_t events;            // Key changes applied
+    uint64_t checkpoints;       // Display hashes compared
+    uint64_t mismatches;        // Display hashes that were different
+    uint64_t first_mismatch;    // Instruction count of the first different one
+    bool complete;              // The movie ended properly, false if it was cut short
+};
+
+/**
+ * Called by CHIP8MoviePlayer::play() at every timer tick, for capturing the replay
+ *
+ * @param   chip8   The interpreter, with the timers just ticked
+ * @param   user    What was passed to play()
+ **/
+typedef void (*CHIP8MovieFrameCallback)(const CHIP8Interpreter &chip8, void *user);
+
+/**
+ * Reads a movie written by CHIP8MovieRecorder and replays it at full speed
+ **/
+class CHIP8MoviePlayer {
+    public:
+        CHIP8MoviePlayer();
+        ~CHIP8MoviePlayer();
+        bool open(const char *filename);
+        CHIP8Platform getPlatform() const { return platform; }
+        uint32_t getCpuFrequency() const { return cpu_frequency; }
+        uint64_t getSeed() const { return seed; }
+        uint64_t getRomHash() const { return rom_hash; }
+        bool play(CHIP8Interpreter &chip8, CHIP8MovieResult &result, CHIP8MovieFrameCallback frame = NULL, void *user = NULL);
+
+    private:
+        FILE *file;
+        CHIP8Platform platform;
+        uint32_t cpu_frequency;
+        uint64_t seed;
+        uint64_t rom_hash;
+
+        bool readRecord(uint64_t &delta, int &tag);
+};
+
+#endif // CHIP8_MOVIE_H
@@ -0,0 +1,56 @@
+#include <string.h>
+
+#include "platform.hpp"
+
+// ==================================================================================================
+// Variables
+// ==================================================================================================
+#define PLATFORM_TEXT(name, text, variant, quirks) text,
+static const char *platform_names[CHIP8_PLATFORM_COUNT] = { CHIP8_PLATFORMS(PLATFORM_TEXT) };
+#undef PLATFORM_TEXT
+
+#define PLATFORM_VARIANT(name, text, variant, quirks) variant,
+static const CHIP8Variant platform_variants[CHIP8_PLATFORM_COUNT] = { CHIP8_PLATFORMS(PLATFORM_VARIANT) };
+#undef PLATFORM_VARIANT
+
+// ==================================================================================================
+// Public Functions
+// ==================================================================================================
+/**
+ * @param   platform    A platform
+ * @return              Its name on the command line, such as "schip"
+ **/
+const char *chip8PlatformName(CHIP8Platform platform) {
+    if(platform < 0 || platform >= CHIP8_PLATFORM_COUNT) {
+        return "unknown";
+    }
+    return platform_names[platform];
+}
+
+/**
+ * Looks a platform up by the name chip8PlatformName() gives it
+ *
+ * @param   name        The name to look up
+ * @param   platform    Receives the platform
+ * @return              false if no platform has that name
+ **/
+bool chip8PlatformFromName(const char *name, CHIP8Platform &platform) {
+    for(int i = 0; i < CHIP8_PLATFORM_COUNT; i++) {
+        if(!strcmp(name, platform_names[i])) {
+            platform = (CHIP8Platform)i;
+            return true;
+        }
+    }
+    return false;
+}
+
+/**
+ * @param   platform    A platform
+ * @return              The instruction set it understands
+ **/
+CHIP8Variant chip8PlatformVariant(CHIP8Platform platform) {
+    if(platform < 0 || platform >= CHIP8_PLATFORM_COUNT) {
+        return CHIP8_VARIANT_CHIP8;
+    }
+    return platform_variants[platform];
+}
@@ -0,0 +1,53 @@
+#ifndef CHIP8_PLATFORM_H
+#define CHIP8_PLATFORM_H
+
+/**
+ * The instruction sets the interpreter understands
+ **/
+enum CHIP8Variant {
+    CHIP8_VARIANT_CHIP8,    // The original instructions: 64x32 display, 4 KB of memory
+    CHIP8_VARIANT_SCHIP,    // SUPER-CHIP 1.1: adds 128x64 high resolution, scrolling, 16x16 sprites and RPL flags
+    CHIP8_VARIANT_XOCHIP    // XO-CHIP: SUPER-CHIP plus 64 KB of memory, two bitplanes and an audio pattern buffer
+};
+
+// Behaviours that differ between interpreters of the same instructions
+#define CHIP8_QUIRK_VF_RESET        0x01    // 8XY1, 8XY2 and 8XY3 clear VF
+#define CHIP8_QUIRK_SHIFT_VX        0x02    // 8XY6 and 8XYE shift VX in place instead of storing VY shifted
+#define CHIP8_QUIRK_FIXED_I         0x04    // FX55 and FX65 leave I unchanged instead of adding X + 1
+#define CHIP8_QUIRK_JUMP_VX         0x08    // BXNN jumps to XNN + VX instead of NNN + V0
+#define CHIP8_QUIRK_WRAP_SPRITES    0x10    // Sprites wrap around the edges of the display instead of being clipped
+#define CHIP8_QUIRK_ADD_I_CARRY     0x20    // FX1E sets VF when I goes past 0xFFF
+
+/**
+ * Every platform the interpreter can emulate, as PLATFORM(name, text, variant, quirks).
+ * The variant and quirks are template parameters of the interpreter loop, so each
+ * platform gets its own copy of it with the differences compiled in. Adding a line here
+ * is all it takes to add a quirk profile.
+ **/
+#define CHIP8_PLATFORMS(PLATFORM) \
+    PLATFORM(CHIP8,  "chip8",  CHIP8_VARIANT_CHIP8,  CHIP8_QUIRK_ADD_I_CARRY) \
+    PLATFORM(COSMAC, "cosmac", CHIP8_VARIANT_CHIP8,  CHIP8_QUIRK_VF_RESET) \
+    PLATFORM(SCHIP,  "schip",  CHIP8_VARIANT_SCHIP,  CHIP8_QUIRK_SHIFT_VX | CHIP8_QUIRK_FIXED_I | CHIP8_QUIRK_JUMP_VX) \
+    PLATFORM(XOCHIP, "xochip", CHIP8_VARIANT_XOCHIP, CHIP8_QUIRK_WRAP_SPRITES)
+
+#define CHIP8_PLATFORM_ENUM(name, text, variant, quirks) CHIP8_PLATFORM_##name,
+/**
+ * A variant together with a set of quirks. CHIP8_PLATFORM_CHIP8 is the behaviour this
+ * interpreter has always had, and the only one the block cache, JIT and recompiled
+ * programs reproduce.
+ **/
+enum CHIP8Platform {
+    CHIP8_PLATFORMS(CHIP8_PLATFORM_ENUM)
+    CHIP8_PLATFORM_COUNT
+};
+#undef CHIP8_PLATFORM_ENUM
+
+// Variant and quirks of CHIP8_PLATFORM_CHIP8, for the engines that only emulate it
+#define CHIP8_CLASSIC_VARIANT   CHIP8_VARIANT_CHIP8
+#define CHIP8_CLASSIC_QUIRKS    CHIP8_QUIRK_ADD_I_CARRY
+
+const char *chip8PlatformName(CHIP8Platform platform);
+bool chip8PlatformFromName(const char *name, CHIP8Platform &platform);
+CHIP8Variant chip8PlatformVariant(CHIP8Platform platform);
+
+#endif // CHIP8_PLATFORM_H
@@ -0,0 +1,137 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "profile.hpp"
+
+// ==================================================================================================
+// Helpers
+// ==================================================================================================
+static double percent(uint64_t count, uint64_t total) {
+    return (total == 0) ? 0.0 : (100.0 * count / total);
+}
+
+// Sorts indices by the counts they refer to, busiest first
+struct ByCount {
+    const uint64_t *counts;
+    bool operator()(uint32_t a, uint32_t b) const {
+        return (counts[a] != counts[b]) ? (counts[a] > counts[b]) : (a < b);
+    }
+};
+
+/**
+ * @return  The indices of the non-zero counts, at most `limit` of them, busiest first
+ **/
+static std::vector<uint32_t> topCounts(const uint64_t *counts, uint32_t length, size_t limit) {
+    std::vector<uint32_t> indices;
+    for(uint32_t i = 0; i < length; i++) {
+        if(counts[i] != 0) {
+            indices.push_back(i);
+        }
+    }
+    ByCount by_count = { counts };
+    if(indices.size() > limit) {
+        std::partial_sort(indices.begin(), indices.begin() + limit, indices.end(), by_count);
+        indices.resize(limit);
+    } else {
+        std::sort(indices.begin(), indices.end(), by_count);
+    }
+    return indices;
+}
+
+// ==================================================================================================
+// Public Functions
+// ==================================================================================================
+CHIP8Profile::CHIP8Profile() {
+    reset();
+}
+
+/**
+ * Clears every counter
+ **/
+void CHIP8Profile::reset() {
+    instructions = 0;
+    memset(opcode_counts, 0, sizeof(opcode_counts));
+    memset(address_hits, 0, sizeof(address_hits));
+    call_depth = 0;
+    max_call_depth = 0;
+    memset(depth_counts, 0, sizeof(depth_counts));
+    frames = 0;
+    frame_draws = 0;
+    memset(draw_counts, 0, sizeof(draw_counts));
+}
+
+/**
+ * Writes a human readable summary of the counters
+ *
+ * @param   out     Where to write the report
+ * @param   memory  The interpreter's memory, used to disassemble the hot addresses
+ **/
+void CHIP8Profile::report(FILE *out, const uint8_t *memory) const {
+    char text[CHIP8_DISASM_MAX];
+
+    fprintf(out, "==== CHIP-8 profile: %llu instructions, %llu frames ====\n",
+        (unsigned long long)instructions, (unsigned long long)frames);
+
+    // Opcode mix by class
+    uint64_t class_counts[CHIP8_OPCODE_CLASSES] = { 0 };
+    for(uint32_t opcode = 0; opcode < 0x10000; opcode++) {
+        class_counts[chip8OpcodeClass(opcode)] += opcode_counts[opcode];
+    }
+    fprintf(out, "\nOpcode mix:\n");
+    std::vector<uint32_t> classes = topCounts(class_counts, CHIP8_OPCODE_CLASSES, CHIP8_OPCODE_CLASSES);
+    for(size_t i = 0; i < classes.size(); i++) {
+        fprintf(out, "  %-8s %14llu  %6.2f%%\n", chip8OpcodeClassName(classes[i]),
+            (unsigned long long)class_counts[classes[i]], percent(class_counts[classes[i]], instructions));
+    }
+
+    // Exact opcodes
+    fprintf(out, "\nTop opcodes:\n");
+    std::vector<uint32_t> opcodes = topCounts(opcode_counts, 0x10000, CHIP8_PROFILE_TOP_ADDRESSES);
+    for(size_t i = 0; i < opcodes.size(); i++) {
+        chip8Disassemble(opcodes[i], text, sizeof(text));
+        fprintf(out, "  %04X  %-20s %14llu  %6.2f%%\n", opcodes[i], text,
+            (unsigned long long)opcode_counts[opcodes[i]], percent(opcode_counts[opcodes[i]], instructions));
+    }
+
+    // Hot spots, disassembled from what is in memory now
+    fprintf(out, "\nHot addresses:\n");
+    std::vector<uint32_t> addresses = topCounts(address_hits, CHIP8_XO_MEMORY_MAX, CHIP8_PROFILE_TOP_ADDRESSES);
+    for(size_t i = 0; i < addresses.size(); i++) {
+        uint16_t address = addresses[i];
+        uint16_t opcode = (memory[address] << 8) | memory[(uint16_t)(address + 1)];
+        chip8Disassemble(opcode, text, sizeof(text));
+        fprintf(out, "  %03X:  %04X  %-20s %14llu  %6.2f%%\n", address, opcode, text,
+            (unsigned long long)address_hits[address], percent(address_hits[address], instructions));
+    }
+
+    // Subroutines
+    fprintf(out, "\nCalls: deepest nesting %d\n", max_call_depth);
+    for(int depth = 1; depth <= CHIP8_PROFILE_MAX_DEPTH; depth++) {
+        if(depth_counts[depth] != 0) {
+            fprintf(out, "  depth %2d%s %14llu\n", depth, (depth == CHIP8_PROFILE_MAX_DEPTH) ? "+" : " ",
+                (unsigned long long)depth_counts[depth]);
+        }
+    }
+
+    // Drawing
+    uint64_t draws = 0;
+    int max_draws = 0;
+    for(int n = 0; n <= CHIP8_PROFILE_MAX_DRAWS; n++) {
+        draws += draw_counts[n] * n;
+        if(draw_counts[n] != 0) {
+            max_draws = n;
+        }
+    }
+    fprintf(out, "\nDraws per frame: %.2f on average, %d%s at most\n", (frames == 0) ? 0.0 : (double)draws / frames,
+        max_draws, (max_draws == CHIP8_PROFILE_MAX_DRAWS) ? "+" : "");
+    for(int n = 0; n <= CHIP8_PROFILE_MAX_DRAWS; n++) {
+        if(draw_counts[n] != 0) {
+            fprintf(out, "  %2d%s draws %14llu frames  %6.2f%%\n", n, (n == CHIP8_PROFILE_MAX_DRAWS) ? "+" : " ",
+                (unsigned long long)draw_counts[n], percent(draw_counts[n], frames));
+        }
+    }
+}
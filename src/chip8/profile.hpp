@@ -0,0 +1,74 @@
+#ifndef CHIP8_PROFILE_H
+#define CHIP8_PROFILE_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "chip8.hpp"
+#include "disasm.hpp"
+
+// Deepest call nesting tracked on its own, deeper calls are counted together
+#define CHIP8_PROFILE_MAX_DEPTH     16
+// Most draws in a frame tracked on its own, busier frames are counted together
+#define CHIP8_PROFILE_MAX_DRAWS     64
+// Number of addresses listed in the report
+#define CHIP8_PROFILE_TOP_ADDRESSES 20
+
+/**
+ * Counters filled in by the interpreter when it is built with CHIP8_PROFILE defined.
+ * Without it the interpreter has no profile and none of the counting code is compiled.
+ *
+ * The counters only cover instructions executed by step(), so a profiling build runs
+ * every engine through the interpreter.
+ **/
+class CHIP8Profile {
+    public:
+        uint64_t instructions;
+        uint64_t opcode_counts[0x10000];                // Executions of each exact opcode, the
+                                                        // report adds them up by class
+        uint64_t address_hits[CHIP8_XO_MEMORY_MAX];     // Instructions fetched from each address
+
+        int call_depth;                                 // Current nesting of 2NNN calls
+        int max_call_depth;
+        uint64_t depth_counts[CHIP8_PROFILE_MAX_DEPTH + 1];  // Calls made at each depth
+
+        uint64_t frames;
+        int frame_draws;                                // DXYN executed in the current frame
+        uint64_t draw_counts[CHIP8_PROFILE_MAX_DRAWS + 1];   // Frames with each number of draws
+
+        CHIP8Profile();
+        void reset();
+        void report(FILE *out, const uint8_t *memory) const;
+
+        inline void instruction(uint16_t address, uint16_t opcode) {
+            instructions++;
+            opcode_counts[opcode]++;
+            address_hits[address]++;
+        }
+
+        inline void call() {
+            call_depth++;
+            if(call_depth > max_call_depth) {
+                max_call_depth = call_depth;
+            }
+            depth_counts[(call_depth < CHIP8_PROFILE_MAX_DEPTH) ? call_depth : CHIP8_PROFILE_MAX_DEPTH]++;
+        }
+
+        inline void ret() {
+            if(call_depth > 0) {
+                call_depth--;
+            }
+        }
+
+        inline void draw() {
+            frame_draws++;
+        }
+
+        inline void frame() {
+            frames++;
+            draw_counts[(frame_draws < CHIP8_PROFILE_MAX_DRAWS) ? frame_draws : CHIP8_PROFILE_MAX_DRAWS]++;
+            frame_draws = 0;
+        }
+};
+
+#endif // CHIP8_PROFILE_H
@@ -0,0 +1,294 @@
+#include <stdint.h>
+#include <string.h>
+
+#include "rewind.hpp"
+
+/**
+ * Encoding of a snapshot. The XOR of two states is a stream of tokens:
+ *
+ *   1xxxxxxx                   literal: the next (x + 1) bytes are copied as they are
+ *   0xxxxxxx, x < 0x7F         run of (x + 1) zero bytes
+ *   01111111 lo hi             run of (lo | hi << 8) zero bytes
+ **/
+#define TOKEN_LITERAL       0x80
+#define TOKEN_LONG_RUN      0x7F
+
+// A snapshot of nothing but zeros, used as the base of keyframes
+static const uint8_t zero_state[CHIP8_STATE_SIZE] = { 0 };
+
+// ==================================================================================================
+// Helpers
+// ==================================================================================================
+/**
+ * @return  How many bytes at the start of a and b are the same, at most limit
+ **/
+static size_t matchingBytes(const uint8_t *a, const uint8_t *b, size_t limit) {
+    // Most of a state is unchanged, skip it a word at a time
+    size_t n = 0;
+    while(n + 8 <= limit) {
+        uint64_t word_a, word_b;
+        memcpy(&word_a, &a[n], 8);
+        memcpy(&word_b, &b[n], 8);
+        if(word_a != word_b) {
+            break;
+        }
+        n += 8;
+    }
+    while(n < limit && a[n] == b[n]) {
+        n++;
+    }
+    return n;
+}
+
+// ==================================================================================================
+// Public Functions
+// ==================================================================================================
+/**
+ * @param   capacity            Bytes of memory used to hold the history
+ * @param   keyframe_interval   Number of snapshots between keyframes
+ **/
+CHIP8Rewind::CHIP8Rewind(size_t capacity, int keyframe_interval) {
+    ring.resize(capacity);
+    encoded.resize(CHIP8_STATE_SIZE * 2);
+    encoded_size = 0;
+    this->keyframe_interval = (keyframe_interval < 1) ? 1 : keyframe_interval;
+    state_size = 0;
+    clear();
+}
+
+/**
+ * Forgets the whole history
+ **/
+void CHIP8Rewind::clear() {
+    records.clear();
+    write_offset = 0;
+    since_keyframe = 0;
+    keyframe_valid = false;
+}
+
+/**
+ * @return  Bytes of the ring buffer taken up by snapshots
+ **/
+size_t CHIP8Rewind::used() const {
+    size_t total = 0;
+    for(size_t i = 0; i < records.size(); i++) {
+        total += records[i].size;
+    }
+    return total;
+}
+
+/**
+ * Records a snapshot of the interpreter, usually once per frame
+ *
+ * @param   chip8   The interpreter to take a snapshot of
+ **/
+void CHIP8Rewind::capture(const CHIP8Interpreter &chip8) {
+    // States of different platforms have different sizes and can't be stored against
+    // each other, a new platform starts a new history
+    size_t size = chip8.saveState(scratch, sizeof(scratch));
+    if(size != state_size) {
+        clear();
+        state_size = size;
+    }
+
+    bool is_keyframe = !keyframe_valid || records.empty() || since_keyframe >= keyframe_interval;
+    if(is_keyframe) {
+        encode(scratch, zero_state);
+    } else {
+        encode(scratch, keyframe);
+    }
+
+    // Making room may drop the keyframe this snapshot is relative to, in that case
+    // the snapshot has to become a keyframe itself
+    if(!store(is_keyframe) && !is_keyframe) {
+        is_keyframe = true;
+        encode(scratch, zero_state);
+        store(true);
+    }
+
+    if(is_keyframe) {
+        memcpy(keyframe, scratch, state_size);
+        keyframe_valid = true;
+        since_keyframe = 0;
+    }
+    since_keyframe++;
+}
+
+/**
+ * Restores the newest snapshot and removes it from the history
+ *
+ * @param   chip8   The interpreter to restore
+ * @return          false if there is no history left
+ **/
+bool CHIP8Rewind::rewind(CHIP8Interpreter &chip8) {
+    if(records.empty()) {
+        return false;
+    }
+
+    Record record = records.back();
+    records.pop_back();
+    write_offset = record.offset;
+
+    if(record.keyframe) {
+        decode(&ring[record.offset], record.size, zero_state, scratch);
+        // The snapshots before this one are relative to the previous keyframe
+        keyframe_valid = decodeKeyframeBefore(records.size());
+    } else {
+        decode(&ring[record.offset], record.size, keyframe, scratch);
+        since_keyframe--;
+    }
+
+    return chip8.loadState(scratch, state_size);
+}
+
+// ==================================================================================================
+// Private Functions
+// ==================================================================================================
+/**
+ * Encodes the XOR of a state and its base into `encoded`
+ **/
+void CHIP8Rewind::encode(const uint8_t *state, const uint8_t *base) {
+    // No token takes more than two bytes per byte it covers, so this always fits
+    uint8_t *out = &encoded[0];
+
+    size_t i = 0;
+    while(i < state_size) {
+        // Run of unchanged bytes
+        size_t run = matchingBytes(&state[i], &base[i], ((state_size - i) < 0xFFFF) ? (state_size - i) : 0xFFFF);
+        if(run > 0) {
+            if(run < TOKEN_LONG_RUN + 1) {
+                *out++ = run - 1;
+            } else {
+                *out++ = TOKEN_LONG_RUN;
+                *out++ = run & 0xFF;
+                *out++ = run >> 8;
+            }
+            i += run;
+            continue;
+        }
+
+        // Changed bytes, up to 128 at a time. Single unchanged bytes are cheaper to
+        // carry along in the literal than to end it for.
+        size_t length = 0;
+        while(i + length < state_size && length < 0x80) {
+            if(state[i + length] == base[i + length] &&
+               (i + length + 1 >= state_size || state[i + length + 1] == base[i + length + 1])) {
+                break;
+            }
+            length++;
+        }
+        *out++ = TOKEN_LITERAL | (length - 1);
+        for(size_t j = 0; j < length; j++) {
+            *out++ = state[i + j] ^ base[i + j];
+        }
+        i += length;
+    }
+    encoded_size = out - &encoded[0];
+}
+
+/**
+ * Rebuilds a state from its encoding and base
+ **/
+void CHIP8Rewind::decode(const uint8_t *data, size_t size, const uint8_t *base, uint8_t *state) const {
+    const uint8_t *end = data + size;
+    size_t i = 0;
+    while(data < end && i < state_size) {
+        uint8_t token = *data++;
+        size_t length;
+        if(token & TOKEN_LITERAL) {
+            length = (token & 0x7F) + 1;
+            for(size_t j = 0; j < length && i < state_size; j++, i++) {
+                state[i] = base[i] ^ *data++;
+            }
+        } else {
+            if(token == TOKEN_LONG_RUN) {
+                length = data[0] | (data[1] << 8);
+                data += 2;
+            } else {
+                length = token + 1;
+            }
+            if(length > state_size - i) {
+                length = state_size - i;
+            }
+            memcpy(&state[i], &base[i], length);
+            i += length;
+        }
+    }
+}
+
+/**
+ * Copies `encoded` into the ring buffer as the newest record, dropping the oldest
+ * keyframes (and their snapshots) until it fits
+ *
+ * @param   is_keyframe     true if the record is a keyframe
+ * @return                  false if the record is a snapshot whose keyframe had to be dropped,
+ *                          nothing is stored in that case
+ **/
+bool CHIP8Rewind::store(bool is_keyframe) {
+    size_t size = encoded_size;
+    if(size > ring.size()) {
+        clear();
+        return is_keyframe;
+    }
+
+    // Wrap around, the records left between here and the end are the oldest ones
+    if(write_offset + size > ring.size()) {
+        while(!records.empty() && records.front().offset >= write_offset) {
+            dropOldestGroup();
+        }
+        write_offset = 0;
+    }
+
+    // Drop whatever the new record would overwrite
+    while(!records.empty()) {
+        const Record &oldest = records.front();
+        bool overlaps = oldest.offset < write_offset + size && write_offset < oldest.offset + oldest.size;
+        if(!overlaps) {
+            break;
+        }
+        dropOldestGroup();
+    }
+
+    if(!is_keyframe && records.empty()) {
+        return false;
+    }
+
+    memcpy(&ring[write_offset], &encoded[0], size);
+    Record record;
+    record.offset = write_offset;
+    record.size = size;
+    record.keyframe = is_keyframe;
+    records.push_back(record);
+    write_offset += size;
+
+    return true;
+}
+
+/**
+ * Drops the oldest keyframe and every snapshot relative to it
+ **/
+void CHIP8Rewind::dropOldestGroup() {
+    records.pop_front();
+    while(!records.empty() && !records.front().keyframe) {
+        records.pop_front();
+    }
+}
+
+/**
+ * Decodes the newest keyframe among the first `index` records into `keyframe`
+ *
+ * @return  false if there is none
+ **/
+bool CHIP8Rewind::decodeKeyframeBefore(size_t index) {
+    since_keyframe = 0;
+    while(index > 0) {
+        index--;
+        since_keyframe++;
+        const Record &record = records[index];
+        if(record.keyframe) {
+            decode(&ring[record.offset], record.size, zero_state, keyframe);
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,62 @@
+#ifndef CHIP8_REWIND_H
+#define CHIP8_REWIND_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <deque>
+#include <vector>
+
+#include "chip8.hpp"
+
+// Default amount of memory used to hold the rewind history
+#define CHIP8_REWIND_DEFAULT_SIZE       (512 * 1024)
+// Default number of snapshots between keyframes
+#define CHIP8_REWIND_DEFAULT_KEYFRAME   60
+
+/**
+ * Keeps a history of save states in a fixed-size ring buffer so the interpreter can be
+ * wound back one frame at a time.
+ *
+ * Every snapshot is XORed against the most recent keyframe and the result, which is
+ * almost entirely zero, is run-length encoded. Keyframes are taken periodically and are
+ * stored the same way against an all-zero state. When the buffer is full the oldest
+ * keyframe is dropped together with the snapshots that depend on it.
+ **/
+class CHIP8Rewind {
+    public:
+        CHIP8Rewind(size_t capacity = CHIP8_REWIND_DEFAULT_SIZE, int keyframe_interval = CHIP8_REWIND_DEFAULT_KEYFRAME);
+        void capture(const CHIP8Interpreter &chip8);
+        bool rewind(CHIP8Interpreter &chip8);
+        void clear();
+        size_t count() const { return records.size(); }
+        size_t used() const;
+
+    private:
+        // Where a snapshot lives in the ring buffer
+        struct Record {
+            size_t offset;
+            size_t size;
+            bool keyframe;
+        };
+
+        std::vector<uint8_t> ring;          // Encoded snapshots
+        std::deque<Record> records;         // Snapshots currently held, oldest first
+        size_t write_offset;                // Where the next snapshot goes
+        int keyframe_interval;
+        int since_keyframe;                 // Snapshots captured since the newest keyframe
+
+        size_t state_size;                  // Size of the states in the history, set by the first capture
+        uint8_t keyframe[CHIP8_STATE_SIZE]; // The state the newest snapshots are relative to
+        bool keyframe_valid;
+        uint8_t scratch[CHIP8_STATE_SIZE];
+        std::vector<uint8_t> encoded;       // Room for the largest encoding, the last one is encoded_size bytes
+        size_t encoded_size;
+
+        void encode(const uint8_t *state, const uint8_t *base);
+        void decode(const uint8_t *data, size_t size, const uint8_t *base, uint8_t *state) const;
+        bool store(bool is_keyframe);
+        void dropOldestGroup();
+        bool decodeKeyframeBefore(size_t index);
+};
+
+#endif // CHIP8_REWIND_H
@@ -0,0 +1,119 @@
+#include <chrono>
+
+#include "runahead.hpp"
+
+// ==================================================================================================
+// Helpers
+// ==================================================================================================
+static uint64_t nowNs() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// ==================================================================================================
+// Public Functions
+// ==================================================================================================
+/**
+ * @param   frames  Frames to run ahead, see setFrames()
+ **/
+CHIP8RunAhead::CHIP8RunAhead(int frames) {
+    pool = NULL;
+    previous = NULL;
+    setFrames(frames);
+    resetStatistics();
+}
+
+CHIP8RunAhead::~CHIP8RunAhead() {
+    if(pool != NULL) {
+        pool->release(previous);
+        delete pool;
+    }
+}
+
+/**
+ * @param   frames  Frames to run ahead, 0 to CHIP8_RUNAHEAD_MAX_FRAMES. One hides the
+ *                  frame most games take to react, more only helps games that wait
+ *                  longer and makes them harder to control.
+ **/
+void CHIP8RunAhead::setFrames(int frames) {
+    if(frames < 0) {
+        frames = 0;
+    } else if(frames > CHIP8_RUNAHEAD_MAX_FRAMES) {
+        frames = CHIP8_RUNAHEAD_MAX_FRAMES;
+    }
+    this->frames = frames;
+}
+
+/**
+ * Publishes the display the interpreter will have some frames from now if the keypad
+ * stays as it is, leaving the interpreter as it was
+ *
+ * @param   chip8       The interpreter, after the real pass
+ * @param   scheduler   The scheduler running it, a copy of it runs the frames ahead so
+ *                      the timers tick where they will
+ * @param   buffer      Where the frame is published
+ * @return              false if nothing was published because no frames are run ahead
+ **/
+bool CHIP8RunAhead::show(CHIP8Interpreter &chip8, const CHIP8Scheduler &scheduler, CHIP8FrameBuffer &buffer) {
+    if(frames == 0) {
+        return false;
+    }
+
+    uint64_t start = nowNs();
+    CHIP8Fork *fork = (pool != NULL) ? pool->fork(chip8, previous) : NULL;
+    if(fork == NULL) {
+        // First pass, or a state of another platform was loaded: the memory size changed
+        if(pool != NULL) {
+            pool->release(previous);
+            delete pool;
+        }
+        pool = new CHIP8ForkPool(chip8.getPlatform());
+        previous = NULL;
+        fork = pool->fork(chip8, NULL);
+    }
+    pool->release(previous);
+    previous = fork;
+
+    uint64_t saved = nowNs();
+    CHIP8Scheduler ahead = scheduler;
+    int cycles = frames * ahead.getCpuFrequency() / CHIP8_TIMER_FREQUENCY;
+    ahead.run(chip8, (cycles < 1) ? 1 : cycles);
+    buffer.publish(chip8);
+
+    uint64_t ran = nowNs();
+    pool->restore(chip8, fork);
+    uint64_t end = nowNs();
+
+    pass_count++;
+    save_ns += (saved - start) + (end - ran);
+    run_ns += ran - saved;
+    return true;
+}
+
+/**
+ * @return  Microseconds spent forking and restoring per pass
+ **/
+double CHIP8RunAhead::averageSaveTime() const {
+    return (pass_count == 0) ? 0.0 : save_ns / 1000.0 / pass_count;
+}
+
+/**
+ * @return  Microseconds spent running the frames ahead per pass
+ **/
+double CHIP8RunAhead::averageRunTime() const {
+    return (pass_count == 0) ? 0.0 : run_ns / 1000.0 / pass_count;
+}
+
+/**
+ * Prints the overhead of running ahead
+ **/
+void CHIP8RunAhead::report(FILE *out) const {
+    fprintf(out, "Run-ahead of %d frame%s: %llu passes, %.1f us per pass (%.2f us save and restore, %.1f us running ahead)\n",
+        frames, (frames == 1) ? "" : "s", (unsigned long long)pass_count, averageSaveTime() + averageRunTime(),
+        averageSaveTime(), averageRunTime());
+}
+
+void CHIP8RunAhead::resetStatistics() {
+    pass_count = 0;
+    save_ns = 0;
+    run_ns = 0;
+}
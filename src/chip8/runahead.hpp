@@ -0,0 +1,52 @@
+#ifndef CHIP8_RUNAHEAD_H
+#define CHIP8_RUNAHEAD_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#include "chip8.hpp"
+#include "fork.hpp"
+#include "framebuffer.hpp"
+#include "scheduler.hpp"
+
+// Most frames that can be run ahead
+#define CHIP8_RUNAHEAD_MAX_FRAMES   8
+
+/**
+ * Hides a few frames of input lag by showing the future. Games read the keypad once a
+ * frame, so a key press only shows up a frame or more after it reached the interpreter.
+ * After every real pass the host calls show(): it forks the interpreter, runs it the
+ * given number of frames further with the keypad as it is now, publishes that frame, and
+ * restores the fork, so the real run carries on as if nothing happened.
+ *
+ * The forks come from a CHIP8ForkPool and share their pages with the fork before them,
+ * so saving and restoring costs little more than comparing memory. Running the frames
+ * ahead is what costs, and it is paid every pass: the time spent on both is kept so the
+ * host can report the overhead. The frames ahead make no sound.
+ **/
+class CHIP8RunAhead {
+    public:
+        CHIP8RunAhead(int frames = 1);
+        ~CHIP8RunAhead();
+        void setFrames(int frames);
+        int getFrames() const { return frames; }
+        bool show(CHIP8Interpreter &chip8, const CHIP8Scheduler &scheduler, CHIP8FrameBuffer &buffer);
+
+        // ======================================== Statistics ========================================
+        uint64_t passes() const { return pass_count; }
+        double averageSaveTime() const;
+        double averageRunTime() const;
+        void report(FILE *out) const;
+        void resetStatistics();
+
+    private:
+        int frames;                         // Frames run ahead, 0 shows the real frame
+        CHIP8ForkPool *pool;                // Made for the platform of the interpreter
+        CHIP8Fork *previous;                // The last fork taken, pages are shared with it
+
+        uint64_t pass_count;
+        uint64_t save_ns;                   // Forking and restoring
+        uint64_t run_ns;                    // Running the frames ahead
+};
+
+#endif // CHIP8_RUNAHEAD_H
@@ -0,0 +1,293 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "chip8.hpp"
+
+/**
+ * Save state format. All values are little-endian.
+ *
+ *   offset  size    field
+ *   0       4       magic "C8ST"
+ *   4       2       version (CHIP8_STATE_VERSION)
+ *   6       2       pc
+ *   8       2       I
+ *   10      2       sp
+ *   12      2       opcode
+ *   14      2       reserved (0)
+ *   16      16      V0-VF
+ *   32      32      stack (16 x 16-bit)
+ *   64      1       delay timer
+ *   65      1       sound timer
+ *   66      1       draw flag
+ *   67      4096    memory
+ *   4163    256     display (32 rows x 64-bit, the first word of the first plane)
+ *   4419    8       random number generator state (version 2 and up)
+ *   4427    1       platform (version 3 and up)
+ *   4428    1       high resolution flag
+ *   4429    1       selected planes
+ *   4430    1       audio pitch
+ *   4431    16      RPL user flags
+ *   4447    16      audio pattern
+ *   4463    2048    whole display (2 planes x 64 rows x 2 x 64-bit), SUPER-CHIP and XO-CHIP only
+ *   6511    61440   memory from 0x1000 to 0xFFFF, XO-CHIP only
+ *
+ * The keypad is not saved, it belongs to whoever is providing the input. Version 1 and 2
+ * states are still accepted as CHIP8_PLATFORM_CHIP8 states, loading a version 1 state
+ * restarts the random number generator from its seed.
+ **/
+
+static const uint8_t state_magic[4] = { 'C', '8', 'S', 'T' };
+
+// ==================================================================================================
+// Helpers
+// ==================================================================================================
+static void put16(uint8_t *&out, uint16_t value) {
+    *out++ = value & 0xFF;
+    *out++ = value >> 8;
+}
+
+static uint16_t get16(const uint8_t *&in) {
+    uint16_t value = in[0] | (in[1] << 8);
+    in += 2;
+    return value;
+}
+
+static void put64(uint8_t *&out, uint64_t value) {
+    for(int b = 0; b < 8; b++) {
+        *out++ = (value >> (8 * b)) & 0xFF;
+    }
+}
+
+static uint64_t get64(const uint8_t *&in) {
+    uint64_t value = 0;
+    for(int b = 0; b < 8; b++) {
+        value |= (uint64_t)*in++ << (8 * b);
+    }
+    return value;
+}
+
+/**
+ * @return  The size of a version 3 state of the given platform
+ **/
+static size_t platformStateSize(CHIP8Platform platform) {
+    switch(chip8PlatformVariant(platform)) {
+        case CHIP8_VARIANT_SCHIP:   return CHIP8_STATE_SIZE_HIRES;
+        case CHIP8_VARIANT_XOCHIP:  return CHIP8_STATE_SIZE;
+        default:                    return CHIP8_STATE_SIZE_BASE;
+    }
+}
+
+// ==================================================================================================
+// Public Functions
+// ==================================================================================================
+/**
+ * @return  The number of bytes saveState() writes for the current platform, at most
+ *          CHIP8_STATE_SIZE
+ **/
+size_t CHIP8Interpreter::stateSize() const {
+    return platformStateSize(platform);
+}
+
+/**
+ * Serializes the machine state into a buffer
+ *
+ * @param   buffer  Where to write the state
+ * @param   size    The size of the buffer, at least stateSize() (CHIP8_STATE_SIZE is always enough)
+ * @return          The number of bytes written, 0 if the buffer is too small
+ **/
+size_t CHIP8Interpreter::saveState(uint8_t *buffer, size_t size) const {
+    if(size < stateSize()) {
+        return 0;
+    }
+    CHIP8Variant variant = chip8PlatformVariant(platform);
+
+    uint8_t *out = buffer;
+    memcpy(out, state_magic, sizeof(state_magic));
+    out += sizeof(state_magic);
+    put16(out, CHIP8_STATE_VERSION);
+    put16(out, pc);
+    put16(out, I);
+    put16(out, sp);
+    put16(out, opcode);
+    put16(out, 0);
+
+    memcpy(out, V, sizeof(V));
+    out += sizeof(V);
+    for(int i = 0; i < 16; i++) {
+        put16(out, stack[i]);
+    }
+
+    *out++ = timer_delay;
+    *out++ = timer_sound;
+    *out++ = draw_flag ? 1 : 0;
+
+    memcpy(out, memory, CHIP8_MEMORY_MAX);
+    out += CHIP8_MEMORY_MAX;
+
+    for(int y = 0; y < CHIP8_SCREEN_HEIGHT; y++) {
+        put64(out, display[0][y][0]);
+    }
+
+    put64(out, rng_state);
+
+    *out++ = platform;
+    *out++ = hires ? 1 : 0;
+    *out++ = planes;
+    *out++ = pitch;
+    memcpy(out, rpl, sizeof(rpl));
+    out += sizeof(rpl);
+    memcpy(out, audio_pattern, sizeof(audio_pattern));
+    out += sizeof(audio_pattern);
+
+    if(variant != CHIP8_VARIANT_CHIP8) {
+        for(int plane = 0; plane < CHIP8_PLANES; plane++) {
+            for(int y = 0; y < CHIP8_HIRES_HEIGHT; y++) {
+                put64(out, display[plane][y][0]);
+                put64(out, display[plane][y][1]);
+            }
+        }
+    }
+    if(variant == CHIP8_VARIANT_XOCHIP) {
+        memcpy(out, &memory[CHIP8_MEMORY_MAX], CHIP8_XO_MEMORY_MAX - CHIP8_MEMORY_MAX);
+        out += CHIP8_XO_MEMORY_MAX - CHIP8_MEMORY_MAX;
+    }
+
+    return out - buffer;
+}
+
+/**
+ * Restores the machine state from a buffer written by saveState(). Nothing is changed
+ * if the buffer doesn't hold a valid state.
+ *
+ * @param   buffer  The saved state
+ * @param   size    The size of the saved state
+ * @return          true if the state was restored
+ **/
+bool CHIP8Interpreter::loadState(const uint8_t *buffer, size_t size) {
+    if(size < CHIP8_STATE_SIZE_V1 || memcmp(buffer, state_magic, sizeof(state_magic)) != 0) {
+        return false;
+    }
+
+    const uint8_t *in = buffer + sizeof(state_magic);
+    uint16_t version = get16(in);
+    if(version < 1 || version > CHIP8_STATE_VERSION || (version >= 2 && size < CHIP8_STATE_SIZE_V2)) {
+        return false;
+    }
+
+    // Older versions only had the one platform
+    CHIP8Platform saved_platform = CHIP8_PLATFORM_CHIP8;
+    if(version >= 3) {
+        if(size < CHIP8_STATE_SIZE_BASE || buffer[CHIP8_STATE_SIZE_V2] >= CHIP8_PLATFORM_COUNT) {
+            return false;
+        }
+        saved_platform = (CHIP8Platform)buffer[CHIP8_STATE_SIZE_V2];
+        if(size < platformStateSize(saved_platform)) {
+            return false;
+        }
+    }
+    applyPlatform(saved_platform);
+    CHIP8Variant variant = chip8PlatformVariant(platform);
+
+    pc = get16(in);
+    I = get16(in);
+    sp = get16(in) & 0xF;
+    opcode = get16(in);
+    in += 2;
+
+    memcpy(V, in, sizeof(V));
+    in += sizeof(V);
+    for(int i = 0; i < 16; i++) {
+        stack[i] = get16(in);
+    }
+
+    timer_delay = *in++;
+    timer_sound = *in++;
+    draw_flag = *in++;
+
+    memset(memory, 0, memorySize());
+    memcpy(memory, in, CHIP8_MEMORY_MAX);
+    in += CHIP8_MEMORY_MAX;
+
+    clearDisplay();
+    for(int y = 0; y < CHIP8_SCREEN_HEIGHT; y++) {
+        display[0][y][0] = get64(in);
+    }
+
+    // A zero state would make the generator return nothing but zeros
+    rng_state = (version >= 2) ? get64(in) : 0;
+    if(rng_state == 0) {
+        seed(rng_seed);
+    }
+
+    hires = false;
+    planes = 1;
+    pitch = 64;
+    memset(rpl, 0, sizeof(rpl));
+    memset(audio_pattern, 0, sizeof(audio_pattern));
+    if(version >= 3) {
+        in++;
+        hires = *in++ != 0;
+        planes = *in++ & 0x3;
+        pitch = *in++;
+        memcpy(rpl, in, sizeof(rpl));
+        in += sizeof(rpl);
+        memcpy(audio_pattern, in, sizeof(audio_pattern));
+        in += sizeof(audio_pattern);
+
+        if(variant != CHIP8_VARIANT_CHIP8) {
+            for(int plane = 0; plane < CHIP8_PLANES; plane++) {
+                for(int y = 0; y < CHIP8_HIRES_HEIGHT; y++) {
+                    display[plane][y][0] = get64(in);
+                    display[plane][y][1] = get64(in);
+                }
+            }
+        }
+        if(variant == CHIP8_VARIANT_XOCHIP) {
+            memcpy(&memory[CHIP8_MEMORY_MAX], in, CHIP8_XO_MEMORY_MAX - CHIP8_MEMORY_MAX);
+            in += CHIP8_XO_MEMORY_MAX - CHIP8_MEMORY_MAX;
+        }
+    }
+
+    // Memory was replaced behind the engine's back
+    invalidateCode();
+
+    return true;
+}
+
+/**
+ * Writes the machine state to a file
+ *
+ * @param   filename    The file to write
+ * @return              true if the whole state was written
+ **/
+bool CHIP8Interpreter::saveStateFile(const char *filename) const {
+    uint8_t buffer[CHIP8_STATE_SIZE];
+    size_t size = saveState(buffer, sizeof(buffer));
+
+    FILE *file = fopen(filename, "wb");
+    if(file == NULL) {
+        return false;
+    }
+    bool written = fwrite(buffer, 1, size, file) == size;
+    return (fclose(file) == 0) && written;
+}
+
+/**
+ * Restores the machine state from a file written by saveStateFile()
+ *
+ * @param   filename    The file to read
+ * @return              true if the state was restored
+ **/
+bool CHIP8Interpreter::loadStateFile(const char *filename) {
+    uint8_t buffer[CHIP8_STATE_SIZE];
+
+    FILE *file = fopen(filename, "rb");
+    if(file == NULL) {
+        return false;
+    }
+    size_t size = fread(buffer, 1, sizeof(buffer), file);
+    fclose(file);
+
+    return loadState(buffer, size);
+}
@@ -0,0 +1,88 @@
+#include <stdint.h>
+
+#include "scheduler.hpp"
+
+// ==================================================================================================
+// Public Functions
+// ==================================================================================================
+/**
+ * @param   counter_frequency   Ticks per second of the clock passed to restart() and due()
+ * @param   cpu_frequency       Instructions to run per second
+ **/
+CHIP8Scheduler::CHIP8Scheduler(uint64_t counter_frequency, uint32_t cpu_frequency) {
+    this->counter_frequency = (counter_frequency == 0) ? 1 : counter_frequency;
+    this->cpu_frequency = 1;
+    last = 0;
+    timer_phase = 0;
+    instructions = 0;
+    setCpuFrequency(cpu_frequency);
+}
+
+/**
+ * Changes the CPU speed. The timers keep running at 60 Hz.
+ *
+ * @param   cpu_frequency   Instructions to run per second
+ **/
+void CHIP8Scheduler::setCpuFrequency(uint32_t cpu_frequency) {
+    if(cpu_frequency == 0) {
+        cpu_frequency = 1;
+    }
+    // Keep the same fraction of the way to the next timer tick
+    timer_phase = (uint64_t)timer_phase * cpu_frequency / this->cpu_frequency;
+    this->cpu_frequency = cpu_frequency;
+    cycle_fraction = 0;
+}
+
+/**
+ * Forgets any time owed, for when the program was paused or ran at some other speed
+ *
+ * @param   now     The current clock value
+ **/
+void CHIP8Scheduler::restart(uint64_t now) {
+    last = now;
+    cycle_fraction = 0;
+}
+
+/**
+ * @param   now     The current clock value
+ * @return          The number of instructions due since the last call
+ **/
+int CHIP8Scheduler::due(uint64_t now) {
+    uint64_t elapsed = now - last;
+    last = now;
+    if(elapsed > counter_frequency / CHIP8_SCHEDULER_MAX_CATCHUP) {
+        elapsed = counter_frequency / CHIP8_SCHEDULER_MAX_CATCHUP;
+    }
+
+    uint64_t owed = cycle_fraction + elapsed * cpu_frequency;
+    cycle_fraction = owed % counter_frequency;
+    return owed / counter_frequency;
+}
+
+/**
+ * Runs instructions and ticks the timers every 1/60th of a second of emulated time
+ *
+ * @param   chip8   The interpreter to run
+ * @param   cycles  The number of instructions to run
+ * @return          What the program is waiting for afterwards, see CHIP8Interpreter::idleStatus()
+ **/
+CHIP8Status CHIP8Scheduler::run(CHIP8Interpreter &chip8, int cycles) {
+    CHIP8Status status = chip8.idleStatus();
+    while(cycles > 0) {
+        // Instructions until the next tick, rounded up
+        uint32_t until_tick = (cpu_frequency - timer_phase + CHIP8_TIMER_FREQUENCY - 1) / CHIP8_TIMER_FREQUENCY;
+        int slice = (cycles < (int)until_tick) ? cycles : (int)until_tick;
+
+        status = chip8.run(slice);
+        cycles -= slice;
+        instructions += slice;
+
+        timer_phase += slice * CHIP8_TIMER_FREQUENCY;
+        while(timer_phase >= cpu_frequency) {
+            timer_phase -= cpu_frequency;
+            chip8.timerUpdate();
+            status = chip8.idleStatus();
+        }
+    }
+    return status;
+}
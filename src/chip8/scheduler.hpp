@@ -0,0 +1,41 @@
+#ifndef CHIP8_SCHEDULER_H
+#define CHIP8_SCHEDULER_H
+
+#include <stdint.h>
+
+#include "chip8.hpp"
+
+// Rate of the delay and sound timers
+#define CHIP8_TIMER_FREQUENCY       60
+// Most time made up for at once after a stall (1/4 of a second), the rest is dropped
+#define CHIP8_SCHEDULER_MAX_CATCHUP 4
+
+/**
+ * Works out how many instructions are due from a high resolution clock and runs them
+ * with the timers ticking at exactly 60 Hz of emulated time.
+ *
+ * Fractions of an instruction are carried over between calls, so over time the CPU runs
+ * at exactly the configured frequency no matter how often the host asks. Timer ticks
+ * are placed between the instructions they fall between, independent of the host's
+ * frame rate.
+ **/
+class CHIP8Scheduler {
+    public:
+        CHIP8Scheduler(uint64_t counter_frequency, uint32_t cpu_frequency);
+        void setCpuFrequency(uint32_t cpu_frequency);
+        uint32_t getCpuFrequency() const { return cpu_frequency; }
+        uint64_t getInstructions() const { return instructions; }
+        void restart(uint64_t now);
+        int due(uint64_t now);
+        CHIP8Status run(CHIP8Interpreter &chip8, int cycles);
+
+    private:
+        uint64_t counter_frequency;     // Clock ticks per second
+        uint32_t cpu_frequency;         // Instructions per second
+        uint64_t last;                  // Clock value at the last call to due()
+        uint64_t cycle_fraction;        // Part of an instruction owed, in 1 / counter_frequency
+        uint32_t timer_phase;           // Emulated time since the last timer tick, in 1 / (60 * cpu_frequency) s
+        uint64_t instructions;          // Instructions run so far
+};
+
+#endif // CHIP8_SCHEDULER_H
@@ -0,0 +1,119 @@
+#include <math.h>
+#include <string.h>
+
+#include "sound.hpp"
+
+// ==================================================================================================
+// Variables
+// ==================================================================================================
+// Half a loop on and half off, CHIP8_SOUND_BEEP_FREQUENCY loops per second make the beep
+static const uint8_t beep_pattern[CHIP8_SOUND_PATTERN_BITS / 8] = {
+    0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00
+};
+
+// Most samples owed at once, anything beyond a quarter of a second (after turbo) is dropped
+#define SOUND_MAX_OWED_DIVISOR  4
+
+// ==================================================================================================
+// Public Functions
+// ==================================================================================================
+/**
+ * @param   sample_rate     Samples per second the output plays at
+ * @param   cpu_frequency   Instructions the interpreter runs per second
+ **/
+CHIP8Sound::CHIP8Sound(uint32_t sample_rate, uint32_t cpu_frequency) {
+    this->sample_rate = (sample_rate == 0) ? 1 : sample_rate;
+    this->cpu_frequency = 1;
+    owed = 0;
+    phase = 0;
+    rate_pitch = -2;
+    rate_step = 0;
+    setCpuFrequency(cpu_frequency);
+}
+
+/**
+ * @param   cpu_frequency   Instructions the interpreter runs per second
+ **/
+void CHIP8Sound::setCpuFrequency(uint32_t cpu_frequency) {
+    this->cpu_frequency = (cpu_frequency == 0) ? 1 : cpu_frequency;
+    sample_fraction = 0;
+}
+
+/**
+ * Adds the samples that many instructions' worth of emulated time takes
+ *
+ * @param   instructions    Instructions the interpreter ran since the last call
+ **/
+void CHIP8Sound::advance(int instructions) {
+    uint64_t total = sample_fraction + (uint64_t)instructions * sample_rate;
+    sample_fraction = total % cpu_frequency;
+    owed += total / cpu_frequency;
+
+    uint64_t max_owed = sample_rate / SOUND_MAX_OWED_DIVISOR;
+    if(owed > max_owed) {
+        owed = max_owed;
+    }
+}
+
+/**
+ * Produces owed samples from the sound state the interpreter is in now
+ *
+ * @param   chip8   The interpreter whose sound timer and audio pattern to play
+ * @param   samples Receives the samples
+ * @param   count   Most samples to produce
+ * @return          Number of samples produced, 0 once nothing is owed
+ **/
+int CHIP8Sound::generate(const CHIP8Interpreter &chip8, int16_t *samples, int count) {
+    if((uint64_t)count > owed) {
+        count = (int)owed;
+    }
+    owed -= count;
+
+    if(!chip8.soundOn()) {
+        // Every beep starts at the beginning of the pattern
+        phase = 0;
+        memset(samples, 0, count * sizeof(int16_t));
+        return count;
+    }
+
+    // XO-CHIP programs play their pattern once they loaded one
+    const uint8_t *pattern = beep_pattern;
+    int pitch = -1;
+    if(chip8PlatformVariant(chip8.getPlatform()) == CHIP8_VARIANT_XOCHIP) {
+        const uint8_t *loaded = chip8.audioPattern();
+        for(int i=0; i<CHIP8_SOUND_PATTERN_BITS / 8; i++) {
+            if(loaded[i] != 0) {
+                pattern = loaded;
+                pitch = chip8.getPitch();
+                break;
+            }
+        }
+    }
+    if(pitch != rate_pitch) {
+        setRate(pitch);
+    }
+
+    for(int i=0; i<count; i++) {
+        uint32_t bit = (uint32_t)(phase >> 32) & (CHIP8_SOUND_PATTERN_BITS - 1);
+        samples[i] = ((pattern[bit >> 3] >> (7 - (bit & 7))) & 1) ? CHIP8_SOUND_VOLUME : -CHIP8_SOUND_VOLUME;
+        phase += rate_step;
+    }
+    return count;
+}
+
+// ==================================================================================================
+// Private Functions
+// ==================================================================================================
+/**
+ * Works out how far through the pattern each sample moves
+ *
+ * @param   pitch   FX3A pitch of the XO-CHIP pattern, -1 for the beep
+ **/
+void CHIP8Sound::setRate(int pitch) {
+    // The beep plays its pattern CHIP8_SOUND_BEEP_FREQUENCY times a second, XO-CHIP
+    // patterns play at 4000 * 2 ^ ((pitch - 64) / 48) bits per second
+    double bits_per_second = (pitch < 0) ? (double)CHIP8_SOUND_BEEP_FREQUENCY * CHIP8_SOUND_PATTERN_BITS :
+        4000.0 * pow(2.0, (pitch - 64) / 48.0);
+    rate_step = (uint64_t)(bits_per_second * 4294967296.0 / sample_rate);
+    rate_pitch = pitch;
+}
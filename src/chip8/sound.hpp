@@ -0,0 +1,48 @@
+#ifndef CHIP8_SOUND_H
+#define CHIP8_SOUND_H
+
+#include <stdint.h>
+
+#include "chip8.hpp"
+
+// Pitch of the square wave the platforms without an audio pattern beep with (Hz)
+#define CHIP8_SOUND_BEEP_FREQUENCY  440
+// Amplitude of the samples
+#define CHIP8_SOUND_VOLUME          4000
+// Bits in the XO-CHIP audio pattern, played as one loop
+#define CHIP8_SOUND_PATTERN_BITS    128
+
+/**
+ * Turns the sound timer into samples (16-bit signed mono), in step with the instructions
+ * the interpreter ran.
+ *
+ * The host tells it how many instructions ran with advance(), which works out how many
+ * samples that much emulated time is worth, and then takes them with generate(). They
+ * hold the tone while the sound timer is running and silence otherwise, so running the
+ * interpreter in small slices places the start and end of each beep as close to the
+ * instruction that caused it as the slices are long. XO-CHIP plays its audio pattern at
+ * the rate set by FX3A, everything else (and XO-CHIP before a pattern is loaded) a
+ * square wave at CHIP8_SOUND_BEEP_FREQUENCY.
+ **/
+class CHIP8Sound {
+    public:
+        CHIP8Sound(uint32_t sample_rate, uint32_t cpu_frequency);
+        void setCpuFrequency(uint32_t cpu_frequency);
+        uint32_t getSampleRate() const { return sample_rate; }
+        void advance(int instructions);
+        int generate(const CHIP8Interpreter &chip8, int16_t *samples, int count);
+        uint64_t pending() const { return owed; }
+
+    private:
+        uint32_t sample_rate;       // Samples per second
+        uint32_t cpu_frequency;     // Instructions per second
+        uint64_t sample_fraction;   // Part of a sample owed, in 1 / cpu_frequency
+        uint64_t owed;              // Whole samples owed
+        uint64_t phase;             // Position in the pattern, in 1 / 2^32 bits
+        int rate_pitch;             // Pitch rate_step was worked out for, -1 for the beep
+        uint64_t rate_step;         // Pattern bits per sample, in 1 / 2^32 bits
+
+        void setRate(int pitch);
+};
+
+#endif // CHIP8_SOUND_H
@@ -0,0 +1,370 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "chip8.hpp"
+#include "debugger.hpp"
+
+/**
+ * Terminal debugger. Loads a ROM and reads commands from stdin, one per line, so it can
+ * be driven by hand or by a script piped in. Time is kept in frames like the front end
+ * does: the timers tick every cycles-per-frame instructions, however the program is
+ * stopped and resumed in between. Only depends on the CHIP-8 core.
+ **/
+
+// ==================================================================================================
+// Variables
+// ==================================================================================================
+// Longest command line read
+#define LINE_MAX_LENGTH     256
+
+// Frames `continue` runs for when it isn't told how many, a minute of emulated time
+#define CONTINUE_FRAMES     3600
+
+// The interpreter being debugged and where it is in the current frame
+struct DebugSession {
+    CHIP8Interpreter *chip8;
+    CHIP8Debugger *debugger;
+    int cycles_per_frame;
+    int frame_cycles;           // Instructions executed so far in the current frame
+    uint64_t frames;            // Frames completed
+};
+
+// ==================================================================================================
+// Helpers
+// ==================================================================================================
+/**
+ * Prints the command line usage of the debugger
+ **/
+static void printUsage(const char *name) {
+    printf("Usage: %s [options] <rom>\n", name);
+    printf("  -z, --hz N        CPU frequency, used to tick the timers at 60 Hz (default 500)\n");
+    printf("  -e, --engine E    Engine run with while nothing is armed: interpreter (default),\n");
+    printf("                    cached or jit\n");
+    printf("  -p, --platform P  Platform: chip8 (default), cosmac, schip or xochip\n");
+    printf("  -s, --seed N      Seed for the CXNN random numbers (default: fixed)\n");
+    printf("  -b, --break A     Set a breakpoint at address A before starting\n");
+}
+
+/**
+ * Prints the commands
+ **/
+static void printCommands() {
+    printf("Addresses, keys and values are hex, counts are decimal\n");
+    printf("  b ADDR            Set a breakpoint\n");
+    printf("  d [ADDR]          Delete a breakpoint, or all of them\n");
+    printf("  w ADDR [LEN]      Stop when LEN bytes (default 1) of memory change\n");
+    printf("  w VX | w I        Stop when a register changes\n");
+    printf("  u N               Delete watchpoint N\n");
+    printf("  i                 List breakpoints and watchpoints\n");
+    printf("  s [N]             Step N instructions (default 1)\n");
+    printf("  n                 Step over: like s, but runs a call (2NNN) until it returns\n");
+    printf("  c [FRAMES]        Continue until something stops the program (at most %d frames)\n", CONTINUE_FRAMES);
+    printf("  r                 Show the registers, timers and keys\n");
+    printf("  t                 Show the stack\n");
+    printf("  l [ADDR] [N]      Disassemble N instructions (default 10) from ADDR (default PC)\n");
+    printf("  x ADDR [LEN]      Show LEN bytes (default 64) of memory\n");
+    printf("  p                 Show the display\n");
+    printf("  k KEY 0|1         Release or press a key (0-F)\n");
+    printf("  q                 Quit\n");
+}
+
+/**
+ * @param   text    A number, hex by default (0x is optional)
+ * @param   value   Receives it
+ * @return          false if the text isn't a number
+ **/
+static bool parseNumber(const char *text, unsigned long &value) {
+    if(text == NULL) {
+        return false;
+    }
+    char *end;
+    value = strtoul(text, &end, 16);
+    return end != text && *end == '\0';
+}
+
+/**
+ * @param   text    A count in decimal, may be NULL
+ * @param   value   What to use when the text is missing or isn't a positive number
+ * @return          The count
+ **/
+static int parseCount(const char *text, int value) {
+    int count = (text != NULL) ? atoi(text) : 0;
+    return (count > 0) ? count : value;
+}
+
+/**
+ * @param   text    V0 to VF or I, in either case
+ * @return          The register number for CHIP8Debugger::watchRegister(), -1 if it isn't one
+ **/
+static int parseRegister(const char *text) {
+    if((text[0] == 'I' || text[0] == 'i') && text[1] == '\0') {
+        return CHIP8_DEBUG_REGISTER_I;
+    }
+    unsigned long reg;
+    if((text[0] == 'V' || text[0] == 'v') && strlen(text) == 2 && parseNumber(text + 1, reg)) {
+        return reg;
+    }
+    return -1;
+}
+
+/**
+ * Counts executed instructions towards the current frame, ticking the timers at the end
+ * of each
+ **/
+static void advanceFrame(DebugSession &session, int cycles) {
+    session.frame_cycles += cycles;
+    while(session.frame_cycles >= session.cycles_per_frame) {
+        session.frame_cycles -= session.cycles_per_frame;
+        session.chip8->timerUpdate();
+        session.frames++;
+    }
+}
+
+/**
+ * Shows why the program stopped, if it did, and the instruction it is at
+ **/
+static void printStop(const DebugSession &session) {
+    if(session.debugger->stopReason() != CHIP8_DEBUG_NONE) {
+        printf("%s\n", session.debugger->stopText());
+    }
+    session.debugger->printDisassembly(stdout, session.debugger->getPC(), 1);
+}
+
+/**
+ * Runs frames until the debugger stops the program or the frames are done
+ *
+ * @param   frames  The most frames to run, counting the one in progress
+ **/
+static void continueRun(DebugSession &session, uint64_t frames) {
+    uint64_t end = session.frames + frames;
+    while(session.frames < end) {
+        int cycles = session.cycles_per_frame - session.frame_cycles;
+
+        // run() only goes through the debugger while it is armed, otherwise it runs them all
+        bool armed = session.debugger->armed();
+        session.chip8->run(cycles);
+        int executed = armed ? session.debugger->executed() : cycles;
+        advanceFrame(session, executed);
+
+        if(armed && session.debugger->stopReason() != CHIP8_DEBUG_NONE) {
+            printStop(session);
+            return;
+        }
+    }
+    printf("Ran to frame %llu\n", (unsigned long long)session.frames);
+    printStop(session);
+}
+
+/**
+ * Lists the breakpoints and watchpoints
+ **/
+static void printInfo(const DebugSession &session) {
+    const CHIP8Debugger &debugger = *session.debugger;
+    printf("Frame %llu, %d instructions into it\n", (unsigned long long)session.frames, session.frame_cycles);
+    for(size_t address = 0; address < session.chip8->memorySize(); address++) {
+        if(debugger.breakpoint(address)) {
+            printf("Breakpoint at 0x%03X\n", (unsigned)address);
+        }
+    }
+    const std::vector<CHIP8Watch> &watches = debugger.getWatches();
+    for(size_t w = 0; w < watches.size(); w++) {
+        if(watches[w].reg == CHIP8_DEBUG_REGISTER_I) {
+            printf("Watchpoint %d on I\n", (int)w);
+        } else if(watches[w].reg >= 0) {
+            printf("Watchpoint %d on V%X\n", (int)w, watches[w].reg);
+        } else {
+            printf("Watchpoint %d on 0x%03X-0x%03X\n", (int)w, watches[w].address,
+                watches[w].address + watches[w].length - 1);
+        }
+    }
+}
+
+/**
+ * Carries out one command line
+ *
+ * @return  false once the debugger should quit
+ **/
+static bool runCommand(DebugSession &session, char *line) {
+    CHIP8Debugger &debugger = *session.debugger;
+    char *words[4] = { NULL, NULL, NULL, NULL };
+    int count = 0;
+    for(char *word = strtok(line, " \t\r\n"); word != NULL && count < 4; word = strtok(NULL, " \t\r\n")) {
+        words[count++] = word;
+    }
+    if(count == 0) {
+        return true;
+    }
+
+    const char *command = words[0];
+    unsigned long first = 0;
+    unsigned long second = 0;
+    bool has_first = parseNumber(words[1], first);
+    bool has_second = parseNumber(words[2], second);
+
+    if(!strcmp(command, "q")) {
+        return false;
+    } else if(!strcmp(command, "b") && has_first) {
+        debugger.setBreakpoint(first, true);
+    } else if(!strcmp(command, "d")) {
+        if(has_first) {
+            debugger.setBreakpoint(first, false);
+        } else {
+            debugger.clearBreakpoints();
+        }
+    } else if(!strcmp(command, "w") && words[1] != NULL) {
+        int index;
+        int reg = parseRegister(words[1]);
+        if(reg >= 0) {
+            index = debugger.watchRegister(reg);
+        } else if(has_first) {
+            index = debugger.watchMemory(first, parseCount(words[2], 1));
+        } else {
+            index = -1;
+        }
+        if(index < 0) {
+            printf("Can't watch that\n");
+        } else {
+            printf("Watchpoint %d\n", index);
+        }
+    } else if(!strcmp(command, "u") && words[1] != NULL) {
+        if(!debugger.removeWatch(atoi(words[1]))) {
+            printf("No watchpoint %s\n", words[1]);
+        }
+    } else if(!strcmp(command, "i")) {
+        printInfo(session);
+    } else if(!strcmp(command, "s")) {
+        int steps = parseCount(words[1], 1);
+        for(int i = 0; i < steps; i++) {
+            debugger.step();
+            advanceFrame(session, 1);
+            if(debugger.stopReason() != CHIP8_DEBUG_NONE) {
+                break;
+            }
+        }
+        printStop(session);
+    } else if(!strcmp(command, "n")) {
+        if(debugger.stepOver()) {
+            continueRun(session, CONTINUE_FRAMES);
+        } else {
+            advanceFrame(session, 1);
+            printStop(session);
+        }
+    } else if(!strcmp(command, "c")) {
+        continueRun(session, parseCount(words[1], CONTINUE_FRAMES));
+    } else if(!strcmp(command, "r")) {
+        debugger.printRegisters(stdout);
+    } else if(!strcmp(command, "t")) {
+        debugger.printStack(stdout);
+    } else if(!strcmp(command, "l")) {
+        uint16_t address = has_first ? first : debugger.getPC();
+        debugger.printDisassembly(stdout, address, parseCount(words[2], 10));
+    } else if(!strcmp(command, "x") && has_first) {
+        debugger.printMemory(stdout, first, parseCount(words[2], 64));
+    } else if(!strcmp(command, "p")) {
+        debugger.printDisplay(stdout);
+    } else if(!strcmp(command, "k") && has_first && has_second) {
+        session.chip8->setKey(first, second != 0);
+    } else {
+        printCommands();
+    }
+    return true;
+}
+
+// ==================================================================================================
+// Main
+// ==================================================================================================
+int main(int argc, char *argv[]) {
+    CHIP8Engine engine = CHIP8_ENGINE_INTERPRETER;
+    CHIP8Platform platform = CHIP8_PLATFORM_CHIP8;
+    uint64_t seed = CHIP8_DEFAULT_SEED;
+    int cpu_freq = 500;
+    std::vector<unsigned long> breakpoints;
+    const char *rom = NULL;
+
+    for(int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        bool has_value = (i + 1) < argc;
+        if((!strcmp(arg, "-z") || !strcmp(arg, "--hz")) && has_value) {
+            cpu_freq = atoi(argv[++i]);
+        } else if((!strcmp(arg, "-e") || !strcmp(arg, "--engine")) && has_value) {
+            const char *name = argv[++i];
+            if(!strcmp(name, "interpreter")) {
+                engine = CHIP8_ENGINE_INTERPRETER;
+            } else if(!strcmp(name, "cached")) {
+                engine = CHIP8_ENGINE_CACHED;
+            } else if(!strcmp(name, "jit")) {
+                engine = CHIP8_ENGINE_JIT;
+            } else {
+                fprintf(stderr, "Unknown engine '%s'\n", name);
+                return 1;
+            }
+        } else if((!strcmp(arg, "-p") || !strcmp(arg, "--platform")) && has_value) {
+            const char *name = argv[++i];
+            if(!chip8PlatformFromName(name, platform)) {
+                fprintf(stderr, "Unknown platform '%s'\n", name);
+                return 1;
+            }
+        } else if((!strcmp(arg, "-s") || !strcmp(arg, "--seed")) && has_value) {
+            seed = strtoull(argv[++i], NULL, 0);
+        } else if((!strcmp(arg, "-b") || !strcmp(arg, "--break")) && has_value) {
+            unsigned long address;
+            if(!parseNumber(argv[++i], address)) {
+                fprintf(stderr, "Invalid address '%s'\n", argv[i]);
+                return 1;
+            }
+            breakpoints.push_back(address);
+        } else if(arg[0] == '-' || rom != NULL) {
+            printUsage(argv[0]);
+            return 1;
+        } else {
+            rom = arg;
+        }
+    }
+
+    if(rom == NULL) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    CHIP8Interpreter chip8;
+    chip8.setPlatform(platform);
+    chip8.seed(seed);
+    chip8.setEngine(engine);
+    CHIP8RomError error;
+    if(!chip8.loadRom(rom, &error)) {
+        fprintf(stderr, "Can't load %s: %s\n", rom, chip8RomErrorText(error));
+        return 1;
+    }
+
+    CHIP8Debugger debugger(chip8);
+    for(size_t i = 0; i < breakpoints.size(); i++) {
+        debugger.setBreakpoint(breakpoints[i], true);
+    }
+
+    DebugSession session;
+    session.chip8 = &chip8;
+    session.debugger = &debugger;
+    session.cycles_per_frame = (cpu_freq / 60 < 1) ? 1 : cpu_freq / 60;
+    session.frame_cycles = 0;
+    session.frames = 0;
+
+    // Prompts only make sense when someone is typing
+    bool interactive = isatty(STDIN_FILENO);
+    printStop(session);
+    char line[LINE_MAX_LENGTH];
+    while(true) {
+        if(interactive) {
+            printf("(chip8) ");
+            fflush(stdout);
+        }
+        if(fgets(line, sizeof(line), stdin) == NULL || !runCommand(session, line)) {
+            break;
+        }
+        fflush(stdout);
+    }
+
+    return 0;
+}
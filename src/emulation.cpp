@@ -0,0 +1,458 @@
+#include <stdio.h>
+#include <atomic>
+#include <string>
+
+#include "audio.hpp"
+#include "emulation.hpp"
+#include "input.hpp"
+#include "movie.hpp"
+#include "rewind.hpp"
+#include "runahead.hpp"
+#include "scheduler.hpp"
+#include "sound.hpp"
+#ifdef __linux__
+#include "spectate/server.hpp"
+#endif
+
+// The thread running the interpreter and what it shares with the rest of the front end
+static SDL_Thread *thread = NULL;
+static SDL_sem *wake = NULL;
+static std::atomic<bool> stopping(false);
+static std::atomic<bool> idle(false);
+
+// Event pushed to the main thread's queue whenever a frame is published, so a thread
+// sleeping in inputWait() wakes up to present it
+static Uint32 frame_event = (Uint32)-1;
+
+// Only used by the emulation thread once it is started
+static CHIP8Interpreter *chip8 = NULL;
+static CHIP8InputQueue *input = NULL;
+static CHIP8FrameBuffer *frames = NULL;
+static int cpu_freq = 500;
+static std::string state_file;
+static std::string movie_file;
+static int run_ahead = 0;
+static CHIP8AudioRing *audio = NULL;
+#ifdef __linux__
+// Broadcasts the frames to viewers (chip8-view), NULL unless --spectate was given
+static SpectatorServer *spectators = NULL;
+#endif
+
+// Samples of one sound update, made on the stack so the thread never allocates for sound
+#define EMULATION_SOUND_CHUNK	256
+
+// Keypad events taken from the queue in one pass, waiting for their instruction
+static CHIP8InputEvent key_events[CHIP8_INPUT_QUEUE_SIZE];
+
+/**
+ * Takes every wake up posted so far, one pass over the input queue covers them all
+ **/
+static void drainWake() {
+	while(SDL_SemTryWait(wake) == 0) {
+	}
+}
+
+/**
+ * Waits until the clock reaches a deadline or emulationWake() is called. Sleeps while the
+ * deadline is far off and spins for the last millisecond, which the semaphore's timeout
+ * can't hit precisely.
+ *
+ * @return	true at the deadline, false if woken up early because input arrived
+ **/
+static bool waitUntil(uint64_t deadline, uint64_t counter_frequency) {
+	uint64_t now = SDL_GetPerformanceCounter();
+	if(now >= deadline) {
+		return true;
+	}
+	uint64_t ms = (deadline - now) * 1000 / counter_frequency;
+	if(ms > 1 && SDL_SemWaitTimeout(wake, ms - 1) == 0) {
+		drainWake();
+		return false;
+	}
+	while(SDL_GetPerformanceCounter() < deadline) {
+		if(SDL_SemTryWait(wake) == 0) {
+			drainWake();
+			return false;
+		}
+	}
+	return true;
+}
+
+/**
+ * Lets the main thread know there is a frame to present
+ **/
+static void emulationFrameEvent() {
+	if(frame_event != (Uint32)-1) {
+		SDL_Event event;
+		SDL_memset(&event, 0, sizeof(event));
+		event.type = frame_event;
+		SDL_PushEvent(&event);
+	}
+}
+
+/**
+ * Publishes the display and lets the main thread know there is a frame to present
+ **/
+static void emulationPublish() {
+	frames->publish(*chip8);
+	chip8->draw_flag = 0;
+	emulationFrameEvent();
+}
+
+/**
+ * Runs instructions in slices of 1/EMULATION_SOUND_RATE of a second of emulated time and
+ * pushes the sound of each slice, so a beep starts and ends within a slice of the
+ * instruction that changed the sound timer. Samples the device is too far behind to play
+ * soon are dropped rather than waited for.
+ *
+ * @param	scheduler	Runs the instructions and ticks the timers
+ * @param	sound		Makes the samples
+ * @param	cycles		Instructions to run
+ * @param	latency		Most samples to have waiting in the ring
+ * @return				What the program is waiting for afterwards
+ **/
+static CHIP8Status emulationRun(CHIP8Scheduler &scheduler, CHIP8Sound &sound, int cycles, uint32_t latency) {
+	if(audio == NULL) {
+		return scheduler.run(*chip8, cycles);
+	}
+
+	int slice = cpu_freq / EMULATION_SOUND_RATE;
+	if(slice < 1) {
+		slice = 1;
+	}
+	CHIP8Status status = chip8->idleStatus();
+	while(cycles > 0) {
+		int count = (cycles < slice) ? cycles : slice;
+		status = scheduler.run(*chip8, count);
+		cycles -= count;
+
+		sound.advance(count);
+		int16_t samples[EMULATION_SOUND_CHUNK];
+		int made;
+		while((made = sound.generate(*chip8, samples, EMULATION_SOUND_CHUNK)) > 0) {
+			audio->push(samples, made, latency);
+		}
+	}
+	return status;
+}
+
+/**
+ * Applies a keypad event and records it if it changes the keypad
+ **/
+static void emulationKey(const CHIP8InputEvent &event, CHIP8MovieRecorder &movie, const CHIP8Scheduler &scheduler) {
+	int key = event.code & 0xF;
+	if(chip8->keyDown(key) != event.down) {
+		movie.key(scheduler.getInstructions(), key, event.down);
+	}
+	chip8->setKey(key, event.down);
+}
+
+/**
+ * Runs the instructions that became due since the last pass with the keypad events
+ * applied in between, each one at the instruction that was due when it happened. The
+ * program sees a key at the same point of emulated time it went down, not at the start
+ * of the next pass.
+ *
+ * @param	scheduler	Runs the instructions and ticks the timers
+ * @param	sound		Makes the samples
+ * @param	movie		Records the keypad events
+ * @param	count		Number of events in key_events
+ * @param	latency		Most samples to have waiting in the ring
+ * @return				What the program is waiting for afterwards
+ **/
+static CHIP8Status emulationRunInput(CHIP8Scheduler &scheduler, CHIP8Sound &sound, CHIP8MovieRecorder &movie, int count, uint32_t latency) {
+	uint64_t counter_frequency = SDL_GetPerformanceFrequency();
+	uint64_t now = SDL_GetPerformanceCounter();
+	int cycles = scheduler.due(now);
+	int done = 0;
+
+	CHIP8Status status = chip8->idleStatus();
+	for(int i=0; i<count; i++) {
+		// Instructions that were due after the event happened, events from before this
+		// pass's instructions go in front of all of them
+		uint64_t age = (key_events[i].time < now) ? now - key_events[i].time : 0;
+		uint64_t after = age * cpu_freq / counter_frequency;
+		int at = (after >= (uint64_t)cycles) ? 0 : cycles - (int)after;
+		if(at > done) {
+			status = emulationRun(scheduler, sound, at - done, latency);
+			done = at;
+		}
+		emulationKey(key_events[i], movie, scheduler);
+	}
+	if(cycles > done) {
+		status = emulationRun(scheduler, sound, cycles - done, latency);
+	}
+	return status;
+}
+
+/**
+ * Ends the movie being recorded, for when the program goes back in time. The movie can
+ * only follow the program forwards.
+ **/
+static void emulationStopMovie(CHIP8MovieRecorder &movie, const CHIP8Scheduler &scheduler) {
+	if(movie.isOpen()) {
+		movie.close(scheduler.getInstructions());
+		printf("Stopped recording %s, the program went back in time\n", movie_file.c_str());
+	}
+}
+
+/**
+ * Body of the emulation thread. Applies the queued input, runs the instructions that
+ * became due and publishes the display whenever it changed, EMULATION_RATE times a second
+ * and whenever input arrives in between.
+ **/
+static int emulationMain(void *data) {
+	uint64_t counter_frequency = SDL_GetPerformanceFrequency();
+	uint64_t tick_ticks = counter_frequency / EMULATION_RATE;
+	CHIP8Scheduler scheduler(counter_frequency, cpu_freq);
+	CHIP8Sound sound(AUDIO_SAMPLE_RATE, cpu_freq);
+	// A tick's worth of samples arrives at once, the device takes them a buffer at a time
+	uint32_t latency = AUDIO_SAMPLE_RATE / EMULATION_RATE + 2 * audioBufferSize();
+	CHIP8Rewind rewind;
+	CHIP8RunAhead runahead(run_ahead);
+	// Hotkeys that are down
+	int hotkeys = 0;
+
+	// The movie follows the scheduler's instruction count, which starts with the ROM
+	CHIP8MovieRecorder movie;
+	if(!movie_file.empty() && !movie.open(movie_file.c_str(), *chip8, cpu_freq)) {
+		printf("Could not record to %s\n", movie_file.c_str());
+	}
+
+	emulationPublish();
+	scheduler.restart(SDL_GetPerformanceCounter());
+	uint64_t next_tick = SDL_GetPerformanceCounter() + tick_ticks;
+	CHIP8Status status = CHIP8_RUNNING;
+	// False for a pass made early because input arrived, rewind snapshots and turbo bursts
+	// only happen once a tick
+	bool tick = true;
+	// The frame shown is one run ahead of the program
+	bool ahead = false;
+
+	while(!stopping.load()) {
+		uint64_t tick_start = SDL_GetPerformanceCounter();
+
+		// Take the input that arrived since the last pass. Hotkeys act at once, keypad
+		// events wait for the instruction they belong to.
+		int pressed = 0;
+		int key_count = 0;
+		CHIP8InputEvent event;
+		while(input->pop(event)) {
+			if(event.type == CHIP8_INPUT_KEY) {
+				key_events[key_count++] = event;
+			} else if(event.down) {
+				hotkeys |= event.code;
+				pressed |= event.code;
+			} else {
+				hotkeys &= ~event.code;
+			}
+		}
+
+		if(pressed & INPUT_HOTKEY_SAVE_STATE) {
+			if(!chip8->saveStateFile(state_file.c_str())) {
+				printf("Could not save state to %s\n", state_file.c_str());
+			}
+		}
+		if(pressed & INPUT_HOTKEY_LOAD_STATE) {
+			if(chip8->loadStateFile(state_file.c_str())) {
+				rewind.clear();
+				chip8->draw_flag = 1;
+				emulationStopMovie(movie, scheduler);
+			} else {
+				printf("Could not load state from %s\n", state_file.c_str());
+			}
+		}
+#ifdef CHIP8_PROFILE
+		if(pressed & INPUT_HOTKEY_PROFILE) {
+			chip8->profileReport(stdout);
+		}
+#endif
+
+		if(hotkeys & (INPUT_HOTKEY_REWIND | INPUT_HOTKEY_TURBO)) {
+			// Emulated time doesn't follow the clock, the keypad changes right away
+			for(int i=0; i<key_count; i++) {
+				emulationKey(key_events[i], movie, scheduler);
+			}
+		}
+
+		if(hotkeys & INPUT_HOTKEY_REWIND) {
+			// Step back one frame for every tick the key is held
+			if(tick && rewind.rewind(*chip8)) {
+				chip8->draw_flag = 1;
+				emulationStopMovie(movie, scheduler);
+			}
+			scheduler.restart(SDL_GetPerformanceCounter());
+		} else if(hotkeys & INPUT_HOTKEY_TURBO) {
+			if(tick) {
+				rewind.capture(*chip8);
+
+				// Run as fast as possible for most of a tick, a 60th of a second of emulated
+				// time at a time so the timers stay in step with the instructions
+				uint64_t turbo_end = tick_start + tick_ticks * 3 / 4;
+				do {
+					status = emulationRun(scheduler, sound, (cpu_freq + 59) / 60, latency);
+				} while(SDL_GetPerformanceCounter() < turbo_end);
+			}
+			scheduler.restart(SDL_GetPerformanceCounter());
+		} else {
+			if(tick) {
+				rewind.capture(*chip8);
+			}
+
+			// Run the instructions that became due since the last pass
+			status = emulationRunInput(scheduler, sound, movie, key_count, latency);
+		}
+		movie.update(scheduler.getInstructions(), *chip8);
+
+#ifdef __linux__
+		// Spectators see the real frames, running ahead only helps the one playing
+		if(spectators != NULL && chip8->draw_flag) {
+			spectators->publish(*chip8);
+		}
+#endif
+
+		// Rewinding and turbo show the real frames. The frame ahead can change without the
+		// program drawing, so it is published every pass.
+		if((hotkeys & (INPUT_HOTKEY_REWIND | INPUT_HOTKEY_TURBO)) == 0 && runahead.show(*chip8, scheduler, *frames)) {
+			chip8->draw_flag = 0;
+			emulationFrameEvent();
+			ahead = true;
+		} else if(chip8->draw_flag || ahead) {
+			emulationPublish();
+			ahead = false;
+		}
+
+		// A program waiting for a key (or stuck jumping to itself) with both timers stopped
+		// can't change until input arrives, so sleep until some does
+		bool blocked = (status == CHIP8_WAIT_KEY || status == CHIP8_HALTED) &&
+			!chip8->timersRunning() && (hotkeys & (INPUT_HOTKEY_REWIND | INPUT_HOTKEY_TURBO)) == 0;
+		idle.store(blocked);
+		if(blocked) {
+			SDL_SemWaitTimeout(wake, EMULATION_IDLE_WAIT);
+			drainWake();
+			scheduler.restart(SDL_GetPerformanceCounter());
+			next_tick = SDL_GetPerformanceCounter() + tick_ticks;
+			tick = true;
+		} else {
+			// Input arriving before the next tick gets a pass of its own, so the program
+			// sees it within a millisecond instead of up to a tick later
+			tick = waitUntil(next_tick, counter_frequency);
+			if(tick) {
+				next_tick += tick_ticks;
+				// Don't try to catch up on ticks that were missed
+				uint64_t now = SDL_GetPerformanceCounter();
+				if(next_tick < now) {
+					next_tick = now + tick_ticks;
+				}
+			}
+		}
+	}
+
+	movie.close(scheduler.getInstructions());
+	if(runahead.getFrames() > 0) {
+		runahead.report(stdout);
+	}
+	idle.store(false);
+	return 0;
+}
+
+/**
+ * Starts running the interpreter on a thread of its own. From then on only that thread
+ * touches the interpreter until emulationStop() returns.
+ *
+ * @param	chip8		The interpreter, with the ROM loaded
+ * @param	input		Queue of input events for the interpreter, see inputPoll()
+ * @param	frames		Where the finished frames are published
+ * @param	cpu_freq	Instructions to run per second
+ * @param	state_file	Where the save state hotkeys save to and load from
+ * @param	movie_file	Where to record the input as a movie, NULL to not record
+ * @param	run_ahead	Frames to show ahead of the program, see CHIP8RunAhead
+ * @param	spectate	Address to let viewers watch on, see SpectatorServer::listen(). NULL
+ *						for none, only supported on Linux.
+ * @param	audio		Where to push the sound for audioInit()'s device, NULL for no sound
+ * @return				True if the thread was started
+ **/
+bool emulationStart(CHIP8Interpreter *chip8, CHIP8InputQueue *input, CHIP8FrameBuffer *frames, int cpu_freq, const char *state_file, const char *movie_file, int run_ahead, const char *spectate, CHIP8AudioRing *audio) {
+	::chip8 = chip8;
+	::input = input;
+	::frames = frames;
+	::cpu_freq = cpu_freq;
+	::state_file = state_file;
+	::movie_file = (movie_file != NULL) ? movie_file : "";
+	::run_ahead = run_ahead;
+	::audio = audio;
+
+	if(spectate != NULL) {
+#ifdef __linux__
+		spectators = new SpectatorServer();
+		if(!spectators->listen(spectate) || !spectators->start()) {
+			printf("Could not let spectators watch on %s\n", spectate);
+			delete spectators;
+			spectators = NULL;
+			return false;
+		}
+		printf("Spectators can watch on %s\n", spectate);
+#else
+		printf("Spectating is only supported on Linux\n");
+		return false;
+#endif
+	}
+
+	frame_event = SDL_RegisterEvents(1);
+	wake = SDL_CreateSemaphore(0);
+	if(wake == NULL) {
+		printf("Semaphore could not be created! SDL_Error: %s\n", SDL_GetError());
+		return false;
+	}
+
+	stopping.store(false);
+	thread = SDL_CreateThread(emulationMain, "emulation", NULL);
+	if(thread == NULL) {
+		printf("Emulation thread could not be created! SDL_Error: %s\n", SDL_GetError());
+		SDL_DestroySemaphore(wake);
+		wake = NULL;
+		return false;
+	}
+	return true;
+}
+
+/**
+ * Wakes the emulation thread if it is sleeping, call it after queueing input
+ **/
+void emulationWake() {
+	if(wake != NULL) {
+		SDL_SemPost(wake);
+	}
+}
+
+/**
+ * @return	True if the program is waiting for input and nothing will change until it arrives
+ **/
+bool emulationIdle() {
+	return idle.load();
+}
+
+/**
+ * Stops the emulation thread and waits for it to finish
+ **/
+void emulationStop() {
+	if(thread == NULL) {
+		return;
+	}
+	stopping.store(true);
+	emulationWake();
+	SDL_WaitThread(thread, NULL);
+	thread = NULL;
+	SDL_DestroySemaphore(wake);
+	wake = NULL;
+
+#ifdef __linux__
+	if(spectators != NULL) {
+		printf("%llu frames sent to spectators, %llu copies dropped for slow ones\n",
+			(unsigned long long)spectators->framesSent(), (unsigned long long)spectators->framesDropped());
+		spectators->stop();
+		delete spectators;
+		spectators = NULL;
+	}
+#endif
+}
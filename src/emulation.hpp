@@ -0,0 +1,53 @@
+#ifndef EMULATION_H
+#define EMULATION_H
+
+#include <stdint.h>
+#include <SDL.h>
+
+#include "audioring.hpp"
+#include "chip8.hpp"
+#include "framebuffer.hpp"
+#include "inputqueue.hpp"
+
+// Rate the emulation thread runs at, it runs the instructions due and publishes a frame this often (Hz)
+#define EMULATION_RATE          60
+// Longest to sleep at once while the program waits for input (ms)
+#define EMULATION_IDLE_WAIT     500
+// Emulated time between sound updates (1/N s), how far the start or end of a beep can be
+// off from the instruction that caused it
+#define EMULATION_SOUND_RATE    1000
+
+/**
+ * Starts running the interpreter on a thread of its own. From then on only that thread
+ * touches the interpreter until emulationStop() returns.
+ *
+ * @param	chip8		The interpreter, with the ROM loaded
+ * @param	input		Queue of input events for the interpreter, see inputPoll()
+ * @param	frames		Where the finished frames are published
+ * @param	cpu_freq	Instructions to run per second
+ * @param	state_file	Where the save state hotkeys save to and load from
+ * @param	movie_file	Where to record the input as a movie, NULL to not record
+ * @param	run_ahead	Frames to show ahead of the program, see CHIP8RunAhead
+ * @param	spectate	Address to let viewers watch on, see SpectatorServer::listen(). NULL
+ *						for none, only supported on Linux.
+ * @param	audio		Where to push the sound for audioInit()'s device, NULL for no sound
+ * @return				True if the thread was started
+ **/
+bool emulationStart(CHIP8Interpreter *chip8, CHIP8InputQueue *input, CHIP8FrameBuffer *frames, int cpu_freq, const char *state_file, const char *movie_file, int run_ahead, const char *spectate, CHIP8AudioRing *audio);
+
+/**
+ * Wakes the emulation thread if it is sleeping, call it after queueing input
+ **/
+void emulationWake();
+
+/**
+ * @return	True if the program is waiting for input and nothing will change until it arrives
+ **/
+bool emulationIdle();
+
+/**
+ * Stops the emulation thread and waits for it to finish
+ **/
+void emulationStop();
+
+#endif // EMULATION_H
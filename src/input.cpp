@@ -2,8 +2,98 @@
 
 SDL_Event event;
 
-bool inputPoll(int (&key)[16]) {
+// Attempts at adding an event to a full queue before it is dropped, a millisecond apart
+#define INPUT_PUSH_ATTEMPTS 100
+
+/**
+ * @param   sym     A host key
+ * @return          The CHIP-8 key it is mapped to, -1 if it isn't one
+ **/
+static int inputKeypad(SDL_Keycode sym) {
+    switch(sym) {
+        case SDLK_1: return 0x1;
+        case SDLK_2: return 0x2;
+        case SDLK_3: return 0x3;
+        case SDLK_4: return 0xC;
+        case SDLK_q: return 0x4;
+        case SDLK_w: return 0x5;
+        case SDLK_e: return 0x6;
+        case SDLK_r: return 0xD;
+        case SDLK_a: return 0x7;
+        case SDLK_s: return 0x8;
+        case SDLK_d: return 0x9;
+        case SDLK_f: return 0xE;
+        case SDLK_z: return 0xA;
+        case SDLK_x: return 0x0;
+        case SDLK_c: return 0xB;
+        case SDLK_v: return 0xF;
+        default:     return -1;
+    }
+}
+
+/**
+ * @param   sym     A host key
+ * @return          The INPUT_HOTKEY_* flag it is mapped to, 0 if it isn't one
+ **/
+static int inputHotkey(SDL_Keycode sym) {
+    switch(sym) {
+        case SDLK_BACKSPACE: return INPUT_HOTKEY_REWIND;
+        case SDLK_TAB:       return INPUT_HOTKEY_TURBO;
+        case SDLK_F5:        return INPUT_HOTKEY_SAVE_STATE;
+        case SDLK_F9:        return INPUT_HOTKEY_LOAD_STATE;
+        case SDLK_F10:       return INPUT_HOTKEY_PROFILE;
+        default:             return 0;
+    }
+}
+
+/**
+ * Works out when SDL received an event on the performance counter's clock. SDL stamps
+ * events in milliseconds when they come in, which can be a while before they are polled
+ * when presenting a frame held this thread up.
+ *
+ * @param   timestamp   SDL's timestamp of the event
+ * @param   now         The performance counter now
+ * @param   now_ms      SDL_GetTicks() now
+ * @return              The performance counter when the event came in
+ **/
+static uint64_t inputTime(Uint32 timestamp, uint64_t now, Uint32 now_ms) {
+    int32_t age = (int32_t)(now_ms - timestamp);
+    if(age <= 0) {
+        return now;
+    }
+    return now - (uint64_t)age * SDL_GetPerformanceFrequency() / 1000;
+}
+
+/**
+ * Adds an event to the queue, waiting a little for the emulation to make room if it is full
+ *
+ * @return  false if the event had to be dropped
+ **/
+static bool inputPush(CHIP8InputQueue &queue, uint8_t type, uint8_t code, bool down, uint64_t time) {
+    CHIP8InputEvent input = {type, code, down, time};
+    for(int attempt = 0; attempt < INPUT_PUSH_ATTEMPTS; attempt++) {
+        if(queue.push(input)) {
+            return true;
+        }
+        SDL_Delay(1);
+    }
+    return false;
+}
+
+/**
+ * Reads every pending event and queues the keypad and hotkey changes for the emulation,
+ * stamped with when they came in. Key repeats are left out since they don't change anything.
+ *
+ * @param   queue       Receives a CHIP8_INPUT_KEY event for each keypad key going down or up and
+ *                      a CHIP8_INPUT_HOTKEY event with an INPUT_HOTKEY_* flag for each hotkey
+ * @param   queued      Set to the number of events queued
+ * @return              true if the user asked to quit
+ **/
+bool inputPoll(CHIP8InputQueue &queue, int &queued) {
     bool quit = false;
+    queued = 0;
+    uint64_t now = SDL_GetPerformanceCounter();
+    Uint32 now_ms = SDL_GetTicks();
 
     while(SDL_PollEvent(&event)) {
         // A key was pressed (true) or released (false)
@@ -12,64 +102,27 @@ bool inputPoll(int (&key)[16]) {
         // If a quit event was pressed (like pressing the 'x' on a window)
         if(event.type == SDL_QUIT) {
             quit = true;
-        }else if(key_press) {
-            // Sets the value to 1 if a key was pressed, 0 otherwise
-            int key_down = (event.type == SDL_KEYDOWN) ? 1 : 0;
+        }else if(key_press && !event.key.repeat) {
+            bool key_down = (event.type == SDL_KEYDOWN);
             // Check whick key the event came from 
-            switch(event.key.keysym.sym) {
-                case SDLK_1:
-                    key[0x1] = key_down;
-                    break;
-                case SDLK_2:
-                    key[0x2] = key_down;;
-                    break;
-                case SDLK_3:
-                    key[0x3] = key_down;
-                    break;
-                case SDLK_4:
-                    key[0xC] = key_down;
-                    break;
-                case SDLK_q:
-                    key[0x4] = key_down;
-                    break;
-                case SDLK_w:
-                    key[0x5] = key_down;
-                    break;
-                case SDLK_e:
-                    key[0x6] = key_down;
-                    break;
-                case SDLK_r:
-                    key[0xD] = key_down;
-                    break;
-                case SDLK_a:
-                    key[0x7] = key_down;
-                    break;
-                case SDLK_s:
-                    key[0x8] = key_down;
-                    break;
-                case SDLK_d:
-                    key[0x9] = key_down;
-                    break;
-                case SDLK_f:
-                    key[0xE] = key_down;
-                    break;
-                case SDLK_z:
-                    key[0xA] = key_down;
-                    break;
-                case SDLK_x:
-                    key[0x0] = key_down;
-                    break;
-                case SDLK_c:
-                    key[0xB] = key_down;
-                    break;
-                case SDLK_v:
-                    key[0xF] = key_down;
-                    break;
-                default:
-                    break;
+            int keypad = inputKeypad(event.key.keysym.sym);
+            int hotkey = inputHotkey(event.key.keysym.sym);
+            uint64_t time = inputTime(event.key.timestamp, now, now_ms);
+            if(keypad >= 0) {
+                queued += inputPush(queue, CHIP8_INPUT_KEY, keypad, key_down, time);
+            } else if(hotkey != 0) {
+                queued += inputPush(queue, CHIP8_INPUT_HOTKEY, hotkey, key_down, time);
             }
         }
     }
 
     return quit;
-}
\ No newline at end of file
+}
+/**
+ * Sleeps until an event arrives, leaving it in the queue for inputPoll()
+ *
+ * @param   timeout     The longest to wait, in milliseconds
+ **/
+void inputWait(int timeout) {
+    SDL_WaitEventTimeout(NULL, timeout);
+}
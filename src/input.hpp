@@ -3,6 +3,16 @@
 
 #include <SDL.h>
 
-bool inputPoll(int (&key)[16]);
+#include "inputqueue.hpp"
+
+// Emulator controls queued by inputPoll() alongside the keypad, as the code of CHIP8_INPUT_HOTKEY events
+#define INPUT_HOTKEY_REWIND         0x01    // Held while Backspace is down
+#define INPUT_HOTKEY_SAVE_STATE     0x02    // F5
+#define INPUT_HOTKEY_LOAD_STATE     0x04    // F9
+#define INPUT_HOTKEY_PROFILE        0x08    // F10
+#define INPUT_HOTKEY_TURBO          0x10    // Held while Tab is down
+
+bool inputPoll(CHIP8InputQueue &queue, int &queued);
+void inputWait(int timeout);
 
 #endif // INPUT_H
\ No newline at end of file
@@ -0,0 +1,406 @@
+#include <stdint.h>
+#include <new>
+#include <vector>
+
+#include "chip8.hpp"
+#include "scheduler.hpp"
+#include "libchip8.h"
+
+/**
+ * A value in guest memory whose change is paid out as reward
+ **/
+struct RewardWatch {
+    uint16_t address;
+    int kind;           // LIBCHIP8_WATCH_*
+    double scale;       // Reward per unit the value goes up
+    int32_t last;       // Value after the previous frame
+};
+
+/**
+ * What sits behind a chip8_instance handle
+ **/
+struct chip8_instance {
+    CHIP8Interpreter chip8;
+    CHIP8Scheduler scheduler;           // Clocked in frames, so fractions of an instruction carry over between them
+    uint64_t frames;                    // Frames stepped since the ROM was loaded or reset
+    std::vector<uint8_t> rom;           // Loaded again by chip8_reset()
+
+    RewardWatch watches[LIBCHIP8_MAX_WATCHES];
+    int watch_count;
+    chip8_reward_callback callback;
+    void *callback_user;
+
+    bool done_enabled;                  // The episode ends once (memory[done_address] & done_mask) == done_value
+    uint16_t done_address;
+    uint8_t done_mask;
+    uint8_t done_value;
+
+    chip8_instance(uint32_t cpu_frequency) : scheduler(CHIP8_TIMER_FREQUENCY, cpu_frequency) {}
+};
+
+// ==================================================================================================
+// Helpers
+// ==================================================================================================
+/**
+ * @param   instance    The instance to read from
+ * @param   watch       What to read
+ * @return              The watched value as it is now
+ **/
+static int32_t readWatch(const chip8_instance *instance, const RewardWatch &watch) {
+    const uint8_t *memory = instance->chip8.getMemory();
+    size_t mask = instance->chip8.memorySize() - 1;
+    uint16_t a = watch.address;
+
+    switch(watch.kind) {
+        case LIBCHIP8_WATCH_U16:
+            return (memory[a & mask] << 8) | memory[(a + 1) & mask];
+        case LIBCHIP8_WATCH_BCD:
+            return memory[a & mask] * 100 + memory[(a + 1) & mask] * 10 + memory[(a + 2) & mask];
+        default:
+            return memory[a & mask];
+    }
+}
+
+/**
+ * Takes the current values of the watches as the ones rewards are counted from
+ **/
+static void resetWatches(chip8_instance *instance) {
+    for(int i=0; i<instance->watch_count; i++) {
+        instance->watches[i].last = readWatch(instance, instance->watches[i]);
+    }
+}
+
+/**
+ * Runs one frame, 1/60th of a second of emulated time
+ *
+ * @return  The reward earned during the frame
+ **/
+static double stepFrame(chip8_instance *instance) {
+    instance->frames++;
+    instance->scheduler.run(instance->chip8, instance->scheduler.due(instance->frames));
+
+    double reward = 0;
+    for(int i=0; i<instance->watch_count; i++) {
+        RewardWatch &watch = instance->watches[i];
+        int32_t value = readWatch(instance, watch);
+        reward += (value - watch.last) * watch.scale;
+        watch.last = value;
+    }
+    if(instance->callback != NULL) {
+        reward += instance->callback(instance->chip8.getMemory(), instance->chip8.memorySize(), instance->callback_user);
+    }
+    return reward;
+}
+
+// ==================================================================================================
+// Public Functions
+// ==================================================================================================
+/**
+ * @return  LIBCHIP8_API_VERSION of the library, to check it against the header used
+ **/
+int chip8_api_version(void) {
+    return LIBCHIP8_API_VERSION;
+}
+
+/**
+ * Creates an instance with no ROM loaded
+ *
+ * @param   platform        LIBCHIP8_PLATFORM_*
+ * @param   cpu_frequency   Instructions per second, frames run 1/60th of it
+ * @return                  The instance, NULL if the platform is unknown or out of memory
+ **/
+chip8_instance *chip8_create(int platform, uint32_t cpu_frequency) {
+    if(platform < 0 || platform >= CHIP8_PLATFORM_COUNT) {
+        return NULL;
+    }
+    chip8_instance *instance = new(std::nothrow) chip8_instance(cpu_frequency);
+    if(instance == NULL) {
+        return NULL;
+    }
+    instance->chip8.setPlatform((CHIP8Platform)platform);
+    instance->frames = 0;
+    instance->watch_count = 0;
+    instance->callback = NULL;
+    instance->callback_user = NULL;
+    instance->done_enabled = false;
+    return instance;
+}
+
+/**
+ * Frees an instance, the pointers it handed out become invalid
+ **/
+void chip8_destroy(chip8_instance *instance) {
+    delete instance;
+}
+
+/**
+ * Chooses how the instance executes the program, see CHIP8Engine
+ *
+ * @param   engine  LIBCHIP8_ENGINE_*, JIT falls back to the cached engine on hosts without it
+ * @return          LIBCHIP8_OK or LIBCHIP8_ERROR_ARGUMENT
+ **/
+int chip8_set_engine(chip8_instance *instance, int engine) {
+    if(instance == NULL || engine < LIBCHIP8_ENGINE_INTERPRETER || engine > LIBCHIP8_ENGINE_JIT) {
+        return LIBCHIP8_ERROR_ARGUMENT;
+    }
+    instance->chip8.setEngine((CHIP8Engine)engine);
+    return LIBCHIP8_OK;
+}
+
+/**
+ * Seeds the random numbers of CXNN, takes effect from the next chip8_load_rom() or chip8_reset()
+ **/
+void chip8_seed(chip8_instance *instance, uint64_t seed) {
+    if(instance != NULL) {
+        instance->chip8.seed(seed);
+    }
+}
+
+/**
+ * Loads a ROM from memory and starts it from the beginning. The data is copied, the
+ * caller can free it afterwards.
+ *
+ * @param   data    The ROM
+ * @param   size    Its size in bytes
+ * @return          LIBCHIP8_OK or one of the LIBCHIP8_ERROR_* values
+ **/
+int chip8_load_rom(chip8_instance *instance, const uint8_t *data, size_t size) {
+    if(instance == NULL || (data == NULL && size > 0)) {
+        return LIBCHIP8_ERROR_ARGUMENT;
+    }
+    CHIP8RomError error;
+    if(!instance->chip8.loadRom(data, size, &error)) {
+        instance->rom.clear();
+        return (error == CHIP8_ROM_TOO_LARGE) ? LIBCHIP8_ERROR_TOO_LARGE : LIBCHIP8_ERROR_EMPTY;
+    }
+    instance->rom.assign(data, data + size);
+    chip8_reset(instance);
+    return LIBCHIP8_OK;
+}
+
+/**
+ * Starts the loaded ROM over, for a new episode. The random numbers start over from the
+ * seed, the watches count rewards from the values the program starts with.
+ **/
+void chip8_reset(chip8_instance *instance) {
+    if(instance == NULL) {
+        return;
+    }
+    if(!instance->rom.empty()) {
+        instance->chip8.loadRom(&instance->rom[0], instance->rom.size());
+    }
+    instance->scheduler = CHIP8Scheduler(CHIP8_TIMER_FREQUENCY, instance->scheduler.getCpuFrequency());
+    instance->frames = 0;
+    resetWatches(instance);
+}
+
+/**
+ * Steps frames, 1/60th of a second of emulated time each, and stops early once the done
+ * watch triggers.
+ *
+ * @param   frames  Number of frames to step
+ * @param   actions One key mask per frame (bit N for key N) held down during it, NULL
+ *                  to keep the keys as they are
+ * @param   reward  Receives the reward summed over the frames stepped, can be NULL
+ * @return          The number of frames stepped
+ **/
+int chip8_step_frames(chip8_instance *instance, int frames, const uint16_t *actions, double *reward) {
+    double total = 0;
+    int stepped = 0;
+    if(instance != NULL) {
+        while(stepped < frames && !chip8_done(instance)) {
+            if(actions != NULL) {
+                instance->chip8.setKeys(actions[stepped]);
+            }
+            total += stepFrame(instance);
+            stepped++;
+        }
+    }
+    if(reward != NULL) {
+        *reward = total;
+    }
+    return stepped;
+}
+
+/**
+ * Steps several instances in one call, to pay for the foreign function call once per
+ * batch instead of once per instance
+ *
+ * @param   instances   The instances to step
+ * @param   count       Number of instances
+ * @param   frames      Frames to step each of them
+ * @param   actions     frames key masks per instance, instance after instance, NULL to keep the keys
+ * @param   rewards     Receives the reward of every instance, can be NULL
+ * @param   done        Receives 1 for every instance whose episode ended, can be NULL
+ **/
+void chip8_step_many(chip8_instance **instances, int count, int frames, const uint16_t *actions,
+    double *rewards, uint8_t *done) {
+    for(int i=0; i<count; i++) {
+        double reward;
+        chip8_step_frames(instances[i], frames, (actions != NULL) ? &actions[(size_t)i * frames] : NULL, &reward);
+        if(rewards != NULL) {
+            rewards[i] = reward;
+        }
+        if(done != NULL) {
+            done[i] = chip8_done(instances[i]);
+        }
+    }
+}
+
+/**
+ * Pays out the change of a value in guest memory as reward after every frame, for
+ * example a score
+ *
+ * @param   address The value's address
+ * @param   kind    LIBCHIP8_WATCH_*, how the value is stored
+ * @param   scale   Reward per unit the value goes up, negative to punish it
+ * @return          LIBCHIP8_OK or LIBCHIP8_ERROR_ARGUMENT if the kind is unknown or
+ *                  there are LIBCHIP8_MAX_WATCHES already
+ **/
+int chip8_add_reward_watch(chip8_instance *instance, uint16_t address, int kind, double scale) {
+    if(instance == NULL || kind < LIBCHIP8_WATCH_U8 || kind > LIBCHIP8_WATCH_BCD || instance->watch_count == LIBCHIP8_MAX_WATCHES) {
+        return LIBCHIP8_ERROR_ARGUMENT;
+    }
+    RewardWatch &watch = instance->watches[instance->watch_count++];
+    watch.address = address;
+    watch.kind = kind;
+    watch.scale = scale;
+    watch.last = readWatch(instance, watch);
+    return LIBCHIP8_OK;
+}
+
+void chip8_clear_reward_watches(chip8_instance *instance) {
+    if(instance != NULL) {
+        instance->watch_count = 0;
+    }
+}
+
+/**
+ * Adds a function's result to the reward of every frame, NULL to remove it. Calling
+ * back into another language every frame is slow, watches are the fast way.
+ **/
+void chip8_set_reward_callback(chip8_instance *instance, chip8_reward_callback callback, void *user) {
+    if(instance != NULL) {
+        instance->callback = callback;
+        instance->callback_user = user;
+    }
+}
+
+/**
+ * Ends the episode once (memory[address] & mask) == value, for example when the lives
+ * run out. A mask of 0 removes the watch.
+ **/
+void chip8_set_done_watch(chip8_instance *instance, uint16_t address, uint8_t mask, uint8_t value) {
+    if(instance != NULL) {
+        instance->done_enabled = mask != 0;
+        instance->done_address = address;
+        instance->done_mask = mask;
+        instance->done_value = value;
+    }
+}
+
+/**
+ * @return  1 if the done watch triggered, chip8_step_frames() doesn't step until chip8_reset()
+ **/
+int chip8_done(const chip8_instance *instance) {
+    if(instance == NULL || !instance->done_enabled) {
+        return 0;
+    }
+    const uint8_t *memory = instance->chip8.getMemory();
+    uint8_t byte = memory[instance->done_address & (instance->chip8.memorySize() - 1)];
+    return (byte & instance->done_mask) == instance->done_value;
+}
+
+/**
+ * The display itself, laid out as LIBCHIP8_DISPLAY_ROW_WORDS words per row and
+ * LIBCHIP8_DISPLAY_PLANE_WORDS words per bitplane. The contents change as frames are
+ * stepped, nothing is copied.
+ *
+ * @param   width   Receives the width in use by the program (64 or 128), can be NULL
+ * @param   height  Receives the height in use by the program (32 or 64), can be NULL
+ * @return          The first word of the first plane, NULL without an instance
+ **/
+const uint64_t *chip8_display(const chip8_instance *instance, int *width, int *height) {
+    if(instance == NULL) {
+        return NULL;
+    }
+    if(width != NULL) {
+        *width = instance->chip8.screenWidth();
+    }
+    if(height != NULL) {
+        *height = instance->chip8.screenHeight();
+    }
+    return &instance->chip8.display[0][0][0];
+}
+
+/**
+ * @return  1 if the display changed since the last call, so unchanged observations can be skipped
+ **/
+int chip8_display_changed(chip8_instance *instance) {
+    if(instance == NULL) {
+        return 0;
+    }
+    int changed = instance->chip8.draw_flag;
+    instance->chip8.draw_flag = 0;
+    return changed;
+}
+
+/**
+ * The guest memory itself, read only, for rewards and observations the library doesn't
+ * work out. Loading a state of a platform with another memory size moves it.
+ *
+ * @param   size    Receives the size in bytes (4096, 65536 for XO-CHIP), can be NULL
+ * @return          The first byte, NULL without an instance
+ **/
+const uint8_t *chip8_memory(const chip8_instance *instance, size_t *size) {
+    if(instance == NULL) {
+        return NULL;
+    }
+    if(size != NULL) {
+        *size = instance->chip8.memorySize();
+    }
+    return instance->chip8.getMemory();
+}
+
+/**
+ * @return  Frames stepped since the ROM was loaded or reset
+ **/
+uint64_t chip8_frame_count(const chip8_instance *instance) {
+    return (instance != NULL) ? instance->frames : 0;
+}
+
+/**
+ * @return  Bytes needed by chip8_save_state()
+ **/
+size_t chip8_state_size(const chip8_instance *instance) {
+    return (instance != NULL) ? instance->chip8.stateSize() : 0;
+}
+
+/**
+ * Saves the interpreter state in the emulator's save state format
+ *
+ * @return  Bytes written, 0 if the buffer is too small
+ **/
+size_t chip8_save_state(const chip8_instance *instance, uint8_t *buffer, size_t size) {
+    if(instance == NULL || buffer == NULL) {
+        return 0;
+    }
+    return instance->chip8.saveState(buffer, size);
+}
+
+/**
+ * Restores a state saved by chip8_save_state(). The watches count rewards from the values
+ * in the restored state.
+ *
+ * @return  LIBCHIP8_OK or LIBCHIP8_ERROR_STATE
+ **/
+int chip8_load_state(chip8_instance *instance, const uint8_t *buffer, size_t size) {
+    if(instance == NULL || buffer == NULL) {
+        return LIBCHIP8_ERROR_ARGUMENT;
+    }
+    if(!instance->chip8.loadState(buffer, size)) {
+        return LIBCHIP8_ERROR_STATE;
+    }
+    resetWatches(instance);
+    return LIBCHIP8_OK;
+}
@@ -0,0 +1,117 @@
+#ifndef LIBCHIP8_H
+#define LIBCHIP8_H
+
+/**
+ * libchip8 - the interpreter as a shared library with a C ABI, for driving it from other
+ * languages through a foreign function interface.
+ *
+ * An instance is one interpreter behind an opaque handle. It is stepped in frames of
+ * 1/60th of a second of emulated time, each with the key state the caller passes as its
+ * action. Rewards are worked out inside the library from watches on guest memory, and
+ * the display and memory are handed out as pointers into the instance, so a step doesn't
+ * copy or marshal anything.
+ *
+ * Only functions and types in this header are exported. Everything stays compatible
+ * within an LIBCHIP8_API_VERSION, check chip8_api_version() after loading the library.
+ **/
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(_WIN32)
+    #ifdef LIBCHIP8_BUILD
+        #define LIBCHIP8_EXPORT __declspec(dllexport)
+    #else
+        #define LIBCHIP8_EXPORT __declspec(dllimport)
+    #endif
+#else
+    #define LIBCHIP8_EXPORT __attribute__((visibility("default")))
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define LIBCHIP8_API_VERSION    1
+
+// Platforms, the same ones the emulator's --platform option takes
+#define LIBCHIP8_PLATFORM_CHIP8     0
+#define LIBCHIP8_PLATFORM_COSMAC    1
+#define LIBCHIP8_PLATFORM_SCHIP     2
+#define LIBCHIP8_PLATFORM_XOCHIP    3
+
+// Engines, they give the same results at different speeds
+#define LIBCHIP8_ENGINE_INTERPRETER 0
+#define LIBCHIP8_ENGINE_CACHED      1
+#define LIBCHIP8_ENGINE_JIT         2
+
+// Results of chip8_load_rom(), negative values are errors
+#define LIBCHIP8_OK                 0
+#define LIBCHIP8_ERROR_EMPTY        (-1)    // The ROM has nothing in it
+#define LIBCHIP8_ERROR_TOO_LARGE    (-2)    // The ROM doesn't fit in the platform's memory
+#define LIBCHIP8_ERROR_ARGUMENT     (-3)    // A NULL instance or buffer, or a value out of range
+#define LIBCHIP8_ERROR_STATE        (-4)    // The save state is damaged or for another platform
+
+// How a reward watch reads its value from guest memory
+#define LIBCHIP8_WATCH_U8           0       // One byte
+#define LIBCHIP8_WATCH_U16          1       // Two bytes, most significant first
+#define LIBCHIP8_WATCH_BCD          2       // Three decimal digits as stored by FX33
+
+// Most reward watches an instance can have
+#define LIBCHIP8_MAX_WATCHES        8
+
+// Layout of the display returned by chip8_display(): two 64-bit words per row, the most
+// significant bit of the first is the leftmost pixel. Rows are 128 pixels wide and there
+// are 64 of them whatever the resolution, the second bitplane (XO-CHIP) follows the first.
+#define LIBCHIP8_DISPLAY_ROW_WORDS      2
+#define LIBCHIP8_DISPLAY_PLANE_WORDS    (64 * LIBCHIP8_DISPLAY_ROW_WORDS)
+
+typedef struct chip8_instance chip8_instance;
+
+/**
+ * Called after every frame for rewards a watch can't express, it must not keep the pointer
+ *
+ * @param   memory  The guest memory
+ * @param   size    Its size in bytes
+ * @param   user    What was passed to chip8_set_reward_callback()
+ * @return          The reward for the frame, added to the watches' rewards
+ **/
+typedef double (*chip8_reward_callback)(const uint8_t *memory, size_t size, void *user);
+
+LIBCHIP8_EXPORT int chip8_api_version(void);
+LIBCHIP8_EXPORT chip8_instance *chip8_create(int platform, uint32_t cpu_frequency);
+LIBCHIP8_EXPORT void chip8_destroy(chip8_instance *instance);
+LIBCHIP8_EXPORT int chip8_set_engine(chip8_instance *instance, int engine);
+LIBCHIP8_EXPORT void chip8_seed(chip8_instance *instance, uint64_t seed);
+LIBCHIP8_EXPORT int chip8_load_rom(chip8_instance *instance, const uint8_t *data, size_t size);
+LIBCHIP8_EXPORT void chip8_reset(chip8_instance *instance);
+
+// Stepping
+LIBCHIP8_EXPORT int chip8_step_frames(chip8_instance *instance, int frames, const uint16_t *actions, double *reward);
+LIBCHIP8_EXPORT void chip8_step_many(chip8_instance **instances, int count, int frames, const uint16_t *actions,
+    double *rewards, uint8_t *done);
+
+// Rewards and episode ends
+LIBCHIP8_EXPORT int chip8_add_reward_watch(chip8_instance *instance, uint16_t address, int kind, double scale);
+LIBCHIP8_EXPORT void chip8_clear_reward_watches(chip8_instance *instance);
+LIBCHIP8_EXPORT void chip8_set_reward_callback(chip8_instance *instance, chip8_reward_callback callback, void *user);
+LIBCHIP8_EXPORT void chip8_set_done_watch(chip8_instance *instance, uint16_t address, uint8_t mask, uint8_t value);
+LIBCHIP8_EXPORT int chip8_done(const chip8_instance *instance);
+
+// Observations, the pointers stay valid until the instance is destroyed (the memory one
+// only until a state with another memory size is loaded)
+LIBCHIP8_EXPORT const uint64_t *chip8_display(const chip8_instance *instance, int *width, int *height);
+LIBCHIP8_EXPORT int chip8_display_changed(chip8_instance *instance);
+LIBCHIP8_EXPORT const uint8_t *chip8_memory(const chip8_instance *instance, size_t *size);
+LIBCHIP8_EXPORT uint64_t chip8_frame_count(const chip8_instance *instance);
+
+// Save states
+LIBCHIP8_EXPORT size_t chip8_state_size(const chip8_instance *instance);
+LIBCHIP8_EXPORT size_t chip8_save_state(const chip8_instance *instance, uint8_t *buffer, size_t size);
+LIBCHIP8_EXPORT int chip8_load_state(chip8_instance *instance, const uint8_t *buffer, size_t size);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // LIBCHIP8_H
@@ -1,72 +1,238 @@
+#include <stdlib.h>
+#include <string.h>
 #include <iostream>
+#include <string>
 
+#include "audio.hpp"
 #include "chip8.hpp"
+#include "emulation.hpp"
+#include "framebuffer.hpp"
+#include "inputqueue.hpp"
+#include "library.hpp"
+#include "runahead.hpp"
 #include "video.hpp"
 #include "input.hpp"
 
+/**
+ * Prints the command line usage of the emulator
+ **/
+static void printUsage(const char *name) {
+    printf("Usage: %s [options] <rom>\n", name);
+    printf("  --freq N      CPU frequency in instructions per second (default 500)\n");
+    printf("  --scale N     Size of a CHIP-8 pixel in the window (default 12)\n");
+    printf("  --vsync       Present in step with the display's refresh\n");
+    printf("  --audio N     Samples the audio device plays at a time (default %d), smaller starts\n", AUDIO_DEFAULT_BUFFER);
+    printf("                and stops the beep sooner but may crackle\n");
+    printf("  --mute        Don't play sound\n");
+    printf("  --platform P  Instruction set and quirks: chip8 (default), cosmac, schip or xochip\n");
+    printf("  --record F    Record the input to the movie F, replay it with chip8-batch --movie\n");
+    printf("  --run-ahead N Show the display N frames ahead of the program (0-%d) to hide the frame\n", CHIP8_RUNAHEAD_MAX_FRAMES);
+    printf("                games take to react to a key, prints the time it costs when quitting\n");
+#ifdef __linux__
+    printf("  --spectate A  Let chip8-view watch the game on A: a Unix socket path (anything with a /),\n");
+    printf("                a port, or host:port\n");
+#endif
+    printf("  --library D   Look the rom up by file name or hash in the ROM directory D and use the\n");
+    printf("                platform and frequency its index has for it, lists the ROMs without a rom\n");
+}
+
+/**
+ * Sleeps until the clock reaches a deadline, to the nearest millisecond, or until an
+ * event arrives
+ *
+ * @return  true if the deadline was reached
+ **/
+static bool sleepUntil(uint64_t deadline, uint64_t counter_frequency) {
+    uint64_t now = SDL_GetPerformanceCounter();
+    if(now < deadline) {
+        inputWait((deadline - now) * 1000 / counter_frequency);
+    }
+    return SDL_GetPerformanceCounter() >= deadline;
+}
+
 int main(int argc, char *argv[]) {
     bool exit = false;
 
-    // TODO: Move these to a config file instead
-    // Rate that the screen refreshes
-    int screen_fps = 60;
-    int screen_ticks_per_frame = 1000 / screen_fps;
-    // Rate at which the CHIP-8 cpu updates (in Hz) - Has to be larger than screen fps
+    // Rate at which the CHIP-8 cpu runs (in Hz), the timers always run at 60 Hz
     int chip8_cpu_freq = 500;
-    // How many ticks will the cpu update for every draw call
-    int chip8_ticks = chip8_cpu_freq / screen_fps;
+    bool freq_given = false;
+    // Size of each CHIP-8 pixel in the initial window
+    int scale = 12;
+    bool vsync = false;
+    int audio_buffer = AUDIO_DEFAULT_BUFFER;
+    bool mute = false;
+    CHIP8Platform platform = CHIP8_PLATFORM_CHIP8;
+    bool platform_given = false;
+    const char *rom_file = NULL;
+    const char *movie_file = NULL;
+    int run_ahead = 0;
+    const char *spectate = NULL;
+    const char *library_dir = NULL;
+
+    for(int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        bool has_value = (i + 1) < argc;
+        if(!strcmp(arg, "--freq") && has_value) {
+            chip8_cpu_freq = atoi(argv[++i]);
+            freq_given = true;
+        } else if(!strcmp(arg, "--scale") && has_value) {
+            scale = atoi(argv[++i]);
+        } else if(!strcmp(arg, "--vsync")) {
+            vsync = true;
+        } else if(!strcmp(arg, "--audio") && has_value) {
+            audio_buffer = atoi(argv[++i]);
+        } else if(!strcmp(arg, "--mute")) {
+            mute = true;
+        } else if(!strcmp(arg, "--library") && has_value) {
+            library_dir = argv[++i];
+        } else if(!strcmp(arg, "--record") && has_value) {
+            movie_file = argv[++i];
+        } else if(!strcmp(arg, "--run-ahead") && has_value) {
+            run_ahead = atoi(argv[++i]);
+#ifdef __linux__
+        } else if(!strcmp(arg, "--spectate") && has_value) {
+            spectate = argv[++i];
+#endif
+        } else if(!strcmp(arg, "--platform") && has_value) {
+            if(!chip8PlatformFromName(argv[++i], platform)) {
+                printUsage(argv[0]);
+                return 1;
+            }
+            platform_given = true;
+        } else if(arg[0] == '-') {
+            printUsage(argv[0]);
+            return 1;
+        } else {
+            rom_file = arg;
+        }
+    }
+    if(rom_file == NULL && library_dir == NULL) {
+        printUsage(argv[0]);
+        return 1;
+    }
 
-    // We'll use this to count the frames per second
-    int frames = 0;
-    double fps_timer = SDL_GetTicks();
+    // ROMs in the library come with the settings its index has for them, the command line
+    // still has the last word
+    std::string rom_path = (rom_file != NULL) ? rom_file : "";
+    if(library_dir != NULL) {
+        CHIP8Library library;
+        if(!library.open(library_dir)) {
+            printf("Could not open the ROM library %s\n", library_dir);
+            return 1;
+        }
+        if(rom_file == NULL) {
+            for(size_t i = 0; i < library.count(); i++) {
+                const CHIP8LibraryEntry &entry = library.entry(i);
+                printf("%016llx  %-6s  %5u Hz  %s\n", (unsigned long long)entry.hash, chip8PlatformName(entry.platform),
+                    (unsigned)entry.cpu_frequency, entry.name.c_str());
+            }
+            return 0;
+        }
+        const CHIP8LibraryEntry *entry = library.find(rom_file);
+        if(entry != NULL) {
+            rom_path = library.path(*entry);
+            if(!platform_given) {
+                platform = entry->platform;
+            }
+            if(!freq_given) {
+                chip8_cpu_freq = entry->cpu_frequency;
+            }
+        }
+    }
+    if(chip8_cpu_freq < 1) {
+        chip8_cpu_freq = 1;
+    }
+    if(scale < 1) {
+        scale = 1;
+    }
+    if(audio_buffer < 16) {
+        audio_buffer = 16;
+    }
 
     // Access CHIP-8 memory and cpu
     CHIP8Interpreter chip8;
-    chip8.loadRom("TEST");
+    chip8.setPlatform(platform);
+    CHIP8RomError error;
+    if(!chip8.loadRom(rom_path.c_str(), &error)) {
+        printf("Could not load %s: %s\n", rom_path.c_str(), chip8RomErrorText(error));
+        return 1;
+    }
+
+    // Save states go next to the ROM
+    std::string state_file = rom_path + ".state";
 
     // Atempt to create a SDL window
-    if(!videoInit(800, 600)) {
+    if(!videoInit(64 * scale, 32 * scale, vsync)) {
         exit = true;
         printf("Video could not be initialized!");
     }
-    
-    // The main game loop
-    while(!exit) {
-        int start_time = SDL_GetTicks();
 
-        // Get input from the User. This does not wait for input only reads the event queue
-        exit = inputPoll(chip8.key);
+    // The sound goes from the emulation to the audio device through a ring big enough for a
+    // tick of the emulation and a few device buffers. Without a device the game runs silently.
+    CHIP8AudioRing audio_ring(AUDIO_SAMPLE_RATE / EMULATION_RATE + 4 * audio_buffer);
+    bool audio = !exit && !mute && audioInit(&audio_ring, audio_buffer);
 
-        // Process one instruction loaded into the CHIP-8's memory
-        for(int i = 0; i < chip8_ticks; i++) {
-            chip8.step();
-        }
-        chip8.timerUpdate();
+    // The interpreter runs on a thread of its own from here on, it gets input through the
+    // queue and hands finished frames back through the triple buffer
+    CHIP8InputQueue input_queue;
+    CHIP8FrameBuffer frames;
+    if(!exit && !emulationStart(&chip8, &input_queue, &frames, chip8_cpu_freq, state_file.c_str(), movie_file, run_ahead, spectate, audio ? &audio_ring : NULL)) {
+        exit = true;
+    }
+
+    // Frames are presented at the display's rate, the emulation runs at its own pace
+    uint64_t counter_frequency = SDL_GetPerformanceFrequency();
+    uint64_t frame_ticks = counter_frequency / videoRefreshRate();
+    uint64_t next_frame = SDL_GetPerformanceCounter() + frame_ticks;
 
-        // Update the screen the CHIP-8 has updated its display
-        if(chip8.draw_flag) {
-            videoDraw(chip8.display);
-            chip8.draw_flag = 0;
+    // The main loop only handles events and presents frames, so a slow present never holds
+    // up the emulation
+    while(!exit) {
+        // Get input from the User. This does not wait for input only reads the event queue
+        int queued = 0;
+        exit = inputPoll(input_queue, queued);
+        if(queued > 0) {
+            emulationWake();
         }
 
-        // Calculate FPS
-        int fps_ticks = SDL_GetTicks() - fps_timer;
-        float fps_avg = frames / (fps_ticks / 1000.f);
-        if(fps_avg > 2000000) {
-            fps_avg = 0;
+        // Present the newest frame. With vsync every refresh is presented since that is
+        // what paces the loop.
+        bool fresh = frames.acquire();
+        bool idle = emulationIdle();
+        if(fresh || (vsync && !idle)) {
+            const CHIP8Frame &frame = frames.front();
+            videoDraw(frame.display, frame.width, frame.height);
         }
-        frames++;
 
-        int tick_time = SDL_GetTicks() - start_time;
-        // Cap screen refresh time
-        if(tick_time < screen_ticks_per_frame) {
-            // Wait remaining time 
-            SDL_Delay(screen_ticks_per_frame - tick_time);
+        if(idle) {
+            // Nothing changes until there is input, the emulation thread also wakes this one
+            // up when it publishes a frame
+            inputWait(EMULATION_IDLE_WAIT);
+            next_frame = SDL_GetPerformanceCounter() + frame_ticks;
+        } else if(!vsync) {
+            // Without vsync, sleep until the next refresh. Presenting a little late only
+            // delays the picture, the emulation keeps its own time. Input cuts the sleep
+            // short so it reaches the emulation as soon as it comes in.
+            if(sleepUntil(next_frame, counter_frequency)) {
+                next_frame += frame_ticks;
+                // Don't try to catch up on frames that were missed
+                uint64_t now = SDL_GetPerformanceCounter();
+                if(next_frame < now) {
+                    next_frame = now + frame_ticks;
+                }
+            }
         }
     }
 
+    emulationStop();
+    audioClose();
+
     // Destroy the SDL window
     videoClose();
 
+#ifdef CHIP8_PROFILE
+    chip8.profileReport(stdout);
+#endif
+
     return 0;
-}
\ No newline at end of file
+}
@@ -0,0 +1,158 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <signal.h>
+
+#include <chrono>
+#include <thread>
+
+#include "chip8.hpp"
+#include "scheduler.hpp"
+#include "server.hpp"
+
+/**
+ * Headless spectator server. Runs a ROM in real time and broadcasts its display to the
+ * viewers connected to it (chip8-view) whenever draw_flag is set. Nobody plays: keys are
+ * never pressed, so it is meant for demos and attract modes. To watch a game someone is
+ * playing, start the emulator with --spectate instead. Linux only.
+ **/
+
+// ==================================================================================================
+// Variables
+// ==================================================================================================
+// Where viewers connect when --listen isn't given
+#define DEFAULT_LISTEN      "localhost:8064"
+
+// Frames between the status lines printed with --verbose, every 10 seconds
+#define STATUS_FRAMES       600
+
+static volatile sig_atomic_t interrupted = 0;
+
+// ==================================================================================================
+// Helpers
+// ==================================================================================================
+/**
+ * Prints the command line usage of the server
+ **/
+static void printUsage(const char *name) {
+    printf("Usage: %s [options] <rom>\n", name);
+    printf("  -l, --listen A    Address to listen on: a Unix socket path (anything with a /),\n");
+    printf("                    a port, or host:port (default %s)\n", DEFAULT_LISTEN);
+    printf("  -z, --hz N        CPU frequency (default 500)\n");
+    printf("  -e, --engine E    interpreter (default), cached or jit\n");
+    printf("  -p, --platform P  Platform: chip8 (default), cosmac, schip or xochip\n");
+    printf("  -s, --seed N      Seed for the CXNN random numbers (default: fixed)\n");
+    printf("  -f, --frames N    Stop after N frames (default: until interrupted)\n");
+    printf("  -v, --verbose     Print the number of spectators every 10 seconds\n");
+}
+
+static void onSignal(int signal) {
+    interrupted = 1;
+}
+
+// ==================================================================================================
+// Main
+// ==================================================================================================
+int main(int argc, char *argv[]) {
+    CHIP8Engine engine = CHIP8_ENGINE_INTERPRETER;
+    CHIP8Platform platform = CHIP8_PLATFORM_CHIP8;
+    uint64_t seed = CHIP8_DEFAULT_SEED;
+    int cpu_freq = 500;
+    uint64_t max_frames = 0;
+    bool verbose = false;
+    const char *address = DEFAULT_LISTEN;
+    const char *rom = NULL;
+
+    for(int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        bool has_value = (i + 1) < argc;
+        if((!strcmp(arg, "-l") || !strcmp(arg, "--listen")) && has_value) {
+            address = argv[++i];
+        } else if((!strcmp(arg, "-z") || !strcmp(arg, "--hz")) && has_value) {
+            cpu_freq = atoi(argv[++i]);
+        } else if((!strcmp(arg, "-e") || !strcmp(arg, "--engine")) && has_value) {
+            const char *name = argv[++i];
+            if(!strcmp(name, "interpreter")) {
+                engine = CHIP8_ENGINE_INTERPRETER;
+            } else if(!strcmp(name, "cached")) {
+                engine = CHIP8_ENGINE_CACHED;
+            } else if(!strcmp(name, "jit")) {
+                engine = CHIP8_ENGINE_JIT;
+            } else {
+                fprintf(stderr, "Unknown engine '%s'\n", name);
+                return 1;
+            }
+        } else if((!strcmp(arg, "-p") || !strcmp(arg, "--platform")) && has_value) {
+            const char *name = argv[++i];
+            if(!chip8PlatformFromName(name, platform)) {
+                fprintf(stderr, "Unknown platform '%s'\n", name);
+                return 1;
+            }
+        } else if((!strcmp(arg, "-s") || !strcmp(arg, "--seed")) && has_value) {
+            seed = strtoull(argv[++i], NULL, 0);
+        } else if((!strcmp(arg, "-f") || !strcmp(arg, "--frames")) && has_value) {
+            max_frames = strtoull(argv[++i], NULL, 10);
+        } else if(!strcmp(arg, "-v") || !strcmp(arg, "--verbose")) {
+            verbose = true;
+        } else if(arg[0] == '-' || rom != NULL) {
+            printUsage(argv[0]);
+            return 1;
+        } else {
+            rom = arg;
+        }
+    }
+
+    if(rom == NULL) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    CHIP8Interpreter chip8;
+    chip8.setPlatform(platform);
+    chip8.seed(seed);
+    chip8.setEngine(engine);
+    CHIP8RomError error;
+    if(!chip8.loadRom(rom, &error)) {
+        fprintf(stderr, "Can't load %s: %s\n", rom, chip8RomErrorText(error));
+        return 1;
+    }
+
+    SpectatorServer server;
+    if(!server.listen(address) || !server.start()) {
+        return 1;
+    }
+    signal(SIGINT, onSignal);
+    signal(SIGTERM, onSignal);
+    printf("Serving %s on %s\n", rom, address);
+    fflush(stdout);
+
+    // Same pacing as the front end: a frame of instructions 60 times a second, the fractions
+    // of an instruction carried over and the timers ticking where they fall
+    CHIP8Scheduler scheduler(CHIP8_TIMER_FREQUENCY, (cpu_freq < 1) ? 1 : cpu_freq);
+    std::chrono::steady_clock::time_point next = std::chrono::steady_clock::now();
+    std::chrono::nanoseconds frame_time(1000000000 / 60);
+    uint64_t frames = 0;
+    while(!interrupted && (max_frames == 0 || frames < max_frames)) {
+        scheduler.run(chip8, scheduler.due(frames + 1));
+        if(chip8.draw_flag) {
+            server.publish(chip8);
+            chip8.draw_flag = 0;
+        }
+        frames++;
+
+        if(verbose && frames % STATUS_FRAMES == 0) {
+            printf("Frame %llu: %d spectators, %llu frames sent, %llu dropped\n", (unsigned long long)frames,
+                server.spectators(), (unsigned long long)server.framesSent(), (unsigned long long)server.framesDropped());
+            fflush(stdout);
+        }
+
+        next += frame_time;
+        std::this_thread::sleep_until(next);
+    }
+
+    printf("%llu frames, %llu sent, %llu copies dropped for slow spectators\n", (unsigned long long)frames,
+        (unsigned long long)server.framesSent(), (unsigned long long)server.framesDropped());
+    server.stop();
+    return 0;
+}
@@ -0,0 +1,380 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <netdb.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "framedelta.hpp"
+#include "server.hpp"
+
+// ==================================================================================================
+// Variables
+// ==================================================================================================
+// Events taken from epoll at a time
+#define SERVER_EVENTS       64
+// Connections waiting to be accepted
+#define SERVER_BACKLOG      64
+
+// What the epoll data of the two server descriptors is, spectators have their pointer
+#define SERVER_LISTEN_TAG   ((void *)1)
+#define SERVER_WAKE_TAG     ((void *)2)
+
+// ==================================================================================================
+// Public Functions
+// ==================================================================================================
+SpectatorServer::SpectatorServer() : stopping(false), spectator_count(0), frames_sent(0), frames_dropped(0) {
+    listen_fd = -1;
+    epoll_fd = -1;
+    wake_fd = -1;
+    memset(&last, 0, sizeof(last));
+    has_frame = false;
+    keyframe_valid = false;
+}
+
+SpectatorServer::~SpectatorServer() {
+    stop();
+}
+
+/**
+ * Opens the socket viewers connect to
+ *
+ * @param   address     Path of a Unix domain socket (anything with a / in it), a port
+ *                      number to listen on every interface, or host:port
+ * @return              false if it couldn't be opened, the reason is printed
+ **/
+bool SpectatorServer::listen(const char *address) {
+    if(strchr(address, '/') != NULL) {
+        struct sockaddr_un local;
+        if(strlen(address) >= sizeof(local.sun_path)) {
+            fprintf(stderr, "Socket path too long: %s\n", address);
+            return false;
+        }
+        memset(&local, 0, sizeof(local));
+        local.sun_family = AF_UNIX;
+        strcpy(local.sun_path, address);
+
+        // A socket file left behind by an earlier run would make bind() fail
+        unlink(address);
+        listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if(listen_fd < 0 || bind(listen_fd, (struct sockaddr *)&local, sizeof(local)) != 0) {
+            perror(address);
+            return false;
+        }
+        unix_path = address;
+    } else {
+        std::string host;
+        const char *port = address;
+        const char *colon = strrchr(address, ':');
+        if(colon != NULL) {
+            host.assign(address, colon - address);
+            port = colon + 1;
+        }
+
+        struct addrinfo hints;
+        memset(&hints, 0, sizeof(hints));
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        hints.ai_flags = AI_PASSIVE;
+        struct addrinfo *found = NULL;
+        int error = getaddrinfo(host.empty() ? NULL : host.c_str(), port, &hints, &found);
+        if(error != 0) {
+            fprintf(stderr, "%s: %s\n", address, gai_strerror(error));
+            return false;
+        }
+        listen_fd = socket(found->ai_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        int reuse = 1;
+        if(listen_fd >= 0) {
+            setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+        }
+        bool bound = listen_fd >= 0 && bind(listen_fd, found->ai_addr, found->ai_addrlen) == 0;
+        freeaddrinfo(found);
+        if(!bound) {
+            perror(address);
+            return false;
+        }
+    }
+
+    if(::listen(listen_fd, SERVER_BACKLOG) != 0) {
+        perror(address);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Starts the server thread, after listen()
+ *
+ * @return  false if epoll couldn't be set up
+ **/
+bool SpectatorServer::start() {
+    epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if(epoll_fd < 0 || wake_fd < 0) {
+        perror("epoll");
+        return false;
+    }
+
+    struct epoll_event event;
+    event.events = EPOLLIN;
+    event.data.ptr = SERVER_LISTEN_TAG;
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, listen_fd, &event);
+    event.data.ptr = SERVER_WAKE_TAG;
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, wake_fd, &event);
+
+    thread = std::thread(&SpectatorServer::run, this);
+    return true;
+}
+
+/**
+ * Disconnects every spectator and closes the server, waiting for its thread
+ **/
+void SpectatorServer::stop() {
+    if(thread.joinable()) {
+        stopping.store(true);
+        uint64_t one = 1;
+        if(write(wake_fd, &one, sizeof(one)) < 0) {
+            // The counter is already non-zero, the thread is being woken anyway
+        }
+        thread.join();
+    }
+    for(size_t i = 0; i < clients.size(); i++) {
+        close(clients[i]->fd);
+        delete clients[i];
+    }
+    clients.clear();
+    spectator_count.store(0);
+
+    int *fds[3] = { &listen_fd, &epoll_fd, &wake_fd };
+    for(int i = 0; i < 3; i++) {
+        if(*fds[i] >= 0) {
+            close(*fds[i]);
+            *fds[i] = -1;
+        }
+    }
+    if(!unix_path.empty()) {
+        unlink(unix_path.c_str());
+        unix_path.clear();
+    }
+}
+
+/**
+ * Hands the display to the server. Called by the thread running the interpreter, usually
+ * whenever draw_flag is set. Never waits: when the server hasn't taken the frame before
+ * this one yet, that one is replaced.
+ *
+ * @param   chip8   The interpreter to take the display from
+ **/
+void SpectatorServer::publish(const CHIP8Interpreter &chip8) {
+    frames.publish(chip8);
+    uint64_t one = 1;
+    if(write(wake_fd, &one, sizeof(one)) < 0) {
+        // EAGAIN only happens with the counter about to overflow, the server is awake then
+    }
+}
+
+// ==================================================================================================
+// Private Functions
+// ==================================================================================================
+/**
+ * The server thread
+ **/
+void SpectatorServer::run() {
+    struct epoll_event events[SERVER_EVENTS];
+    while(!stopping.load()) {
+        int count = epoll_wait(epoll_fd, events, SERVER_EVENTS, -1);
+        if(count < 0 && errno != EINTR) {
+            perror("epoll_wait");
+            return;
+        }
+
+        for(int i = 0; i < count; i++) {
+            void *tag = events[i].data.ptr;
+            if(tag == SERVER_LISTEN_TAG) {
+                accept();
+            } else if(tag == SERVER_WAKE_TAG) {
+                uint64_t posted;
+                if(read(wake_fd, &posted, sizeof(posted)) > 0 && frames.acquire()) {
+                    broadcast();
+                }
+            } else {
+                Spectator *client = (Spectator *)tag;
+                if(events[i].events & (EPOLLERR | EPOLLHUP | EPOLLRDHUP)) {
+                    disconnect(client);
+                    continue;
+                }
+                if(events[i].events & EPOLLIN) {
+                    // Viewers have nothing to say, whatever they send is thrown away
+                    uint8_t ignored[256];
+                    ssize_t size = recv(client->fd, ignored, sizeof(ignored), 0);
+                    if(size == 0 || (size < 0 && errno != EAGAIN && errno != EWOULDBLOCK)) {
+                        disconnect(client);
+                        continue;
+                    }
+                }
+                if((events[i].events & EPOLLOUT) && flush(client) && client->resync) {
+                    queueKeyframe(client);
+                }
+            }
+        }
+
+        // Closed spectators are only freed once none of this round's events can point at them
+        for(size_t c = 0; c < clients.size(); ) {
+            if(clients[c]->fd < 0) {
+                delete clients[c];
+                clients.erase(clients.begin() + c);
+            } else {
+                c++;
+            }
+        }
+        spectator_count.store(clients.size(), std::memory_order_relaxed);
+    }
+}
+
+/**
+ * Takes every pending connection
+ **/
+void SpectatorServer::accept() {
+    while(true) {
+        int fd = accept4(listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if(fd < 0) {
+            return;
+        }
+
+        Spectator *client = new Spectator();
+        client->fd = fd;
+        client->sent = 0;
+        client->resync = true;
+        client->writing = false;
+
+        struct epoll_event event;
+        event.events = EPOLLIN | EPOLLRDHUP;
+        event.data.ptr = client;
+        epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event);
+        clients.push_back(client);
+
+        // Without a frame yet the first update turns into its keyframe
+        if(has_frame) {
+            queueKeyframe(client);
+        }
+    }
+}
+
+/**
+ * Encodes the frame just acquired against the last one and queues it for everyone
+ **/
+void SpectatorServer::broadcast() {
+    const CHIP8Frame &frame = frames.front();
+    message.clear();
+    CHIP8FrameDelta::encode(frame, has_frame ? &last : NULL, message);
+    last = frame;
+    has_frame = true;
+    keyframe_valid = false;
+    frames_sent.fetch_add(1, std::memory_order_relaxed);
+
+    for(size_t c = 0; c < clients.size(); c++) {
+        Spectator *client = clients[c];
+        if(client->fd < 0) {
+            continue;
+        }
+        if(!client->resync) {
+            queue(client, message);
+        } else if(client->pending.empty()) {
+            // Caught up again, or never had a frame
+            queueKeyframe(client);
+        } else {
+            frames_dropped.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+}
+
+/**
+ * Queues a message for a spectator and sends what the socket takes, or drops the message
+ * if the spectator is too far behind
+ **/
+void SpectatorServer::queue(Spectator *client, const std::vector<uint8_t> &data) {
+    if(client->pending.size() - client->sent + data.size() > SPECTATOR_QUEUE_LIMIT) {
+        client->resync = true;
+        frames_dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    client->pending.insert(client->pending.end(), data.begin(), data.end());
+    flush(client);
+}
+
+/**
+ * Queues a keyframe of the last frame, the spectator is in sync again afterwards
+ **/
+void SpectatorServer::queueKeyframe(Spectator *client) {
+    if(!keyframe_valid) {
+        keyframe.clear();
+        CHIP8FrameDelta::encode(last, NULL, keyframe);
+        keyframe_valid = true;
+    }
+    client->resync = false;
+    queue(client, keyframe);
+}
+
+/**
+ * Sends as much of the queue as the socket takes
+ *
+ * @return  true if the queue is empty afterwards
+ **/
+bool SpectatorServer::flush(Spectator *client) {
+    while(client->fd >= 0 && client->sent < client->pending.size()) {
+        ssize_t size = send(client->fd, &client->pending[client->sent], client->pending.size() - client->sent,
+            MSG_NOSIGNAL | MSG_DONTWAIT);
+        if(size < 0) {
+            if(errno == EAGAIN || errno == EWOULDBLOCK) {
+                // Drop what was sent once it is most of the buffer, so a spectator that
+                // never quite catches up keeps at most SPECTATOR_QUEUE_LIMIT queued
+                if(client->sent > client->pending.size() / 2) {
+                    client->pending.erase(client->pending.begin(), client->pending.begin() + client->sent);
+                    client->sent = 0;
+                }
+                watchWritable(client, true);
+                return false;
+            }
+            disconnect(client);
+            return false;
+        }
+        client->sent += size;
+    }
+    if(client->fd < 0) {
+        return false;
+    }
+    client->pending.clear();
+    client->sent = 0;
+    watchWritable(client, false);
+    return true;
+}
+
+/**
+ * Asks epoll to report when the spectator's socket can take more, or stops it
+ **/
+void SpectatorServer::watchWritable(Spectator *client, bool writable) {
+    if(client->writing == writable) {
+        return;
+    }
+    struct epoll_event event;
+    event.events = EPOLLIN | EPOLLRDHUP | (writable ? EPOLLOUT : 0);
+    event.data.ptr = client;
+    epoll_ctl(epoll_fd, EPOLL_CTL_MOD, client->fd, &event);
+    client->writing = writable;
+}
+
+/**
+ * Closes a spectator's connection, run() frees it at the end of the round
+ **/
+void SpectatorServer::disconnect(Spectator *client) {
+    if(client->fd < 0) {
+        return;
+    }
+    epoll_ctl(epoll_fd, EPOLL_CTL_DEL, client->fd, NULL);
+    close(client->fd);
+    client->fd = -1;
+}
@@ -0,0 +1,88 @@
+#ifndef SPECTATOR_SERVER_H
+#define SPECTATOR_SERVER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "chip8.hpp"
+#include "framebuffer.hpp"
+
+// Bytes a subscriber may have waiting to be sent, frames that don't fit are dropped for it
+#define SPECTATOR_QUEUE_LIMIT   (64 * 1024)
+
+/**
+ * A viewer connected to the server
+ **/
+struct Spectator {
+    int fd;
+    std::vector<uint8_t> pending;   // Messages waiting for the socket
+    size_t sent;                    // Bytes of pending already sent
+    bool resync;                    // Frames were dropped, it needs a keyframe before any update
+    bool writing;                   // Waiting for the socket to be writable
+};
+
+/**
+ * Broadcasts the display of a running interpreter to any number of viewers, over TCP or
+ * a Unix domain socket (Linux only, it is built on epoll).
+ *
+ * The thread running the interpreter calls publish() whenever the display changed. That
+ * only copies the display into a CHIP8FrameBuffer and pokes an eventfd, it never waits
+ * for the server. The server's own thread takes the newest frame, encodes the rows that
+ * changed since the last frame it sent (CHIP8FrameDelta) once, and queues the message for
+ * every spectator. Sockets are non-blocking: a spectator whose queue would go past
+ * SPECTATOR_QUEUE_LIMIT has the frame dropped, and once its queue has drained it is sent
+ * a keyframe of the frame current then and carries on with the updates. New spectators
+ * start with a keyframe too.
+ **/
+class SpectatorServer {
+    public:
+        SpectatorServer();
+        ~SpectatorServer();
+        bool listen(const char *address);
+        bool start();
+        void stop();
+
+        // ======================================== Producer ========================================
+        void publish(const CHIP8Interpreter &chip8);
+
+        // ======================================== Statistics ========================================
+        int spectators() const { return spectator_count.load(std::memory_order_relaxed); }
+        uint64_t framesSent() const { return frames_sent.load(std::memory_order_relaxed); }
+        uint64_t framesDropped() const { return frames_dropped.load(std::memory_order_relaxed); }
+
+    private:
+        int listen_fd;
+        int epoll_fd;
+        int wake_fd;                        // eventfd written by publish() and stop()
+        std::string unix_path;              // Socket file to remove when stopping, if any
+        std::thread thread;
+        std::atomic<bool> stopping;
+        CHIP8FrameBuffer frames;
+
+        // Server thread only
+        std::vector<Spectator *> clients;
+        CHIP8Frame last;                    // The frame the newest update is relative to
+        bool has_frame;                     // Something was published
+        std::vector<uint8_t> message;       // Update for everyone in sync
+        std::vector<uint8_t> keyframe;      // Keyframe of last, made when a spectator needs it
+        bool keyframe_valid;
+
+        std::atomic<int> spectator_count;
+        std::atomic<uint64_t> frames_sent;
+        std::atomic<uint64_t> frames_dropped;
+
+        void run();
+        void accept();
+        void broadcast();
+        void queue(Spectator *client, const std::vector<uint8_t> &data);
+        void queueKeyframe(Spectator *client);
+        bool flush(Spectator *client);
+        void watchWritable(Spectator *client, bool writable);
+        void disconnect(Spectator *client);
+};
+
+#endif // SPECTATOR_SERVER_H
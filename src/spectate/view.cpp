@@ -0,0 +1,224 @@
+#include <stdlib.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <netdb.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "framedelta.hpp"
+
+/**
+ * Spectator viewer. Connects to chip8-serve and draws the display it broadcasts in the
+ * terminal, two rows of pixels per line with half block characters. Linux only.
+ **/
+
+// ==================================================================================================
+// Variables
+// ==================================================================================================
+#define DEFAULT_CONNECT     "localhost:8064"
+
+// Bytes read from the socket at a time
+#define READ_SIZE           4096
+
+// ==================================================================================================
+// Helpers
+// ==================================================================================================
+/**
+ * Prints the command line usage of the viewer
+ **/
+static void printUsage(const char *name) {
+    printf("Usage: %s [options] [address]\n", name);
+    printf("  address           A Unix socket path (anything with a /), a port, or host:port\n");
+    printf("                    (default %s)\n", DEFAULT_CONNECT);
+    printf("  -n, --frames N    Quit after N frames\n");
+    printf("  -q, --quiet       Print a line per frame instead of drawing it\n");
+    printf("  -d, --delay MS    Wait MS milliseconds after every frame, to try a slow spectator\n");
+}
+
+/**
+ * @param   address     Where the server listens, as given to chip8-serve
+ * @return              The connected socket, -1 on failure (the reason is printed)
+ **/
+static int connectTo(const char *address) {
+    if(strchr(address, '/') != NULL) {
+        struct sockaddr_un remote;
+        if(strlen(address) >= sizeof(remote.sun_path)) {
+            fprintf(stderr, "Socket path too long: %s\n", address);
+            return -1;
+        }
+        memset(&remote, 0, sizeof(remote));
+        remote.sun_family = AF_UNIX;
+        strcpy(remote.sun_path, address);
+        int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if(fd < 0 || connect(fd, (struct sockaddr *)&remote, sizeof(remote)) != 0) {
+            perror(address);
+            return -1;
+        }
+        return fd;
+    }
+
+    std::string host = "localhost";
+    const char *port = address;
+    const char *colon = strrchr(address, ':');
+    if(colon != NULL) {
+        host.assign(address, colon - address);
+        port = colon + 1;
+    }
+    struct addrinfo hints;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    struct addrinfo *found = NULL;
+    int error = getaddrinfo(host.c_str(), port, &hints, &found);
+    if(error != 0) {
+        fprintf(stderr, "%s: %s\n", address, gai_strerror(error));
+        return -1;
+    }
+    int fd = -1;
+    for(struct addrinfo *option = found; option != NULL; option = option->ai_next) {
+        fd = socket(option->ai_family, option->ai_socktype, option->ai_protocol);
+        if(fd >= 0 && connect(fd, option->ai_addr, option->ai_addrlen) == 0) {
+            break;
+        }
+        if(fd >= 0) {
+            close(fd);
+            fd = -1;
+        }
+    }
+    freeaddrinfo(found);
+    if(fd < 0) {
+        perror(address);
+    }
+    return fd;
+}
+
+/**
+ * Draws the display, the cursor is moved back to the top left first
+ **/
+static void drawFrame(const CHIP8FrameDecoder &decoder) {
+    const CHIP8Frame &frame = decoder.frame();
+    std::string text = "\x1b[H";
+    for(int y = 0; y < frame.height; y += 2) {
+        for(int x = 0; x < frame.width; x++) {
+            bool top = decoder.getPixel(x, y);
+            bool bottom = decoder.getPixel(x, y + 1);
+            text += top ? (bottom ? "█" : "▀") : (bottom ? "▄" : " ");
+        }
+        text += "\n";
+    }
+    fputs(text.c_str(), stdout);
+    fflush(stdout);
+}
+
+/**
+ * @return  FNV-1a of the pixels shown, so runs can be compared in quiet mode
+ **/
+static uint64_t frameHash(const CHIP8FrameDecoder &decoder) {
+    const CHIP8Frame &frame = decoder.frame();
+    uint64_t hash = 0xCBF29CE484222325ULL;
+    for(int y = 0; y < frame.height; y++) {
+        for(int x = 0; x < frame.width; x++) {
+            hash = (hash ^ decoder.getPixel(x, y)) * 0x100000001B3ULL;
+        }
+    }
+    return hash;
+}
+
+// ==================================================================================================
+// Main
+// ==================================================================================================
+int main(int argc, char *argv[]) {
+    const char *address = DEFAULT_CONNECT;
+    uint64_t max_frames = 0;
+    bool quiet = false;
+    int delay = 0;
+
+    for(int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        bool has_value = (i + 1) < argc;
+        if((!strcmp(arg, "-n") || !strcmp(arg, "--frames")) && has_value) {
+            max_frames = strtoull(argv[++i], NULL, 10);
+        } else if(!strcmp(arg, "-q") || !strcmp(arg, "--quiet")) {
+            quiet = true;
+        } else if((!strcmp(arg, "-d") || !strcmp(arg, "--delay")) && has_value) {
+            delay = atoi(argv[++i]);
+        } else if(arg[0] == '-') {
+            printUsage(argv[0]);
+            return 1;
+        } else {
+            address = arg;
+        }
+    }
+
+    int fd = connectTo(address);
+    if(fd < 0) {
+        return 1;
+    }
+    if(!quiet) {
+        // Clear the screen and hide the cursor
+        printf("\x1b[2J\x1b[?25l");
+    }
+
+    CHIP8FrameDecoder decoder;
+    std::vector<uint8_t> stream;
+    uint8_t buffer[READ_SIZE];
+    uint64_t frames = 0;
+    uint64_t skipped = 0;
+    uint64_t last_number = 0;
+    bool malformed = false;
+    while(!malformed && (max_frames == 0 || frames < max_frames)) {
+        ssize_t size = recv(fd, buffer, sizeof(buffer), 0);
+        if(size <= 0) {
+            break;
+        }
+        stream.insert(stream.end(), buffer, buffer + size);
+
+        size_t offset = 0;
+        while(max_frames == 0 || frames < max_frames) {
+            size_t length = CHIP8FrameDelta::messageSize(&stream[offset], stream.size() - offset);
+            // A length no frame can have means the stream is corrupt, don't wait for it
+            bool too_long = length > CHIP8_DELTA_MAX_SIZE;
+            if(!too_long && (length == 0 || stream.size() - offset < length)) {
+                break;
+            }
+            if(too_long || !decoder.decode(&stream[offset], length)) {
+                fprintf(stderr, "Malformed message at frame %llu\n", (unsigned long long)frames);
+                malformed = true;
+                break;
+            }
+            offset += length;
+
+            // The server left out frames for us when we fell behind
+            uint64_t number = decoder.frame().number;
+            if(frames > 0 && number > last_number + 1) {
+                skipped += number - last_number - 1;
+            }
+            last_number = number;
+            frames++;
+
+            if(quiet) {
+                printf("%llu %016llx\n", (unsigned long long)number, (unsigned long long)frameHash(decoder));
+            } else {
+                drawFrame(decoder);
+            }
+            if(delay > 0) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(delay));
+            }
+        }
+        stream.erase(stream.begin(), stream.begin() + offset);
+    }
+    close(fd);
+
+    if(!quiet) {
+        printf("\x1b[?25h");
+    }
+    fprintf(stderr, "%llu frames shown, %llu skipped\n", (unsigned long long)frames, (unsigned long long)skipped);
+    return malformed ? 1 : 0;
+}
@@ -8,27 +8,156 @@
 SDL_Window* window = NULL;
 //The window renderer
 SDL_Renderer* renderer = NULL;
+//Streaming texture big enough for the 128x64 display, the top left corner is used in low resolution
+SDL_Texture* texture = NULL;
+
+// Colour of each pixel value (ARGB8888): bit 0 is the first plane and bit 1 the second
+static const Uint32 palette[1 << CHIP8_PLANES] = {
+	0xFF000000,	// Unlit
+	0xFFFFFFFF,	// First plane, the only one before XO-CHIP
+	0xFFAAAAAA,	// Second plane
+	0xFF555555	// Both planes
+};
+
+// The display as it was last uploaded to the texture
+static uint64_t uploaded[CHIP8_PLANES][CHIP8_HIRES_HEIGHT][2];
+static bool uploaded_valid = false;
+// Size of the display that was last drawn
+static int screen_width = CHIP8_SCREEN_WIDTH;
+static int screen_height = CHIP8_SCREEN_HEIGHT;
+
+// Where the game screen goes in the window, recalculated when the window is resized
+static SDL_Rect viewport;
+static bool viewport_valid = false;
+
+// The renderer lost its device and every texture with it, the texture is made again before the next draw
+static bool texture_lost = false;
+
+/**
+ * Event watch that notices when the window size changes or the renderer loses what it drew
+ **/
+static int videoEventWatch(void *userdata, SDL_Event *event) {
+	if(event->type == SDL_WINDOWEVENT && event->window.event == SDL_WINDOWEVENT_SIZE_CHANGED) {
+		viewport_valid = false;
+	}
+	// The texture contents (or the texture itself, when the device is reset) are gone, so
+	// every row has to be uploaded again. The output may have changed size as well.
+	if(event->type == SDL_RENDER_TARGETS_RESET || event->type == SDL_RENDER_DEVICE_RESET) {
+		uploaded_valid = false;
+		viewport_valid = false;
+	}
+	if(event->type == SDL_RENDER_DEVICE_RESET) {
+		texture_lost = true;
+	}
+	return 0;
+}
+
+/**
+ * Creates the streaming texture the display is uploaded to
+ *
+ * @return	false if it couldn't be created, the reason is printed
+ **/
+static bool videoCreateTexture() {
+	texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING, CHIP8_HIRES_WIDTH, CHIP8_HIRES_HEIGHT);
+	if(texture == NULL) {
+		printf( "Texture could not be created! SDL Error: %s\n", SDL_GetError() );
+		return false;
+	}
+	texture_lost = false;
+	uploaded_valid = false;
+	return true;
+}
+
+/**
+ * Calculates the largest viewport with square pixels that fits in the window, centred
+ **/
+static void videoLayout() {
+	// Window dimensions
+	int window_width = 0;
+	int window_height = 0;
+	SDL_GetRendererOutputSize(renderer, &window_width, &window_height);
+
+	// Calculate the size of each pixel on the high resolution grid, so the viewport keeps
+	// its size when the program switches resolution
+	int size = window_width / CHIP8_HIRES_WIDTH;
+	int tmp = window_height / CHIP8_HIRES_HEIGHT;
+	if(tmp < size) {
+		size = tmp;
+	}
+	if(size < 1) {
+		size = 1;
+	}
+
+	// Padding to centre the game viewport
+	viewport.x = (window_width - (CHIP8_HIRES_WIDTH * size)) / 2;
+	viewport.y = (window_height - (CHIP8_HIRES_HEIGHT * size)) / 2;
+	viewport.w = CHIP8_HIRES_WIDTH * size;
+	viewport.h = CHIP8_HIRES_HEIGHT * size;
+	viewport_valid = true;
+}
+
+/**
+ * @param	display		The CHIP-8 display
+ * @param	y			A row of it
+ * @return				True if the row is the same as when it was last uploaded
+ **/
+static bool videoRowUploaded(const uint64_t display[CHIP8_PLANES][CHIP8_HIRES_HEIGHT][2], int y) {
+	if(!uploaded_valid) {
+		return false;
+	}
+	for(int plane=0; plane<CHIP8_PLANES; plane++) {
+		if(display[plane][y][0] != uploaded[plane][y][0] || display[plane][y][1] != uploaded[plane][y][1]) {
+			return false;
+		}
+	}
+	return true;
+}
+
+/**
+ * Converts rows of the display into texture pixels and uploads them
+ *
+ * @param	display		The CHIP-8 display
+ * @param	first		The first row to upload
+ * @param	count		The number of rows to upload
+ **/
+static void videoUploadRows(const uint64_t display[CHIP8_PLANES][CHIP8_HIRES_HEIGHT][2], int first, int count) {
+	Uint32 pixels[CHIP8_HIRES_HEIGHT][CHIP8_HIRES_WIDTH];
+	for(int y=0; y<count; y++) {
+		for(int x=0; x<screen_width; x++) {
+			int shift = 63 - (x & 63);
+			int value = 0;
+			for(int plane=0; plane<CHIP8_PLANES; plane++) {
+				value |= ((display[plane][first + y][x >> 6] >> shift) & 1) << plane;
+			}
+			pixels[y][x] = palette[value];
+		}
+	}
+
+	SDL_Rect rect = {0, first, screen_width, count};
+	SDL_UpdateTexture(texture, &rect, pixels, sizeof(pixels[0]));
+}
 
 /**
  * Initialize SDL window and settings
  * 
  * @param	width	Width of the window
  * @param	height	Height of the window
+ * @param	vsync	Wait for the display's vertical blank when presenting
  * @return			True if initialization succesfull
  **/
-bool videoInit(int width, int height) {
+bool videoInit(int width, int height, bool vsync) {
     // Initialize SDL
     if(SDL_Init(SDL_INIT_VIDEO) < 0) {
         printf("SDL could not initialize! SDL_Error: %s\n", SDL_GetError());
         return false;
     } else {
         //Create window
-		window = SDL_CreateWindow("CHIP-8", SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, width, height, SDL_WINDOW_SHOWN);
+		window = SDL_CreateWindow("CHIP-8", SDL_WINDOWPOS_UNDEFINED, SDL_WINDOWPOS_UNDEFINED, width, height, SDL_WINDOW_SHOWN | SDL_WINDOW_RESIZABLE);
 		if(window == NULL) {
 			printf( "Window could not be created! SDL_Error: %s\n", SDL_GetError() );
 		} else {
-			//Create renderer for window - Vsync disabled
-			renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED);
+			//Create renderer for window
+			renderer = SDL_CreateRenderer(window, -1, SDL_RENDERER_ACCELERATED | (vsync ? SDL_RENDERER_PRESENTVSYNC : 0));
 			if(renderer == NULL) {
 				printf( "Renderer could not be created! SDL Error: %s\n", SDL_GetError() );
 				return false;
@@ -37,6 +166,14 @@ bool videoInit(int width, int height) {
 				SDL_SetRenderDrawColor(renderer, 0xFF, 0xFF, 0xFF, 0xFF);
 				// Clear screen
 				SDL_RenderClear(renderer);
+
+				// Scale the display up with hard pixel edges
+				SDL_SetHint(SDL_HINT_RENDER_SCALE_QUALITY, "0");
+				if(!videoCreateTexture()) {
+					return false;
+				}
+				viewport_valid = false;
+				SDL_AddEventWatch(videoEventWatch, NULL);
 			}
 		}
     }
@@ -44,13 +181,27 @@ bool videoInit(int width, int height) {
     return true;
 }
 
+/**
+ * @return	The refresh rate of the display the window is on, 60 if it is unknown
+ **/
+int videoRefreshRate() {
+	SDL_DisplayMode mode;
+	if(window == NULL || SDL_GetWindowDisplayMode(window, &mode) != 0 || mode.refresh_rate <= 0) {
+		return 60;
+	}
+	return mode.refresh_rate;
+}
+
 /**
  * Close SDL window and free related memory
  **/
 void videoClose() {
+	SDL_DelEventWatch(videoEventWatch, NULL);
+	SDL_DestroyTexture(texture);
+	texture = NULL;
     //Destroy window
-	SDL_DestroyWindow(window);
 	SDL_DestroyRenderer(renderer);
+	SDL_DestroyWindow(window);
 	window = NULL;
 	renderer = NULL;
 	//Quit SDL subsystems
@@ -58,51 +209,64 @@ void videoClose() {
 }
 
 /**
- * Draws the the CHIP-8 display to the game screen
+ * Draws the the CHIP-8 display to the game screen. Only the rows that changed since the
+ * last call are uploaded to the texture, which is then drawn with a single copy.
  * 
- * @param	display		A 64x32 2D array containing information about the CHIP-8 display
+ * @param	display		The rows of each plane of the CHIP-8 display, one bit per pixel with the
+ * 						leftmost pixel in the most significant bit of the first word
+ * @param	width		Width of the display in its current resolution
+ * @param	height		Height of the display in its current resolution
  **/
-void videoDraw(uint8_t display[64][32]) {
-	// Clear screen
-	SDL_SetRenderDrawColor(renderer, 0x38, 0x39, 0x3A, 0x00);
-	SDL_RenderClear(renderer);
-
-	// Window dimensions
-	int window_width = 0;
-	int window_height = 0;
-	SDL_GetWindowSize(window, &window_width, &window_height);
-
-	// Calculate the size of each pixel
-	int size = (int)SDL_floor(window_width / 64);
-	int tmp = (int)SDL_floor(window_height / 32);
-	if(tmp < size) {
-		size = tmp;
+void videoDraw(const uint64_t display[CHIP8_PLANES][CHIP8_HIRES_HEIGHT][2], int width, int height) {
+	// After a device reset the old texture can only be destroyed, drawing waits for a new one
+	if(texture_lost) {
+		SDL_DestroyTexture(texture);
+		if(!videoCreateTexture()) {
+			return;
+		}
 	}
 
-	// Padding to centre the game viewport
-	int x_padding = (int)SDL_floor((window_width - (64 * size)) / 2);
-	int y_padding = (int)SDL_floor((window_height - (32 * size)) / 2);
-
-	// Make game screen have black background
-	SDL_SetRenderDrawColor(renderer, 0x00, 0x00, 0x00, 0x00);
-	SDL_Rect sprite = {x_padding, y_padding, size * 64, size * 32};
-	SDL_RenderFillRect(renderer, &sprite);
-
-	// Draw the game screen	
-	SDL_SetRenderDrawColor(renderer, 0xFF, 0xFF, 0xFF, 0xFF);
+	// A change of resolution changes every row
+	if(width != screen_width || height != screen_height) {
+		screen_width = width;
+		screen_height = height;
+		uploaded_valid = false;
+	}
 
-	for(int y=0; y<32; y++) {
-		for(int x=0; x<64; x++) { 
-			if(display[x][y]) {
-				SDL_Rect sprite = {(x*size)+x_padding, (y*size)+y_padding, size, size};
-				SDL_RenderFillRect(renderer, &sprite);
+	// Upload each run of changed rows
+	int y = 0;
+	while(y < screen_height) {
+		if(videoRowUploaded(display, y)) {
+			y++;
+			continue;
+		}
+		int first = y;
+		while(y < screen_height && !videoRowUploaded(display, y)) {
+			for(int plane=0; plane<CHIP8_PLANES; plane++) {
+				uploaded[plane][y][0] = display[plane][y][0];
+				uploaded[plane][y][1] = display[plane][y][1];
 			}
+			y++;
 		}
+		videoUploadRows(display, first, y - first);
+	}
+	uploaded_valid = true;
+
+	if(!viewport_valid) {
+		videoLayout();
 	}
 
+	// Clear screen
+	SDL_SetRenderDrawColor(renderer, 0x38, 0x39, 0x3A, 0x00);
+	SDL_RenderClear(renderer);
+
+	// Draw the part of the texture the current resolution uses
+	SDL_Rect source = {0, 0, screen_width, screen_height};
+	SDL_RenderCopy(renderer, texture, &source, &viewport);
+
 	// Add border to the game screen
-	SDL_Rect sprite2 = {x_padding, y_padding, size * 64, size * 32};
-	SDL_RenderDrawRect(renderer, &sprite2);
+	SDL_SetRenderDrawColor(renderer, 0xFF, 0xFF, 0xFF, 0xFF);
+	SDL_RenderDrawRect(renderer, &viewport);
 
 	//Update screen
 	SDL_RenderPresent(renderer);
@@ -1,16 +1,25 @@
 #ifndef VIDEO_H
 #define VIDEO_H
 
+#include <stdint.h>
 #include <SDL.h>
 
+#include "chip8.hpp"
+
 /**
  * Initialize SDL window and settings
  * 
  * @param	width	Width of the window
  * @param	height	Height of the window
+ * @param	vsync	Wait for the display's vertical blank when presenting
  * @return			True if initialization succesfull
  **/
-bool videoInit(int width, int height);
+bool videoInit(int width, int height, bool vsync);
+
+/**
+ * @return	The refresh rate of the display the window is on, 60 if it is unknown
+ **/
+int videoRefreshRate();
 
 /**
  * Close SDL window and free related memory
@@ -18,10 +27,14 @@ bool videoInit(int width, int height);
 void videoClose();
 
 /**
- * Draws the the CHIP-8 display to the game screen
+ * Draws the the CHIP-8 display to the game screen. Only the rows that changed since the
+ * last call are uploaded to the texture, which is then drawn with a single copy.
  * 
- * @param	display		A 64x32 2D array containing information about the CHIP-8 display
+ * @param	display		The rows of each plane of the CHIP-8 display, one bit per pixel with the
+ * 						leftmost pixel in the most significant bit of the first word
+ * @param	width		Width of the display in its current resolution
+ * @param	height		Height of the display in its current resolution
  **/
-void videoDraw(uint8_t display[64][32]);
+void videoDraw(const uint64_t display[CHIP8_PLANES][CHIP8_HIRES_HEIGHT][2], int width, int height);
 
 #endif // VIDEO_H
\ No newline at end of file